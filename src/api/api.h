@@ -17,8 +17,45 @@
 /**
  * \page api API
  * 
- * The API library currently contains no working functionality, and is set
- * up  for future expansion. 
+ * The API library holds the core functionality of *MediaIndex* that does
+ * not depend on Qt:
+ * 
+ * * `api::exif` -- reading EXIF data from the headers of image files
+ * 
+ * * `api::thumbnail_store` -- a persistent, disk-backed store of encoded
+ *   thumbnails
+ * 
+ * * `api::scanner` -- a parallel scanner for media files in a directory
+ *   tree
+ * 
+ * * `api::media_index` -- a persistent index of media files, kept up to
+ *   date by incremental rescans, with running totals for each directory
+ * 
+ * * `api::watcher` -- a service that keeps the index and thumbnail store
+ *   up to date with changes to the file system
+ * 
+ * * `api::hash` and `api::find_duplicates` -- content hashing, and finding
+ *   files with identical contents
+ * 
+ * * `api::similarity` -- perceptual hashing, and searching for images that
+ *   look alike
+ * 
+ * * `api::read_metadata` and `api::extract_metadata` -- reading capture
+ *   time, camera, dimensions, orientation, location and keywords from
+ *   EXIF and XMP headers, and recording them in the index
+ * 
+ * * `api::search_index` and `api::posting_list` -- an inverted index over
+ *   that metadata, answering keyword, camera and date-range queries
+ *   combined with `AND`, `OR` and `NOT`
+ * 
+ * * `api::catalogue` -- a compact, column-wise snapshot of the index, for
+ *   filtering, sorting and totalling millions of files
+ * 
+ * * `api::path_table` -- compact storage of paths, interning directories
+ *   and packing names, with a 32-bit id for each path
+ * 
+ * * `api::batch_reader` -- reading many files at once, with deep queues of
+ *   reads in flight through `io_uring` (or threads, where it isn't there)
  */
 
 /**
@@ -0,0 +1,625 @@
+/**
+ * \file batch_reader.cpp
+ * Implement the `batch_reader` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Kernel headers older than 5.1 don't describe `io_uring`, in which case
+// only the threaded reader is built
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define API_BATCH_READER_IO_URING 1
+#endif
+#endif
+#endif
+#endif
+
+#include "batch_reader.h"
+#include "error.h"
+#include "large_file.h"
+#include "parallel.h"
+
+namespace api {
+
+const std::uint64_t read_request::whole_file;
+
+namespace {
+
+/**
+ * \brief The most bytes asked for by one read system call, which returns
+ * its count as an `int`
+ */
+const std::uint64_t max_chunk = 1 << 30;
+
+/**
+ * \brief Work out how many bytes a request reads from a file of a given
+ * size
+ */
+std::uint64_t wanted(const read_request& request, std::uint64_t file_size)
+{
+    if (request.offset >= file_size) return 0;
+    return std::min(request.length, file_size - request.offset);
+}   // end wanted function
+
+#if defined(__linux__)
+
+/**
+ * \brief Open a file for a request, and size its buffer
+ * 
+ * \return The file descriptor, or -1 if the file couldn't be opened, in
+ * which case the error is set in the result
+ */
+int open_for(
+        const read_request& request
+        , bool evict
+        , read_result& result)
+{
+    int fd = ::open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        result.error = errno;
+        return -1;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        result.error = errno;
+        ::close(fd);
+        return -1;
+    }
+
+    if (evict) ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    result.file_size = static_cast<std::uint64_t>(st.st_size);
+    result.data.resize(
+        static_cast<std::size_t>(wanted(request, result.file_size)));
+    return fd;
+}   // end open_for function
+
+/**
+ * \brief Make a request with blocking reads
+ */
+void read_blocking(
+        const read_request& request
+        , bool evict
+        , read_result& result)
+{
+    int fd = open_for(request, evict, result);
+    if (fd < 0) return;
+
+    std::size_t done = 0;
+    while (done < result.data.size())
+    {
+        auto chunk = std::min<std::uint64_t>(
+            result.data.size() - done
+            , max_chunk);
+        auto n = ::pread(
+            fd
+            , result.data.data() + done
+            , static_cast<std::size_t>(chunk)
+            , static_cast<off_t>(request.offset + done));
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) result.error = errno;
+        if (n <= 0) break;
+        done += static_cast<std::size_t>(n);
+    }
+
+    ::close(fd);
+    result.data.resize(done);
+}   // end read_blocking function
+
+#else
+
+/**
+ * \brief Make a request with blocking reads
+ */
+void read_blocking(
+        const read_request& request
+        , bool
+        , read_result& result)
+{
+    std::FILE* file = std::fopen(request.path.c_str(), "rb");
+    if (!file)
+    {
+        result.error = errno;
+        return;
+    }
+
+    if (!large_file::size(file, result.file_size)
+            || !large_file::seek(file, request.offset))
+    {
+        result.error = errno;
+        std::fclose(file);
+        return;
+    }
+
+    result.data.resize(
+        static_cast<std::size_t>(wanted(request, result.file_size)));
+    result.data.resize(
+        std::fread(result.data.data(), 1, result.data.size(), file));
+    if (std::ferror(file)) result.error = EIO;
+    std::fclose(file);
+}   // end read_blocking function
+
+#endif
+
+}   // end anonymous namespace
+
+#if defined(API_BATCH_READER_IO_URING)
+
+/**
+ * \brief An `io_uring`, set up with raw system calls, and the reads in
+ * flight through it
+ * 
+ * Only one thread submits to and reaps from the ring, so the only memory
+ * ordering needed is with the kernel, on the ring indices.
+ */
+struct batch_reader::ring
+{
+    /**
+     * \brief A read in flight
+     */
+    struct slot
+    {
+        std::size_t request = 0;    ///< The position of the request
+        int fd = -1;                ///< The open file
+        std::uint64_t offset = 0;   ///< Where the read started
+        std::size_t done = 0;       ///< The bytes read so far
+        read_result result;         ///< The result being built
+        ::iovec iov;                ///< The buffer for the current read
+    };  // end slot struct
+
+    int fd = -1;                    ///< The ring's file descriptor
+    unsigned entries = 0;           ///< The size of the submission queue
+
+    void* sq_map = MAP_FAILED;      ///< The submission ring mapping
+    std::size_t sq_map_size = 0;    ///< Its size
+    void* cq_map = MAP_FAILED;      ///< The completion ring mapping
+    std::size_t cq_map_size = 0;    ///< Its size
+    void* sqe_map = MAP_FAILED;     ///< The submission entries mapping
+    std::size_t sqe_map_size = 0;   ///< Its size
+
+    unsigned* sq_tail = nullptr;    ///< The kernel's submission tail
+    unsigned* sq_array = nullptr;   ///< The submission index array
+    unsigned sq_mask = 0;           ///< Masks submission indices
+    unsigned tail = 0;              ///< Our submission tail, unpublished
+    unsigned unsubmitted = 0;       ///< Entries not yet taken by the kernel
+    ::io_uring_sqe* sqes = nullptr; ///< The submission entries
+
+    unsigned* cq_head = nullptr;    ///< The completion head
+    unsigned* cq_tail = nullptr;    ///< The kernel's completion tail
+    unsigned cq_mask = 0;           ///< Masks completion indices
+    ::io_uring_cqe* cqes = nullptr; ///< The completion entries
+
+    /**
+     * \brief The reads in flight, one per submission entry, so there is
+     * always room to submit a read for every slot
+     * 
+     * These belong to the ring, rather than to a call to `read`, because
+     * the kernel writes into their buffers for as long as they are in
+     * flight.
+     */
+    std::vector<slot> slots;
+
+    /**
+     * \brief Whether a system call on the ring has failed, so it can't be
+     * used again
+     */
+    bool broken = false;
+
+    /**
+     * \brief For testing, the number of entries into the ring up to the
+     * one that fails as though the system call had; 0 never fails
+     */
+    unsigned fail_after = 0;
+
+    /**
+     * \brief Set up a ring
+     * 
+     * \return `false` if `io_uring` isn't available
+     */
+    bool setup(unsigned depth);
+
+    /**
+     * \brief Destructor, unmapping and closing the ring
+     */
+    ~ring(void);
+
+    /**
+     * \brief Queue a read of the rest of a slot's buffer (without
+     * submitting it)
+     */
+    void queue(std::size_t index);
+
+    /**
+     * \brief Submit the queued reads, and wait for at least one read to
+     * complete
+     * 
+     * \throw api::error The ring has failed
+     */
+    void submit_and_wait(void);
+};  // end ring struct
+
+bool batch_reader::ring::setup(unsigned depth)
+{
+    ::io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    fd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+    if (fd < 0) return false;
+
+    entries = params.sq_entries;
+    sq_map_size = params.sq_off.array + entries * sizeof(unsigned);
+    cq_map_size = params.cq_off.cqes
+        + params.cq_entries * sizeof(::io_uring_cqe);
+    sqe_map_size = entries * sizeof(::io_uring_sqe);
+
+    sq_map = ::mmap(
+        nullptr
+        , sq_map_size
+        , PROT_READ | PROT_WRITE
+        , MAP_SHARED | MAP_POPULATE
+        , fd
+        , IORING_OFF_SQ_RING);
+    cq_map = ::mmap(
+        nullptr
+        , cq_map_size
+        , PROT_READ | PROT_WRITE
+        , MAP_SHARED | MAP_POPULATE
+        , fd
+        , IORING_OFF_CQ_RING);
+    sqe_map = ::mmap(
+        nullptr
+        , sqe_map_size
+        , PROT_READ | PROT_WRITE
+        , MAP_SHARED | MAP_POPULATE
+        , fd
+        , IORING_OFF_SQES);
+    if (sq_map == MAP_FAILED || cq_map == MAP_FAILED
+            || sqe_map == MAP_FAILED)
+        return false;
+
+    auto sq = static_cast<char*>(sq_map);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    tail = *sq_tail;
+    sqes = static_cast<::io_uring_sqe*>(sqe_map);
+
+    auto cq = static_cast<char*>(cq_map);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<::io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    slots.resize(entries);
+    return true;
+}   // end setup method
+
+batch_reader::ring::~ring(void)
+{
+    // Files are only left open by reads that were in flight when the ring
+    // failed
+    for (auto& s : slots)
+        if (s.fd >= 0) ::close(s.fd);
+
+    if (sqe_map != MAP_FAILED) ::munmap(sqe_map, sqe_map_size);
+    if (cq_map != MAP_FAILED) ::munmap(cq_map, cq_map_size);
+    if (sq_map != MAP_FAILED) ::munmap(sq_map, sq_map_size);
+    if (fd >= 0) ::close(fd);
+}
+
+void batch_reader::ring::queue(std::size_t index)
+{
+    auto& s = slots[index];
+    auto& data = s.result.data;
+    s.iov.iov_base = data.data() + s.done;
+    s.iov.iov_len = static_cast<std::size_t>(
+        std::min<std::uint64_t>(data.size() - s.done, max_chunk));
+
+    // `IORING_OP_READV` is used rather than `IORING_OP_READ`, which needs
+    // kernel 5.6
+    unsigned i = tail & sq_mask;
+    auto& sqe = sqes[i];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = s.fd;
+    sqe.off = s.offset + s.done;
+    sqe.addr = reinterpret_cast<std::uint64_t>(&s.iov);
+    sqe.len = 1;
+    sqe.user_data = index;
+    sq_array[i] = i;
+    ++tail;
+    ++unsubmitted;
+}   // end queue method
+
+void batch_reader::ring::submit_and_wait(void)
+{
+    // The entries must be visible to the kernel before the new tail
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+    long n = -1;
+    errno = EIO;
+    if (fail_after == 0 || --fail_after > 0)
+    {
+        n = ::syscall(
+            __NR_io_uring_enter
+            , fd
+            , unsubmitted
+            , 1
+            , IORING_ENTER_GETEVENTS
+            , nullptr
+            , 0);
+    }
+    if (n >= 0)
+    {
+        unsubmitted -= static_cast<unsigned>(n);
+        return;
+    }
+
+    // Entries that weren't taken are submitted again on the next call
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) return;
+
+    broken = true;
+    throw error(
+        std::string("io_uring_enter failed: ") + std::strerror(errno));
+}   // end submit_and_wait method
+
+#else
+
+/**
+ * \brief A placeholder for the `io_uring`, which isn't available
+ */
+struct batch_reader::ring
+{
+};  // end ring struct
+
+#endif
+
+batch_reader::batch_reader(void) : batch_reader(options())
+{
+}
+
+batch_reader::batch_reader(const options& opts) :
+        m_options(opts)
+        , m_ring()
+{
+    m_options.queue_depth = std::max(1u, m_options.queue_depth);
+
+#if defined(API_BATCH_READER_IO_URING)
+    if (m_options.use_io_uring)
+    {
+        // Setting up fails where the kernel doesn't support `io_uring`, or
+        // it has been disabled (e.g. by a container's seccomp policy)
+        m_ring.reset(new ring());
+        if (!m_ring->setup(m_options.queue_depth)) m_ring.reset();
+        else m_ring->fail_after = m_options.fail_io_uring_on;
+    }
+#endif
+}
+
+batch_reader::~batch_reader(void)
+{
+}
+
+bool batch_reader::uses_io_uring(void) const
+{
+#if defined(API_BATCH_READER_IO_URING)
+    return m_ring && !m_ring->broken;
+#else
+    return false;
+#endif
+}   // end uses_io_uring method
+
+void batch_reader::read(
+        const std::vector<read_request>& requests
+        , const sink& s)
+{
+    if (uses_io_uring()) read_ring(requests, s);
+    else read_threads(requests, s);
+}   // end read method
+
+#if defined(API_BATCH_READER_IO_URING)
+
+void batch_reader::read_ring(
+        const std::vector<read_request>& requests
+        , const sink& s)
+{
+    auto& r = *m_ring;
+
+    std::vector<std::size_t> free_slots;
+    for (std::size_t i = r.slots.size(); i > 0; --i)
+        free_slots.push_back(i - 1);
+
+    std::size_t next = 0, in_flight = 0;
+    std::uint64_t bytes = 0;
+
+    // Once the sink has thrown, the reads in flight are waited for (their
+    // buffers are still being written to), but nothing more is started or
+    // reported
+    std::exception_ptr failure;
+    std::vector<bool> reported(requests.size(), false);
+    auto report = [&](std::size_t request, read_result&& result)
+    {
+        reported[request] = true;
+        if (failure) return;
+        try
+        {
+            s(request, std::move(result));
+        }
+        catch (...)
+        {
+            failure = std::current_exception();
+        }
+    };
+
+    auto finish = [&](std::size_t index)
+    {
+        auto& slot = r.slots[index];
+        ::close(slot.fd);
+        slot.fd = -1;
+        bytes -= slot.result.data.size();
+        slot.result.data.resize(slot.done);
+        --in_flight;
+        free_slots.push_back(index);
+        report(slot.request, std::move(slot.result));
+    };
+
+    while (in_flight > 0 || (next < requests.size() && !failure))
+    {
+        // Start reads while there are free slots and buffer space; a read
+        // is always started if nothing else is in flight
+        while (!failure
+                && next < requests.size()
+                && !free_slots.empty()
+                && (in_flight == 0 || bytes < m_options.max_bytes_in_flight))
+        {
+            std::size_t request = next++;
+
+            read_result result;
+            int fd = open_for(requests[request], m_options.evict, result);
+            if (fd < 0 || result.data.empty())
+            {
+                if (fd >= 0) ::close(fd);
+                report(request, std::move(result));
+                continue;
+            }
+
+            std::size_t index = free_slots.back();
+            free_slots.pop_back();
+
+            auto& slot = r.slots[index];
+            slot.request = request;
+            slot.fd = fd;
+            slot.offset = requests[request].offset;
+            slot.done = 0;
+            slot.result = std::move(result);
+            bytes += slot.result.data.size();
+            ++in_flight;
+            r.queue(index);
+        }
+
+        if (in_flight == 0) continue;
+
+        // The reads still in flight when the ring fails are left to it, as
+        // the kernel may yet write to their buffers
+        try
+        {
+            r.submit_and_wait();
+        }
+        catch (const error&)
+        {
+            break;
+        }
+
+        unsigned head = *r.cq_head;
+        unsigned tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const auto& cqe = r.cqes[head & r.cq_mask];
+            auto index = static_cast<std::size_t>(cqe.user_data);
+            auto& slot = r.slots[index];
+            int res = cqe.res;
+
+            if (res == -EINTR || res == -EAGAIN) r.queue(index);
+            else if (res < 0)
+            {
+                slot.result.error = -res;
+                finish(index);
+            }
+            else
+            {
+                // A short read is continued; an empty one means that the
+                // file has shrunk since it was opened
+                slot.done += static_cast<std::size_t>(res);
+                if (res > 0 && slot.done < slot.result.data.size())
+                    r.queue(index);
+                else finish(index);
+            }
+        }
+
+        // The completion entries may be reused once the new head is seen
+        __atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (failure) std::rethrow_exception(failure);
+    if (!r.broken) return;
+
+    // Everything the ring didn't finish is read again by threads
+    std::vector<std::size_t> positions;
+    std::vector<read_request> rest;
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        if (reported[i]) continue;
+        positions.push_back(i);
+        rest.push_back(requests[i]);
+    }
+
+    read_threads(rest, [&](std::size_t i, read_result&& result)
+        { s(positions[i], std::move(result)); });
+}   // end read_ring method
+
+#else
+
+void batch_reader::read_ring(
+        const std::vector<read_request>& requests
+        , const sink& s)
+{
+    read_threads(requests, s);
+}   // end read_ring method
+
+#endif
+
+void batch_reader::read_threads(
+        const std::vector<read_request>& requests
+        , const sink& s) const
+{
+    // The sink is never called concurrently, and an exception from it
+    // stops the threads, and is passed on once they have finished
+    std::mutex sink_mutex;
+    bool stopped = false;
+    parallel_for(requests.size(), m_options.queue_depth, [&](std::size_t i)
+    {
+        read_result result;
+        read_blocking(requests[i], m_options.evict, result);
+
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        if (stopped) return;
+        try
+        {
+            s(i, std::move(result));
+        }
+        catch (...)
+        {
+            stopped = true;
+            throw;
+        }
+    });
+}   // end read_threads method
+
+}   // end api namespace
@@ -0,0 +1,199 @@
+/**
+ * \file batch_reader.h
+ * Declare the `batch_reader` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _api_batch_reader_h_included
+#define _api_batch_reader_h_included
+
+namespace api {
+
+/**
+ * \brief A read of part or all of a file, for a `batch_reader`
+ */
+struct read_request
+{
+    std::string path;               ///< The path of the file
+    std::uint64_t offset = 0;       ///< Where to start reading
+
+    /**
+     * \brief The most bytes to read; `whole_file` reads to the end
+     */
+    std::uint64_t length = whole_file;
+
+    /**
+     * \brief The length that reads everything from the offset on
+     */
+    static const std::uint64_t whole_file = ~std::uint64_t(0);
+};  // end read_request struct
+
+/**
+ * \brief The result of a read by a `batch_reader`
+ */
+struct read_result
+{
+    /**
+     * \brief The bytes read; this is shorter than asked for if the file
+     * ends first
+     */
+    std::vector<unsigned char> data;
+
+    /**
+     * \brief The size of the whole file, if it could be opened
+     */
+    std::uint64_t file_size = 0;
+
+    /**
+     * \brief The `errno` value for a read that failed; 0 for success
+     */
+    int error = 0;
+};  // end read_result struct
+
+/**
+ * \brief Reads many files (or the starts of many files) at once
+ * 
+ * Reading files one at a time, with a blocking read for each, leaves
+ * storage that can serve many requests in parallel (such as an NVMe SSD)
+ * mostly idle on a cold cache, and pays for a system call per read. A
+ * batch reader instead keeps a deep queue of reads in flight, and hands
+ * each result to the client as soon as it arrives, in whatever order they
+ * finish.
+ * 
+ * On Linux, reads are submitted through an `io_uring`, many to a system
+ * call, and reaped from its completion queue; the files are still opened
+ * and closed with ordinary system calls. Where `io_uring` isn't available
+ * (other systems, kernels before 5.1, or where it is disabled), the reader
+ * falls back to a pool of threads, each making blocking `pread` calls.
+ * 
+ * A reader may only be used by one thread at a time, but several readers
+ * may be used at once.
+ */
+class batch_reader
+{
+    public:
+
+    /**
+     * \brief The type of function that receives the result of each read
+     * 
+     * This is given the position of the request in the batch. It is never
+     * called concurrently, but may be called from the reader's worker
+     * threads.
+     */
+    using sink = std::function<void(std::size_t, read_result&&)>;
+
+    /**
+     * \brief Reader configuration
+     */
+    struct options
+    {
+        /**
+         * \brief The number of reads to keep in flight at once; this is
+         * also the number of threads used without `io_uring`
+         */
+        unsigned queue_depth = 32;
+
+        /**
+         * \brief The most bytes to hold in buffers for reads in flight
+         * through `io_uring`; new reads wait while there are this many, but
+         * a read of any size is made when nothing else is in flight
+         */
+        std::uint64_t max_bytes_in_flight = 256 * 1024 * 1024;
+
+        /**
+         * \brief Whether to use `io_uring` where it is available
+         */
+        bool use_io_uring = true;
+
+        /**
+         * \brief Whether to drop each file from the operating system's
+         * page cache before reading it, so that the read comes from disk;
+         * this is for measuring cold-cache performance
+         */
+        bool evict = false;
+
+        /**
+         * \brief For testing, the time the `io_uring` is entered on which
+         * to fail as though the system call had; 0 never fails
+         */
+        unsigned fail_io_uring_on = 0;
+    };  // end options struct
+
+    /**
+     * \brief Constructor, using the default configuration
+     */
+    batch_reader(void);
+
+    /**
+     * \brief Constructor, setting the configuration
+     */
+    explicit batch_reader(const options& opts);
+
+    /**
+     * \brief Destructor
+     */
+    ~batch_reader(void);
+
+    batch_reader(const batch_reader&) = delete;
+    batch_reader& operator=(const batch_reader&) = delete;
+
+    /**
+     * \brief Whether reads are made through `io_uring`, rather than by
+     * threads
+     */
+    bool uses_io_uring(void) const;
+
+    /**
+     * \brief Make a batch of reads, blocking until they are all complete
+     * 
+     * Files that can't be opened or read are reported to the sink with an
+     * error, like any other result.
+     * 
+     * \param requests The reads to make
+     * 
+     * \param s The function that receives the result of each read
+     * 
+     * If the `io_uring` fails, the reads that it hadn't finished are made
+     * again by threads, as are all later batches.
+     * 
+     * An exception thrown by the sink is passed on once the reads in
+     * flight have finished; no more results are reported after it.
+     */
+    void read(const std::vector<read_request>& requests, const sink& s);
+
+    private:
+
+    struct ring;                    ///< The `io_uring`, where there is one
+
+    /**
+     * \brief Make the reads through the `io_uring`
+     */
+    void read_ring(const std::vector<read_request>& requests, const sink& s);
+
+    /**
+     * \brief Make the reads with a pool of threads
+     */
+    void read_threads(
+        const std::vector<read_request>& requests
+        , const sink& s) const;
+
+    options m_options;              ///< The configuration
+    std::unique_ptr<ring> m_ring;   ///< The `io_uring`; null if not used
+
+};  // end batch_reader class
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * \file byte_order.h
+ * Declare helpers for reading and writing little-endian integers in the
+ * API's file formats
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+#include <vector>
+
+#ifndef _api_byte_order_h_included
+#define _api_byte_order_h_included
+
+namespace api {
+
+/**
+ * \brief Helpers for the little-endian integers used in the files written
+ * by the API, so that the files don't depend on the host byte order
+ */
+namespace byte_order {
+
+inline void put_u32(std::vector<unsigned char>& b, std::uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) b.push_back((v >> (8 * i)) & 0xff);
+}
+
+inline void put_u64(std::vector<unsigned char>& b, std::uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) b.push_back((v >> (8 * i)) & 0xff);
+}
+
+inline std::uint32_t get_u32(const unsigned char* p)
+{
+    return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8)
+        | (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+}
+
+inline std::uint64_t get_u64(const unsigned char* p)
+{
+    return std::uint64_t(get_u32(p)) | (std::uint64_t(get_u32(p + 4)) << 32);
+}
+
+}   // end byte_order namespace
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * \file calendar.h
+ * Declare a helper for converting calendar dates to days since the epoch
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+
+#ifndef _api_calendar_h_included
+#define _api_calendar_h_included
+
+namespace api {
+
+/**
+ * \brief Retrieve the number of days since the epoch of a date in the
+ * proleptic Gregorian calendar
+ * 
+ * This doesn't depend on the time zone or the C library's idea of the
+ * calendar, so dates convert the same everywhere.
+ */
+inline std::int64_t days_from_civil(int year, int month, int day)
+{
+    int y = year - (month <= 2 ? 1 : 0);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int year_of_era = y - era * 400;
+    int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100
+        + day_of_year;
+    return std::int64_t(era) * 146097 + day_of_era - 719468;
+}   // end days_from_civil function
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,340 @@
+/**
+ * \file catalogue.cpp
+ * Implement the `catalogue` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+
+#include "catalogue.h"
+
+namespace api {
+
+namespace {
+
+/**
+ * \brief The number of rows filtered at a time
+ * 
+ * The mask for a block stays in the L1 cache while each criterion is
+ * applied to it.
+ */
+const std::size_t block_rows = 4096;
+
+/**
+ * \brief Retrieve the position at which the file name in a path starts
+ */
+std::size_t name_start(const std::string& path)
+{
+    auto pos = path.find_last_of('/');
+    return pos == std::string::npos ? 0 : pos + 1;
+}
+
+/**
+ * \brief Map a signed value to an unsigned one with the same order
+ */
+inline std::uint64_t ordered(std::int64_t value)
+{
+    return static_cast<std::uint64_t>(value) ^ (std::uint64_t(1) << 63);
+}
+
+/**
+ * \brief Add up columns over a sequence of rows
+ * 
+ * \param count The number of rows
+ * 
+ * \param row_at A function giving the `i`th row; for all the rows, this is
+ * the identity, so that the loop runs straight down the columns
+ */
+template <typename RowAt>
+catalogue_totals add_up(
+        std::size_t count
+        , RowAt row_at
+        , const std::uint64_t* sizes
+        , const std::uint8_t* types
+        , const std::int64_t* capture_times)
+{
+    std::uint64_t type_files[3] = {};
+    std::uint64_t type_bytes[3] = {};
+    std::int64_t first = std::numeric_limits<std::int64_t>::max();
+    std::int64_t last = std::numeric_limits<std::int64_t>::min();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto row = row_at(i);
+        auto size = sizes[row];
+        auto type = types[row];
+
+        // Masks, rather than indexing the totals by type, keep the loop
+        // free of branches and scattered writes
+        for (unsigned t = 0; t < 3; ++t)
+        {
+            std::uint64_t match = type == t;
+            type_files[t] += match;
+            type_bytes[t] += size & (0 - match);
+        }
+
+        auto c = capture_times[row];
+        first = (c != 0 && c < first) ? c : first;
+        last = (c != 0 && c > last) ? c : last;
+    }
+
+    catalogue_totals result;
+    result.files = count;
+    for (unsigned t = 0; t < 3; ++t)
+    {
+        result.type_files[t] = type_files[t];
+        result.type_bytes[t] = type_bytes[t];
+        result.bytes += type_bytes[t];
+    }
+
+    if (first <= last)
+    {
+        result.first_capture_time = first;
+        result.last_capture_time = last;
+    }
+
+    return result;
+}   // end add_up function
+
+}   // end anonymous namespace
+
+catalogue::catalogue(const media_index& index) :
+    m_paths()
+    , m_directory_rows()
+    , m_sizes()
+    , m_mtimes()
+    , m_widths()
+    , m_heights()
+    , m_capture_times()
+    , m_types()
+{
+    // Gather the records, noting where their names start
+    std::vector<media_record> records;
+    std::vector<std::size_t> names;
+    records.reserve(index.size());
+    names.reserve(index.size());
+    index.for_each([&](const media_record& r)
+    {
+        records.push_back(r);
+        names.push_back(name_start(r.path));
+    });
+
+    // Order the files by directory, then by name, so that adding them to
+    // the path table in this order numbers the directories in order too
+    std::vector<std::uint32_t> order(records.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+
+    std::sort(
+        order.begin()
+        , order.end()
+        , [&](std::uint32_t a, std::uint32_t b)
+        {
+            const auto& pa = records[a].path;
+            const auto& pb = records[b].path;
+            auto da = names[a] > 1 ? names[a] - 1 : names[a];
+            auto db = names[b] > 1 ? names[b] - 1 : names[b];
+
+            int c = pa.compare(0, da, pb, 0, db);
+            if (c != 0) return c < 0;
+            return pa.compare(names[a], std::string::npos, pb, names[b]) < 0;
+        });
+
+    // Fill in the columns
+    auto count = records.size();
+    m_paths.reserve(count);
+    m_sizes.reserve(count);
+    m_mtimes.reserve(count);
+    m_widths.reserve(count);
+    m_heights.reserve(count);
+    m_capture_times.reserve(count);
+    m_types.reserve(count);
+
+    for (auto i : order)
+    {
+        const auto& r = records[i];
+
+        m_paths.intern(r.path);
+        m_sizes.push_back(r.size);
+        m_mtimes.push_back(r.mtime);
+        m_widths.push_back(r.width);
+        m_heights.push_back(r.height);
+        m_capture_times.push_back(r.metadata ? r.metadata->capture_time : 0);
+        m_types.push_back(static_cast<std::uint8_t>(r.type));
+    }
+
+    m_paths.shrink_to_fit();
+
+    // Count the files per directory, and turn the counts into first rows
+    m_directory_rows.assign(m_paths.directory_count() + 1, 0);
+    for (std::uint32_t row = 0; row < count; ++row)
+        ++m_directory_rows[m_paths.directory_id(row) + 1];
+    for (std::size_t d = 1; d < m_directory_rows.size(); ++d)
+        m_directory_rows[d] += m_directory_rows[d - 1];
+}   // end constructor
+
+std::pair<std::uint32_t, std::uint32_t> catalogue::rows_in(
+        const std::string& directory) const
+{
+    path_table::id_type d = 0;
+    if (!m_paths.find_directory(directory, d))
+        return std::make_pair(0u, 0u);
+
+    return std::make_pair(m_directory_rows[d], m_directory_rows[d + 1]);
+}   // end rows_in method
+
+catalogue::row_list catalogue::select(const catalogue_filter& filter) const
+{
+    const auto int_min = std::numeric_limits<std::int64_t>::min();
+    const auto int_max = std::numeric_limits<std::int64_t>::max();
+
+    bool by_size = filter.min_size > 0
+        || filter.max_size < std::numeric_limits<std::uint64_t>::max();
+    bool by_mtime = filter.min_mtime > int_min || filter.max_mtime < int_max;
+    bool by_dimensions = filter.min_width > 0 || filter.min_height > 0;
+    bool by_capture_time = filter.min_capture_time > int_min
+        || filter.max_capture_time < int_max;
+
+    row_list result(size());
+    std::size_t count = 0;
+
+    // Each criterion is applied down its column into a mask for the block;
+    // the loops have no branches, so they can be vectorised
+    std::uint8_t keep[block_rows];
+    for (std::size_t first = 0; first < size(); first += block_rows)
+    {
+        auto n = std::min(block_rows, size() - first);
+
+        const auto* types = m_types.data() + first;
+        for (std::size_t i = 0; i < n; ++i)
+            keep[i] = (filter.types >> types[i]) & 1;
+
+        if (by_size)
+        {
+            const auto* sizes = m_sizes.data() + first;
+            for (std::size_t i = 0; i < n; ++i)
+                keep[i] &= (sizes[i] >= filter.min_size)
+                    & (sizes[i] <= filter.max_size);
+        }
+
+        if (by_mtime)
+        {
+            const auto* mtimes = m_mtimes.data() + first;
+            for (std::size_t i = 0; i < n; ++i)
+                keep[i] &= (mtimes[i] >= filter.min_mtime)
+                    & (mtimes[i] <= filter.max_mtime);
+        }
+
+        if (by_dimensions)
+        {
+            const auto* widths = m_widths.data() + first;
+            const auto* heights = m_heights.data() + first;
+            for (std::size_t i = 0; i < n; ++i)
+                keep[i] &= (widths[i] >= filter.min_width)
+                    & (heights[i] >= filter.min_height);
+        }
+
+        if (by_capture_time)
+        {
+            const auto* times = m_capture_times.data() + first;
+            for (std::size_t i = 0; i < n; ++i)
+                keep[i] &= (times[i] != 0)
+                    & (times[i] >= filter.min_capture_time)
+                    & (times[i] <= filter.max_capture_time);
+        }
+
+        // Every row is written, but only the kept ones are counted
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            result[count] = static_cast<std::uint32_t>(first + i);
+            count += keep[i];
+        }
+    }
+
+    result.resize(count);
+    return result;
+}   // end select method
+
+void catalogue::sort(
+        row_list& rows
+        , catalogue_key key
+        , bool descending) const
+{
+    // Rows are already numbered in path order
+    if (key == catalogue_key::path)
+    {
+        std::sort(rows.begin(), rows.end());
+        if (descending) std::reverse(rows.begin(), rows.end());
+        return;
+    }
+
+    // The keys are gathered once, as unsigned numbers in the same order,
+    // and sorted with their rows, which break ties
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> keyed;
+    keyed.reserve(rows.size());
+    for (auto row : rows)
+    {
+        std::uint64_t k = 0;
+        switch (key)
+        {
+            case catalogue_key::size: k = m_sizes[row]; break;
+            case catalogue_key::mtime: k = ordered(m_mtimes[row]); break;
+
+            case catalogue_key::capture_time:
+                k = m_capture_times[row] == 0
+                    ? 0 : ordered(m_capture_times[row]);
+                break;
+
+            case catalogue_key::pixels:
+                k = std::uint64_t(m_widths[row]) * m_heights[row];
+                break;
+
+            default: break;
+        }
+
+        keyed.emplace_back(descending ? ~k : k, row);
+    }
+
+    std::sort(keyed.begin(), keyed.end());
+
+    for (std::size_t i = 0; i < rows.size(); ++i) rows[i] = keyed[i].second;
+}   // end sort method
+
+catalogue_totals catalogue::totals(void) const
+{
+    return add_up(
+        size()
+        , [](std::size_t i) { return i; }
+        , m_sizes.data()
+        , m_types.data()
+        , m_capture_times.data());
+}   // end totals method
+
+catalogue_totals catalogue::totals(const row_list& rows) const
+{
+    return add_up(
+        rows.size()
+        , [&rows](std::size_t i) { return rows[i]; }
+        , m_sizes.data()
+        , m_types.data()
+        , m_capture_times.data());
+}   // end totals method
+
+std::size_t catalogue::memory_usage(void) const
+{
+    return sizeof(*this)
+        + m_paths.memory_usage()
+        + m_directory_rows.capacity() * sizeof(std::uint32_t)
+        + m_sizes.capacity() * sizeof(std::uint64_t)
+        + m_mtimes.capacity() * sizeof(std::int64_t)
+        + m_widths.capacity() * sizeof(std::uint32_t)
+        + m_heights.capacity() * sizeof(std::uint32_t)
+        + m_capture_times.capacity() * sizeof(std::int64_t)
+        + m_types.capacity();
+}   // end memory_usage method
+
+}   // end api namespace
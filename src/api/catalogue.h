@@ -0,0 +1,268 @@
+/**
+ * \file catalogue.h
+ * Declare the `catalogue` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "media_index.h"
+#include "path_table.h"
+
+#ifndef _api_catalogue_h_included
+#define _api_catalogue_h_included
+
+namespace api {
+
+/**
+ * \brief The columns that a `catalogue` can be sorted on
+ */
+enum class catalogue_key
+{
+    path = 0        ///< Directory, then file name
+    , size          ///< File size
+    , mtime         ///< Modification time
+    , capture_time  ///< Capture time; files without one come first
+    , pixels        ///< Width times height
+};  // end catalogue_key enum
+
+/**
+ * \brief Criteria for selecting files from a `catalogue`
+ * 
+ * The ranges are inclusive, and the defaults select every file.
+ */
+struct catalogue_filter
+{
+    /**
+     * \brief The media types to select, as a mask of `1 << type`
+     */
+    unsigned types = 0x7;
+
+    std::uint64_t min_size = 0;     ///< The smallest file size
+
+    /**
+     * \brief The largest file size
+     */
+    std::uint64_t max_size = std::numeric_limits<std::uint64_t>::max();
+
+    /**
+     * \brief The earliest modification time
+     */
+    std::int64_t min_mtime = std::numeric_limits<std::int64_t>::min();
+
+    /**
+     * \brief The latest modification time
+     */
+    std::int64_t max_mtime = std::numeric_limits<std::int64_t>::max();
+
+    std::uint32_t min_width = 0;    ///< The smallest width, in pixels
+    std::uint32_t min_height = 0;   ///< The smallest height, in pixels
+
+    /**
+     * \brief The earliest capture time, in seconds since the epoch
+     * 
+     * If either end of the capture range is set, files without a capture
+     * time are not selected.
+     */
+    std::int64_t min_capture_time = std::numeric_limits<std::int64_t>::min();
+
+    /**
+     * \brief The latest capture time
+     */
+    std::int64_t max_capture_time = std::numeric_limits<std::int64_t>::max();
+};  // end catalogue_filter struct
+
+/**
+ * \brief Totals over a set of files in a `catalogue`
+ */
+struct catalogue_totals
+{
+    std::uint64_t files = 0;            ///< Number of files
+    std::uint64_t bytes = 0;            ///< Total size of the files
+    std::uint64_t type_files[3] = {};   ///< Number of files, by media type
+    std::uint64_t type_bytes[3] = {};   ///< Total size, by media type
+
+    /**
+     * \brief The earliest capture time; 0 if no file has one
+     */
+    std::int64_t first_capture_time = 0;
+
+    /**
+     * \brief The latest capture time; 0 if no file has one
+     */
+    std::int64_t last_capture_time = 0;
+};  // end catalogue_totals struct
+
+/**
+ * \brief A compact, read-only snapshot of the files in a `media_index`, for
+ * scanning, sorting and totalling large numbers of them
+ * 
+ * A `media_record` per file costs well over 100 bytes, mostly in a
+ * separately allocated path that repeats the directory of every file. A
+ * catalogue instead holds each field as a column: a contiguous array with
+ * an element per file. The paths are held in a `path_table`, whose ids are
+ * the row numbers, and every other field is a fixed-size number, so a file
+ * costs about 50 bytes plus its name.
+ * 
+ * Filters and totals run down one or two columns at a time, in simple
+ * loops that touch only the bytes they need and that the compiler can
+ * vectorise. Sorting gathers the sort column into an array of pairs once,
+ * rather than following a pointer per comparison.
+ * 
+ * Files are numbered (as *rows*) in order of directory and then name, so
+ * the files of a directory are consecutive rows.
+ * 
+ * Like `search_index`, a catalogue doesn't follow changes to the index,
+ * and should be rebuilt when `media_index::generation` changes. Once
+ * built, it may be used from several threads at once.
+ */
+class catalogue
+{
+    public:
+
+    /**
+     * \brief A list of row numbers
+     */
+    using row_list = std::vector<std::uint32_t>;
+
+    /**
+     * \brief Constructor, building the catalogue from a media index
+     */
+    explicit catalogue(const media_index& index);
+
+    /**
+     * \brief Retrieve the number of rows (files)
+     */
+    std::size_t size(void) const { return m_sizes.size(); }
+
+    /**
+     * \brief Retrieve the full path of a file
+     */
+    std::string path(std::uint32_t row) const { return m_paths.path(row); }
+
+    /**
+     * \brief Retrieve the path of the directory holding a file
+     */
+    const std::string& directory(std::uint32_t row) const
+        { return m_paths.directory(row); }
+
+    /**
+     * \brief Retrieve the name of a file
+     */
+    std::string name(std::uint32_t row) const { return m_paths.name(row); }
+
+    /**
+     * \brief Retrieve the table of paths, whose ids are row numbers
+     */
+    const path_table& paths(void) const { return m_paths; }
+
+    /**
+     * \brief Retrieve the size of a file
+     */
+    std::uint64_t file_size(std::uint32_t row) const
+        { return m_sizes[row]; }
+
+    /**
+     * \brief Retrieve the modification time of a file
+     */
+    std::int64_t mtime(std::uint32_t row) const { return m_mtimes[row]; }
+
+    /**
+     * \brief Retrieve the width of an image; 0 if unknown
+     */
+    std::uint32_t width(std::uint32_t row) const { return m_widths[row]; }
+
+    /**
+     * \brief Retrieve the height of an image; 0 if unknown
+     */
+    std::uint32_t height(std::uint32_t row) const { return m_heights[row]; }
+
+    /**
+     * \brief Retrieve the capture time of a file; 0 if unknown
+     */
+    std::int64_t capture_time(std::uint32_t row) const
+        { return m_capture_times[row]; }
+
+    /**
+     * \brief Retrieve the media type of a file
+     */
+    media_type type(std::uint32_t row) const
+        { return static_cast<media_type>(m_types[row]); }
+
+    /**
+     * \brief Retrieve the rows of the files directly in a directory
+     * 
+     * \return The first row and one past the last; both are equal if the
+     * directory has no files
+     */
+    std::pair<std::uint32_t, std::uint32_t> rows_in(
+        const std::string& directory) const;
+
+    /**
+     * \brief Select the rows of the files that match a filter, in row
+     * order
+     */
+    row_list select(const catalogue_filter& filter) const;
+
+    /**
+     * \brief Sort a list of rows
+     * 
+     * The sort is stable with respect to row order, so files with equal
+     * keys stay in path order.
+     */
+    void sort(
+        row_list& rows
+        , catalogue_key key
+        , bool descending = false) const;
+
+    /**
+     * \brief Retrieve the totals over all the files
+     */
+    catalogue_totals totals(void) const;
+
+    /**
+     * \brief Retrieve the totals over some of the files
+     */
+    catalogue_totals totals(const row_list& rows) const;
+
+    /**
+     * \brief Retrieve the approximate number of bytes used by the
+     * catalogue
+     */
+    std::size_t memory_usage(void) const;
+
+    private:
+
+    /**
+     * \brief The paths, with each row's path having the row number as its
+     * id, and the directories numbered in sorted order
+     */
+    path_table m_paths;
+
+    /**
+     * \brief The first row of each directory, by directory id, and the
+     * number of rows at the end
+     */
+    std::vector<std::uint32_t> m_directory_rows;
+
+    std::vector<std::uint64_t> m_sizes;         ///< File sizes
+    std::vector<std::int64_t> m_mtimes;         ///< Modification times
+    std::vector<std::uint32_t> m_widths;        ///< Widths
+    std::vector<std::uint32_t> m_heights;       ///< Heights
+    std::vector<std::int64_t> m_capture_times;  ///< Capture times
+    std::vector<std::uint8_t> m_types;          ///< Media types
+
+};  // end catalogue class
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * \file duplicates.cpp
+ * Implement functionality for finding duplicate media files
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <utility>
+
+#include "duplicates.h"
+#include "hash.h"
+#include "parallel.h"
+
+namespace api {
+
+namespace {
+
+/**
+ * \brief A candidate file, with what is known about its contents
+ */
+struct candidate
+{
+    media_record record;        ///< The index record
+    std::uint64_t ends_hash;    ///< The partial hash; 0 if not known
+    bool readable;              ///< Whether the file could be read
+};  // end candidate struct
+
+}   // end anonymous namespace
+
+std::vector<duplicate_group> find_duplicates(
+        media_index& index
+        , unsigned threads
+        , duplicate_statistics* stats)
+{
+    threads = thread_count(threads);
+
+    duplicate_statistics st{0, 0, 0, 0, 0, 0, 0};
+
+    // Stage 1: group by size
+    std::map<std::uint64_t, std::vector<candidate>> by_size;
+    index.for_each([&by_size, &st](const media_record& r)
+    {
+        ++st.files;
+        if (r.size > 0) by_size[r.size].push_back(candidate{r, 0, true});
+    });
+
+    std::vector<candidate*> to_hash;
+    for (auto& group : by_size)
+    {
+        if (group.second.size() < 2) continue;
+
+        st.same_size += group.second.size();
+        for (auto& c : group.second)
+            if (c.record.hash == 0) to_hash.push_back(&c);
+            else ++st.hashes_reused;
+    }
+
+    // Stage 2: hash the ends of files without a known full hash
+    std::atomic<std::uint64_t> bytes(0), errors(0);
+    parallel_for(to_hash.size(), threads, [&](std::size_t i)
+    {
+        std::uint64_t read = 0;
+        candidate& c = *to_hash[i];
+        c.readable = hash::hash_ends(c.record.path, c.ends_hash, &read);
+        if (!c.readable) ++errors;
+        bytes += read;
+    });
+    st.ends_hashed = to_hash.size();
+
+    // Stage 3: fully hash the files whose partial hash collides with
+    // another file's, or which might match a file whose full hash is known
+    to_hash.clear();
+    for (auto& group : by_size)
+    {
+        auto& files = group.second;
+        if (files.size() < 2) continue;
+
+        bool known = std::any_of(
+            files.begin()
+            , files.end()
+            , [](const candidate& c) { return c.record.hash != 0; });
+
+        std::map<std::uint64_t, std::size_t> ends_count;
+        for (const auto& c : files)
+            if (c.record.hash == 0 && c.readable) ++ends_count[c.ends_hash];
+
+        for (auto& c : files)
+            if (c.record.hash == 0 && c.readable
+                    && (known || ends_count[c.ends_hash] > 1))
+                to_hash.push_back(&c);
+    }
+
+    parallel_for(to_hash.size(), threads, [&](std::size_t i)
+    {
+        std::uint64_t read = 0;
+        candidate& c = *to_hash[i];
+        if (!hash::hash_file(c.record.path, c.record.hash, &read))
+        {
+            c.readable = false;
+            ++errors;
+        }
+        bytes += read;
+    });
+    st.fully_hashed = to_hash.size();
+
+    // Keep the hashes for next time; a file that has changed since it was
+    // indexed is simply not updated
+    for (auto c : to_hash)
+        if (c->readable)
+        {
+            const media_record& r = c->record;
+            index.set_details(
+                r.path
+                , r.size
+                , r.mtime
+                , r.width
+                , r.height
+                , r.hash);
+        }
+
+    // Group by full hash
+    std::vector<duplicate_group> result;
+    for (auto& group : by_size)
+    {
+        std::map<std::uint64_t, std::vector<std::string>> by_hash;
+        for (auto& c : group.second)
+            if (c.record.hash != 0 && c.readable)
+                by_hash[c.record.hash].push_back(std::move(c.record.path));
+
+        for (auto& h : by_hash)
+        {
+            if (h.second.size() < 2) continue;
+
+            std::sort(h.second.begin(), h.second.end());
+            result.push_back(
+                duplicate_group{group.first, h.first, std::move(h.second)});
+        }
+    }
+
+    std::sort(
+        result.begin()
+        , result.end()
+        , [](const duplicate_group& a, const duplicate_group& b)
+        {
+            return a.size * (a.paths.size() - 1)
+                > b.size * (b.paths.size() - 1);
+        });
+
+    st.bytes_read = bytes;
+    st.errors = errors;
+    if (stats) *stats = st;
+
+    return result;
+}   // end find_duplicates function
+
+}   // end api namespace
@@ -0,0 +1,83 @@
+/**
+ * \file duplicates.h
+ * Declare functionality for finding duplicate media files
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "media_index.h"
+
+#ifndef _api_duplicates_h_included
+#define _api_duplicates_h_included
+
+namespace api {
+
+/**
+ * \brief A set of files with identical contents
+ */
+struct duplicate_group
+{
+    std::uint64_t size;             ///< The size of each file
+    std::uint64_t hash;             ///< The content hash of each file
+    std::vector<std::string> paths; ///< The paths of the files, sorted
+};  // end duplicate_group struct
+
+/**
+ * \brief Counters reported by a search for duplicates
+ */
+struct duplicate_statistics
+{
+    std::uint64_t files;            ///< Number of files considered
+    std::uint64_t same_size;        ///< Files sharing their size
+    std::uint64_t ends_hashed;      ///< Files given a partial hash
+    std::uint64_t fully_hashed;     ///< Files given a full hash
+    std::uint64_t hashes_reused;    ///< Full hashes already in the index
+    std::uint64_t bytes_read;       ///< Total bytes read
+    std::uint64_t errors;           ///< Files that couldn't be read
+};  // end duplicate_statistics struct
+
+/**
+ * \brief Find the sets of files in an index with identical contents
+ * 
+ * Hashing every file in an archive would be bound by reading all of it, so
+ * files are narrowed down in stages, each more expensive than the last but
+ * applied to fewer files:
+ * 
+ * 1. Files are grouped by size, from the index, without reading anything;
+ *    a file with a unique size has no duplicates
+ * 
+ * 2. The remaining files are given a partial hash of their first and last
+ *    `hash::end_size` bytes, which separates almost all files that merely
+ *    share a size
+ * 
+ * 3. Only files that still collide are hashed in full
+ * 
+ * The hashing stages are spread over a pool of threads. Full hashes are
+ * written back to the index, so they are reused by later searches for as
+ * long as the files are unchanged. Empty files are ignored.
+ * 
+ * \param index The index of files to search
+ * 
+ * \param threads The number of threads to use; 0 means one per core
+ * 
+ * \param stats If not null, this is filled in with the counters for the
+ * search
+ * 
+ * \return The groups of duplicate files, with the most wasted space first
+ */
+extern std::vector<duplicate_group> find_duplicates(
+    media_index& index
+    , unsigned threads = 0
+    , duplicate_statistics* stats = nullptr);
+
+}   // end api namespace
+
+#endif
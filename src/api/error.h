@@ -0,0 +1,43 @@
+/**
+ * \file error.h
+ * Declare the error class for the API
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <stdexcept>
+#include <string>
+
+#ifndef _api_error_h_included
+#define _api_error_h_included
+
+namespace api {
+
+/**
+ * \brief An exception class for signalling errors in the API
+ * 
+ * API functions signal errors that the caller needs to know about (e.g. a
+ * root directory that doesn't exist) by throwing this. Problems that are
+ * expected in normal operation (e.g. an unreadable sub-directory during a
+ * scan) are counted or ignored instead.
+ */
+class error : public std::runtime_error
+{
+    public:
+
+    /**
+     * \brief Constructor, initialising the error message
+     * 
+     * \param msg Human-readable error message
+     */
+    explicit error(const std::string& msg) : std::runtime_error(msg) {}
+
+};  // end error class
+
+}   // end api namespace
+
+#endif
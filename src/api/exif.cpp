@@ -0,0 +1,571 @@
+/**
+ * \file exif.cpp
+ * Implement functionality for reading EXIF data embedded in image files
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "calendar.h"
+#include "exif.h"
+
+namespace api {
+
+namespace exif {
+
+namespace {
+
+/**
+ * \brief Visit the metadata segments of a JPEG buffer, in order, up to the
+ * start of the image scan
+ * 
+ * The function is given the marker, and the offset and length of the
+ * segment's payload; the payload may run past the end of the buffer if the
+ * buffer is a truncated header. The function returns `false` to stop the
+ * walk.
+ * 
+ * \return `false` if the buffer is not a JPEG file
+ */
+template <typename Fn>
+bool for_each_segment(const unsigned char* data, std::size_t size, Fn fn)
+{
+    // Every JPEG file starts with the SOI marker
+    if (size < 4 || data[0] != 0xff || data[1] != 0xd8) return false;
+
+    std::size_t pos = 2;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xff) return true;
+
+        unsigned char marker = data[pos + 1];
+
+        // Skip fill bytes
+        if (marker == 0xff) { ++pos; continue; }
+
+        // Metadata segments all come before the image scan
+        if (marker == 0xda || marker == 0xd9) return true;
+
+        // Stand-alone markers have no length field
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+        {
+            pos += 2;
+            continue;
+        }
+
+        std::size_t length = (std::size_t(data[pos + 2]) << 8) | data[pos + 3];
+        if (length < 2) return true;
+
+        if (!fn(marker, pos + 4, length - 2)) return true;
+
+        pos += 2 + length;
+    }
+
+    return true;
+}   // end for_each_segment function
+
+/**
+ * \brief Locate the TIFF structure inside the EXIF APP1 segment of a JPEG
+ * buffer
+ * 
+ * \return `true` if the segment was found, in which case `tiff_offset` and
+ * `tiff_length` are set to the extent of the TIFF data within `data`
+ */
+bool find_tiff_block(
+        const unsigned char* data
+        , std::size_t size
+        , std::size_t& tiff_offset
+        , std::size_t& tiff_length)
+{
+    static const unsigned char exif_id[] = { 'E', 'x', 'i', 'f', 0, 0 };
+
+    bool found = false;
+    for_each_segment(data, size, [&](
+            unsigned char marker
+            , std::size_t payload
+            , std::size_t payload_length)
+        {
+            if (marker == 0xe1
+                    && payload_length > sizeof(exif_id)
+                    && payload + payload_length <= size
+                    && std::memcmp(data + payload, exif_id, sizeof(exif_id))
+                        == 0)
+            {
+                tiff_offset = payload + sizeof(exif_id);
+                tiff_length = payload_length - sizeof(exif_id);
+                found = true;
+            }
+
+            return !found;
+        });
+
+    return found;
+}   // end find_tiff_block function
+
+/**
+ * \brief A bounds-checked reader for the TIFF structure that holds EXIF
+ * data
+ * 
+ * All offsets are relative to the start of the TIFF header, as they are in
+ * the file. Reads that would fall outside the buffer fail rather than
+ * throwing, because truncated and malformed EXIF blocks are common.
+ */
+class tiff_reader
+{
+    public:
+
+    /**
+     * \brief An entry in an Image File Directory
+     */
+    struct entry
+    {
+        std::uint16_t tag;      ///< The tag identifying the entry
+        std::uint16_t type;     ///< The TIFF data type of the value
+        std::uint32_t count;    ///< The number of values
+        std::uint32_t value;    ///< The value itself, or its offset
+
+        /**
+         * \brief The offset of the value field, for values of up to four
+         * bytes that are stored in the entry itself
+         */
+        std::uint32_t value_offset;
+    };  // end entry struct
+
+    /**
+     * \brief Constructor, checking the byte-order mark of the header
+     */
+    tiff_reader(const unsigned char* data, std::size_t size) :
+        m_data(data)
+        , m_size(size)
+        , m_little_endian(false)
+        , m_valid(false)
+    {
+        if (size < 8) return;
+
+        if (data[0] == 'I' && data[1] == 'I') m_little_endian = true;
+        else if (data[0] != 'M' || data[1] != 'M') return;
+
+        std::uint16_t magic = 0;
+        m_valid = u16(2, magic) && magic == 42;
+    }
+
+    /**
+     * \brief Whether the buffer holds a recognisable TIFF header
+     */
+    bool valid(void) const { return m_valid; }
+
+    /**
+     * \brief Read an unsigned 16-bit value at the given offset
+     */
+    bool u16(std::size_t offset, std::uint16_t& value) const
+    {
+        if (offset + 2 > m_size) return false;
+
+        const unsigned char* p = m_data + offset;
+        value = m_little_endian
+            ? std::uint16_t(p[0] | (p[1] << 8))
+            : std::uint16_t((p[0] << 8) | p[1]);
+        return true;
+    }
+
+    /**
+     * \brief Read an unsigned 32-bit value at the given offset
+     */
+    bool u32(std::size_t offset, std::uint32_t& value) const
+    {
+        if (offset + 4 > m_size) return false;
+
+        const unsigned char* p = m_data + offset;
+        value = m_little_endian
+            ? std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8)
+                | (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24)
+            : (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16)
+                | (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+        return true;
+    }
+
+    /**
+     * \brief The offset of the first Image File Directory (IFD0), or 0 if
+     * there is none
+     */
+    std::uint32_t first_ifd(void) const
+    {
+        std::uint32_t offset = 0;
+        return u32(4, offset) ? offset : 0;
+    }
+
+    /**
+     * \brief Visit every entry of the IFD at the given offset, and retrieve
+     * the offset of the next IFD in the chain (0 if there is none)
+     */
+    template <typename Fn>
+    std::uint32_t for_each_entry(std::uint32_t ifd, Fn fn) const
+    {
+        std::uint16_t count = 0;
+        if (ifd == 0 || !u16(ifd, count)) return 0;
+
+        for (std::uint16_t i = 0; i < count; ++i)
+        {
+            std::size_t offset = ifd + 2 + 12 * std::size_t(i);
+            entry e;
+            e.value_offset = static_cast<std::uint32_t>(offset + 8);
+
+            if (!u16(offset, e.tag)
+                    || !u16(offset + 2, e.type)
+                    || !u32(offset + 4, e.count))
+                return 0;
+
+            // Short values are stored in the first half of the value field
+            if (e.type == 3 && e.count == 1)
+            {
+                std::uint16_t v = 0;
+                if (!u16(offset + 8, v)) return 0;
+                e.value = v;
+            }
+            else if (!u32(offset + 8, e.value)) return 0;
+
+            fn(e);
+        }
+
+        std::uint32_t next = 0;
+        u32(ifd + 2 + 12 * std::size_t(count), next);
+
+        // Guard against directories that loop back on themselves
+        return next > ifd ? next : 0;
+    }
+
+    /**
+     * \brief Read an ASCII (type 2) value, without trailing nulls and
+     * spaces
+     */
+    bool ascii(const entry& e, std::string& value) const
+    {
+        if (e.type != 2) return false;
+
+        std::size_t offset = e.count <= 4 ? e.value_offset : e.value;
+        if (offset + e.count > m_size) return false;
+
+        const char* p = reinterpret_cast<const char*>(m_data + offset);
+        std::size_t length = e.count;
+        while (length > 0 && (p[length - 1] == 0 || p[length - 1] == ' '))
+            --length;
+
+        value.assign(p, std::find(p, p + length, '\0'));
+        return true;
+    }
+
+    /**
+     * \brief Read one element of a RATIONAL (type 5) value
+     */
+    bool rational(const entry& e, std::uint32_t index, double& value) const
+    {
+        std::uint32_t numerator = 0, denominator = 0;
+        if (e.type != 5 || index >= e.count
+                || !u32(std::size_t(e.value) + 8 * index, numerator)
+                || !u32(std::size_t(e.value) + 8 * index + 4, denominator)
+                || denominator == 0)
+            return false;
+
+        value = double(numerator) / denominator;
+        return true;
+    }
+
+    /**
+     * \brief Read a SHORT or LONG value, which some tags may be either of
+     */
+    static bool integer(const entry& e, std::uint32_t& value)
+    {
+        if ((e.type != 3 && e.type != 4) || e.count != 1) return false;
+
+        value = e.value;
+        return true;
+    }
+
+    private:
+
+    const unsigned char* m_data;    ///< The TIFF data
+    std::size_t m_size;             ///< Length of the TIFF data
+    bool m_little_endian;           ///< Byte-order of the data
+    bool m_valid;                   ///< Whether the header was recognised
+
+};  // end tiff_reader class
+
+/**
+ * \brief Convert an EXIF date and time ("YYYY:MM:DD HH:MM:SS") to
+ * seconds since the epoch
+ * 
+ * \return 0 if the text is not a valid date and time
+ */
+std::int64_t parse_date_time(const std::string& text)
+{
+    int year, month, day, hour, minute, second;
+    if (text.size() < 19
+            || std::sscanf(
+                text.c_str()
+                , "%4d:%2d:%2d %2d:%2d:%2d"
+                , &year
+                , &month
+                , &day
+                , &hour
+                , &minute
+                , &second) != 6
+            || year < 1900 || month < 1 || month > 12 || day < 1 || day > 31
+            || hour > 23 || minute > 59 || second > 60)
+        return 0;
+
+    return days_from_civil(year, month, day) * 86400
+        + hour * 3600 + minute * 60 + second;
+}   // end parse_date_time function
+
+/**
+ * \brief Read a GPS coordinate from its degrees / minutes / seconds
+ * rationals and its reference ("N", "S", "E" or "W")
+ */
+bool gps_coordinate(
+        const tiff_reader& reader
+        , const tiff_reader::entry& value
+        , const std::string& ref
+        , double& result)
+{
+    double degrees = 0, minutes = 0, seconds = 0;
+    if (!reader.rational(value, 0, degrees)) return false;
+    reader.rational(value, 1, minutes);
+    reader.rational(value, 2, seconds);
+
+    result = degrees + minutes / 60 + seconds / 3600;
+    if (ref == "S" || ref == "W") result = -result;
+    return true;
+}   // end gps_coordinate function
+
+/**
+ * \brief Read the metadata from a TIFF structure (the EXIF block of a
+ * JPEG file, or a TIFF-based file)
+ */
+void read_tiff_metadata(const tiff_reader& reader, media_metadata& m)
+{
+    std::uint32_t exif_ifd = 0, gps_ifd = 0, width = 0, height = 0, v = 0;
+    std::string date_time;
+
+    reader.for_each_entry(reader.first_ifd(), [&](const tiff_reader::entry& e)
+        {
+            switch (e.tag)
+            {
+                case 0x0100: tiff_reader::integer(e, width); break;
+                case 0x0101: tiff_reader::integer(e, height); break;
+                case 0x010f: reader.ascii(e, m.make); break;
+                case 0x0110: reader.ascii(e, m.model); break;
+                case 0x0112:
+                    if (tiff_reader::integer(e, v) && v >= 1 && v <= 8)
+                        m.orientation = static_cast<std::uint16_t>(v);
+                    break;
+                case 0x0132: reader.ascii(e, date_time); break;
+                case 0x8769: exif_ifd = e.value; break;
+                case 0x8825: gps_ifd = e.value; break;
+            }
+        });
+
+    std::string original;
+    reader.for_each_entry(exif_ifd, [&](const tiff_reader::entry& e)
+        {
+            switch (e.tag)
+            {
+                case 0x9003: reader.ascii(e, original); break;
+                case 0xa002: tiff_reader::integer(e, width); break;
+                case 0xa003: tiff_reader::integer(e, height); break;
+                case 0xa434: reader.ascii(e, m.lens); break;
+            }
+        });
+
+    m.capture_time = parse_date_time(original);
+    if (m.capture_time == 0) m.capture_time = parse_date_time(date_time);
+
+    if (m.width == 0 && m.height == 0)
+    {
+        m.width = width;
+        m.height = height;
+    }
+
+    std::string latitude_ref, longitude_ref;
+    tiff_reader::entry latitude{0, 0, 0, 0, 0}, longitude{0, 0, 0, 0, 0};
+    reader.for_each_entry(gps_ifd, [&](const tiff_reader::entry& e)
+        {
+            switch (e.tag)
+            {
+                case 1: reader.ascii(e, latitude_ref); break;
+                case 2: latitude = e; break;
+                case 3: reader.ascii(e, longitude_ref); break;
+                case 4: longitude = e; break;
+            }
+        });
+
+    m.has_location =
+        gps_coordinate(reader, latitude, latitude_ref, m.latitude)
+        && gps_coordinate(reader, longitude, longitude_ref, m.longitude);
+}   // end read_tiff_metadata function
+
+/**
+ * \brief Replace the predefined XML entities in some text
+ */
+std::string unescape_xml(const std::string& text)
+{
+    static const struct { const char* entity; char c; } entities[] = {
+        { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }
+        , { "&quot;", '"' }, { "&apos;", '\'' }
+    };
+
+    std::string result;
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        bool replaced = false;
+        if (text[i] == '&')
+            for (const auto& e : entities)
+                if (text.compare(i, std::strlen(e.entity), e.entity) == 0)
+                {
+                    result += e.c;
+                    i += std::strlen(e.entity) - 1;
+                    replaced = true;
+                    break;
+                }
+
+        if (!replaced) result += text[i];
+    }
+
+    return result;
+}   // end unescape_xml function
+
+/**
+ * \brief Read the keywords from an XMP packet
+ * 
+ * Keywords are the items of the `dc:subject` bag. This is a simple scan of
+ * the text rather than a full XML parse, which is enough for the packets
+ * that cameras and photo management software write.
+ */
+void read_xmp_keywords(const char* text, std::size_t length, media_metadata& m)
+{
+    std::string xmp(text, length);
+
+    auto start = xmp.find("<dc:subject");
+    if (start == std::string::npos) return;
+
+    auto end = xmp.find("</dc:subject>", start);
+    if (end == std::string::npos) return;
+
+    const std::string open = "<rdf:li", close = "</rdf:li>";
+    for (auto pos = xmp.find(open, start);
+            pos != std::string::npos && pos < end;
+            pos = xmp.find(open, pos))
+    {
+        auto content = xmp.find('>', pos);
+        auto finish = xmp.find(close, pos);
+        if (content == std::string::npos || finish == std::string::npos)
+            break;
+
+        auto keyword = unescape_xml(
+            xmp.substr(content + 1, finish - content - 1));
+        if (!keyword.empty()) m.keywords.push_back(keyword);
+
+        pos = finish + close.size();
+    }
+}   // end read_xmp_keywords function
+
+}   // end anonymous namespace
+
+bool read_metadata(
+        const unsigned char* data
+        , std::size_t size
+        , media_metadata& metadata)
+{
+    static const char xmp_id[] = "http://ns.adobe.com/xap/1.0/";
+
+    // TIFF-based files start with the TIFF header itself
+    tiff_reader file_reader(data, size);
+    if (file_reader.valid())
+    {
+        read_tiff_metadata(file_reader, metadata);
+        return true;
+    }
+
+    return for_each_segment(data, size, [&](
+            unsigned char marker
+            , std::size_t payload
+            , std::size_t length)
+        {
+            std::size_t available = std::min(length, size - payload);
+
+            // The frame header gives the actual dimensions
+            if (marker >= 0xc0 && marker <= 0xcf
+                    && marker != 0xc4 && marker != 0xc8 && marker != 0xcc
+                    && available >= 5)
+            {
+                const unsigned char* p = data + payload;
+                metadata.height = (std::uint32_t(p[1]) << 8) | p[2];
+                metadata.width = (std::uint32_t(p[3]) << 8) | p[4];
+                return false;
+            }
+
+            if (marker != 0xe1 || available < length) return true;
+
+            const unsigned char* p = data + payload;
+            if (length > 6 && std::memcmp(p, "Exif\0\0", 6) == 0)
+            {
+                tiff_reader reader(p + 6, length - 6);
+                if (reader.valid()) read_tiff_metadata(reader, metadata);
+            }
+            else if (length > sizeof(xmp_id)
+                    && std::memcmp(p, xmp_id, sizeof(xmp_id)) == 0)
+                read_xmp_keywords(
+                    reinterpret_cast<const char*>(p + sizeof(xmp_id))
+                    , length - sizeof(xmp_id)
+                    , metadata);
+
+            return true;
+        });
+}   // end read_metadata function
+
+bool find_thumbnail(
+        const unsigned char* data
+        , std::size_t size
+        , thumbnail_location& location)
+{
+    std::size_t tiff_offset = 0, tiff_length = 0;
+    if (!find_tiff_block(data, size, tiff_offset, tiff_length)) return false;
+
+    tiff_reader reader(data + tiff_offset, tiff_length);
+    if (!reader.valid()) return false;
+
+    // The preview is described by IFD1, which follows IFD0 in the chain
+    std::uint32_t ifd1 =
+        reader.for_each_entry(reader.first_ifd(), [](const tiff_reader::entry&)
+            {});
+
+    std::uint32_t offset = 0, length = 0;
+    reader.for_each_entry(ifd1, [&](const tiff_reader::entry& e)
+        {
+            if (e.tag == 0x0201) offset = e.value;
+            else if (e.tag == 0x0202) length = e.value;
+        });
+
+    if (offset == 0 || length < 4
+            || std::size_t(offset) + length > tiff_length)
+        return false;
+
+    // The preview must be a JPEG image in its own right
+    const unsigned char* p = data + tiff_offset + offset;
+    if (p[0] != 0xff || p[1] != 0xd8) return false;
+
+    location.offset = tiff_offset + offset;
+    location.length = length;
+    return true;
+}   // end find_thumbnail function
+
+}   // end exif namespace
+
+}   // end api namespace
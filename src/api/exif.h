@@ -0,0 +1,97 @@
+/**
+ * \file exif.h
+ * Declare functionality for reading EXIF data embedded in image files
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+
+#include "metadata.h"
+
+#ifndef _api_exif_h_included
+#define _api_exif_h_included
+
+namespace api {
+
+/**
+ * \brief Functionality for reading EXIF (Exchangeable Image File Format)
+ * data from the header of JPEG files
+ * 
+ * All functions in this namespace work on a buffer holding the first part
+ * of a file, so that callers can read a bounded header rather than the
+ * whole file. The EXIF block of a JPEG file is stored in its APP1 segment,
+ * which cannot exceed 64 KiB, and is (almost always) the first segment in
+ * the file.
+ */
+namespace exif {
+
+/**
+ * \brief The number of header bytes that should be read from a file to be
+ * sure of including its whole EXIF block
+ */
+constexpr std::size_t header_size = 128 * 1024;
+
+/**
+ * \brief The location of an embedded preview image within a file buffer
+ */
+struct thumbnail_location
+{
+    std::size_t offset; ///< Offset of the first byte of the preview
+    std::size_t length; ///< Length of the preview in bytes
+};  // end thumbnail_location struct
+
+/**
+ * \brief Find the JPEG preview image that cameras embed in the EXIF data
+ * of their JPEG files
+ * 
+ * This preview is held in the second Image File Directory (IFD1) of the
+ * EXIF block, and is usually around 160x120 pixels. Decoding it is far
+ * cheaper than decoding the main image.
+ * 
+ * \param data The beginning of the file; this should be at least
+ * `header_size` bytes, or the whole file if it is shorter
+ * 
+ * \param size The number of bytes in `data`
+ * 
+ * \param location Set to the location of the preview if one is found
+ * 
+ * \return `true` if a preview was found that lies entirely within the
+ * buffer, `false` otherwise; malformed data is treated as not found
+ */
+extern bool find_thumbnail(
+    const unsigned char* data
+    , std::size_t size
+    , thumbnail_location& location);
+
+/**
+ * \brief Read the metadata from the header of a JPEG file (its EXIF block,
+ * XMP packet and frame header) or a TIFF-based file (its EXIF data)
+ * 
+ * The frame header of a JPEG file gives its actual dimensions, which take
+ * precedence over the dimensions recorded in the EXIF data.
+ * 
+ * \param data The beginning of the file; this should be at least
+ * `header_size` bytes, or the whole file if it is shorter
+ * 
+ * \param size The number of bytes in `data`
+ * 
+ * \param metadata Filled in with whatever metadata is found
+ * 
+ * \return `true` if the buffer holds a JPEG or TIFF header (whether or not
+ * it has any metadata); malformed data is ignored
+ */
+extern bool read_metadata(
+    const unsigned char* data
+    , std::size_t size
+    , media_metadata& metadata);
+
+}   // end exif namespace
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * \file extractor.cpp
+ * Implement functionality for extracting metadata into the media index
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "batch_reader.h"
+#include "exif.h"
+#include "extractor.h"
+#include "metadata.h"
+
+namespace api {
+
+void extract_metadata(
+        media_index& index
+        , unsigned queue_depth
+        , extraction_statistics* stats)
+{
+    extraction_statistics st{0, 0, 0, 0, 0};
+
+    std::vector<media_record> to_read;
+    index.for_each([&to_read, &st](const media_record& r)
+    {
+        if (r.type != media_type::image) return;
+
+        ++st.files;
+        if (r.metadata) ++st.reused;
+        else to_read.push_back(r);
+    });
+
+    std::sort(
+        to_read.begin()
+        , to_read.end()
+        , [](const media_record& a, const media_record& b)
+        {
+            return a.path < b.path;
+        });
+
+    std::vector<read_request> requests(to_read.size());
+    for (std::size_t i = 0; i < to_read.size(); ++i)
+    {
+        requests[i].path = to_read[i].path;
+        requests[i].length = exif::header_size;
+    }
+
+    batch_reader::options options;
+    if (queue_depth != 0) options.queue_depth = queue_depth;
+
+    // The headers are parsed as they arrive, while the reads after them
+    // are still in flight. A failure to write the index stops the
+    // extraction once those reads are done; a file that has changed since
+    // it was indexed is simply not updated.
+    batch_reader(options).read(
+        requests
+        , [&](std::size_t i, read_result&& result)
+        {
+            const media_record& r = to_read[i];
+
+            media_metadata metadata;
+            if (result.error != 0
+                    || !parse_metadata(
+                        result.data.data()
+                        , result.data.size()
+                        , metadata))
+                ++st.errors;
+            st.bytes_read += result.data.size();
+
+            index.set_metadata(r.path, r.size, r.mtime, metadata);
+        });
+
+    st.extracted = to_read.size();
+    if (stats) *stats = st;
+}   // end extract_metadata function
+
+}   // end api namespace
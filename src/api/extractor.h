@@ -0,0 +1,61 @@
+/**
+ * \file extractor.h
+ * Declare functionality for extracting metadata into the media index
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+
+#include "media_index.h"
+
+#ifndef _api_extractor_h_included
+#define _api_extractor_h_included
+
+namespace api {
+
+/**
+ * \brief Counters reported by a metadata extraction
+ */
+struct extraction_statistics
+{
+    std::uint64_t files;        ///< Number of image files considered
+    std::uint64_t reused;       ///< Files whose metadata was already known
+    std::uint64_t extracted;    ///< Files whose headers were read
+    std::uint64_t bytes_read;   ///< Total bytes read
+    std::uint64_t errors;       ///< Files that couldn't be read or parsed
+};  // end extraction_statistics struct
+
+/**
+ * \brief Read the metadata of the image files in an index that don't
+ * have it yet, and record it in the index
+ * 
+ * Each file costs one bounded read of its header (see `parse_metadata`);
+ * the images are never decoded. Files are taken in path order, so that
+ * the files of a directory are read together, and are read by a
+ * `batch_reader`, which keeps many reads in flight on storage that can
+ * serve them in parallel. A file that can't be parsed is recorded with
+ * empty metadata, so it isn't read again until it changes.
+ * 
+ * \param index The index to update
+ * 
+ * \param queue_depth The number of reads to keep in flight (see
+ * `batch_reader::options`); 0 means the reader's default
+ * 
+ * \param stats If not null, this is filled in with the counters for the
+ * extraction
+ * 
+ * \throw api::error The metadata couldn't be written to the index file
+ */
+extern void extract_metadata(
+    media_index& index
+    , unsigned queue_depth = 0
+    , extraction_statistics* stats = nullptr);
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,302 @@
+/**
+ * \file hash.cpp
+ * Implement content hashing functionality
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+
+#include "hash.h"
+#include "large_file.h"
+
+namespace api {
+
+namespace hash {
+
+namespace {
+
+const std::uint64_t prime1 = 0x9e3779b185ebca87ull;
+const std::uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+const std::uint64_t prime3 = 0x165667b19e3779f9ull;
+const std::uint64_t prime4 = 0x85ebca77c2b2ae63ull;
+const std::uint64_t prime5 = 0x27d4eb2f165667c5ull;
+
+/**
+ * \brief The size of the buffer for reading whole files
+ */
+const std::size_t read_size = 1024 * 1024;
+
+inline std::uint64_t rotl(std::uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// Read little-endian values; the hash is defined in terms of these
+inline std::uint64_t read64(const unsigned char* p)
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+inline std::uint32_t read32(const unsigned char* p)
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+inline std::uint64_t round(std::uint64_t acc, std::uint64_t input)
+{
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+inline std::uint64_t merge_round(std::uint64_t acc, std::uint64_t lane)
+{
+    acc ^= round(0, lane);
+    return acc * prime1 + prime4;
+}
+
+/**
+ * \brief Make sure that a hash is never zero, which means "unknown"
+ */
+inline std::uint64_t nonzero(std::uint64_t h) { return h ? h : 1; }
+
+/**
+ * \brief A file opened for sequential reading
+ */
+class input_file
+{
+    public:
+
+    explicit input_file(const std::string& path) :
+        m_file(std::fopen(path.c_str(), "rb"))
+    {
+        if (!m_file) return;
+
+        // Our own buffer is big enough
+        std::setvbuf(m_file, nullptr, _IONBF, 0);
+
+#if defined(__linux__)
+        ::posix_fadvise(::fileno(m_file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    ~input_file(void) { if (m_file) std::fclose(m_file); }
+
+    input_file(const input_file&) = delete;
+    input_file& operator=(const input_file&) = delete;
+
+    bool valid(void) const { return m_file != nullptr; }
+
+    std::size_t read(unsigned char* buffer, std::size_t length)
+    {
+        return std::fread(buffer, 1, length, m_file);
+    }
+
+    bool error(void) const { return std::ferror(m_file) != 0; }
+
+    bool seek(std::uint64_t offset)
+    {
+        return large_file::seek(m_file, offset);
+    }
+
+    bool size(std::uint64_t& s) { return large_file::size(m_file, s); }
+
+    private:
+
+    std::FILE* m_file;  ///< The file
+
+};  // end input_file class
+
+}   // end anonymous namespace
+
+xxh64::xxh64(std::uint64_t seed) :
+    m_seed(seed)
+    , m_lanes{
+        seed + prime1 + prime2
+        , seed + prime2
+        , seed
+        , seed - prime1 }
+    , m_total(0)
+    , m_buffer()
+    , m_buffered(0)
+{}
+
+void xxh64::update(const void* data, std::size_t length)
+{
+    auto p = static_cast<const unsigned char*>(data);
+    m_total += length;
+
+    // Complete a partial stripe first
+    if (m_buffered > 0)
+    {
+        std::size_t n = std::min(length, sizeof(m_buffer) - m_buffered);
+        std::memcpy(m_buffer + m_buffered, p, n);
+        m_buffered += n;
+        p += n;
+        length -= n;
+
+        if (m_buffered < sizeof(m_buffer)) return;
+
+        for (int i = 0; i < 4; ++i)
+            m_lanes[i] = round(m_lanes[i], read64(m_buffer + 8 * i));
+        m_buffered = 0;
+    }
+
+    // The four lanes are independent, so they proceed in parallel in the
+    // processor's pipelines
+    std::uint64_t v1 = m_lanes[0], v2 = m_lanes[1]
+        , v3 = m_lanes[2], v4 = m_lanes[3];
+    for ( ; length >= 32; p += 32, length -= 32)
+    {
+        v1 = round(v1, read64(p));
+        v2 = round(v2, read64(p + 8));
+        v3 = round(v3, read64(p + 16));
+        v4 = round(v4, read64(p + 24));
+    }
+    m_lanes[0] = v1;
+    m_lanes[1] = v2;
+    m_lanes[2] = v3;
+    m_lanes[3] = v4;
+
+    std::memcpy(m_buffer, p, length);
+    m_buffered = length;
+}   // end update method
+
+std::uint64_t xxh64::digest(void) const
+{
+    std::uint64_t h;
+    if (m_total >= 32)
+    {
+        h = rotl(m_lanes[0], 1) + rotl(m_lanes[1], 7)
+            + rotl(m_lanes[2], 12) + rotl(m_lanes[3], 18);
+        for (int i = 0; i < 4; ++i) h = merge_round(h, m_lanes[i]);
+    }
+    else h = m_seed + prime5;
+
+    h += m_total;
+
+    const unsigned char* p = m_buffer;
+    std::size_t length = m_buffered;
+
+    for ( ; length >= 8; p += 8, length -= 8)
+    {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * prime1 + prime4;
+    }
+
+    if (length >= 4)
+    {
+        h ^= std::uint64_t(read32(p)) * prime1;
+        h = rotl(h, 23) * prime2 + prime3;
+        p += 4;
+        length -= 4;
+    }
+
+    for ( ; length > 0; ++p, --length)
+    {
+        h ^= std::uint64_t(*p) * prime5;
+        h = rotl(h, 11) * prime1;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}   // end digest method
+
+std::uint64_t xxh64_of(
+        const void* data
+        , std::size_t length
+        , std::uint64_t seed)
+{
+    xxh64 h(seed);
+    h.update(data, length);
+    return h.digest();
+}   // end xxh64_of function
+
+bool hash_file(
+        const std::string& path
+        , std::uint64_t& result
+        , std::uint64_t* bytes_read)
+{
+    input_file file(path);
+    if (!file.valid()) return false;
+
+    std::unique_ptr<unsigned char[]> buffer(new unsigned char[read_size]);
+    xxh64 h;
+    std::uint64_t total = 0;
+
+    for (;;)
+    {
+        auto n = file.read(buffer.get(), read_size);
+        h.update(buffer.get(), n);
+        total += n;
+        if (n < read_size) break;
+    }
+
+    if (bytes_read) *bytes_read += total;
+    if (file.error()) return false;
+
+    result = nonzero(h.digest());
+    return true;
+}   // end hash_file function
+
+bool hash_ends(
+        const std::string& path
+        , std::uint64_t& result
+        , std::uint64_t* bytes_read)
+{
+    input_file file(path);
+    if (!file.valid()) return false;
+
+    std::uint64_t size;
+    if (!file.size(size)) return false;
+
+    std::vector<unsigned char> buffer(2 * end_size);
+    std::size_t n;
+
+    if (size <= 2 * end_size)
+        n = file.read(buffer.data(), buffer.size());
+    else
+    {
+        n = file.read(buffer.data(), end_size);
+        if (n == end_size
+                && file.seek(size - end_size))
+            n += file.read(buffer.data() + end_size, end_size);
+    }
+
+    if (bytes_read) *bytes_read += n;
+    if (file.error()) return false;
+
+    result = nonzero(xxh64_of(buffer.data(), n));
+    return true;
+}   // end hash_ends function
+
+}   // end hash namespace
+
+}   // end api namespace
@@ -0,0 +1,120 @@
+/**
+ * \file hash.h
+ * Declare content hashing functionality
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifndef _api_hash_h_included
+#define _api_hash_h_included
+
+namespace api {
+
+/**
+ * \brief Content hashing of files, based on the 64-bit xxHash algorithm
+ * (XXH64)
+ * 
+ * XXH64 is not a cryptographic hash, but it has excellent distribution,
+ * and it processes four independent lanes per 32-byte stripe, so it runs
+ * at several GB/s per core, well above the bandwidth of the disks that
+ * media archives live on.
+ */
+namespace hash {
+
+/**
+ * \brief The number of bytes read from each end of a file for a partial
+ * hash
+ */
+constexpr std::size_t end_size = 64 * 1024;
+
+/**
+ * \brief Incremental XXH64 hashing, for data that arrives in pieces
+ */
+class xxh64
+{
+    public:
+
+    /**
+     * \brief Constructor, starting a new hash
+     */
+    explicit xxh64(std::uint64_t seed = 0);
+
+    /**
+     * \brief Add data to the hash
+     */
+    void update(const void* data, std::size_t length);
+
+    /**
+     * \brief Retrieve the hash of all the data added so far
+     */
+    std::uint64_t digest(void) const;
+
+    private:
+
+    std::uint64_t m_seed;           ///< The seed
+    std::uint64_t m_lanes[4];       ///< The four accumulators
+    std::uint64_t m_total;          ///< Total number of bytes added
+    unsigned char m_buffer[32];     ///< A partial stripe
+    std::size_t m_buffered;         ///< Number of bytes in `m_buffer`
+
+};  // end xxh64 class
+
+/**
+ * \brief Calculate the XXH64 hash of a buffer
+ */
+extern std::uint64_t xxh64_of(
+    const void* data
+    , std::size_t length
+    , std::uint64_t seed = 0);
+
+/**
+ * \brief Hash the whole contents of a file, with large sequential reads
+ * 
+ * \param path The path of the file
+ * 
+ * \param result Set to the hash; this is never zero, so that zero can mean
+ * "unknown"
+ * 
+ * \param bytes_read If not null, the number of bytes read is added to this
+ * 
+ * \return `false` if the file couldn't be read
+ */
+extern bool hash_file(
+    const std::string& path
+    , std::uint64_t& result
+    , std::uint64_t* bytes_read = nullptr);
+
+/**
+ * \brief Hash the first and last `end_size` bytes of a file (or the whole
+ * file if it is shorter than both together)
+ * 
+ * This is a cheap way to tell apart most files of the same size, because
+ * files that differ almost always differ in their headers or their
+ * endings.
+ * 
+ * \param path The path of the file
+ * 
+ * \param result Set to the hash; this is never zero
+ * 
+ * \param bytes_read If not null, the number of bytes read is added to this
+ * 
+ * \return `false` if the file couldn't be read
+ */
+extern bool hash_ends(
+    const std::string& path
+    , std::uint64_t& result
+    , std::uint64_t* bytes_read = nullptr);
+
+}   // end hash namespace
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * \file large_file.h
+ * Declare helpers for sizes and offsets in files bigger than 2 GB
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+#include <cstdio>
+
+#if !defined(_WIN32)
+#include <sys/types.h>
+#endif
+
+#ifndef _api_large_file_h_included
+#define _api_large_file_h_included
+
+namespace api {
+
+/**
+ * \brief Helpers for seeking in `std::FILE` streams with 64-bit offsets,
+ * because `fseek` and `ftell` use a `long`, which has only 32 bits on
+ * Windows
+ */
+namespace large_file {
+
+/**
+ * \brief Seek to an absolute position in a file
+ * 
+ * \return `false` if the seek failed
+ */
+inline bool seek(std::FILE* file, std::uint64_t offset)
+{
+#if defined(_WIN32)
+    return ::_fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return ::fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+/**
+ * \brief Retrieve the size of an open file, leaving it positioned at the
+ * start
+ * 
+ * \return `false` if the size couldn't be found
+ */
+inline bool size(std::FILE* file, std::uint64_t& result)
+{
+#if defined(_WIN32)
+    if (::_fseeki64(file, 0, SEEK_END) != 0) return false;
+    auto end = ::_ftelli64(file);
+#else
+    if (::fseeko(file, 0, SEEK_END) != 0) return false;
+    auto end = ::ftello(file);
+#endif
+
+    if (end < 0 || !seek(file, 0)) return false;
+    result = static_cast<std::uint64_t>(end);
+    return true;
+}
+
+}   // end large_file namespace
+
+}   // end api namespace
+
+#endif
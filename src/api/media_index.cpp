@@ -0,0 +1,863 @@
+/**
+ * \file media_index.cpp
+ * Implement the `media_index` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <unordered_set>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+
+#include "byte_order.h"
+#include "error.h"
+#include "media_index.h"
+
+namespace api {
+
+namespace {
+
+namespace bip = boost::interprocess;
+using namespace byte_order;
+
+/**
+ * \brief The magic bytes at the start of the index file; the last two
+ * characters are the format version
+ */
+const char index_magic[8] = { 'M', 'I', 'D', 'X', 'L', 'G', '0', '2' };
+
+/**
+ * \brief The number of magic bytes that are the same for every version
+ */
+const std::size_t format_magic_size = 6;
+
+/**
+ * \brief The magic number at the start of every record
+ */
+const std::uint32_t record_magic = 0x5844494d;
+
+/**
+ * \brief The size of the fixed part of a record
+ * 
+ * The fixed part is followed by the path and then, for file records, by
+ * the file's encoded metadata (see `encode_metadata`), whose length is in
+ * bytes 6 and 7 of the fixed part.
+ */
+const std::size_t record_header_size = 52;
+
+/**
+ * \brief The longest metadata that fits in a record
+ */
+const std::size_t max_metadata_size = 0xffff;
+
+/**
+ * \brief The index file is only compacted if it is at least this big
+ */
+const std::uint64_t min_compaction_bytes = 4 * 1024 * 1024;
+
+/**
+ * \brief The kinds of record in the log
+ */
+const char file_record = 'F';           ///< A file was added or updated
+const char file_removal = 'R';          ///< A file was removed
+const char directory_record = 'D';      ///< A directory was read
+const char directory_removal = 'X';     ///< A directory was removed
+
+/**
+ * \brief Split a path into its directory and file name
+ */
+void split_path(
+        const std::string& path
+        , std::string& directory
+        , std::string& name)
+{
+    auto pos = path.find_last_of('/');
+    if (pos == std::string::npos)
+    {
+        directory.clear();
+        name = path;
+    }
+    else
+    {
+        directory = path.substr(0, pos == 0 ? 1 : pos);
+        name = path.substr(pos + 1);
+    }
+}   // end split_path function
+
+/**
+ * \brief Join a directory path and a file name
+ */
+std::string join(const std::string& directory, const std::string& name)
+{
+    if (directory.empty() || directory.back() == '/') return directory + name;
+    return directory + "/" + name;
+}
+
+/**
+ * \brief Whether a file has contents that aren't a media index of any
+ * version, and so mustn't be overwritten
+ */
+bool foreign_file(const std::string& path)
+{
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    char magic[format_magic_size];
+    auto n = std::fread(magic, 1, sizeof(magic), f);
+    std::fclose(f);
+    return n > 0 && std::memcmp(magic, index_magic, n) != 0;
+}   // end foreign_file function
+
+/**
+ * \brief Take the lock that gives one process the use of an index file,
+ * held in a file alongside it
+ * 
+ * \throw api::error Another process holds the lock, or it couldn't be
+ * taken
+ */
+std::unique_ptr<bip::file_lock> lock_index(const std::string& file_path)
+{
+    std::string lock_path = file_path + ".lock";
+    if (std::FILE* f = std::fopen(lock_path.c_str(), "ab")) std::fclose(f);
+
+    std::unique_ptr<bip::file_lock> lock;
+    bool locked = false;
+    try
+    {
+        lock = std::make_unique<bip::file_lock>(lock_path.c_str());
+        locked = lock->try_lock();
+    }
+    catch (const bip::interprocess_exception&)
+    {
+        throw error("cannot lock media index \"" + file_path + "\"");
+    }
+
+    if (!locked)
+        throw error(
+            "media index \"" + file_path + "\" is in use by another process");
+    return lock;
+}   // end lock_index function
+
+/**
+ * \brief Add the counters from one scan to another
+ */
+void accumulate(scan_statistics& total, const scan_statistics& stats)
+{
+    total.directories += stats.directories;
+    total.entries += stats.entries;
+    total.files += stats.files;
+    total.errors += stats.errors;
+    total.skipped += stats.skipped;
+}
+
+}   // end anonymous namespace
+
+media_index::media_index(std::string file_path) :
+    m_file_path(std::move(file_path))
+    , m_lock()
+    , m_file(nullptr)
+    , m_pending()
+    , m_directories()
+    , m_file_count(0)
+    , m_generation(0)
+    , m_mutex()
+{
+    boost::system::error_code ec;
+    auto parent = boost::filesystem::path(m_file_path).parent_path();
+    if (!parent.empty()) boost::filesystem::create_directories(parent, ec);
+
+    // An older version or a damaged file is rebuilt, but a file that was
+    // never an index (e.g. a mistyped path) is left alone
+    if (foreign_file(m_file_path))
+        throw error("\"" + m_file_path + "\" is not a media index");
+
+    // Another process appending to the file could lose its records to a
+    // compaction here, and wouldn't see the changes made here anyway
+    m_lock = lock_index(m_file_path);
+
+    std::uint64_t records = 0;
+    if (!load(records)
+            || (records > 2 * (m_directories.size() + m_file_count)
+                && boost::filesystem::file_size(m_file_path, ec)
+                    >= min_compaction_bytes))
+        if (!rewrite())
+            throw error("cannot write media index \"" + m_file_path + "\"");
+
+    m_file = std::fopen(m_file_path.c_str(), "ab");
+    if (!m_file)
+        throw error("cannot open media index \"" + m_file_path + "\"");
+}   // end constructor
+
+media_index::~media_index(void)
+{
+    if (m_file) std::fclose(m_file);
+}
+
+std::size_t media_index::size(void) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file_count;
+}
+
+std::uint64_t media_index::generation(void) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+}
+
+bool media_index::find(const std::string& path, media_record& record) const
+{
+    std::string directory, name;
+    split_path(path, directory, name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto d = m_directories.find(directory);
+    if (d == m_directories.end()) return false;
+
+    auto f = d->second.files.find(name);
+    if (f == d->second.files.end()) return false;
+
+    record = make_record(directory, name, f->second);
+    return true;
+}   // end find method
+
+void media_index::for_each(
+        const std::function<void(const media_record&)>& fn) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& d : m_directories)
+        for (const auto& f : d.second.files)
+            fn(make_record(d.first, f.first, f.second));
+}   // end for_each method
+
+bool media_index::for_each_in(
+        const std::string& directory
+        , const std::function<void(const media_record&)>& fn) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto d = m_directories.find(directory);
+    if (d == m_directories.end()) return false;
+
+    for (const auto& f : d->second.files)
+        fn(make_record(d->first, f.first, f.second));
+    return true;
+}   // end for_each_in method
+
+std::vector<std::string> media_index::directories(
+        const std::string& root) const
+{
+    std::vector<std::string> result;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_directories.find(root) == m_directories.end()) return result;
+
+    result.push_back(root);
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        auto d = m_directories.find(result[i]);
+        if (d == m_directories.end()) continue;
+
+        result.insert(
+            result.end()
+            , d->second.subdirectories.begin()
+            , d->second.subdirectories.end());
+    }
+
+    return result;
+}   // end directories method
+
+bool media_index::summarise(
+        const std::string& directory
+        , directory_summary& summary) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto d = m_directories.find(directory);
+    if (d == m_directories.end()) return false;
+
+    summary.mtime = d->second.mtime;
+    summary.files = d->second.files.size();
+    summary.bytes = d->second.bytes;
+    summary.tree_files = d->second.tree_files;
+    summary.tree_bytes = d->second.tree_bytes;
+    summary.unread_directories = d->second.tree_unread;
+    summary.subdirectories = d->second.subdirectories;
+    return true;
+}   // end summarise method
+
+bool media_index::set_details(
+        const std::string& path
+        , std::uint64_t size
+        , std::int64_t mtime
+        , std::uint32_t width
+        , std::uint32_t height
+        , std::uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    file_entry* e = find_current(path, size, mtime);
+    if (!e) return false;
+
+    if (e->width == width && e->height == height && e->hash == hash)
+        return true;
+
+    e->width = width;
+    e->height = height;
+    e->hash = hash;
+    log(file_record, path, 0, e);
+    flush();
+    return true;
+}   // end set_details method
+
+bool media_index::set_perceptual_hash(
+        const std::string& path
+        , std::uint64_t size
+        , std::int64_t mtime
+        , std::uint64_t phash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    file_entry* e = find_current(path, size, mtime);
+    if (!e) return false;
+
+    if (e->phash == phash) return true;
+
+    e->phash = phash;
+    log(file_record, path, 0, e);
+    flush();
+    return true;
+}   // end set_perceptual_hash method
+
+bool media_index::set_metadata(
+        const std::string& path
+        , std::uint64_t size
+        , std::int64_t mtime
+        , const media_metadata& metadata)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    file_entry* e = find_current(path, size, mtime);
+    if (!e) return false;
+
+    if (e->metadata && *e->metadata == metadata) return true;
+
+    e->metadata = std::make_shared<const media_metadata>(metadata);
+    if (metadata.width != 0 && metadata.height != 0)
+    {
+        e->width = metadata.width;
+        e->height = metadata.height;
+    }
+
+    log(file_record, path, 0, e);
+    flush();
+    return true;
+}   // end set_metadata method
+
+rescan_statistics media_index::rescan(
+        const std::string& root
+        , const scanner::options& options)
+{
+    rescan_statistics stats{ scan_statistics{0, 0, 0, 0, 0}, 0, 0, 0 };
+
+    stats.scan = scanner(options).scan(
+        root
+        , [this](
+                const std::string& directory
+                , std::int64_t mtime
+                , std::vector<std::string>& subdirectories)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto d = m_directories.find(directory);
+            if (d == m_directories.end() || d->second.mtime != mtime)
+                return true;
+
+            subdirectories = d->second.subdirectories;
+            return false;
+        }
+        , [this, &stats](directory_listing&& listing)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            apply(std::move(listing), stats);
+        });
+
+    return stats;
+}   // end rescan method
+
+rescan_statistics media_index::refresh(
+        const std::vector<std::string>& directories
+        , const scanner::options& options)
+{
+    rescan_statistics stats{ scan_statistics{0, 0, 0, 0, 0}, 0, 0, 0 };
+
+    scanner::options single = options;
+    single.recursive = false;
+
+    std::vector<std::string> fresh;
+    for (const auto& directory : directories)
+    {
+        boost::system::error_code ec;
+        if (!boost::filesystem::is_directory(directory, ec))
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            std::string parent, name;
+            split_path(directory, parent, name);
+            auto p = m_directories.find(parent);
+            if (p != m_directories.end())
+            {
+                auto& subs = p->second.subdirectories;
+                subs.erase(
+                    std::remove(subs.begin(), subs.end(), directory)
+                    , subs.end());
+            }
+
+            stats.removed += remove_tree(directory);
+            flush();
+            continue;
+        }
+
+        accumulate(stats.scan, scanner(single).scan(
+            directory
+            , scanner::directory_filter()
+            , [this, &stats, &fresh](directory_listing&& listing)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (const auto& sub : listing.subdirectories)
+                    if (m_directories.find(sub) == m_directories.end())
+                        fresh.push_back(sub);
+
+                apply(std::move(listing), stats);
+            }));
+    }
+
+    for (const auto& directory : fresh)
+    {
+        boost::system::error_code ec;
+        if (!boost::filesystem::is_directory(directory, ec)) continue;
+
+        auto sub = rescan(directory, options);
+        accumulate(stats.scan, sub.scan);
+        stats.added += sub.added;
+        stats.changed += sub.changed;
+        stats.removed += sub.removed;
+    }
+
+    return stats;
+}   // end refresh method
+
+media_record media_index::make_record(
+        const std::string& directory
+        , const std::string& name
+        , const file_entry& e)
+{
+    return media_record{
+        join(directory, name)
+        , e.size
+        , e.mtime
+        , e.width
+        , e.height
+        , e.hash
+        , e.phash
+        , e.type
+        , e.metadata};
+}   // end make_record method
+
+media_index::file_entry* media_index::find_current(
+        const std::string& path
+        , std::uint64_t size
+        , std::int64_t mtime)
+{
+    std::string directory, name;
+    split_path(path, directory, name);
+
+    auto d = m_directories.find(directory);
+    if (d == m_directories.end()) return nullptr;
+
+    auto f = d->second.files.find(name);
+    if (f == d->second.files.end()
+            || f->second.size != size
+            || f->second.mtime != mtime)
+        return nullptr;
+
+    return &f->second;
+}   // end find_current method
+
+bool media_index::load(std::uint64_t& records)
+{
+    boost::system::error_code ec;
+    auto file_size = boost::filesystem::file_size(m_file_path, ec);
+    if (ec || file_size < sizeof(index_magic)) return false;
+
+    records = 0;
+    std::size_t end = 0, size = 0;
+
+    {
+        std::unique_ptr<bip::mapped_region> region;
+        try
+        {
+            bip::file_mapping mapping(m_file_path.c_str(), bip::read_only);
+            region = std::make_unique<bip::mapped_region>(
+                mapping
+                , bip::read_only);
+        }
+        catch (const bip::interprocess_exception&)
+        {
+            return false;
+        }
+
+        auto base = static_cast<const unsigned char*>(region->get_address());
+        size = region->get_size();
+
+        if (std::memcmp(base, index_magic, sizeof(index_magic)) != 0)
+            return false;
+
+        std::string path, directory, name;
+        end = sizeof(index_magic);
+        while (size - end >= record_header_size)
+        {
+            const unsigned char* p = base + end;
+            std::size_t path_length = get_u32(p + 8);
+            std::size_t metadata_length =
+                std::size_t(p[6]) | (std::size_t(p[7]) << 8);
+            if (get_u32(p) != record_magic
+                    || size - end - record_header_size
+                        < path_length + metadata_length)
+                break;
+
+            path.assign(
+                reinterpret_cast<const char*>(p + record_header_size)
+                , path_length);
+
+            bool known = true;
+            switch (static_cast<char>(p[4]))
+            {
+                case file_record:
+                {
+                    split_path(path, directory, name);
+                    auto& files = m_directories[directory].files;
+                    file_entry e{
+                        get_u64(p + 12)
+                        , static_cast<std::int64_t>(get_u64(p + 20))
+                        , get_u32(p + 28)
+                        , get_u32(p + 32)
+                        , get_u64(p + 36)
+                        , get_u64(p + 44)
+                        , static_cast<media_type>(p[5])
+                        , nullptr};
+
+                    if (metadata_length > 0)
+                    {
+                        auto m = std::make_shared<media_metadata>();
+                        if (decode_metadata(
+                                p + record_header_size + path_length
+                                , metadata_length
+                                , *m))
+                            e.metadata = std::move(m);
+                    }
+
+                    if (files.emplace(name, e).second) ++m_file_count;
+                    else files[name] = e;
+                    break;
+                }
+
+                case file_removal:
+                {
+                    split_path(path, directory, name);
+                    auto d = m_directories.find(directory);
+                    if (d != m_directories.end())
+                        m_file_count -= d->second.files.erase(name);
+                    break;
+                }
+
+                case directory_record:
+                    m_directories[path].mtime =
+                        static_cast<std::int64_t>(get_u64(p + 20));
+                    break;
+
+                case directory_removal:
+                {
+                    auto d = m_directories.find(path);
+                    if (d != m_directories.end())
+                    {
+                        m_file_count -= d->second.files.size();
+                        m_directories.erase(d);
+                    }
+                    break;
+                }
+
+                default:
+                    // Unknown record kind: treat as damage
+                    known = false;
+                    break;
+            }
+
+            if (!known) break;
+
+            end += record_header_size + path_length + metadata_length;
+            ++records;
+        }
+    }
+
+    // Drop a damaged tail, so that new records follow valid ones
+    if (end < size) boost::filesystem::resize_file(m_file_path, end, ec);
+
+    // Link the directories to their parents
+    for (auto& d : m_directories)
+    {
+        std::string parent, name;
+        split_path(d.first, parent, name);
+        if (name.empty()) continue;
+
+        auto p = m_directories.find(parent);
+        if (p != m_directories.end())
+            p->second.subdirectories.push_back(d.first);
+    }
+
+    // Total up the files in each directory, and add them to the tree
+    // totals of the directory and its ancestors
+    for (auto& d : m_directories)
+    {
+        d.second.bytes = 0;
+        for (const auto& f : d.second.files) d.second.bytes += f.second.size;
+    }
+
+    for (const auto& d : m_directories)
+        add_to_tree(
+            d.first
+            , static_cast<std::int64_t>(d.second.files.size())
+            , static_cast<std::int64_t>(d.second.bytes)
+            , d.second.mtime < 0 ? 1 : 0);
+
+    return true;
+}   // end load method
+
+bool media_index::rewrite(void)
+{
+    std::string temp_path = m_file_path + ".tmp";
+    std::FILE* temp = std::fopen(temp_path.c_str(), "wb");
+    if (!temp) return false;
+
+    bool ok = std::fwrite(index_magic, 1, sizeof(index_magic), temp)
+        == sizeof(index_magic);
+
+    for (const auto& d : m_directories)
+    {
+        if (!ok) break;
+
+        for (const auto& f : d.second.files)
+            log(file_record, join(d.first, f.first), 0, &f.second);
+        log(directory_record, d.first, d.second.mtime);
+
+        ok = std::fwrite(m_pending.data(), 1, m_pending.size(), temp)
+            == m_pending.size();
+        m_pending.clear();
+    }
+
+    if (std::fclose(temp) != 0) ok = false;
+
+    boost::system::error_code ec;
+    if (ok) boost::filesystem::rename(temp_path, m_file_path, ec);
+    if (!ok || ec)
+    {
+        boost::filesystem::remove(temp_path, ec);
+        return false;
+    }
+
+    return true;
+}   // end rewrite method
+
+void media_index::apply(directory_listing&& listing, rescan_statistics& stats)
+{
+    auto& directory = m_directories[listing.path];
+
+    std::unordered_map<std::string, file_entry> files;
+    files.reserve(listing.files.size());
+
+    std::string parent, name;
+    for (const auto& f : listing.files)
+    {
+        split_path(f.path, parent, name);
+
+        auto old = directory.files.find(name);
+        if (old != directory.files.end()
+                && old->second.size == f.size
+                && old->second.mtime == f.mtime)
+        {
+            files.emplace(name, old->second);
+            continue;
+        }
+
+        if (old == directory.files.end()) ++stats.added;
+        else ++stats.changed;
+
+        file_entry e{f.size, f.mtime, 0, 0, 0, 0, f.type, nullptr};
+        log(file_record, f.path, 0, &e);
+        files.emplace(name, e);
+    }
+
+    for (const auto& f : directory.files)
+        if (files.find(f.first) == files.end())
+        {
+            log(file_removal, join(listing.path, f.first), 0);
+            ++stats.removed;
+        }
+
+    m_file_count -= directory.files.size();
+    m_file_count += files.size();
+    directory.files = std::move(files);
+
+    directory.bytes = 0;
+    for (const auto& f : directory.files) directory.bytes += f.second.size;
+
+    // Sub-directories that have gone are removed with everything in them;
+    // new ones are logged as unread, so they will be read by the next
+    // rescan if this one is interrupted
+    std::unordered_set<std::string> current(
+        listing.subdirectories.begin()
+        , listing.subdirectories.end());
+    for (const auto& sub : directory.subdirectories)
+        if (current.find(sub) == current.end())
+            stats.removed += remove_tree(sub);
+
+    for (const auto& sub : listing.subdirectories)
+        if (m_directories.find(sub) == m_directories.end())
+        {
+            m_directories[sub].tree_unread = 1;
+            log(directory_record, sub, -1);
+        }
+
+    directory.subdirectories = std::move(listing.subdirectories);
+
+    // The tree totals are worked out again from the sub-directories', so
+    // that they also take in any that were in the index before this one
+    // was (e.g. from rescanning a sub-directory on its own)
+    std::uint64_t tree_files = directory.files.size()
+        , tree_bytes = directory.bytes
+        , tree_unread = 0;
+    for (const auto& sub : directory.subdirectories)
+    {
+        auto s = m_directories.find(sub);
+        if (s == m_directories.end()) continue;
+
+        tree_files += s->second.tree_files;
+        tree_bytes += s->second.tree_bytes;
+        tree_unread += s->second.tree_unread;
+    }
+
+    add_to_tree(
+        listing.path
+        , static_cast<std::int64_t>(tree_files - directory.tree_files)
+        , static_cast<std::int64_t>(tree_bytes - directory.tree_bytes)
+        , static_cast<std::int64_t>(tree_unread - directory.tree_unread));
+
+    // The directory's time goes last, so that it is only recorded if all
+    // the changes before it are
+    directory.mtime = listing.mtime;
+    log(directory_record, listing.path, listing.mtime);
+
+    flush();
+}   // end apply method
+
+std::uint64_t media_index::remove_tree(const std::string& directory)
+{
+    auto d = m_directories.find(directory);
+    if (d == m_directories.end()) return 0;
+
+    // Only the top of the tree is taken from its ancestors' totals; the
+    // directories below it have no ancestors left in the index by the time
+    // they are removed
+    std::string parent, name;
+    split_path(directory, parent, name);
+    if (!name.empty())
+        add_to_tree(
+            parent
+            , -static_cast<std::int64_t>(d->second.tree_files)
+            , -static_cast<std::int64_t>(d->second.tree_bytes)
+            , -static_cast<std::int64_t>(d->second.tree_unread));
+
+    auto subdirectories = std::move(d->second.subdirectories);
+    std::uint64_t removed = d->second.files.size();
+    m_file_count -= removed;
+    m_directories.erase(d);
+    log(directory_removal, directory, 0);
+
+    for (const auto& sub : subdirectories) removed += remove_tree(sub);
+    return removed;
+}   // end remove_tree method
+
+void media_index::add_to_tree(
+        const std::string& directory
+        , std::int64_t files
+        , std::int64_t bytes
+        , std::int64_t unread)
+{
+    std::string path = directory, parent, name;
+    for (;;)
+    {
+        auto d = m_directories.find(path);
+        if (d == m_directories.end()) break;
+
+        d->second.tree_files += static_cast<std::uint64_t>(files);
+        d->second.tree_bytes += static_cast<std::uint64_t>(bytes);
+        d->second.tree_unread += static_cast<std::uint64_t>(unread);
+
+        split_path(path, parent, name);
+        if (name.empty()) break;
+        path.swap(parent);
+    }
+}   // end add_to_tree method
+
+void media_index::log(
+        char kind
+        , const std::string& path
+        , std::int64_t mtime
+        , const file_entry* e)
+{
+    std::vector<unsigned char> metadata;
+    if (e && e->metadata)
+    {
+        encode_metadata(*e->metadata, metadata);
+
+        // Pathologically long metadata is not kept, rather than failing
+        if (metadata.size() > max_metadata_size) metadata.clear();
+    }
+
+    put_u32(m_pending, record_magic);
+    m_pending.push_back(static_cast<unsigned char>(kind));
+    m_pending.push_back(
+        e ? static_cast<unsigned char>(e->type) : 0);
+    m_pending.push_back(metadata.size() & 0xff);
+    m_pending.push_back(metadata.size() >> 8);
+    put_u32(m_pending, static_cast<std::uint32_t>(path.size()));
+    put_u64(m_pending, e ? e->size : 0);
+    put_u64(m_pending, static_cast<std::uint64_t>(e ? e->mtime : mtime));
+    put_u32(m_pending, e ? e->width : 0);
+    put_u32(m_pending, e ? e->height : 0);
+    put_u64(m_pending, e ? e->hash : 0);
+    put_u64(m_pending, e ? e->phash : 0);
+    m_pending.insert(m_pending.end(), path.begin(), path.end());
+    m_pending.insert(m_pending.end(), metadata.begin(), metadata.end());
+}   // end log method
+
+void media_index::flush(void)
+{
+    if (m_pending.empty()) return;
+
+    bool ok = m_file
+        && std::fwrite(m_pending.data(), 1, m_pending.size(), m_file)
+            == m_pending.size()
+        && std::fflush(m_file) == 0;
+    m_pending.clear();
+    ++m_generation;
+
+    if (!ok)
+        throw error("cannot write to media index \"" + m_file_path + "\"");
+}   // end flush method
+
+}   // end api namespace
@@ -0,0 +1,481 @@
+/**
+ * \file media_index.h
+ * Declare the `media_index` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "metadata.h"
+#include "scanner.h"
+
+#ifndef _api_media_index_h_included
+#define _api_media_index_h_included
+
+namespace boost { namespace interprocess { class file_lock; } }
+
+namespace api {
+
+/**
+ * \brief The information held in the index about one media file
+ */
+struct media_record
+{
+    std::string path;       ///< The full path of the file
+    std::uint64_t size;     ///< The size of the file in bytes
+    std::int64_t mtime;     ///< Modification time, in ms since the epoch
+    std::uint32_t width;    ///< Image width in pixels; 0 if unknown
+    std::uint32_t height;   ///< Image height in pixels; 0 if unknown
+    std::uint64_t hash;     ///< Hash of the file contents; 0 if unknown
+
+    /**
+     * \brief Perceptual hash of the image (see `api::similarity`); 0 if
+     * unknown
+     */
+    std::uint64_t phash;
+
+    media_type type;        ///< The type of media in the file
+
+    /**
+     * \brief The metadata read from the file's headers; null if it hasn't
+     * been read
+     */
+    std::shared_ptr<const media_metadata> metadata;
+};  // end media_record struct
+
+/**
+ * \brief Counters reported by a rescan of the index
+ */
+struct rescan_statistics
+{
+    scan_statistics scan;   ///< The counters from the directory scan
+    std::uint64_t added;    ///< Number of files added to the index
+    std::uint64_t changed;  ///< Number of files whose size or time changed
+    std::uint64_t removed;  ///< Number of files removed from the index
+};  // end rescan_statistics struct
+
+/**
+ * \brief A summary of one directory in the index
+ */
+struct directory_summary
+{
+    /**
+     * \brief Modification time when the directory was last read; -1 if it
+     * hasn't been read yet (so `subdirectories` may be incomplete)
+     */
+    std::int64_t mtime;
+
+    std::uint64_t files;        ///< Number of media files in the directory
+    std::uint64_t bytes;        ///< Total size of those files
+
+    /**
+     * \brief Number of media files in the directory and all the
+     * directories below it
+     */
+    std::uint64_t tree_files;
+
+    std::uint64_t tree_bytes;   ///< Total size of those files
+
+    /**
+     * \brief Number of directories in the tree (including this one) that
+     * haven't been read yet, and so aren't in the totals; the totals are
+     * complete if this is 0
+     */
+    std::uint64_t unread_directories;
+
+    /**
+     * \brief The full paths of the sub-directories
+     */
+    std::vector<std::string> subdirectories;
+};  // end directory_summary struct
+
+/**
+ * \brief A persistent index of the media files in one or more directory
+ * trees
+ * 
+ * The index holds a record for each media file, and the modification time
+ * of each directory as it was when the directory was last read. It is
+ * persisted in a single append-only log file: every change is appended as
+ * a fixed-size record followed by a path, and when the index is opened,
+ * the log is memory-mapped and replayed. Records that have been superseded
+ * are dropped by rewriting the log when they outnumber the live ones. A
+ * damaged tail (e.g. after a crash) is truncated, and because a
+ * directory's time is only logged after the changes to its files, anything
+ * lost is picked up by the next rescan.
+ * 
+ * Rescans are incremental. Adding, removing or renaming an entry in a
+ * directory updates the directory's modification time, so directories
+ * whose time hasn't changed are not read again, and only their known
+ * sub-directories are visited; rescanning an unchanged tree costs one
+ * `stat` per directory, rather than one per file. A file whose size or
+ * modification time has changed keeps its record, but loses its
+ * dimensions, hashes and metadata, which are filled in by clients with
+ * `set_details`, `set_perceptual_hash` and `set_metadata`.
+ * 
+ * Each directory also keeps the number and total size of the files in it
+ * and below it, adjusted as its files and sub-directories change, so that
+ * a folder tree can show them without walking the tree.
+ * 
+ * An index file is used by one process at a time: it is locked (through a
+ * `.lock` file alongside it) for as long as it is open.
+ * 
+ * All public methods are thread-safe.
+ */
+class media_index
+{
+    public:
+
+    /**
+     * \brief Constructor, opening the index file (creating it if it
+     * doesn't exist)
+     * 
+     * \param file_path The path of the index file
+     * 
+     * \throw api::error The index file couldn't be opened for writing, is
+     * open in another process, or exists but isn't a media index
+     */
+    explicit media_index(std::string file_path);
+
+    /**
+     * \brief Destructor, closing the index file
+     */
+    ~media_index(void);
+
+    media_index(const media_index&) = delete;
+    media_index& operator=(const media_index&) = delete;
+
+    /**
+     * \brief Retrieve the path of the index file
+     */
+    const std::string& file_path(void) const { return m_file_path; }
+
+    /**
+     * \brief Retrieve the number of media files in the index
+     */
+    std::size_t size(void) const;
+
+    /**
+     * \brief Retrieve a number that changes whenever the index does, so
+     * that clients can tell whether anything they have derived from it
+     * (e.g. a `search_index`) is out of date
+     */
+    std::uint64_t generation(void) const;
+
+    /**
+     * \brief Look up the record for a media file
+     * 
+     * \return `true` if the file is in the index
+     */
+    bool find(const std::string& path, media_record& record) const;
+
+    /**
+     * \brief Call a function for every file in the index
+     * 
+     * The index is locked while this runs, so the function must not call
+     * back into the index.
+     */
+    void for_each(const std::function<void(const media_record&)>& fn) const;
+
+    /**
+     * \brief Call a function for each file in a directory (not including
+     * its sub-directories)
+     * 
+     * The index is locked while this runs, so the function must not call
+     * back into the index.
+     * 
+     * \return `false` if the directory is not in the index
+     */
+    bool for_each_in(
+        const std::string& directory
+        , const std::function<void(const media_record&)>& fn) const;
+
+    /**
+     * \brief Retrieve the paths of a directory and all the directories
+     * below it that are in the index
+     */
+    std::vector<std::string> directories(const std::string& root) const;
+
+    /**
+     * \brief Summarise a directory: its sub-directories, and the number and
+     * total size of the media files in it and below it
+     * 
+     * The totals for each directory are kept up to date as the index
+     * changes, so this costs the same for a directory at the top of a
+     * large tree as for one at the bottom.
+     * 
+     * \return `false` if the directory is not in the index
+     */
+    bool summarise(
+        const std::string& directory
+        , directory_summary& summary) const;
+
+    /**
+     * \brief Record the dimensions and content hash of a file
+     * 
+     * \return `false` if the file is not in the index, or has a different
+     * size or modification time (i.e. the details are stale)
+     * 
+     * \throw api::error The change couldn't be written to the index file
+     */
+    bool set_details(
+        const std::string& path
+        , std::uint64_t size
+        , std::int64_t mtime
+        , std::uint32_t width
+        , std::uint32_t height
+        , std::uint64_t hash);
+
+    /**
+     * \brief Record the perceptual hash of an image file
+     * 
+     * \return `false` if the file is not in the index, or has a different
+     * size or modification time (i.e. the hash is stale)
+     * 
+     * \throw api::error The change couldn't be written to the index file
+     */
+    bool set_perceptual_hash(
+        const std::string& path
+        , std::uint64_t size
+        , std::int64_t mtime
+        , std::uint64_t phash);
+
+    /**
+     * \brief Record the metadata of a file, and the dimensions it gives
+     * 
+     * \return `false` if the file is not in the index, or has a different
+     * size or modification time (i.e. the metadata is stale)
+     * 
+     * \throw api::error The change couldn't be written to the index file
+     */
+    bool set_metadata(
+        const std::string& path
+        , std::uint64_t size
+        , std::int64_t mtime
+        , const media_metadata& metadata);
+
+    /**
+     * \brief Bring the index up to date with a directory tree
+     * 
+     * \param root The directory at the top of the tree
+     * 
+     * \param options The scanner configuration
+     * 
+     * \return The counters for the rescan
+     * 
+     * \throw api::error The root is not a readable directory, or a change
+     * couldn't be written to the index file
+     */
+    rescan_statistics rescan(
+        const std::string& root
+        , const scanner::options& options = scanner::options());
+
+    /**
+     * \brief Bring the index up to date with a set of directories that are
+     * known to have changed
+     * 
+     * This is for clients that are told about changes (e.g. by a
+     * `watcher`). Each directory is read whether or not its modification
+     * time has changed, because rewriting a file doesn't change the time of
+     * its directory. Sub-directories are not read, unless they are new to
+     * the index, in which case they are scanned recursively. Directories
+     * that no longer exist are removed, with everything below them.
+     * 
+     * \param directories The directories that have changed
+     * 
+     * \param options The scanner configuration
+     * 
+     * \return The counters for the refresh
+     * 
+     * \throw api::error A change couldn't be written to the index file
+     */
+    rescan_statistics refresh(
+        const std::vector<std::string>& directories
+        , const scanner::options& options = scanner::options());
+
+    private:
+
+    /**
+     * \brief The information held about a file, within its directory
+     */
+    struct file_entry
+    {
+        std::uint64_t size;     ///< File size
+        std::int64_t mtime;     ///< File modification time
+        std::uint32_t width;    ///< Image width
+        std::uint32_t height;   ///< Image height
+        std::uint64_t hash;     ///< Content hash
+        std::uint64_t phash;    ///< Perceptual hash
+        media_type type;        ///< Media type
+
+        /**
+         * \brief Metadata; shared with the records handed out, so that
+         * copying a record doesn't copy its strings
+         */
+        std::shared_ptr<const media_metadata> metadata;
+    };  // end file_entry struct
+
+    /**
+     * \brief The information held about a directory
+     */
+    struct directory_entry
+    {
+        /**
+         * \brief Modification time when last read; -1 if it has never
+         * been read completely
+         */
+        std::int64_t mtime = -1;
+
+        /**
+         * \brief The files in the directory, keyed on name
+         */
+        std::unordered_map<std::string, file_entry> files;
+
+        /**
+         * \brief The full paths of the sub-directories
+         */
+        std::vector<std::string> subdirectories;
+
+        std::uint64_t bytes = 0;        ///< Total size of the files
+
+        /**
+         * \brief Number of files in the directory and those below it in
+         * the index
+         */
+        std::uint64_t tree_files = 0;
+
+        std::uint64_t tree_bytes = 0;   ///< Total size of those files
+
+        /**
+         * \brief Number of directories in the tree (including this one)
+         * that have never been read
+         */
+        std::uint64_t tree_unread = 0;
+    };  // end directory_entry struct
+
+    /**
+     * \brief Make a `media_record` from a file entry
+     */
+    static media_record make_record(
+        const std::string& directory
+        , const std::string& name
+        , const file_entry& e);
+
+    /**
+     * \brief Find the entry for a file, if it is in the index with the
+     * given size and modification time
+     * 
+     * This must be called with `m_mutex` held.
+     * 
+     * \return The entry, or null if there is no current entry
+     */
+    file_entry* find_current(
+        const std::string& path
+        , std::uint64_t size
+        , std::int64_t mtime);
+
+    /**
+     * \brief Replay the index file into memory
+     * 
+     * \param records Set to the number of records replayed
+     * 
+     * \return `false` if the file is missing or has a bad header, and so
+     * needs to be rewritten
+     */
+    bool load(std::uint64_t& records);
+
+    /**
+     * \brief Rewrite the index file with only the live records
+     * 
+     * \return `false` if the file couldn't be written
+     */
+    bool rewrite(void);
+
+    /**
+     * \brief Bring a directory entry up to date with a listing, logging
+     * the changes
+     * 
+     * This must be called with `m_mutex` held.
+     */
+    void apply(directory_listing&& listing, rescan_statistics& stats);
+
+    /**
+     * \brief Remove a directory and everything below it, logging the
+     * changes
+     * 
+     * This must be called with `m_mutex` held.
+     * 
+     * \return The number of files removed
+     */
+    std::uint64_t remove_tree(const std::string& directory);
+
+    /**
+     * \brief Add to the tree totals of a directory and of each of its
+     * ancestors, up to the first that isn't in the index
+     * 
+     * The changes may be negative; the totals wrap around as unsigned
+     * numbers do, so they come out right.
+     * 
+     * This must be called with `m_mutex` held.
+     */
+    void add_to_tree(
+        const std::string& directory
+        , std::int64_t files
+        , std::int64_t bytes
+        , std::int64_t unread);
+
+    /**
+     * \brief Append a record to the log buffer
+     */
+    void log(
+        char kind
+        , const std::string& path
+        , std::int64_t mtime
+        , const file_entry* e = nullptr);
+
+    /**
+     * \brief Write the log buffer to the index file
+     * 
+     * \throw api::error The write failed
+     */
+    void flush(void);
+
+    std::string m_file_path;    ///< Path of the index file
+
+    /**
+     * \brief The lock giving this process the use of the index file
+     */
+    std::unique_ptr<boost::interprocess::file_lock> m_lock;
+
+    std::FILE* m_file;          ///< The index file, open for appending
+
+    /**
+     * \brief Records waiting to be written to the index file
+     */
+    std::vector<unsigned char> m_pending;
+
+    /**
+     * \brief All directories in the index, keyed on full path
+     */
+    std::unordered_map<std::string, directory_entry> m_directories;
+
+    std::size_t m_file_count;   ///< Number of files in the index
+    std::uint64_t m_generation; ///< Number of changes written
+    mutable std::mutex m_mutex; ///< Protects all members
+
+};  // end media_index class
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,276 @@
+/**
+ * \file metadata.cpp
+ * Implement metadata reading and serialisation
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+
+#include "byte_order.h"
+#include "exif.h"
+#include "metadata.h"
+
+namespace api {
+
+namespace {
+
+using namespace byte_order;
+
+/**
+ * \brief The version of the serialised form
+ */
+const unsigned char encoding_version = 1;
+
+/**
+ * \brief Read the dimensions from the header of a PNG file
+ * 
+ * \return `false` if the buffer is not a PNG file
+ */
+bool read_png_metadata(
+        const unsigned char* data
+        , std::size_t size
+        , media_metadata& metadata)
+{
+    static const unsigned char signature[] =
+        { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    if (size < 24
+            || std::memcmp(data, signature, sizeof(signature)) != 0
+            || std::memcmp(data + 12, "IHDR", 4) != 0)
+        return false;
+
+    // The IHDR chunk is always first, and is big-endian
+    auto be32 = [](const unsigned char* p)
+        {
+            return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16)
+                | (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+        };
+
+    metadata.width = be32(data + 16);
+    metadata.height = be32(data + 20);
+    return true;
+}   // end read_png_metadata function
+
+/**
+ * \brief Append a string with a 16-bit length prefix, truncating it if it
+ * is longer than that allows
+ */
+void put_string(std::vector<unsigned char>& out, const std::string& s)
+{
+    auto length = static_cast<std::uint16_t>(std::min<std::size_t>(
+        s.size(), std::numeric_limits<std::uint16_t>::max()));
+    out.push_back(length & 0xff);
+    out.push_back(length >> 8);
+    out.insert(out.end(), s.begin(), s.begin() + length);
+}   // end put_string function
+
+/**
+ * \brief A bounds-checked reader for the serialised form
+ */
+class decoder
+{
+    public:
+
+    decoder(const unsigned char* data, std::size_t size) :
+        m_data(data)
+        , m_size(size)
+        , m_pos(0)
+    {}
+
+    bool u8(unsigned char& v)
+    {
+        if (m_size - m_pos < 1) return false;
+        v = m_data[m_pos++];
+        return true;
+    }
+
+    bool u16(std::uint16_t& v)
+    {
+        if (m_size - m_pos < 2) return false;
+        v = std::uint16_t(m_data[m_pos] | (m_data[m_pos + 1] << 8));
+        m_pos += 2;
+        return true;
+    }
+
+    bool u32(std::uint32_t& v)
+    {
+        if (m_size - m_pos < 4) return false;
+        v = get_u32(m_data + m_pos);
+        m_pos += 4;
+        return true;
+    }
+
+    bool u64(std::uint64_t& v)
+    {
+        if (m_size - m_pos < 8) return false;
+        v = get_u64(m_data + m_pos);
+        m_pos += 8;
+        return true;
+    }
+
+    bool f64(double& v)
+    {
+        std::uint64_t bits = 0;
+        if (!u64(bits)) return false;
+        std::memcpy(&v, &bits, sizeof(v));
+        return true;
+    }
+
+    bool string(std::string& s)
+    {
+        std::uint16_t length = 0;
+        if (!u16(length) || m_size - m_pos < length) return false;
+        s.assign(reinterpret_cast<const char*>(m_data + m_pos), length);
+        m_pos += length;
+        return true;
+    }
+
+    bool at_end(void) const { return m_pos == m_size; }
+
+    private:
+
+    const unsigned char* m_data;    ///< The serialised data
+    std::size_t m_size;             ///< The size of the data
+    std::size_t m_pos;              ///< The current read position
+
+};  // end decoder class
+
+}   // end anonymous namespace
+
+bool media_metadata::operator==(const media_metadata& other) const
+{
+    return capture_time == other.capture_time
+        && make == other.make
+        && model == other.model
+        && lens == other.lens
+        && width == other.width
+        && height == other.height
+        && orientation == other.orientation
+        && has_location == other.has_location
+        && latitude == other.latitude
+        && longitude == other.longitude
+        && keywords == other.keywords;
+}   // end operator== method
+
+bool read_metadata(
+        const std::string& path
+        , media_metadata& metadata
+        , std::uint64_t* bytes_read
+        , bool evict)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    // The buffer is reused, because a header read is small compared with
+    // the cost of allocating and clearing the buffer for every file
+    thread_local std::vector<unsigned char> buffer(exif::header_size);
+
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+#if defined(__linux__)
+    if (evict) ::posix_fadvise(::fileno(file), 0, 0, POSIX_FADV_DONTNEED);
+#else
+    (void)evict;
+#endif
+
+    std::size_t size = std::fread(buffer.data(), 1, buffer.size(), file);
+    bool error = std::ferror(file) != 0;
+    std::fclose(file);
+
+    if (bytes_read) *bytes_read += size;
+    if (error) return false;
+
+    return parse_metadata(buffer.data(), size, metadata);
+}   // end read_metadata function
+
+bool parse_metadata(
+        const unsigned char* data
+        , std::size_t size
+        , media_metadata& metadata)
+{
+    size = std::min(size, exif::header_size);
+    return exif::read_metadata(data, size, metadata)
+        || read_png_metadata(data, size, metadata);
+}   // end parse_metadata function
+
+void encode_metadata(
+        const media_metadata& metadata
+        , std::vector<unsigned char>& out)
+{
+    std::uint64_t latitude = 0, longitude = 0;
+    std::memcpy(&latitude, &metadata.latitude, sizeof(latitude));
+    std::memcpy(&longitude, &metadata.longitude, sizeof(longitude));
+
+    out.push_back(encoding_version);
+    put_u64(out, static_cast<std::uint64_t>(metadata.capture_time));
+    put_u32(out, metadata.width);
+    put_u32(out, metadata.height);
+    out.push_back(metadata.orientation & 0xff);
+    out.push_back(metadata.orientation >> 8);
+    out.push_back(metadata.has_location ? 1 : 0);
+    put_u64(out, latitude);
+    put_u64(out, longitude);
+    put_string(out, metadata.make);
+    put_string(out, metadata.model);
+    put_string(out, metadata.lens);
+
+    auto count = std::min<std::size_t>(
+        metadata.keywords.size(), std::numeric_limits<std::uint16_t>::max());
+    out.push_back(count & 0xff);
+    out.push_back(count >> 8);
+    for (std::size_t i = 0; i < count; ++i)
+        put_string(out, metadata.keywords[i]);
+}   // end encode_metadata function
+
+bool decode_metadata(
+        const unsigned char* data
+        , std::size_t size
+        , media_metadata& metadata)
+{
+    decoder d(data, size);
+    media_metadata m;
+
+    unsigned char version = 0, has_location = 0;
+    std::uint64_t capture_time = 0;
+    std::uint16_t count = 0;
+    if (!d.u8(version) || version != encoding_version
+            || !d.u64(capture_time)
+            || !d.u32(m.width)
+            || !d.u32(m.height)
+            || !d.u16(m.orientation)
+            || !d.u8(has_location)
+            || !d.f64(m.latitude)
+            || !d.f64(m.longitude)
+            || !d.string(m.make)
+            || !d.string(m.model)
+            || !d.string(m.lens)
+            || !d.u16(count))
+        return false;
+
+    m.capture_time = static_cast<std::int64_t>(capture_time);
+    m.has_location = has_location != 0;
+
+    m.keywords.resize(count);
+    for (auto& k : m.keywords)
+        if (!d.string(k)) return false;
+
+    if (!d.at_end()) return false;
+
+    metadata = std::move(m);
+    return true;
+}   // end decode_metadata function
+
+}   // end api namespace
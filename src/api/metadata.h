@@ -0,0 +1,123 @@
+/**
+ * \file metadata.h
+ * Declare the `media_metadata` struct, and functionality for reading it
+ * from files
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef _api_metadata_h_included
+#define _api_metadata_h_included
+
+namespace api {
+
+/**
+ * \brief Descriptive information about a media file, read from its
+ * headers
+ */
+struct media_metadata
+{
+    /**
+     * \brief When the image was captured, in seconds since the epoch; the
+     * camera's clock is taken as UTC, because EXIF doesn't record a time
+     * zone; 0 if unknown
+     */
+    std::int64_t capture_time = 0;
+
+    std::string make;               ///< Camera manufacturer
+    std::string model;              ///< Camera model
+    std::string lens;               ///< Lens model
+    std::uint32_t width = 0;        ///< Image width in pixels; 0 if unknown
+    std::uint32_t height = 0;       ///< Image height in pixels; 0 if unknown
+
+    /**
+     * \brief The EXIF orientation (1 to 8); 0 if unknown
+     */
+    std::uint16_t orientation = 0;
+
+    bool has_location = false;      ///< Whether there is a GPS location
+    double latitude = 0;            ///< Degrees north
+    double longitude = 0;           ///< Degrees east
+
+    /**
+     * \brief Keywords (from the XMP `dc:subject` property)
+     */
+    std::vector<std::string> keywords;
+
+    bool operator==(const media_metadata& other) const;
+};  // end media_metadata struct
+
+/**
+ * \brief Read the metadata of a file, from a bounded read of its header
+ * 
+ * JPEG files are read for their EXIF block, XMP packet and frame header,
+ * TIFF-based files (including most camera raw formats) for their EXIF
+ * data, and PNG files for their dimensions. At most `exif::header_size`
+ * bytes are read, and the image is never decoded.
+ * 
+ * \param path The path of the file
+ * 
+ * \param metadata Filled in with whatever metadata is found
+ * 
+ * \param bytes_read If not null, the number of bytes read is added to this
+ * 
+ * \param evict If true, the file is first dropped from the operating
+ * system's page cache (where this is supported), so that the read comes
+ * from disk; this is for measuring cold-cache performance
+ * 
+ * \return `false` if the file couldn't be read, or is not a recognised
+ * format
+ */
+extern bool read_metadata(
+    const std::string& path
+    , media_metadata& metadata
+    , std::uint64_t* bytes_read = nullptr
+    , bool evict = false);
+
+/**
+ * \brief Read the metadata from the header of a file that has already been
+ * read (see `read_metadata`)
+ * 
+ * \param data The start of the file
+ * 
+ * \param size The number of bytes at `data`; at most `exif::header_size`
+ * are looked at
+ * 
+ * \param metadata Filled in with whatever metadata is found
+ * 
+ * \return `false` if the data is not a recognised format
+ */
+extern bool parse_metadata(
+    const unsigned char* data
+    , std::size_t size
+    , media_metadata& metadata);
+
+/**
+ * \brief Serialise metadata into a compact binary form
+ */
+extern void encode_metadata(
+    const media_metadata& metadata
+    , std::vector<unsigned char>& out);
+
+/**
+ * \brief Deserialise metadata from the form written by `encode_metadata`
+ * 
+ * \return `false` if the data is malformed
+ */
+extern bool decode_metadata(
+    const unsigned char* data
+    , std::size_t size
+    , media_metadata& metadata);
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * \file parallel.h
+ * Declare a helper for spreading work over a number of threads
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _api_parallel_h_included
+#define _api_parallel_h_included
+
+namespace api {
+
+/**
+ * \brief Retrieve the number of threads to use for a requested number,
+ * where 0 means one per core
+ */
+inline unsigned thread_count(unsigned threads)
+{
+    return threads != 0
+        ? threads
+        : std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * \brief Call a function for each of a number of items, spread over a
+ * number of threads
+ * 
+ * Items are handed out one at a time, so that slow items don't hold up
+ * the rest. The calling thread is one of the workers.
+ * 
+ * If the function throws, no more items are handed out, and the first
+ * exception is rethrown in the calling thread once all the workers have
+ * finished.
+ */
+template <typename Function>
+void parallel_for(std::size_t count, unsigned threads, Function fn)
+{
+    std::atomic<std::size_t> next(0);
+    std::mutex failure_mutex;
+    std::exception_ptr failure;
+
+    auto work = [&]
+    {
+        try
+        {
+            for (std::size_t i = next++; i < count; i = next++) fn(i);
+        }
+        catch (...)
+        {
+            next = count;
+            std::lock_guard<std::mutex> lock(failure_mutex);
+            if (!failure) failure = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads && i < count; ++i)
+        workers.emplace_back(work);
+    work();
+    for (auto& w : workers) w.join();
+
+    if (failure) std::rethrow_exception(failure);
+}   // end parallel_for function
+
+}   // end api namespace
+
+#endif
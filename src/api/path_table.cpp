@@ -0,0 +1,240 @@
+/**
+ * \file path_table.cpp
+ * Implement the `path_table` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstring>
+#include <limits>
+
+#include "error.h"
+#include "path_table.h"
+
+namespace api {
+
+namespace {
+
+/**
+ * \brief The number of slots in a new hash table
+ */
+const std::size_t initial_slots = 64;
+
+/**
+ * \brief Split a path into the length of its directory and the position
+ * of its name, in the same way as `media_index`
+ */
+void split(const std::string& path, std::size_t& directory, std::size_t& name)
+{
+    auto pos = path.find_last_of('/');
+    if (pos == std::string::npos)
+    {
+        directory = 0;
+        name = 0;
+    }
+    else
+    {
+        directory = pos == 0 ? 1 : pos;
+        name = pos + 1;
+    }
+}   // end split function
+
+/**
+ * \brief Hash a file name within a directory (FNV-1a)
+ */
+std::uint32_t hash_name(
+        std::uint32_t directory
+        , const char* name
+        , std::size_t length)
+{
+    std::uint64_t h = 14695981039346656037ull ^ directory;
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        h ^= static_cast<unsigned char>(name[i]);
+        h *= 1099511628211ull;
+    }
+    return static_cast<std::uint32_t>(h ^ (h >> 32));
+}   // end hash_name function
+
+}   // end anonymous namespace
+
+path_table::path_table(void) :
+    m_directories()
+    , m_directory_map()
+    , m_names()
+    , m_name_offsets(1, 0)
+    , m_directory_ids()
+    , m_slots(initial_slots, slot{empty, 0})
+{
+}   // end constructor
+
+path_table::id_type path_table::intern(const std::string& path)
+{
+    std::size_t directory_length = 0, name_start = 0;
+    split(path, directory_length, name_start);
+
+    auto d = m_directory_map.find(path.substr(0, directory_length));
+    id_type directory = 0;
+    if (d != m_directory_map.end()) directory = d->second;
+    else
+    {
+        directory = static_cast<id_type>(m_directories.size());
+        m_directories.push_back(path.substr(0, directory_length));
+        m_directory_map.emplace(m_directories.back(), directory);
+    }
+
+    const char* name = path.data() + name_start;
+    std::size_t length = path.size() - name_start;
+    auto hash = hash_name(directory, name, length);
+
+    auto s = find_slot(directory, name, length, hash);
+    if (m_slots[s].id != empty) return m_slots[s].id;
+
+    if (m_names.size() + length > std::numeric_limits<std::uint32_t>::max())
+        throw error("too many paths for a path table");
+
+    auto id = static_cast<id_type>(m_directory_ids.size());
+    m_names.append(name, length);
+    m_name_offsets.push_back(static_cast<std::uint32_t>(m_names.size()));
+    m_directory_ids.push_back(directory);
+    m_slots[s] = slot{id, hash};
+
+    if (size() * 4 > m_slots.size() * 3) grow();
+
+    return id;
+}   // end intern method
+
+bool path_table::find(const std::string& path, id_type& id) const
+{
+    std::size_t directory_length = 0, name_start = 0;
+    split(path, directory_length, name_start);
+
+    id_type directory = 0;
+    if (!find_directory(path.substr(0, directory_length), directory))
+        return false;
+
+    const char* name = path.data() + name_start;
+    std::size_t length = path.size() - name_start;
+    auto s = find_slot(
+        directory
+        , name
+        , length
+        , hash_name(directory, name, length));
+    if (m_slots[s].id == empty) return false;
+
+    id = m_slots[s].id;
+    return true;
+}   // end find method
+
+bool path_table::find_directory(
+        const std::string& directory
+        , id_type& id) const
+{
+    auto d = m_directory_map.find(directory);
+    if (d == m_directory_map.end()) return false;
+
+    id = d->second;
+    return true;
+}   // end find_directory method
+
+std::string path_table::path(id_type id) const
+{
+    const auto& directory = m_directories[m_directory_ids[id]];
+    auto result = directory;
+    if (!directory.empty() && directory.back() != '/') result += '/';
+    result.append(
+        m_names
+        , m_name_offsets[id]
+        , m_name_offsets[id + 1] - m_name_offsets[id]);
+    return result;
+}   // end path method
+
+void path_table::clear(void)
+{
+    m_directories.clear();
+    m_directory_map.clear();
+    m_names.clear();
+    m_name_offsets.assign(1, 0);
+    m_directory_ids.clear();
+    m_slots.assign(initial_slots, slot{empty, 0});
+}   // end clear method
+
+void path_table::reserve(std::size_t paths)
+{
+    m_name_offsets.reserve(paths + 1);
+    m_directory_ids.reserve(paths);
+    while (paths * 4 > m_slots.size() * 3) grow();
+}   // end reserve method
+
+void path_table::shrink_to_fit(void)
+{
+    m_directories.shrink_to_fit();
+    m_names.shrink_to_fit();
+    m_name_offsets.shrink_to_fit();
+    m_directory_ids.shrink_to_fit();
+}   // end shrink_to_fit method
+
+std::size_t path_table::memory_usage(void) const
+{
+    std::size_t result = sizeof(*this)
+        + m_directories.capacity() * sizeof(std::string)
+        + m_names.capacity()
+        + m_name_offsets.capacity() * sizeof(std::uint32_t)
+        + m_directory_ids.capacity() * sizeof(id_type)
+        + m_slots.capacity() * sizeof(slot);
+
+    // Each directory is held twice: by id, and as a key of the map
+    for (const auto& d : m_directories)
+        result += 2 * d.capacity() + sizeof(d) + 2 * sizeof(void*);
+
+    return result;
+}   // end memory_usage method
+
+std::size_t path_table::find_slot(
+        id_type directory
+        , const char* name
+        , std::size_t length
+        , std::uint32_t hash) const
+{
+    std::size_t mask = m_slots.size() - 1;
+    for (std::size_t s = hash & mask; ; s = (s + 1) & mask)
+    {
+        const auto& candidate = m_slots[s];
+        if (candidate.id == empty) return s;
+
+        // The stored hash rules out almost all other paths without
+        // touching their names
+        auto id = candidate.id;
+        if (candidate.hash == hash
+                && m_directory_ids[id] == directory
+                && m_name_offsets[id + 1] - m_name_offsets[id] == length
+                && std::memcmp(
+                    m_names.data() + m_name_offsets[id]
+                    , name
+                    , length) == 0)
+            return s;
+    }
+}   // end find_slot method
+
+void path_table::grow(void)
+{
+    std::vector<slot> slots(m_slots.size() * 2, slot{empty, 0});
+    std::size_t mask = slots.size() - 1;
+
+    for (const auto& old : m_slots)
+    {
+        if (old.id == empty) continue;
+
+        auto s = old.hash & mask;
+        while (slots[s].id != empty) s = (s + 1) & mask;
+        slots[s] = old;
+    }
+
+    m_slots.swap(slots);
+}   // end grow method
+
+}   // end api namespace
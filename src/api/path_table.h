@@ -0,0 +1,211 @@
+/**
+ * \file path_table.h
+ * Declare the `path_table` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _api_path_table_h_included
+#define _api_path_table_h_included
+
+namespace api {
+
+/**
+ * \brief A table of file paths, giving each a compact number
+ * 
+ * Holding a path as a string per file repeats its directory for every
+ * file, costs a heap allocation each, and makes every lookup hash the
+ * whole path. A path table instead holds each directory path once, and
+ * packs the file names end to end in a single buffer; a path costs its
+ * name and about 20 bytes. Each path is given an *id*, numbered from 0 in
+ * the order they are added, and clients key their own tables on the ids
+ * (e.g. in a vector indexed by id), which are cheap to hash and compare.
+ * 
+ * Paths are found by hashing only their directory's id and their name,
+ * into an open-addressed table of ids.
+ * 
+ * Paths are never removed (except by `clear`), so an id stays valid for as
+ * long as the table does.
+ * 
+ * Like the standard containers, a table may be read from several threads
+ * at once, but must not be read while it is being changed.
+ */
+class path_table
+{
+    public:
+
+    /**
+     * \brief The type of path and directory ids
+     */
+    using id_type = std::uint32_t;
+
+    /**
+     * \brief Constructor, making an empty table
+     */
+    path_table(void);
+
+    /**
+     * \brief Retrieve the number of paths in the table
+     */
+    std::size_t size(void) const { return m_directory_ids.size(); }
+
+    /**
+     * \brief Retrieve the number of distinct directories in the table
+     */
+    std::size_t directory_count(void) const { return m_directories.size(); }
+
+    /**
+     * \brief Add a path to the table, if it isn't there already
+     * 
+     * \return The id of the path
+     * 
+     * \throw api::error The table is full (the names come to 4 GiB)
+     */
+    id_type intern(const std::string& path);
+
+    /**
+     * \brief Look up a path without adding it
+     * 
+     * \return `true` if the path is in the table, in which case `id` is set
+     * to its id
+     */
+    bool find(const std::string& path, id_type& id) const;
+
+    /**
+     * \brief Look up a directory
+     * 
+     * \return `true` if any path in the table is in the directory, in
+     * which case `id` is set to its directory id
+     */
+    bool find_directory(const std::string& directory, id_type& id) const;
+
+    /**
+     * \brief Retrieve the full path for an id
+     */
+    std::string path(id_type id) const;
+
+    /**
+     * \brief Retrieve the file name for an id
+     */
+    std::string name(id_type id) const
+    {
+        return m_names.substr(
+            m_name_offsets[id]
+            , m_name_offsets[id + 1] - m_name_offsets[id]);
+    }
+
+    /**
+     * \brief Retrieve the directory id of a path
+     */
+    id_type directory_id(id_type id) const { return m_directory_ids[id]; }
+
+    /**
+     * \brief Retrieve the directory path of a path
+     */
+    const std::string& directory(id_type id) const
+        { return m_directories[m_directory_ids[id]]; }
+
+    /**
+     * \brief Retrieve a directory path by its directory id
+     */
+    const std::string& directory_path(id_type directory) const
+        { return m_directories[directory]; }
+
+    /**
+     * \brief Remove all the paths, making all ids invalid
+     */
+    void clear(void);
+
+    /**
+     * \brief Make room for a number of paths, to avoid growing the table
+     * while they are added
+     */
+    void reserve(std::size_t paths);
+
+    /**
+     * \brief Release any spare memory, once all the paths have been added
+     */
+    void shrink_to_fit(void);
+
+    /**
+     * \brief Retrieve the approximate number of bytes used by the table
+     */
+    std::size_t memory_usage(void) const;
+
+    private:
+
+    /**
+     * \brief An entry in the hash table
+     */
+    struct slot
+    {
+        id_type id;         ///< The path id; `empty` if the slot is free
+        std::uint32_t hash; ///< The lower bits of the path's hash
+    };  // end slot struct
+
+    /**
+     * \brief The id of an empty slot
+     */
+    static const id_type empty = 0xffffffff;
+
+    /**
+     * \brief Find the slot for a directory and name
+     * 
+     * \return The index of the slot holding the path, or of the free slot
+     * at which it would be added
+     */
+    std::size_t find_slot(
+        id_type directory
+        , const char* name
+        , std::size_t length
+        , std::uint32_t hash) const;
+
+    /**
+     * \brief Double the size of the hash table
+     */
+    void grow(void);
+
+    /**
+     * \brief The directory paths, by directory id
+     */
+    std::vector<std::string> m_directories;
+
+    /**
+     * \brief The directory ids, keyed on directory path
+     */
+    std::unordered_map<std::string, id_type> m_directory_map;
+
+    std::string m_names;    ///< The file names, end to end
+
+    /**
+     * \brief The offset of each name in `m_names`, and its length at the
+     * end
+     */
+    std::vector<std::uint32_t> m_name_offsets;
+
+    /**
+     * \brief The directory id of each path
+     */
+    std::vector<id_type> m_directory_ids;
+
+    /**
+     * \brief The hash table, whose size is a power of two, and which is
+     * never more than three quarters full
+     */
+    std::vector<slot> m_slots;
+
+};  // end path_table class
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,380 @@
+/**
+ * \file posting_list.cpp
+ * Implement the `posting_list` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <bitset>
+#include <iterator>
+
+#include "posting_list.h"
+
+namespace api {
+
+namespace {
+
+/**
+ * \brief The most members that a container holds as an array
+ */
+const std::uint32_t max_array_size = 4096;
+
+/**
+ * \brief The number of 64-bit words in a container's bitmap
+ */
+const std::size_t bitmap_words = 65536 / 64;
+
+inline std::uint32_t popcount(std::uint64_t bits)
+{
+    return static_cast<std::uint32_t>(std::bitset<64>(bits).count());
+}
+
+inline bool test(const std::vector<std::uint64_t>& bitmap, std::uint16_t low)
+{
+    return (bitmap[low >> 6] >> (low & 63)) & 1;
+}
+
+inline void set(std::vector<std::uint64_t>& bitmap, std::uint16_t low)
+{
+    bitmap[low >> 6] |= std::uint64_t(1) << (low & 63);
+}
+
+/**
+ * \brief Combine two sorted sequences of containers by key
+ * 
+ * `both` is called for a pair of containers with the same key, and `only_a`
+ * for a container of `a` whose key is not in `b`. Each returns whether the
+ * container it was given (as modified) should be kept. Containers of `b`
+ * whose keys aren't in `a` are passed to `only_b`, which may append them to
+ * the result.
+ */
+template <typename Container, typename Both, typename OnlyA, typename OnlyB>
+std::vector<Container> merge(
+        std::vector<Container>& a
+        , const std::vector<Container>& b
+        , Both both
+        , OnlyA only_a
+        , OnlyB only_b)
+{
+    std::vector<Container> result;
+    result.reserve(a.size());
+
+    auto i = a.begin();
+    auto j = b.begin();
+    while (i != a.end() || j != b.end())
+    {
+        if (j == b.end() || (i != a.end() && i->key < j->key))
+        {
+            if (only_a(*i)) result.push_back(std::move(*i));
+            ++i;
+        }
+        else if (i == a.end() || j->key < i->key)
+        {
+            only_b(*j, result);
+            ++j;
+        }
+        else
+        {
+            if (both(*i, *j)) result.push_back(std::move(*i));
+            ++i;
+            ++j;
+        }
+    }
+
+    return result;
+}   // end merge function
+
+}   // end anonymous namespace
+
+posting_list posting_list::all(std::uint32_t count)
+{
+    posting_list result;
+    for (std::uint64_t start = 0; start < count; start += 65536)
+    {
+        container c;
+        c.key = static_cast<std::uint16_t>(start >> 16);
+        c.count = static_cast<std::uint32_t>(
+            std::min<std::uint64_t>(65536, count - start));
+        c.bitmap.assign(bitmap_words, 0);
+        for (std::uint32_t low = 0; low < c.count; low += 64)
+            c.bitmap[low >> 6] = c.count - low >= 64
+                ? ~std::uint64_t(0)
+                : (std::uint64_t(1) << (c.count - low)) - 1;
+        normalise(c);
+        result.m_containers.push_back(std::move(c));
+    }
+
+    return result;
+}   // end all method
+
+void posting_list::add(std::uint32_t n)
+{
+    auto key = static_cast<std::uint16_t>(n >> 16);
+    auto low = static_cast<std::uint16_t>(n & 0xffff);
+
+    // Numbers normally arrive in ascending order, and go on the end
+    auto c = m_containers.end();
+    if (m_containers.empty() || m_containers.back().key < key)
+        c = m_containers.insert(c, container{key, 0, {}, {}});
+    else if (m_containers.back().key == key) c = std::prev(c);
+    else
+    {
+        c = std::lower_bound(
+            m_containers.begin()
+            , m_containers.end()
+            , key
+            , [](const container& x, std::uint16_t k) { return x.key < k; });
+        if (c->key != key)
+            c = m_containers.insert(c, container{key, 0, {}, {}});
+    }
+
+    if (!c->bitmap.empty())
+    {
+        if (test(c->bitmap, low)) return;
+        set(c->bitmap, low);
+        ++c->count;
+        return;
+    }
+
+    auto& array = c->array;
+    if (array.empty() || array.back() < low) array.push_back(low);
+    else
+    {
+        auto pos = std::lower_bound(array.begin(), array.end(), low);
+        if (*pos == low) return;
+        array.insert(pos, low);
+    }
+
+    ++c->count;
+    normalise(*c);
+}   // end add method
+
+bool posting_list::contains(std::uint32_t n) const
+{
+    auto key = static_cast<std::uint16_t>(n >> 16);
+    auto low = static_cast<std::uint16_t>(n & 0xffff);
+
+    auto c = std::lower_bound(
+        m_containers.begin()
+        , m_containers.end()
+        , key
+        , [](const container& x, std::uint16_t k) { return x.key < k; });
+    if (c == m_containers.end() || c->key != key) return false;
+
+    if (!c->bitmap.empty()) return test(c->bitmap, low);
+    return std::binary_search(c->array.begin(), c->array.end(), low);
+}   // end contains method
+
+std::size_t posting_list::size(void) const
+{
+    std::size_t result = 0;
+    for (const auto& c : m_containers) result += c.count;
+    return result;
+}   // end size method
+
+std::size_t posting_list::memory_usage(void) const
+{
+    std::size_t result = sizeof(*this)
+        + m_containers.capacity() * sizeof(container);
+    for (const auto& c : m_containers)
+        result += c.array.capacity() * sizeof(std::uint16_t)
+            + c.bitmap.capacity() * sizeof(std::uint64_t);
+    return result;
+}   // end memory_usage method
+
+std::vector<std::uint32_t> posting_list::numbers(void) const
+{
+    std::vector<std::uint32_t> result;
+    result.reserve(size());
+    for_each([&result](std::uint32_t n) { result.push_back(n); });
+    return result;
+}   // end numbers method
+
+posting_list& posting_list::operator&=(const posting_list& other)
+{
+    m_containers = merge(
+        m_containers
+        , other.m_containers
+        , [](container& a, const container& b)
+        {
+            if (a.bitmap.empty() && b.bitmap.empty())
+            {
+                std::vector<std::uint16_t> result;
+                std::set_intersection(
+                    a.array.begin()
+                    , a.array.end()
+                    , b.array.begin()
+                    , b.array.end()
+                    , std::back_inserter(result));
+                a.array = std::move(result);
+                a.count = static_cast<std::uint32_t>(a.array.size());
+            }
+            else if (a.bitmap.empty())
+            {
+                a.array.erase(
+                    std::remove_if(
+                        a.array.begin()
+                        , a.array.end()
+                        , [&b](std::uint16_t low)
+                            { return !test(b.bitmap, low); })
+                    , a.array.end());
+                a.count = static_cast<std::uint32_t>(a.array.size());
+            }
+            else if (b.bitmap.empty())
+            {
+                std::vector<std::uint16_t> result;
+                for (auto low : b.array)
+                    if (test(a.bitmap, low)) result.push_back(low);
+                a.bitmap = std::vector<std::uint64_t>();
+                a.array = std::move(result);
+                a.count = static_cast<std::uint32_t>(a.array.size());
+            }
+            else
+            {
+                a.count = 0;
+                for (std::size_t w = 0; w < bitmap_words; ++w)
+                    a.count += popcount(a.bitmap[w] &= b.bitmap[w]);
+                normalise(a);
+            }
+
+            return a.count > 0;
+        }
+        , [](container&) { return false; }
+        , [](const container&, std::vector<container>&) {});
+
+    return *this;
+}   // end operator&= method
+
+posting_list& posting_list::operator|=(const posting_list& other)
+{
+    m_containers = merge(
+        m_containers
+        , other.m_containers
+        , [](container& a, const container& b)
+        {
+            if (a.bitmap.empty() && b.bitmap.empty())
+            {
+                std::vector<std::uint16_t> result;
+                std::set_union(
+                    a.array.begin()
+                    , a.array.end()
+                    , b.array.begin()
+                    , b.array.end()
+                    , std::back_inserter(result));
+                a.array = std::move(result);
+                a.count = static_cast<std::uint32_t>(a.array.size());
+                normalise(a);
+                return true;
+            }
+
+            if (a.bitmap.empty())
+            {
+                auto array = std::move(a.array);
+                a.array.clear();
+                a.bitmap = b.bitmap;
+                for (auto low : array) set(a.bitmap, low);
+            }
+            else if (b.bitmap.empty())
+                for (auto low : b.array) set(a.bitmap, low);
+            else
+                for (std::size_t w = 0; w < bitmap_words; ++w)
+                    a.bitmap[w] |= b.bitmap[w];
+
+            a.count = 0;
+            for (auto bits : a.bitmap) a.count += popcount(bits);
+            return true;
+        }
+        , [](container&) { return true; }
+        , [](const container& b, std::vector<container>& result)
+        {
+            result.push_back(b);
+        });
+
+    return *this;
+}   // end operator|= method
+
+posting_list& posting_list::operator-=(const posting_list& other)
+{
+    m_containers = merge(
+        m_containers
+        , other.m_containers
+        , [](container& a, const container& b)
+        {
+            if (a.bitmap.empty())
+            {
+                a.array.erase(
+                    std::remove_if(
+                        a.array.begin()
+                        , a.array.end()
+                        , [&b](std::uint16_t low)
+                        {
+                            return b.bitmap.empty()
+                                ? std::binary_search(
+                                    b.array.begin(), b.array.end(), low)
+                                : test(b.bitmap, low);
+                        })
+                    , a.array.end());
+                a.count = static_cast<std::uint32_t>(a.array.size());
+                return a.count > 0;
+            }
+
+            if (b.bitmap.empty())
+                for (auto low : b.array)
+                    a.bitmap[low >> 6] &= ~(std::uint64_t(1) << (low & 63));
+            else
+                for (std::size_t w = 0; w < bitmap_words; ++w)
+                    a.bitmap[w] &= ~b.bitmap[w];
+
+            a.count = 0;
+            for (auto bits : a.bitmap) a.count += popcount(bits);
+            normalise(a);
+            return a.count > 0;
+        }
+        , [](container&) { return true; }
+        , [](const container&, std::vector<container>&) {});
+
+    return *this;
+}   // end operator-= method
+
+bool posting_list::operator==(const posting_list& other) const
+{
+    if (m_containers.size() != other.m_containers.size()) return false;
+
+    for (std::size_t i = 0; i < m_containers.size(); ++i)
+    {
+        const auto& a = m_containers[i];
+        const auto& b = other.m_containers[i];
+        if (a.key != b.key || a.count != b.count
+                || a.array != b.array || a.bitmap != b.bitmap)
+            return false;
+    }
+
+    return true;
+}   // end operator== method
+
+void posting_list::normalise(container& c)
+{
+    if (c.bitmap.empty() && c.count > max_array_size)
+    {
+        c.bitmap.assign(bitmap_words, 0);
+        for (auto low : c.array) set(c.bitmap, low);
+        c.array = std::vector<std::uint16_t>();
+    }
+    else if (!c.bitmap.empty() && c.count <= max_array_size)
+    {
+        c.array.clear();
+        c.array.reserve(c.count);
+        for (std::size_t w = 0; w < bitmap_words; ++w)
+            for (auto bits = c.bitmap[w]; bits; bits &= bits - 1)
+                c.array.push_back(
+                    static_cast<std::uint16_t>(w * 64 + lowest_bit(bits)));
+        c.bitmap = std::vector<std::uint64_t>();
+    }
+}   // end normalise method
+
+}   // end api namespace
@@ -0,0 +1,172 @@
+/**
+ * \file posting_list.h
+ * Declare the `posting_list` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef _api_posting_list_h_included
+#define _api_posting_list_h_included
+
+namespace api {
+
+/**
+ * \brief A compressed set of document numbers, supporting fast set
+ * operations
+ * 
+ * This is a *roaring bitmap*: the 32-bit numbers are split into chunks of
+ * 65536 by their upper 16 bits, and each chunk that has any members is
+ * held in a *container* of whichever form is smaller:
+ * 
+ * * a sorted array of the lower 16 bits, for chunks with up to 4096
+ *   members (at most 8 KiB)
+ * 
+ * * a bitmap of 65536 bits (8 KiB), for denser chunks
+ * 
+ * Rare terms cost two bytes per document, and common ones an eighth of a
+ * byte, and intersections, unions and differences work a container at a
+ * time: merging arrays, probing bitmaps with arrays, or combining bitmaps
+ * a 64-bit word at a time.
+ * 
+ * Numbers are added most efficiently in ascending order, which is how an
+ * index is normally built.
+ */
+class posting_list
+{
+    public:
+
+    /**
+     * \brief Create a list holding every number from 0 to `count - 1`
+     */
+    static posting_list all(std::uint32_t count);
+
+    /**
+     * \brief Add a number to the list
+     */
+    void add(std::uint32_t n);
+
+    /**
+     * \brief Check whether the list holds a number
+     */
+    bool contains(std::uint32_t n) const;
+
+    /**
+     * \brief Retrieve the number of numbers in the list
+     */
+    std::size_t size(void) const;
+
+    /**
+     * \brief Check whether the list is empty
+     */
+    bool empty(void) const { return m_containers.empty(); }
+
+    /**
+     * \brief Retrieve the approximate number of bytes used by the list
+     */
+    std::size_t memory_usage(void) const;
+
+    /**
+     * \brief Call a function for each number in the list, in ascending
+     * order
+     */
+    template <typename Function>
+    void for_each(Function fn) const
+    {
+        for (const auto& c : m_containers)
+        {
+            std::uint32_t high = std::uint32_t(c.key) << 16;
+            if (c.bitmap.empty())
+                for (auto low : c.array) fn(high | low);
+            else
+                for (std::size_t w = 0; w < c.bitmap.size(); ++w)
+                    for (auto bits = c.bitmap[w]; bits; bits &= bits - 1)
+                        fn(high | std::uint32_t(w * 64 + lowest_bit(bits)));
+        }
+    }
+
+    /**
+     * \brief Retrieve the numbers in the list, in ascending order
+     */
+    std::vector<std::uint32_t> numbers(void) const;
+
+    posting_list& operator&=(const posting_list& other);    ///< Intersect
+    posting_list& operator|=(const posting_list& other);    ///< Unite
+    posting_list& operator-=(const posting_list& other);    ///< Subtract
+
+    bool operator==(const posting_list& other) const;
+
+    private:
+
+    /**
+     * \brief Retrieve the index of the lowest set bit of a non-zero word
+     */
+    static unsigned lowest_bit(std::uint64_t bits)
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned>(__builtin_ctzll(bits));
+#else
+        unsigned i = 0;
+        while (!(bits & 1)) { bits >>= 1; ++i; }
+        return i;
+#endif
+    }
+
+    /**
+     * \brief The members of the list with the same upper 16 bits
+     */
+    struct container
+    {
+        std::uint16_t key;      ///< The upper 16 bits
+        std::uint32_t count;    ///< The number of members
+
+        /**
+         * \brief The sorted lower 16 bits of the members, if `bitmap` is
+         * empty
+         */
+        std::vector<std::uint16_t> array;
+
+        /**
+         * \brief The members as a bitmap of 1024 words, for dense
+         * containers
+         */
+        std::vector<std::uint64_t> bitmap;
+    };  // end container struct
+
+    /**
+     * \brief Put a container in whichever form is smaller for its count
+     */
+    static void normalise(container& c);
+
+    /**
+     * \brief The containers, ordered by key, with none empty
+     */
+    std::vector<container> m_containers;
+
+};  // end posting_list class
+
+inline posting_list operator&(posting_list a, const posting_list& b)
+{
+    return a &= b;
+}
+
+inline posting_list operator|(posting_list a, const posting_list& b)
+{
+    return a |= b;
+}
+
+inline posting_list operator-(posting_list a, const posting_list& b)
+{
+    return a -= b;
+}
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,573 @@
+/**
+ * \file scanner.cpp
+ * Implement the media scanner
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "error.h"
+#include "parallel.h"
+#include "scanner.h"
+
+namespace api {
+
+namespace {
+
+/**
+ * \brief Join a directory path and an entry name
+ */
+std::string join(const std::string& directory, const char* name)
+{
+    std::string path;
+    path.reserve(directory.size() + 1 + std::strlen(name));
+    path = directory;
+    if (path.empty() || path.back() != '/') path += '/';
+    path += name;
+    return path;
+}   // end join function
+
+#if defined(__linux__)
+
+/**
+ * \brief The layout of the records returned by `getdents64`
+ * 
+ * This is only used to interpret the buffer; the name is actually variable
+ * length.
+ */
+struct linux_dirent64
+{
+    std::uint64_t d_ino;        ///< Inode number
+    std::int64_t d_off;         ///< Offset of the next record
+    unsigned short d_reclen;    ///< Length of this record
+    unsigned char d_type;       ///< File type
+    char d_name[256];           ///< Null-terminated file name
+};  // end linux_dirent64 struct
+
+/**
+ * \brief Convert a `stat` modification time to milliseconds
+ */
+std::int64_t mtime_ms(const struct stat& st)
+{
+    return std::int64_t(st.st_mtim.tv_sec) * 1000
+        + st.st_mtim.tv_nsec / 1000000;
+}
+
+/**
+ * \brief Retrieve the modification time of a directory
+ * 
+ * \return `false` if the directory couldn't be found
+ */
+bool directory_mtime(const std::string& directory, std::int64_t& mtime)
+{
+    struct stat st;
+    if (::stat(directory.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        return false;
+
+    mtime = mtime_ms(st);
+    return true;
+}   // end directory_mtime function
+
+/**
+ * \brief Read the entries of one directory
+ * 
+ * \param root Whether this is the root of the scan, which is opened even
+ * if it is a symbolic link
+ * 
+ * \return `false` if the directory couldn't be read
+ */
+bool enumerate(
+        const std::string& directory
+        , bool root
+        , std::vector<media_file>& files
+        , std::vector<std::string>& subdirectories
+        , scan_statistics& stats)
+{
+    int fd = ::open(
+        directory.c_str()
+        , O_RDONLY | O_DIRECTORY | O_CLOEXEC | (root ? 0 : O_NOFOLLOW));
+    if (fd < 0) return false;
+
+    alignas(linux_dirent64) char buffer[64 * 1024];
+    bool ok = true;
+
+    for (;;)
+    {
+        long n = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (n <= 0)
+        {
+            ok = (n == 0);
+            break;
+        }
+
+        for (long pos = 0; pos < n; )
+        {
+            auto entry = reinterpret_cast<const linux_dirent64*>(buffer + pos);
+            pos += entry->d_reclen;
+
+            const char* name = entry->d_name;
+            if (name[0] == '.'
+                    && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+                continue;
+
+            ++stats.entries;
+
+            unsigned char type = entry->d_type;
+            media_type mtype;
+            struct stat st;
+            bool have_stat = false;
+
+            // Some file systems don't report entry types
+            if (type == DT_UNKNOWN)
+            {
+                if (::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    ++stats.errors;
+                    continue;
+                }
+
+                have_stat = true;
+                type = S_ISDIR(st.st_mode) ? DT_DIR
+                    : S_ISREG(st.st_mode) ? DT_REG
+                    : S_ISLNK(st.st_mode) ? DT_LNK
+                    : DT_UNKNOWN;
+            }
+
+            if (type == DT_DIR) subdirectories.push_back(join(directory, name));
+            else if (type == DT_LNK && classify_media(name, mtype))
+            {
+                // A link to a media file is listed under the link's own
+                // name; links to anything else are skipped
+                if (::fstatat(fd, name, &st, 0) != 0)
+                {
+                    ++stats.errors;
+                    continue;
+                }
+
+                if (S_ISREG(st.st_mode))
+                    files.push_back(media_file{
+                        join(directory, name)
+                        , static_cast<std::uint64_t>(st.st_size)
+                        , mtime_ms(st)
+                        , mtype});
+            }
+            else if (type == DT_REG && classify_media(name, mtype))
+            {
+                if (!have_stat
+                        && ::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    ++stats.errors;
+                    continue;
+                }
+
+                files.push_back(media_file{
+                    join(directory, name)
+                    , static_cast<std::uint64_t>(st.st_size)
+                    , mtime_ms(st)
+                    , mtype});
+            }
+        }
+    }
+
+    ::close(fd);
+    return ok;
+}   // end enumerate function
+
+#else
+
+/**
+ * \brief Retrieve the modification time of a directory
+ * 
+ * \return `false` if the directory couldn't be found
+ */
+bool directory_mtime(const std::string& directory, std::int64_t& mtime)
+{
+    boost::system::error_code ec;
+    auto t = boost::filesystem::last_write_time(directory, ec);
+    if (ec) return false;
+
+    mtime = std::int64_t(t) * 1000;
+    return true;
+}   // end directory_mtime function
+
+/**
+ * \brief Read the entries of one directory
+ * 
+ * \param root Whether this is the root of the scan; it is always followed
+ * if it is a symbolic link
+ * 
+ * \return `false` if the directory couldn't be read
+ */
+bool enumerate(
+        const std::string& directory
+        , bool
+        , std::vector<media_file>& files
+        , std::vector<std::string>& subdirectories
+        , scan_statistics& stats)
+{
+    namespace bfs = boost::filesystem;
+
+    boost::system::error_code ec;
+    bfs::directory_iterator it(directory, ec), end;
+    if (ec) return false;
+
+    for ( ; it != end; it.increment(ec))
+    {
+        if (ec) return false;
+
+        ++stats.entries;
+        auto status = it->symlink_status(ec);
+        if (ec)
+        {
+            ++stats.errors;
+            continue;
+        }
+
+        auto name = it->path().filename().string();
+        media_type mtype;
+
+        if (bfs::is_directory(status))
+            subdirectories.push_back(join(directory, name.c_str()));
+        else if (bfs::is_symlink(status) && classify_media(name, mtype))
+        {
+            // As on Linux, only links to media files are listed
+            auto target = it->status(ec);
+            if (!bfs::is_regular_file(target))
+            {
+                if (ec || !bfs::exists(target)) ++stats.errors;
+                continue;
+            }
+
+            auto size = bfs::file_size(it->path(), ec);
+            auto mtime = ec ? 0 : bfs::last_write_time(it->path(), ec);
+            if (ec)
+            {
+                ++stats.errors;
+                continue;
+            }
+
+            files.push_back(media_file{
+                join(directory, name.c_str())
+                , static_cast<std::uint64_t>(size)
+                , std::int64_t(mtime) * 1000
+                , mtype});
+        }
+        else if (bfs::is_regular_file(status) && classify_media(name, mtype))
+        {
+            auto size = bfs::file_size(it->path(), ec);
+            auto mtime = ec ? 0 : bfs::last_write_time(it->path(), ec);
+            if (ec)
+            {
+                ++stats.errors;
+                continue;
+            }
+
+            files.push_back(media_file{
+                join(directory, name.c_str())
+                , static_cast<std::uint64_t>(size)
+                , std::int64_t(mtime) * 1000
+                , mtype});
+        }
+    }
+
+    return true;
+}   // end enumerate function
+
+#endif
+
+/**
+ * \brief Per-worker queues of directories waiting to be enumerated, with
+ * work stealing
+ */
+class work_queues
+{
+    public:
+
+    /**
+     * \brief Constructor, making one queue per worker
+     */
+    explicit work_queues(unsigned workers) : m_queues(), m_outstanding(0)
+    {
+        for (unsigned i = 0; i < workers; ++i)
+            m_queues.push_back(std::make_unique<queue>());
+    }
+
+    /**
+     * \brief Add a directory to a worker's queue
+     */
+    void push(unsigned worker, std::string directory)
+    {
+        ++m_outstanding;
+        std::lock_guard<std::mutex> lock(m_queues[worker]->mutex);
+        m_queues[worker]->directories.push_back(std::move(directory));
+    }
+
+    /**
+     * \brief Take a directory for a worker, from the back of its own queue
+     * or else from the front of another worker's queue
+     * 
+     * \return `false` if there is no work queued anywhere
+     */
+    bool pop(unsigned worker, std::string& directory)
+    {
+        {
+            auto& own = *m_queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.directories.empty())
+            {
+                directory = std::move(own.directories.back());
+                own.directories.pop_back();
+                return true;
+            }
+        }
+
+        for (std::size_t i = 1; i < m_queues.size(); ++i)
+        {
+            auto& victim = *m_queues[(worker + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.directories.empty())
+            {
+                directory = std::move(victim.directories.front());
+                victim.directories.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * \brief Record that a directory that was popped has been finished
+     * 
+     * Its sub-directories must have been pushed before this is called.
+     */
+    void done(void) { --m_outstanding; }
+
+    /**
+     * \brief Whether all directories have been finished
+     */
+    bool finished(void) const { return m_outstanding.load() == 0; }
+
+    private:
+
+    /**
+     * \brief A single worker's queue
+     */
+    struct queue
+    {
+        std::mutex mutex;                       ///< Protects the queue
+        std::deque<std::string> directories;    ///< The queued directories
+    };  // end queue struct
+
+    std::vector<std::unique_ptr<queue>> m_queues;   ///< Queue per worker
+
+    /**
+     * \brief The number of directories pushed but not yet finished
+     */
+    std::atomic<std::size_t> m_outstanding;
+
+};  // end work_queues class
+
+}   // end anonymous namespace
+
+bool classify_media(const std::string& name, media_type& type)
+{
+    static const struct { const char* extension; media_type type; }
+        extensions[] = {
+            { "jpg", media_type::image }, { "jpeg", media_type::image }
+            , { "jpe", media_type::image }, { "png", media_type::image }
+            , { "gif", media_type::image }, { "bmp", media_type::image }
+            , { "tif", media_type::image }, { "tiff", media_type::image }
+            , { "webp", media_type::image }, { "heic", media_type::image }
+            , { "heif", media_type::image }, { "dng", media_type::image }
+            , { "cr2", media_type::image }, { "cr3", media_type::image }
+            , { "nef", media_type::image }, { "arw", media_type::image }
+            , { "orf", media_type::image }, { "rw2", media_type::image }
+            , { "raf", media_type::image }, { "mp4", media_type::video }
+            , { "m4v", media_type::video }, { "mov", media_type::video }
+            , { "avi", media_type::video }, { "mkv", media_type::video }
+            , { "wmv", media_type::video }, { "mpg", media_type::video }
+            , { "mpeg", media_type::video }, { "mts", media_type::video }
+            , { "m2ts", media_type::video }, { "3gp", media_type::video }
+            , { "webm", media_type::video }, { "mp3", media_type::audio }
+            , { "wav", media_type::audio }, { "flac", media_type::audio }
+            , { "aac", media_type::audio }, { "m4a", media_type::audio }
+            , { "ogg", media_type::audio }, { "opus", media_type::audio }
+            , { "wma", media_type::audio }, { "aif", media_type::audio }
+            , { "aiff", media_type::audio }
+        };
+
+    auto dot = name.find_last_of("./\\");
+    if (dot == std::string::npos || name[dot] != '.') return false;
+
+    std::size_t length = name.size() - dot - 1;
+    if (length == 0 || length > 4) return false;
+
+    char extension[5] = { 0 };
+    for (std::size_t i = 0; i < length; ++i)
+        extension[i] = static_cast<char>(
+            std::tolower(static_cast<unsigned char>(name[dot + 1 + i])));
+
+    for (const auto& e : extensions)
+        if (std::strcmp(e.extension, extension) == 0)
+        {
+            type = e.type;
+            return true;
+        }
+
+    return false;
+}   // end classify_media function
+
+scan_statistics scanner::scan(const std::string& root, const sink& s) const
+{
+    return scan(
+        root
+        , directory_filter()
+        , [&s](directory_listing&& listing)
+        {
+            if (!listing.files.empty() && s) s(std::move(listing.files));
+        });
+}   // end scan method
+
+scan_statistics scanner::scan(
+        const std::string& root
+        , const directory_filter& filter
+        , const directory_sink& s) const
+{
+    boost::system::error_code ec;
+    if (!boost::filesystem::is_directory(root, ec))
+        throw error("cannot scan \"" + root + "\": not a directory");
+
+    std::string top = root;
+    while (top.size() > 1 && (top.back() == '/' || top.back() == '\\'))
+        top.pop_back();
+
+    unsigned workers = thread_count(m_options.threads);
+
+    work_queues queues(workers);
+    queues.push(0, top);
+
+    std::mutex sink_mutex;
+    std::vector<scan_statistics> stats(workers, scan_statistics{0, 0, 0, 0, 0});
+    std::atomic<bool> abort(false);
+    std::exception_ptr failure;
+
+    auto work = [&](unsigned worker)
+    {
+        std::string directory;
+        auto& st = stats[worker];
+        unsigned idle = 0;
+
+        while (!abort.load())
+        {
+            if (!queues.pop(worker, directory))
+            {
+                if (queues.finished()) break;
+
+                // Another worker is still enumerating, and may produce more
+                // work; back off gradually
+                if (++idle < 64) std::this_thread::yield();
+                else std::this_thread::sleep_for(
+                    std::chrono::microseconds(100));
+                continue;
+            }
+
+            idle = 0;
+
+            directory_listing listing{directory, 0, {}, {}};
+            bool read = false;
+
+            try
+            {
+                // The time is taken before reading, so that changes made
+                // while the directory is being read show up next time
+                if (!directory_mtime(directory, listing.mtime)) ++st.errors;
+                else if (filter
+                        && !filter(
+                            directory
+                            , listing.mtime
+                            , listing.subdirectories))
+                    ++st.skipped;
+                else if (enumerate(
+                        directory
+                        , directory == top
+                        , listing.files
+                        , listing.subdirectories
+                        , st))
+                {
+                    ++st.directories;
+                    st.files += listing.files.size();
+                    read = true;
+                }
+                else
+                {
+                    listing.subdirectories.clear();
+                    ++st.errors;
+                }
+
+                if (m_options.recursive)
+                    for (const auto& sub : listing.subdirectories)
+                        queues.push(worker, sub);
+
+                if (read && s)
+                {
+                    std::lock_guard<std::mutex> lock(sink_mutex);
+                    s(std::move(listing));
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(sink_mutex);
+                if (!failure) failure = std::current_exception();
+                abort = true;
+            }
+
+            queues.done();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < workers; ++i) threads.emplace_back(work, i);
+    work(0);
+    for (auto& t : threads) t.join();
+
+    if (failure) std::rethrow_exception(failure);
+
+    scan_statistics total{0, 0, 0, 0, 0};
+    for (const auto& st : stats)
+    {
+        total.directories += st.directories;
+        total.entries += st.entries;
+        total.files += st.files;
+        total.errors += st.errors;
+        total.skipped += st.skipped;
+    }
+
+    return total;
+}   // end scan method
+
+}   // end api namespace
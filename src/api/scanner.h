@@ -0,0 +1,216 @@
+/**
+ * \file scanner.h
+ * Declare the media scanner
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef _api_scanner_h_included
+#define _api_scanner_h_included
+
+namespace api {
+
+/**
+ * \brief The types of media file that are recognised
+ */
+enum class media_type : std::uint8_t
+{
+    image = 0
+    , video
+    , audio
+};  // end media_type enum
+
+/**
+ * \brief Work out the media type of a file from its name
+ * 
+ * \param name The name (or path) of the file; its extension is compared
+ * case-insensitively with a list of known media extensions
+ * 
+ * \param type Set to the media type if the file is a media file
+ * 
+ * \return `true` if the file is a media file
+ */
+extern bool classify_media(const std::string& name, media_type& type);
+
+/**
+ * \brief A media file found by a scan
+ */
+struct media_file
+{
+    std::string path;       ///< The full path of the file
+    std::uint64_t size;     ///< The size of the file in bytes
+    std::int64_t mtime;     ///< Modification time, in ms since the epoch
+    media_type type;        ///< The type of media in the file
+};  // end media_file struct
+
+/**
+ * \brief Counters reported by a scan
+ */
+struct scan_statistics
+{
+    std::uint64_t directories;  ///< Number of directories enumerated
+    std::uint64_t entries;      ///< Number of directory entries seen
+    std::uint64_t files;        ///< Number of media files found
+    std::uint64_t errors;       ///< Number of entries that couldn't be read
+    std::uint64_t skipped;      ///< Number of directories not re-read
+};  // end scan_statistics struct
+
+/**
+ * \brief The contents of one directory, found by a scan
+ */
+struct directory_listing
+{
+    std::string path;       ///< The full path of the directory
+    std::int64_t mtime;     ///< Modification time, in ms since the epoch
+
+    /**
+     * \brief The media files in the directory
+     */
+    std::vector<media_file> files;
+
+    /**
+     * \brief The full paths of the sub-directories of the directory
+     */
+    std::vector<std::string> subdirectories;
+};  // end directory_listing struct
+
+/**
+ * \brief A parallel scanner for media files in a directory tree
+ * 
+ * The scanner walks a directory tree with a pool of worker threads. Each
+ * worker keeps its own queue of directories to enumerate, taking work from
+ * the back of its own queue (so that it works depth-first, close to the
+ * directories it has just read), and *stealing* work from the front of
+ * other workers' queues when its own is empty, so that all workers stay
+ * busy however unbalanced the tree is.
+ * 
+ * On Linux, directories are read in large batches with `getdents64`, and
+ * the entry types reported by the file system are used to tell files from
+ * directories, so only media files (recognised by their extensions) are
+ * `stat`-ed, and then relative to their open directory with `fstatat`.
+ * Elsewhere, the scanner falls back to `boost::filesystem`.
+ * 
+ * The root may be a symbolic link to a directory. Below it, symbolic links
+ * to media files are listed under the links' own paths, with the sizes and
+ * times of the files they point to; links to directories are skipped, so
+ * the scan can't loop, and dangling links are counted as errors.
+ * 
+ * Media files are streamed to a client-supplied *sink* function as the
+ * scan runs, in batches of one directory's files. The sink is called from
+ * the worker threads, but never concurrently.
+ */
+class scanner
+{
+    public:
+
+    /**
+     * \brief The type of function that receives found media files
+     */
+    using sink = std::function<void(std::vector<media_file>&&)>;
+
+    /**
+     * \brief The type of function that receives whole directory listings
+     */
+    using directory_sink = std::function<void(directory_listing&&)>;
+
+    /**
+     * \brief The type of function that decides whether a directory needs
+     * to be read
+     * 
+     * The function is given the path and current modification time of a
+     * directory. It returns `true` if the directory should be read, or
+     * `false` to skip it, in which case it should fill in the
+     * sub-directories to scan in its place (e.g. those found by an earlier
+     * scan).
+     */
+    using directory_filter = std::function<bool(
+        const std::string&
+        , std::int64_t
+        , std::vector<std::string>&)>;
+
+    /**
+     * \brief Scanner configuration
+     */
+    struct options
+    {
+        /**
+         * \brief The number of worker threads; 0 means one per core
+         */
+        unsigned threads = 0;
+
+        /**
+         * \brief Whether to scan sub-directories
+         */
+        bool recursive = true;
+    };  // end options struct
+
+    /**
+     * \brief Constructor, using the default configuration
+     */
+    scanner(void) : m_options() {}
+
+    /**
+     * \brief Constructor, setting the configuration
+     */
+    explicit scanner(const options& opts) : m_options(opts) {}
+
+    /**
+     * \brief Scan a directory tree, blocking until the scan is complete
+     * 
+     * \param root The path of the directory at the top of the tree
+     * 
+     * \param s The function that receives the media files that are found
+     * 
+     * \return The counters for the scan
+     * 
+     * \throw api::error The root is not a readable directory
+     */
+    scan_statistics scan(const std::string& root, const sink& s) const;
+
+    /**
+     * \brief Scan a directory tree, reporting whole directories and
+     * skipping those that haven't changed
+     * 
+     * This is the basis of incremental scanning: adding or removing an
+     * entry in a directory updates the directory's modification time, so a
+     * client that remembers the modification times from an earlier scan
+     * can use the filter to skip unchanged directories without reading
+     * them.
+     * 
+     * \param root The path of the directory at the top of the tree
+     * 
+     * \param filter Decides which directories are read; this may be called
+     * concurrently from the worker threads; if it is empty, all directories
+     * are read
+     * 
+     * \param s The function that receives a listing of each directory that
+     * is read (including directories with no media files); like the
+     * simple sink, it is never called concurrently
+     * 
+     * \return The counters for the scan
+     * 
+     * \throw api::error The root is not a readable directory
+     */
+    scan_statistics scan(
+        const std::string& root
+        , const directory_filter& filter
+        , const directory_sink& s) const;
+
+    private:
+
+    options m_options;  ///< The scanner configuration
+
+};  // end scanner class
+
+}   // end api namespace
+
+#endif
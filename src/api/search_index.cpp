@@ -0,0 +1,422 @@
+/**
+ * \file search_index.cpp
+ * Implement the `search_index` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <limits>
+
+#include "calendar.h"
+#include "error.h"
+#include "search_index.h"
+
+namespace api {
+
+namespace {
+
+/**
+ * \brief Convert a string to lower case (ASCII only)
+ */
+std::string lower(std::string s)
+{
+    for (auto& c : s)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+/**
+ * \brief Parse a date (`YYYY`, `YYYY-MM` or `YYYY-MM-DD`) into the first
+ * and last second of the period that it names
+ * 
+ * \throw api::error The date is malformed
+ */
+void parse_date(
+        const std::string& text
+        , std::int64_t& first
+        , std::int64_t& last)
+{
+    // `used` is the length of the text matched by the fields that were
+    // read, which must be all of it
+    int year = 0, month = 0, day = 0, used = 0;
+    int fields = std::sscanf(
+        text.c_str()
+        , "%4d%n-%2d%n-%2d%n"
+        , &year
+        , &used
+        , &month
+        , &used
+        , &day
+        , &used);
+
+    if (fields < 1 || text.size() < 4
+            || static_cast<std::size_t>(used) != text.size()
+            || !std::isdigit(static_cast<unsigned char>(text[0]))
+            || text.find_first_not_of("0123456789-") != std::string::npos
+            || (fields >= 2 && (month < 1 || month > 12))
+            || (fields == 3 && (day < 1 || day > 31)))
+        throw error("bad date \"" + text + "\" in query");
+
+    if (fields == 1)
+    {
+        first = days_from_civil(year, 1, 1);
+        last = days_from_civil(year + 1, 1, 1);
+    }
+    else if (fields == 2)
+    {
+        first = days_from_civil(year, month, 1);
+        last = month == 12
+            ? days_from_civil(year + 1, 1, 1)
+            : days_from_civil(year, month + 1, 1);
+    }
+    else
+    {
+        first = days_from_civil(year, month, day);
+        last = first + 1;
+    }
+
+    first *= 86400;
+    last = last * 86400 - 1;
+}   // end parse_date function
+
+/**
+ * \brief A token of a query
+ */
+struct token
+{
+    /**
+     * \brief The kinds of token
+     */
+    enum kind_type { end, open, close, and_op, or_op, not_op, term };
+
+    kind_type kind;     ///< The kind of token
+    std::string field;  ///< The field of a term; empty for a bare value
+    std::string value;  ///< The value of a term
+};  // end token struct
+
+/**
+ * \brief Split a query into tokens
+ * 
+ * \throw api::error A quoted value is not closed
+ */
+std::vector<token> tokenise(const std::string& text)
+{
+    std::vector<token> tokens;
+    std::size_t i = 0;
+    while (i < text.size())
+    {
+        char c = text[i];
+        if (std::isspace(static_cast<unsigned char>(c))) { ++i; continue; }
+
+        if (c == '(' || c == ')' || c == '-')
+        {
+            auto kind = c == '(' ? token::open
+                : c == ')' ? token::close
+                : token::not_op;
+            tokens.push_back(token{kind, "", ""});
+            ++i;
+            continue;
+        }
+
+        // A word runs to the next space or parenthesis, except within
+        // quotes; the first unquoted colon separates the field
+        token t{token::term, "", ""};
+        bool has_field = false, quoted = false;
+        for (; i < text.size(); ++i)
+        {
+            c = text[i];
+            if (c == '"') quoted = !quoted;
+            else if (!quoted
+                    && (std::isspace(static_cast<unsigned char>(c))
+                        || c == '(' || c == ')'))
+                break;
+            else if (!quoted && c == ':' && !has_field)
+            {
+                t.field = lower(t.value);
+                t.value.clear();
+                has_field = true;
+            }
+            else t.value += c;
+        }
+
+        if (quoted) throw error("unterminated quote in query");
+
+        if (!has_field && t.value == "AND") t.kind = token::and_op;
+        else if (!has_field && t.value == "OR") t.kind = token::or_op;
+        else if (!has_field && t.value == "NOT") t.kind = token::not_op;
+
+        tokens.push_back(std::move(t));
+    }
+
+    tokens.push_back(token{token::end, "", ""});
+    return tokens;
+}   // end tokenise function
+
+/**
+ * \brief A recursive-descent parser and evaluator for queries
+ */
+class query_parser
+{
+    public:
+
+    query_parser(const search_index& index, const std::string& text) :
+        m_index(index)
+        , m_tokens(tokenise(text))
+        , m_pos(0)
+    {}
+
+    /**
+     * \brief Parse and evaluate the whole query
+     */
+    posting_list evaluate(void)
+    {
+        if (peek() == token::end) return m_index.all();
+
+        auto result = disjunction();
+        if (peek() != token::end) throw error("unexpected \")\" in query");
+        return result;
+    }
+
+    private:
+
+    token::kind_type peek(void) const { return m_tokens[m_pos].kind; }
+
+    posting_list disjunction(void)
+    {
+        auto result = conjunction();
+        while (peek() == token::or_op)
+        {
+            ++m_pos;
+            result |= conjunction();
+        }
+        return result;
+    }
+
+    posting_list conjunction(void)
+    {
+        auto result = unary();
+        for (;;)
+        {
+            auto k = peek();
+            if (k == token::end || k == token::close || k == token::or_op)
+                break;
+
+            if (k == token::and_op) k = m_tokens[++m_pos].kind;
+
+            // "a NOT b" is a difference, rather than an intersection with
+            // a complement
+            if (k == token::not_op)
+            {
+                ++m_pos;
+                result -= unary();
+            }
+            else result &= unary();
+        }
+        return result;
+    }
+
+    posting_list unary(void)
+    {
+        const token& t = m_tokens[m_pos];
+        switch (t.kind)
+        {
+            case token::not_op:
+                ++m_pos;
+                return m_index.all() - unary();
+
+            case token::open:
+            {
+                ++m_pos;
+                auto result = disjunction();
+                if (peek() != token::close)
+                    throw error("missing \")\" in query");
+                ++m_pos;
+                return result;
+            }
+
+            case token::term:
+                ++m_pos;
+                return term(t);
+
+            default:
+                throw error("missing term in query");
+        }
+    }
+
+    posting_list term(const token& t)
+    {
+        if (t.field.empty()) return m_index.term("keyword", t.value);
+        if (t.field != "date") return m_index.term(t.field, t.value);
+
+        // A range runs from the start of its first date to the end of its
+        // last
+        std::int64_t from = std::numeric_limits<std::int64_t>::min();
+        std::int64_t to = std::numeric_limits<std::int64_t>::max();
+        std::int64_t unused = 0;
+
+        auto dots = t.value.find("..");
+        if (dots == std::string::npos)
+            parse_date(t.value, from, to);
+        else
+        {
+            if (dots > 0) parse_date(t.value.substr(0, dots), from, unused);
+            if (dots + 2 < t.value.size())
+                parse_date(t.value.substr(dots + 2), unused, to);
+        }
+
+        return m_index.captured(from, to);
+    }
+
+    const search_index& m_index;    ///< The index being searched
+    std::vector<token> m_tokens;    ///< The tokens of the query
+    std::size_t m_pos;              ///< The current token
+
+};  // end query_parser class
+
+}   // end anonymous namespace
+
+search_index::search_index(const media_index& index) :
+    m_terms()
+    , m_captured()
+    , m_paths()
+{
+    // Documents are numbered in path order, so the files of a directory
+    // are close together in the posting lists, and results come out in
+    // path order
+    std::vector<media_record> records;
+    records.reserve(index.size());
+    index.for_each([&records](const media_record& r)
+    {
+        records.push_back(r);
+    });
+    std::sort(
+        records.begin()
+        , records.end()
+        , [](const media_record& a, const media_record& b)
+        {
+            return a.path < b.path;
+        });
+
+    static const char* type_names[] = { "image", "video", "audio" };
+
+    m_paths.reserve(records.size());
+    for (auto& r : records)
+    {
+        auto document = static_cast<std::uint32_t>(m_paths.size());
+        m_paths.push_back(std::move(r.path));
+
+        add_term("type", type_names[static_cast<int>(r.type)], document);
+
+        const media_metadata* m = r.metadata.get();
+        if (!m) continue;
+
+        if (!m->make.empty())
+        {
+            add_term("make", m->make, document);
+            add_term("camera", m->make, document);
+        }
+
+        if (!m->model.empty())
+        {
+            add_term("model", m->model, document);
+            if (lower(m->model) != lower(m->make))
+                add_term("camera", m->model, document);
+        }
+
+        if (!m->lens.empty()) add_term("lens", m->lens, document);
+
+        for (const auto& k : m->keywords) add_term("keyword", k, document);
+
+        if (m->capture_time != 0)
+            m_captured.emplace_back(m->capture_time, document);
+    }
+
+    std::sort(m_captured.begin(), m_captured.end());
+}   // end constructor
+
+posting_list search_index::all(void) const
+{
+    return posting_list::all(static_cast<std::uint32_t>(m_paths.size()));
+}   // end all method
+
+posting_list search_index::term(
+        const std::string& field
+        , const std::string& value) const
+{
+    std::string name = lower(field);
+    if (name == "tag") name = "keyword";
+    if (name != "keyword" && name != "make" && name != "model"
+            && name != "camera" && name != "lens" && name != "type")
+        throw error("unknown search field \"" + field + "\"");
+
+    auto it = m_terms.find(name + ":" + lower(value));
+    return it == m_terms.end() ? posting_list() : it->second;
+}   // end term method
+
+posting_list search_index::captured(std::int64_t from, std::int64_t to) const
+{
+    auto first = std::lower_bound(
+        m_captured.begin()
+        , m_captured.end()
+        , std::make_pair(from, std::uint32_t(0)));
+    auto last = std::upper_bound(
+        first
+        , m_captured.end()
+        , std::make_pair(to, std::numeric_limits<std::uint32_t>::max()));
+
+    std::vector<std::uint32_t> documents;
+    documents.reserve(std::distance(first, last));
+    for (auto it = first; it != last; ++it) documents.push_back(it->second);
+    std::sort(documents.begin(), documents.end());
+
+    posting_list result;
+    for (auto d : documents) result.add(d);
+    return result;
+}   // end captured method
+
+posting_list search_index::query(const std::string& text) const
+{
+    return query_parser(*this, text).evaluate();
+}   // end query method
+
+std::vector<std::string> search_index::paths(
+        const posting_list& documents) const
+{
+    std::vector<std::string> result;
+    result.reserve(documents.size());
+    documents.for_each([this, &result](std::uint32_t d)
+    {
+        if (d < m_paths.size()) result.push_back(m_paths[d]);
+    });
+    return result;
+}   // end paths method
+
+std::size_t search_index::memory_usage(void) const
+{
+    std::size_t result = sizeof(*this)
+        + m_captured.capacity() * sizeof(m_captured[0])
+        + m_paths.capacity() * sizeof(std::string);
+
+    for (const auto& p : m_paths) result += p.capacity();
+    for (const auto& t : m_terms)
+        result += t.first.capacity() + t.second.memory_usage();
+
+    return result;
+}   // end memory_usage method
+
+void search_index::add_term(
+        const char* field
+        , const std::string& value
+        , std::uint32_t document)
+{
+    m_terms[std::string(field) + ":" + lower(value)].add(document);
+}   // end add_term method
+
+}   // end api namespace
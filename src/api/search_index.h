@@ -0,0 +1,156 @@
+/**
+ * \file search_index.h
+ * Declare the `search_index` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "media_index.h"
+#include "posting_list.h"
+
+#ifndef _api_search_index_h_included
+#define _api_search_index_h_included
+
+namespace api {
+
+/**
+ * \brief An in-memory inverted index over the metadata in a `media_index`
+ * 
+ * Each file in the index is given a document number, and each searchable
+ * value is mapped to the `posting_list` of the documents that have it, so
+ * a search combines a few compressed lists rather than visiting every
+ * record. The searchable fields are:
+ * 
+ * * `keyword` (or `tag`) -- a keyword from the file's XMP data
+ * 
+ * * `make`, `model` and `lens` -- the camera and lens; `camera` matches
+ *   either the make or the model
+ * 
+ * * `type` -- `image`, `video` or `audio`
+ * 
+ * Values are matched whole, ignoring case. Capture times are held in a
+ * sorted array, so a date range is found with two binary searches.
+ * 
+ * Queries (see `query`) are text, such as:
+ * 
+ *     beach AND (make:canon OR make:nikon) NOT lens:"EF 50mm"
+ *     date:2018-06..2019
+ * 
+ * The index is a snapshot: it does not follow changes to the
+ * `media_index` it was built from, and should be rebuilt when the
+ * `media_index::generation` changes. Once built, it may be searched from
+ * several threads at once.
+ */
+class search_index
+{
+    public:
+
+    /**
+     * \brief Constructor, building the index from a media index
+     */
+    explicit search_index(const media_index& index);
+
+    /**
+     * \brief Retrieve the number of documents (files) in the index
+     */
+    std::size_t size(void) const { return m_paths.size(); }
+
+    /**
+     * \brief Retrieve the path of the file for a document number
+     */
+    const std::string& path(std::uint32_t document) const
+        { return m_paths[document]; }
+
+    /**
+     * \brief Retrieve the list of all the documents
+     */
+    posting_list all(void) const;
+
+    /**
+     * \brief Retrieve the documents with a value for a field
+     * 
+     * \param field The field name (see the class description)
+     * 
+     * \param value The value, which is matched ignoring case
+     * 
+     * \throw api::error The field is not known
+     */
+    posting_list term(
+        const std::string& field
+        , const std::string& value) const;
+
+    /**
+     * \brief Retrieve the documents captured within a range of times
+     * 
+     * \param from The earliest capture time, in seconds since the epoch
+     * 
+     * \param to The latest capture time (inclusive)
+     */
+    posting_list captured(std::int64_t from, std::int64_t to) const;
+
+    /**
+     * \brief Run a text query
+     * 
+     * A query is a sequence of terms, combined with `AND`, `OR` and `NOT`
+     * (or `-`), grouped with parentheses. Terms next to each other are
+     * combined with `AND`, which binds more tightly than `OR`. A term is
+     * either `field:value`, or a bare value, which is taken to be a
+     * keyword. Values containing spaces are given in double quotes.
+     * 
+     * The `date` field takes a date (`YYYY`, `YYYY-MM` or `YYYY-MM-DD`),
+     * which matches the whole of that period, or a range of two dates
+     * separated by `..`, either of which may be left out.
+     * 
+     * \throw api::error The query is malformed
+     */
+    posting_list query(const std::string& text) const;
+
+    /**
+     * \brief Retrieve the paths of the files in a list of documents, in
+     * document order
+     */
+    std::vector<std::string> paths(const posting_list& documents) const;
+
+    /**
+     * \brief Retrieve the approximate number of bytes used by the index
+     */
+    std::size_t memory_usage(void) const;
+
+    private:
+
+    /**
+     * \brief Add a document to the list for a field and value
+     */
+    void add_term(
+        const char* field
+        , const std::string& value
+        , std::uint32_t document);
+
+    /**
+     * \brief The posting lists, keyed on field name and lower-case value,
+     * separated by a colon
+     */
+    std::unordered_map<std::string, posting_list> m_terms;
+
+    /**
+     * \brief The capture time of each document that has one, sorted
+     */
+    std::vector<std::pair<std::int64_t, std::uint32_t>> m_captured;
+
+    std::vector<std::string> m_paths;   ///< Paths by document number
+
+};  // end search_index class
+
+}   // end api namespace
+
+#endif
@@ -0,0 +1,150 @@
+/**
+ * \file similarity.cpp
+ * Implement functionality for finding visually similar images
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <bitset>
+
+#include "similarity.h"
+
+namespace api {
+
+namespace similarity {
+
+std::uint64_t dhash(
+        const unsigned char* pixels
+        , unsigned width
+        , unsigned height
+        , std::size_t stride)
+{
+    const unsigned columns = 9, rows = 8;
+
+    if (width == 0 || height == 0) return 1;
+
+    // Average each cell; cells are at least one pixel, so that tiny images
+    // still work
+    double cells[rows][columns];
+    for (unsigned cy = 0; cy < rows; ++cy)
+    {
+        unsigned y0 = cy * height / rows
+            , y1 = std::max(y0 + 1, (cy + 1) * height / rows);
+        y0 = std::min(y0, height - 1);
+        y1 = std::min(y1, height);
+
+        for (unsigned cx = 0; cx < columns; ++cx)
+        {
+            unsigned x0 = cx * width / columns
+                , x1 = std::max(x0 + 1, (cx + 1) * width / columns);
+            x0 = std::min(x0, width - 1);
+            x1 = std::min(x1, width);
+
+            std::uint64_t sum = 0;
+            for (unsigned y = y0; y < y1; ++y)
+            {
+                const unsigned char* row = pixels + y * stride;
+                for (unsigned x = x0; x < x1; ++x) sum += row[x];
+            }
+
+            cells[cy][cx] = double(sum) / ((y1 - y0) * (x1 - x0));
+        }
+    }
+
+    std::uint64_t h = 0;
+    for (unsigned cy = 0; cy < rows; ++cy)
+        for (unsigned cx = 0; cx + 1 < columns; ++cx)
+            h = (h << 1) | (cells[cy][cx] > cells[cy][cx + 1] ? 1 : 0);
+
+    return h ? h : 1;
+}   // end dhash function
+
+unsigned distance(std::uint64_t a, std::uint64_t b)
+{
+    return static_cast<unsigned>(std::bitset<64>(a ^ b).count());
+}
+
+void index::add(std::string path, std::uint64_t hash)
+{
+    auto n = static_cast<std::uint32_t>(m_nodes.size());
+    m_nodes.push_back(node{hash, 0, 0, 0});
+    m_paths.push_back(std::move(path));
+    if (n == 0) return;
+
+    // Walk down from the root to the child at the right distance, until
+    // there isn't one
+    std::uint32_t current = 0;
+    for (;;)
+    {
+        unsigned d = distance(m_nodes[current].hash, hash);
+
+        std::uint32_t child = m_nodes[current].first_child;
+        while (child != 0 && m_nodes[child].distance != d)
+            child = m_nodes[child].next_sibling;
+
+        if (child == 0)
+        {
+            m_nodes[n].distance = d;
+            m_nodes[n].next_sibling = m_nodes[current].first_child;
+            m_nodes[current].first_child = n;
+            return;
+        }
+
+        current = child;
+    }
+}   // end add method
+
+std::vector<match> index::find(
+        std::uint64_t hash
+        , unsigned max_distance
+        , std::size_t* visited) const
+{
+    std::vector<match> result;
+    std::size_t count = 0;
+
+    if (!m_nodes.empty())
+    {
+        std::vector<std::uint32_t> stack(1, 0);
+        while (!stack.empty())
+        {
+            auto n = stack.back();
+            stack.pop_back();
+            ++count;
+
+            const node& current = m_nodes[n];
+            unsigned d = distance(current.hash, hash);
+            if (d <= max_distance)
+                result.push_back(match{m_paths[n], current.hash, d});
+
+            unsigned low = d > max_distance ? d - max_distance : 0
+                , high = d + max_distance;
+            for (auto child = current.first_child;
+                    child != 0;
+                    child = m_nodes[child].next_sibling)
+                if (m_nodes[child].distance >= low
+                        && m_nodes[child].distance <= high)
+                    stack.push_back(child);
+        }
+    }
+
+    std::sort(
+        result.begin()
+        , result.end()
+        , [](const match& a, const match& b)
+        {
+            return a.distance < b.distance
+                || (a.distance == b.distance && a.path < b.path);
+        });
+
+    if (visited) *visited = count;
+    return result;
+}   // end find method
+
+}   // end similarity namespace
+
+}   // end api namespace
@@ -0,0 +1,144 @@
+/**
+ * \file similarity.h
+ * Declare functionality for finding visually similar images
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef _api_similarity_h_included
+#define _api_similarity_h_included
+
+namespace api {
+
+/**
+ * \brief Perceptual hashing of images, and searching for images with
+ * similar hashes
+ * 
+ * A perceptual hash summarises what an image looks like, rather than its
+ * exact contents, so that an image that has been resized or re-encoded has
+ * the same hash as the original, or one that differs in only a few bits.
+ * The number of differing bits (the *Hamming distance*) between two hashes
+ * measures how different the images look.
+ */
+namespace similarity {
+
+/**
+ * \brief Calculate the difference hash (dHash) of a grayscale image
+ * 
+ * The image is reduced to 9x8 cells by averaging, and each bit of the hash
+ * records whether a cell is brighter than its right-hand neighbour. The
+ * image only needs to be a reduced-resolution decode (e.g. a thumbnail).
+ * 
+ * \param pixels The 8-bit grayscale pixels, row by row
+ * 
+ * \param width The width of the image in pixels
+ * 
+ * \param height The height of the image in pixels
+ * 
+ * \param stride The number of bytes from the start of one row to the next
+ * 
+ * \return The hash; this is never zero, so that zero can mean "unknown"
+ */
+extern std::uint64_t dhash(
+    const unsigned char* pixels
+    , unsigned width
+    , unsigned height
+    , std::size_t stride);
+
+/**
+ * \brief Calculate the Hamming distance between two hashes
+ */
+extern unsigned distance(std::uint64_t a, std::uint64_t b);
+
+/**
+ * \brief An image found by a similarity search
+ */
+struct match
+{
+    std::string path;       ///< The path of the image
+    std::uint64_t hash;     ///< The perceptual hash of the image
+    unsigned distance;      ///< The distance from the searched-for hash
+};  // end match struct
+
+/**
+ * \brief A searchable collection of perceptual hashes
+ * 
+ * The hashes are held in a BK-tree. Each node's children are keyed on
+ * their distance from the node, so by the triangle inequality, a search
+ * for hashes within distance `r` of a hash at distance `d` from a node
+ * need only visit the children keyed from `d - r` to `d + r`. For the
+ * small distances that mean "similar", this visits a small fraction of
+ * the tree.
+ * 
+ * The tree is held in a single array of nodes, linked by index, so it is
+ * compact and cheap to build for millions of images. It is not
+ * thread-safe while it is being built.
+ */
+class index
+{
+    public:
+
+    /**
+     * \brief Constructor, creating an empty collection
+     */
+    index(void) : m_nodes(), m_paths() {}
+
+    /**
+     * \brief Add an image to the collection
+     */
+    void add(std::string path, std::uint64_t hash);
+
+    /**
+     * \brief Retrieve the number of images in the collection
+     */
+    std::size_t size(void) const { return m_nodes.size(); }
+
+    /**
+     * \brief Find the images within a given distance of a hash
+     * 
+     * \param hash The hash to search for
+     * 
+     * \param max_distance The largest distance to report
+     * 
+     * \param visited If not null, set to the number of nodes visited, as
+     * a measure of the cost of the search
+     * 
+     * \return The matching images, closest first
+     */
+    std::vector<match> find(
+        std::uint64_t hash
+        , unsigned max_distance
+        , std::size_t* visited = nullptr) const;
+
+    private:
+
+    /**
+     * \brief A node in the tree
+     */
+    struct node
+    {
+        std::uint64_t hash;         ///< The perceptual hash
+        std::uint32_t first_child;  ///< Index of the first child, or 0
+        std::uint32_t next_sibling; ///< Index of the next sibling, or 0
+        unsigned distance;          ///< The distance from the parent
+    };  // end node struct
+
+    std::vector<node> m_nodes;          ///< The nodes; the first is the root
+    std::vector<std::string> m_paths;   ///< Image paths, by node index
+
+};  // end index class
+
+}   // end similarity namespace
+
+}   // end api namespace
+
+#endif
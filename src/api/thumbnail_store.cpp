@@ -0,0 +1,733 @@
+/**
+ * \file thumbnail_store.cpp
+ * Implement the `thumbnail_store` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+
+#include "byte_order.h"
+#include "thumbnail_store.h"
+
+namespace api {
+
+namespace {
+
+namespace bip = boost::interprocess;
+using namespace byte_order;
+
+/**
+ * \brief The magic bytes at the start of every pack file; the last two
+ * characters are the format version
+ */
+const char pack_magic[8] = { 'M', 'I', 'T', 'P', 'A', 'K', '0', '1' };
+
+/**
+ * \brief The magic number at the start of every record
+ */
+const std::uint32_t record_magic = 0x3154494d;
+
+/**
+ * \brief The size of the fixed part of a record
+ */
+const std::size_t record_header_size = 36;
+
+/**
+ * \brief Packs are only compacted if they have at least this many bytes of
+ * superseded records
+ */
+const std::uint64_t min_compaction_bytes = 4 * 1024 * 1024;
+
+/**
+ * \brief Split a path into its directory and file name
+ */
+void split_path(
+        const std::string& path
+        , std::string& directory
+        , std::string& name)
+{
+    auto pos = path.find_last_of("/\\");
+    if (pos == std::string::npos)
+    {
+        directory.clear();
+        name = path;
+    }
+    else
+    {
+        directory = path.substr(0, pos);
+        name = path.substr(pos + 1);
+    }
+}   // end split_path function
+
+/**
+ * \brief Make the name of the pack file for a media directory, from a
+ * 64-bit FNV-1a hash of its path
+ */
+std::string pack_file_name(const std::string& media_directory)
+{
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : media_directory)
+    {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+
+    char name[32];
+    std::snprintf(
+        name
+        , sizeof(name)
+        , "%016llx.pack"
+        , static_cast<unsigned long long>(h));
+    return name;
+}   // end pack_file_name function
+
+/**
+ * \brief Holds the store's lock on the pack files, if it has one, for as
+ * long as it exists
+ */
+class scoped_file_lock
+{
+    public:
+
+    /**
+     * \brief Constructor, taking the lock (and waiting for it)
+     */
+    explicit scoped_file_lock(bip::file_lock* lock) : m_lock(lock)
+    {
+        try
+        {
+            if (m_lock) m_lock->lock();
+        }
+        catch (const bip::interprocess_exception&)
+        {
+            m_lock = nullptr;
+        }
+    }
+
+    /**
+     * \brief Destructor, releasing the lock
+     */
+    ~scoped_file_lock(void)
+    {
+        try
+        {
+            if (m_lock) m_lock->unlock();
+        }
+        catch (const bip::interprocess_exception&)
+        {
+        }
+    }
+
+    scoped_file_lock(const scoped_file_lock&) = delete;
+    scoped_file_lock& operator=(const scoped_file_lock&) = delete;
+
+    private:
+
+    bip::file_lock* m_lock;         ///< The lock; null if there is none
+
+};  // end scoped_file_lock class
+
+}   // end anonymous namespace
+
+/**
+ * \brief The thumbnails for a single media directory, held in one pack
+ * file
+ */
+class thumbnail_store::pack
+{
+    public:
+
+    /**
+     * \brief Constructor, opening and indexing the pack file (creating it
+     * if it doesn't exist)
+     * 
+     * \param lock The store's lock on the pack files; this may be null
+     */
+    pack(
+            std::string file_path
+            , std::string media_directory
+            , bip::file_lock* lock) :
+        last_used(0)
+        , m_file_path(std::move(file_path))
+        , m_media_directory(std::move(media_directory))
+        , m_lock(lock)
+        , m_region()
+        , m_entries()
+        , m_live_bytes(0)
+        , m_dead_bytes(0)
+        , m_size(0)
+    {
+        scoped_file_lock hold(m_lock);
+
+        bool intact = load();
+        if (!intact || (m_dead_bytes > m_live_bytes
+                && m_dead_bytes >= min_compaction_bytes))
+            rewrite();
+    }
+
+    /**
+     * \brief Look up the thumbnail for a file name
+     */
+    bool lookup(
+            const std::string& name
+            , std::uint64_t file_size
+            , std::int64_t mtime
+            , unsigned width
+            , unsigned height
+            , std::vector<unsigned char>& data) const
+    {
+        auto it = m_entries.find(name);
+        if (it == m_entries.end()) return false;
+
+        const entry& e = it->second;
+        if (e.file_size != file_size || e.mtime != mtime
+                || e.width != width || e.height != height)
+            return false;
+
+        auto p = mapped(e);
+        if (!p) return false;
+
+        data.assign(p, p + e.length);
+        return true;
+    }
+
+    /**
+     * \brief Append a thumbnail record to the pack
+     */
+    bool store(
+            const std::string& name
+            , std::uint64_t file_size
+            , std::int64_t mtime
+            , unsigned width
+            , unsigned height
+            , const unsigned char* data
+            , std::size_t length)
+    {
+        // This would be indistinguishable from a removal record
+        if (width == 0 && height == 0 && length == 0) return false;
+
+        auto record = make_record(
+            name
+            , file_size
+            , mtime
+            , width
+            , height
+            , data
+            , length);
+
+        scoped_file_lock hold(m_lock);
+        auto offset = m_size + record_header_size + name.size();
+        if (!append(record)) return false;
+
+        // The new record is read back through a new mapping of the file,
+        // rather than kept in memory
+        if (!map())
+        {
+            reset();
+            return false;
+        }
+
+        entry e;
+        e.file_size = file_size;
+        e.mtime = mtime;
+        e.width = width;
+        e.height = height;
+        e.offset = offset;
+        e.length = length;
+        add_entry(name, std::move(e));
+
+        return true;
+    }
+
+    /**
+     * \brief Remove the thumbnail for a file name, appending a removal
+     * record to the pack
+     */
+    void remove(const std::string& name)
+    {
+        if (m_entries.find(name) == m_entries.end()) return;
+
+        auto record = make_record(name, 0, 0, 0, 0, nullptr, 0);
+
+        scoped_file_lock hold(m_lock);
+        if (!append(record)) return;
+
+        remove_entry(name);
+        m_dead_bytes += record.size();
+    }
+
+    std::uint64_t last_used;    ///< Use stamp for LRU tracking
+
+    private:
+
+    /**
+     * \brief A record in the pack index
+     * 
+     * The thumbnail data is only ever in the mapped file, which is mapped
+     * again after each append.
+     */
+    struct entry
+    {
+        std::uint64_t file_size;    ///< Size of the media file
+        std::int64_t mtime;         ///< Modification time of the media file
+        unsigned width;             ///< Thumbnail box width
+        unsigned height;            ///< Thumbnail box height
+        std::uint64_t offset;       ///< Where the data is in the file
+        std::size_t length;         ///< Length of the thumbnail data
+    };  // end entry struct
+
+    /**
+     * \brief Find the data of an entry in the mapped file
+     * 
+     * \return The data, or a null pointer if it isn't mapped
+     */
+    const unsigned char* mapped(const entry& e) const
+    {
+        if (!m_region || e.offset + e.length > m_region->get_size())
+            return nullptr;
+        return static_cast<const unsigned char*>(m_region->get_address())
+            + e.offset;
+    }
+
+    /**
+     * \brief Serialise a record
+     */
+    static std::vector<unsigned char> make_record(
+            const std::string& name
+            , std::uint64_t file_size
+            , std::int64_t mtime
+            , unsigned width
+            , unsigned height
+            , const unsigned char* data
+            , std::size_t length)
+    {
+        std::vector<unsigned char> record;
+        record.reserve(record_header_size + name.size() + length);
+        put_u32(record, record_magic);
+        put_u32(record, static_cast<std::uint32_t>(name.size()));
+        put_u64(record, file_size);
+        put_u64(record, static_cast<std::uint64_t>(mtime));
+        put_u32(record, width);
+        put_u32(record, height);
+        put_u32(record, static_cast<std::uint32_t>(length));
+        record.insert(record.end(), name.begin(), name.end());
+        if (length > 0) record.insert(record.end(), data, data + length);
+        return record;
+    }
+
+    /**
+     * \brief Serialise the pack file header
+     */
+    std::vector<unsigned char> make_header(void) const
+    {
+        std::vector<unsigned char> header(pack_magic, pack_magic + 8);
+        put_u32(header, static_cast<std::uint32_t>(m_media_directory.size()));
+        header.insert(
+            header.end()
+            , m_media_directory.begin()
+            , m_media_directory.end());
+        return header;
+    }
+
+    /**
+     * \brief Add an entry to the index, superseding any previous entry
+     */
+    void add_entry(const std::string& name, entry e)
+    {
+        std::size_t size = record_header_size + name.size() + e.length;
+        auto it = m_entries.find(name);
+        if (it != m_entries.end())
+        {
+            std::size_t old_size =
+                record_header_size + name.size() + it->second.length;
+            m_live_bytes -= old_size;
+            m_dead_bytes += old_size;
+            it->second = std::move(e);
+        }
+        else m_entries.emplace(name, std::move(e));
+
+        m_live_bytes += size;
+    }
+
+    /**
+     * \brief Remove an entry from the index, if it is there
+     */
+    void remove_entry(const std::string& name)
+    {
+        auto it = m_entries.find(name);
+        if (it == m_entries.end()) return;
+
+        std::size_t size =
+            record_header_size + name.size() + it->second.length;
+        m_live_bytes -= size;
+        m_dead_bytes += size;
+        m_entries.erase(it);
+    }
+
+    /**
+     * \brief Map the pack file and index its records
+     * 
+     * \return `false` if the file doesn't exist or is damaged (e.g. a
+     * partial record at the end after a crash), or if it belongs to a
+     * different directory; in all these cases, the file needs to be
+     * rewritten
+     */
+    bool load(void)
+    {
+        boost::system::error_code ec;
+        auto file_size = boost::filesystem::file_size(m_file_path, ec);
+        if (ec || file_size == 0) return false;
+
+        m_size = 0;
+        if (!map()) return false;
+
+        auto base = static_cast<const unsigned char*>(
+            m_region->get_address());
+        std::size_t size = m_region->get_size();
+
+        auto header = make_header();
+        if (size < header.size()
+                || std::memcmp(base, header.data(), header.size()) != 0)
+            return false;
+
+        std::size_t pos = header.size();
+        while (pos < size)
+        {
+            if (size - pos < record_header_size) return false;
+
+            const unsigned char* p = base + pos;
+            std::size_t name_length = get_u32(p + 4)
+                , length = get_u32(p + 32);
+
+            if (get_u32(p) != record_magic
+                    || size - pos - record_header_size < name_length
+                    || size - pos - record_header_size - name_length < length)
+                return false;
+
+            std::string name(
+                reinterpret_cast<const char*>(p + record_header_size)
+                , name_length);
+
+            entry e;
+            e.file_size = get_u64(p + 8);
+            e.mtime = static_cast<std::int64_t>(get_u64(p + 16));
+            e.width = get_u32(p + 24);
+            e.height = get_u32(p + 28);
+            e.offset = pos + record_header_size + name_length;
+            e.length = length;
+
+            // A record with no thumbnail box and no data is a removal
+            if (e.width == 0 && e.height == 0 && e.length == 0)
+            {
+                remove_entry(name);
+                m_dead_bytes += record_header_size + name_length;
+            }
+            else add_entry(name, std::move(e));
+
+            pos += record_header_size + name_length + length;
+        }
+
+        m_size = size;
+        return true;
+    }
+
+    /**
+     * \brief Map the whole of the pack file, as it is now
+     * 
+     * \return `false` if the file can't be mapped
+     */
+    bool map(void)
+    {
+        m_region.reset();
+        try
+        {
+            bip::file_mapping mapping(m_file_path.c_str(), bip::read_only);
+            m_region = std::make_unique<bip::mapped_region>(
+                mapping
+                , bip::read_only);
+        }
+        catch (const bip::interprocess_exception&)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * \brief Forget the pack's contents, and unmap the file
+     */
+    void reset(void)
+    {
+        m_entries.clear();
+        m_region.reset();
+        m_live_bytes = m_dead_bytes = 0;
+        m_size = 0;
+    }
+
+    /**
+     * \brief Bring the index up to date with the pack file, if another
+     * process has changed it (with the store lock held)
+     * 
+     * \return `false` if the pack file can't be written
+     */
+    bool sync(void)
+    {
+        boost::system::error_code ec;
+        auto size = boost::filesystem::file_size(m_file_path, ec);
+        if (!ec && size == m_size) return true;
+
+        reset();
+        return load() || rewrite();
+    }
+
+    /**
+     * \brief Append a record to the pack file (with the store lock held)
+     * 
+     * The file is opened for each append, so that the record goes to the
+     * file now at the path, even if another process has compacted it.
+     */
+    bool append(const std::vector<unsigned char>& record)
+    {
+        if (!sync()) return false;
+
+        std::FILE* f = std::fopen(m_file_path.c_str(), "ab");
+        if (!f) return false;
+
+        bool ok = std::fwrite(record.data(), 1, record.size(), f)
+            == record.size();
+        if (std::fclose(f) != 0) ok = false;
+
+        if (!ok)
+        {
+            // Don't leave a partial record for the next one to follow
+            boost::system::error_code ec;
+            boost::filesystem::resize_file(m_file_path, m_size, ec);
+            return false;
+        }
+
+        m_size += record.size();
+        return true;
+    }
+
+    /**
+     * \brief Rewrite the pack file with only its live records (with the
+     * store lock held)
+     * 
+     * If the new file can't be written, the old one is left as it was.
+     * 
+     * \return `false` if the pack file can't be written
+     */
+    bool rewrite(void)
+    {
+        std::string temp_path = m_file_path + ".tmp";
+        std::FILE* temp = std::fopen(temp_path.c_str(), "wb");
+        if (!temp) return false;
+
+        auto header = make_header();
+        bool ok = std::fwrite(header.data(), 1, header.size(), temp)
+            == header.size();
+
+        for (const auto& item : m_entries)
+        {
+            if (!ok) break;
+
+            const entry& e = item.second;
+            auto data = mapped(e);
+            if (!data)
+            {
+                ok = false;
+                break;
+            }
+
+            auto record = make_record(
+                item.first
+                , e.file_size
+                , e.mtime
+                , e.width
+                , e.height
+                , data
+                , e.length);
+            ok = std::fwrite(record.data(), 1, record.size(), temp)
+                == record.size();
+        }
+
+        if (std::fclose(temp) != 0) ok = false;
+
+        boost::system::error_code ec;
+        if (!ok)
+        {
+            boost::filesystem::remove(temp_path, ec);
+            return false;
+        }
+
+        // The new file is read back in, so that the data is mapped from it
+        reset();
+        boost::filesystem::rename(temp_path, m_file_path, ec);
+        if (ec) boost::filesystem::remove(temp_path, ec);
+        return load();
+    }
+
+    std::string m_file_path;        ///< Path of the pack file
+    std::string m_media_directory;  ///< The directory the pack is for
+    bip::file_lock* m_lock;         ///< The store's lock; may be null
+
+    /**
+     * \brief The mapping of the pack file, as it was when it was loaded or
+     * last appended to
+     */
+    std::unique_ptr<bip::mapped_region> m_region;
+
+    /**
+     * \brief Index of the current record for each file name
+     */
+    std::unordered_map<std::string, entry> m_entries;
+
+    std::uint64_t m_live_bytes;     ///< Bytes in current records
+    std::uint64_t m_dead_bytes;     ///< Bytes in superseded records
+
+    /**
+     * \brief The size of the pack file as this pack last knew it; a
+     * different size means another process has changed the file
+     */
+    std::uint64_t m_size;
+
+};  // end pack class
+
+thumbnail_store::thumbnail_store(
+        std::string directory
+        , std::size_t max_open_packs) :
+    m_directory(std::move(directory))
+    , m_max_open_packs(max_open_packs > 0 ? max_open_packs : 1)
+    , m_lock()
+    , m_packs()
+    , m_use_counter(0)
+    , m_mutex()
+{
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(m_directory, ec);
+
+    // Without the lock, the store still works, but isn't safe to share
+    auto lock_path =
+        (boost::filesystem::path(m_directory) / "store.lock").string();
+    if (std::FILE* f = std::fopen(lock_path.c_str(), "ab")) std::fclose(f);
+    try
+    {
+        m_lock = std::make_unique<bip::file_lock>(lock_path.c_str());
+    }
+    catch (const bip::interprocess_exception&)
+    {
+    }
+}   // end constructor
+
+thumbnail_store::~thumbnail_store(void) {}
+
+bool thumbnail_store::lookup(
+        const std::string& path
+        , std::uint64_t file_size
+        , std::int64_t mtime
+        , unsigned width
+        , unsigned height
+        , std::vector<unsigned char>& data)
+{
+    std::string media_directory, name;
+    split_path(path, media_directory, name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return open_pack(media_directory).lookup(
+        name
+        , file_size
+        , mtime
+        , width
+        , height
+        , data);
+}   // end lookup method
+
+bool thumbnail_store::store(
+        const std::string& path
+        , std::uint64_t file_size
+        , std::int64_t mtime
+        , unsigned width
+        , unsigned height
+        , const unsigned char* data
+        , std::size_t length)
+{
+    std::string media_directory, name;
+    split_path(path, media_directory, name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return open_pack(media_directory).store(
+        name
+        , file_size
+        , mtime
+        , width
+        , height
+        , data
+        , length);
+}   // end store method
+
+void thumbnail_store::remove(const std::string& path)
+{
+    std::string media_directory, name;
+    split_path(path, media_directory, name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    open_pack(media_directory).remove(name);
+}   // end remove method
+
+void thumbnail_store::remove_directory(const std::string& media_directory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_packs.erase(media_directory);
+
+    scoped_file_lock hold(m_lock.get());
+    boost::system::error_code ec;
+    boost::filesystem::remove(
+        boost::filesystem::path(m_directory)
+            / pack_file_name(media_directory)
+        , ec);
+}   // end remove_directory method
+
+thumbnail_store::pack& thumbnail_store::open_pack(
+        const std::string& media_directory)
+{
+    auto it = m_packs.find(media_directory);
+    if (it == m_packs.end())
+    {
+        // Close the least recently used pack if we have too many open
+        if (m_packs.size() >= m_max_open_packs)
+        {
+            auto lru = m_packs.begin();
+            for (auto i = m_packs.begin(); i != m_packs.end(); ++i)
+                if (i->second->last_used < lru->second->last_used) lru = i;
+            m_packs.erase(lru);
+        }
+
+        auto file_path =
+            (boost::filesystem::path(m_directory)
+                / pack_file_name(media_directory)).string();
+
+        it = m_packs.emplace(
+            media_directory
+            , std::make_unique<pack>(
+                file_path
+                , media_directory
+                , m_lock.get())).first;
+    }
+
+    it->second->last_used = ++m_use_counter;
+    return *it->second;
+}   // end open_pack method
+
+}   // end api namespace
@@ -0,0 +1,194 @@
+/**
+ * \file thumbnail_store.h
+ * Declare the `thumbnail_store` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _api_thumbnail_store_h_included
+#define _api_thumbnail_store_h_included
+
+namespace boost { namespace interprocess { class file_lock; } }
+
+namespace api {
+
+/**
+ * \brief A persistent, disk-backed store of encoded thumbnail images
+ * 
+ * Thumbnails are kept in one *pack* file per media directory, held in the
+ * store's own directory and named after a hash of the media directory's
+ * path. A pack file is a header followed by a sequence of appended
+ * records, each holding the file name, the size and modification time of
+ * the media file when the thumbnail was made, the size of the box the
+ * thumbnail was made for, and the encoded thumbnail itself.
+ * 
+ * When a pack is first used, it is memory-mapped and its records are
+ * indexed, so that looking up a thumbnail is a hash lookup and a copy out
+ * of the mapped file. A thumbnail is only returned if the size and
+ * modification time of the media file, and the thumbnail box size, all
+ * match the record; a changed file simply misses, and its new thumbnail
+ * supersedes the old record. Removing a thumbnail appends a record with
+ * no data. Packs with more superseded data than live
+ * data are compacted when they are opened.
+ * 
+ * The store may be shared by several processes (e.g. the GUI and the
+ * command-line tool). Packs are only appended to and compacted under a
+ * lock on a `store.lock` file in the store's directory, and each append
+ * first checks the pack's size, re-reading the pack if another process
+ * has changed it; changes made by other processes are otherwise only
+ * seen when a pack is opened.
+ * 
+ * The store doesn't interpret the thumbnail data, so the encoding is up to
+ * the client.
+ * 
+ * All public methods are thread-safe. Input / output failures are not
+ * treated as errors, because a cache that can't be read or written is
+ * simply a cache that misses.
+ */
+class thumbnail_store
+{
+    public:
+
+    /**
+     * \brief Constructor, setting the directory for the pack files
+     * 
+     * \param directory The directory that holds the pack files; it is
+     * created if it doesn't exist
+     * 
+     * \param max_open_packs The maximum number of pack files to hold open
+     * at any time; packs are closed in least-recently-used order
+     */
+    explicit thumbnail_store(
+        std::string directory
+        , std::size_t max_open_packs = 16);
+
+    /**
+     * \brief Destructor, closing all pack files
+     */
+    ~thumbnail_store(void);
+
+    thumbnail_store(const thumbnail_store&) = delete;
+    thumbnail_store& operator=(const thumbnail_store&) = delete;
+
+    /**
+     * \brief Retrieve the directory holding the pack files
+     */
+    const std::string& directory(void) const { return m_directory; }
+
+    /**
+     * \brief Look up a stored thumbnail
+     * 
+     * \param path The full path of the media file
+     * 
+     * \param file_size The current size of the media file in bytes
+     * 
+     * \param mtime The current modification time of the media file, in
+     * milliseconds since the epoch
+     * 
+     * \param width The width of the thumbnail box
+     * 
+     * \param height The height of the thumbnail box
+     * 
+     * \param data Filled with the encoded thumbnail if it is found
+     * 
+     * \return `true` if an up-to-date thumbnail was found
+     */
+    bool lookup(
+        const std::string& path
+        , std::uint64_t file_size
+        , std::int64_t mtime
+        , unsigned width
+        , unsigned height
+        , std::vector<unsigned char>& data);
+
+    /**
+     * \brief Store a thumbnail, superseding any previous one for the file
+     * 
+     * \param path The full path of the media file
+     * 
+     * \param file_size The size of the media file in bytes
+     * 
+     * \param mtime The modification time of the media file, in milliseconds
+     * since the epoch
+     * 
+     * \param width The width of the thumbnail box
+     * 
+     * \param height The height of the thumbnail box
+     * 
+     * \param data The encoded thumbnail
+     * 
+     * \param length The number of bytes in `data`
+     * 
+     * \return `true` if the thumbnail was written to the pack file
+     */
+    bool store(
+        const std::string& path
+        , std::uint64_t file_size
+        , std::int64_t mtime
+        , unsigned width
+        , unsigned height
+        , const unsigned char* data
+        , std::size_t length);
+
+    /**
+     * \brief Remove the thumbnail for a media file (e.g. because the file
+     * has been deleted)
+     * 
+     * \param path The full path of the media file
+     */
+    void remove(const std::string& path);
+
+    /**
+     * \brief Remove all thumbnails for the files in a media directory
+     * (but not its sub-directories), deleting its pack file
+     * 
+     * \param media_directory The full path of the media directory
+     */
+    void remove_directory(const std::string& media_directory);
+
+    private:
+
+    class pack;
+
+    /**
+     * \brief Retrieve the pack for a given media directory, opening it if
+     * necessary
+     * 
+     * This must be called with `m_mutex` held.
+     */
+    pack& open_pack(const std::string& media_directory);
+
+    std::string m_directory;        ///< Directory holding the pack files
+    std::size_t m_max_open_packs;   ///< Maximum number of open packs
+
+    /**
+     * \brief The lock on the pack files, shared with other processes; null
+     * if it couldn't be made
+     */
+    std::unique_ptr<boost::interprocess::file_lock> m_lock;
+
+    /**
+     * \brief The open packs, keyed on media directory path
+     */
+    std::map<std::string, std::unique_ptr<pack>> m_packs;
+
+    std::uint64_t m_use_counter;    ///< Stamp for LRU tracking of packs
+    std::mutex m_mutex;             ///< Protects all members
+
+};  // end thumbnail_store class
+
+}   // end api namespace
+
+#endif
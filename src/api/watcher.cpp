@@ -0,0 +1,478 @@
+/**
+ * \file watcher.cpp
+ * Implement the `watcher` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "watcher.h"
+
+namespace api {
+
+namespace {
+
+/**
+ * \brief The changes collected from a run of events, waiting to be
+ * applied
+ */
+struct batch
+{
+    std::set<std::string> dirty;            ///< Directories to re-read
+    std::set<std::string> created;          ///< New directories
+    std::set<std::string> removed_dirs;     ///< Directories that have gone
+    std::set<std::string> removed_files;    ///< Media files that have gone
+    bool overflow = false;                  ///< Whether events were lost
+
+    bool empty(void) const { return dirty.empty() && !overflow; }
+};  // end batch struct
+
+/**
+ * \brief Join a directory path and an entry name
+ */
+std::string join(const std::string& directory, const std::string& name)
+{
+    if (directory.empty() || directory.back() == '/') return directory + name;
+    return directory + "/" + name;
+}
+
+}   // end anonymous namespace
+
+#if defined(__linux__)
+
+/**
+ * \brief An `inotify` instance, with the map from watch descriptors to
+ * directories
+ */
+class watcher::notifier
+{
+    public:
+
+    /**
+     * \brief Constructor, creating the `inotify` instance
+     */
+    notifier(void) :
+        m_fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+        , m_wake_fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        , m_watches()
+    {}
+
+    ~notifier(void)
+    {
+        if (m_fd >= 0) ::close(m_fd);
+        if (m_wake_fd >= 0) ::close(m_wake_fd);
+    }
+
+    /**
+     * \brief Whether `inotify` is available
+     */
+    bool valid(void) const { return m_fd >= 0 && m_wake_fd >= 0; }
+
+    /**
+     * \brief Watch a directory
+     * 
+     * \return `false` if the system limit on watches has been reached;
+     * other failures (e.g. a directory that has already gone) are ignored
+     */
+    bool watch(const std::string& directory)
+    {
+        int wd = ::inotify_add_watch(
+            m_fd
+            , directory.c_str()
+            , IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                | IN_CLOSE_WRITE | IN_ATTRIB | IN_ONLYDIR | IN_DONT_FOLLOW
+                | IN_EXCL_UNLINK);
+
+        if (wd < 0) return errno != ENOSPC && errno != ENOMEM;
+
+        m_watches[wd] = directory;
+        return true;
+    }
+
+    /**
+     * \brief Stop watching a directory and everything below it
+     */
+    void unwatch_tree(const std::string& directory)
+    {
+        std::string prefix = join(directory, "");
+        for (auto it = m_watches.begin(); it != m_watches.end(); )
+        {
+            if (it->second == directory
+                    || it->second.compare(0, prefix.size(), prefix) == 0)
+            {
+                ::inotify_rm_watch(m_fd, it->first);
+                it = m_watches.erase(it);
+            }
+            else ++it;
+        }
+    }
+
+    /**
+     * \brief Stop watching everything
+     */
+    void unwatch_all(void)
+    {
+        for (const auto& w : m_watches) ::inotify_rm_watch(m_fd, w.first);
+        m_watches.clear();
+    }
+
+    /**
+     * \brief Interrupt a `wait` from another thread
+     */
+    void wake(void)
+    {
+        std::uint64_t one = 1;
+        if (::write(m_wake_fd, &one, sizeof(one)) < 0) {}
+    }
+
+    /**
+     * \brief Wait for events
+     * 
+     * \param timeout_ms The longest time to wait, in milliseconds; -1 to
+     * wait indefinitely
+     * 
+     * \return `true` if there are events to read
+     */
+    bool wait(int timeout_ms)
+    {
+        pollfd fds[2] = {
+            { m_fd, POLLIN, 0 }
+            , { m_wake_fd, POLLIN, 0 }
+        };
+
+        if (::poll(fds, 2, timeout_ms) <= 0) return false;
+        return (fds[0].revents & POLLIN) != 0;
+    }
+
+    /**
+     * \brief Read the waiting events into a batch
+     * 
+     * \return The number of events read
+     */
+    std::uint64_t read(batch& b)
+    {
+        alignas(inotify_event) char buffer[64 * 1024];
+        std::uint64_t count = 0;
+
+        for (;;)
+        {
+            auto n = ::read(m_fd, buffer, sizeof(buffer));
+            if (n <= 0) break;
+
+            for (decltype(n) pos = 0; pos < n; )
+            {
+                auto e = reinterpret_cast<const inotify_event*>(buffer + pos);
+                pos += sizeof(inotify_event) + e->len;
+                ++count;
+
+                if (e->mask & IN_Q_OVERFLOW)
+                {
+                    b.overflow = true;
+                    continue;
+                }
+
+                auto w = m_watches.find(e->wd);
+                if (w == m_watches.end()) continue;
+
+                if (e->mask & IN_IGNORED)
+                {
+                    m_watches.erase(w);
+                    continue;
+                }
+
+                // Events on the directory itself are also reported to its
+                // parent
+                if (e->len == 0) continue;
+
+                const std::string& directory = w->second;
+                std::string name(e->name);
+                media_type type;
+
+                if (e->mask & IN_ISDIR)
+                {
+                    if (e->mask & (IN_CREATE | IN_MOVED_TO))
+                        b.created.insert(join(directory, name));
+                    else if (e->mask & (IN_DELETE | IN_MOVED_FROM))
+                        b.removed_dirs.insert(join(directory, name));
+                    else continue;
+                }
+                else if (!classify_media(name, type)) continue;
+                else if (e->mask & (IN_DELETE | IN_MOVED_FROM))
+                    b.removed_files.insert(join(directory, name));
+
+                b.dirty.insert(directory);
+            }
+        }
+
+        return count;
+    }
+
+    private:
+
+    int m_fd;           ///< The `inotify` file descriptor
+    int m_wake_fd;      ///< Event file descriptor for interrupting waits
+
+    /**
+     * \brief The watched directories, keyed on watch descriptor
+     */
+    std::unordered_map<int, std::string> m_watches;
+
+};  // end notifier class
+
+#else
+
+/**
+ * \brief A stand-in for the `inotify` instance where it isn't available,
+ * so that the watcher always polls
+ */
+class watcher::notifier
+{
+    public:
+
+    bool valid(void) const { return false; }
+    bool watch(const std::string&) { return false; }
+    void unwatch_tree(const std::string&) {}
+    void unwatch_all(void) {}
+    void wake(void) {}
+    bool wait(int) { return false; }
+    std::uint64_t read(batch&) { return 0; }
+
+};  // end notifier class
+
+#endif
+
+watcher::watcher(
+        media_index& index
+        , std::shared_ptr<thumbnail_store> store
+        , std::string root
+        , const options& opts
+        , update_handler handler) :
+    m_index(index)
+    , m_store(std::move(store))
+    , m_root(std::move(root))
+    , m_options(opts)
+    , m_handler(std::move(handler))
+    , m_polling(false)
+    , m_events(0)
+    , m_batches(0)
+    , m_rescans(0)
+    , m_errors(0)
+    , m_mutex()
+    , m_wake()
+    , m_stop(false)
+    , m_notifier(std::make_unique<notifier>())
+    , m_thread()
+{
+    while (m_root.size() > 1 && m_root.back() == '/') m_root.pop_back();
+
+    m_index.rescan(m_root, m_options.scan);
+
+    m_polling = !m_notifier->valid();
+    m_thread = std::thread(&watcher::run, this);
+}   // end constructor
+
+watcher::~watcher(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_wake.notify_all();
+    m_notifier->wake();
+    m_thread.join();
+}   // end destructor
+
+watch_statistics watcher::statistics(void) const
+{
+    return watch_statistics{
+        m_events.load()
+        , m_batches.load()
+        , m_rescans.load()
+        , m_errors.load()};
+}   // end statistics method
+
+void watcher::run(void)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto stopping = [this]
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stop;
+    };
+
+    // Watch every directory, then catch any changes that were made before
+    // the watches were in place
+    auto watch_tree = [this](const std::string& directory)
+    {
+        for (const auto& d : m_index.directories(directory))
+            if (!m_notifier->watch(d)) return false;
+        return true;
+    };
+
+    auto fall_back = [this]
+    {
+        m_notifier->unwatch_all();
+        m_polling = true;
+    };
+
+    if (!m_polling)
+    {
+        if (!watch_tree(m_root)) fall_back();
+        rescan();
+    }
+
+    batch pending;
+    clock::time_point first, quiet;
+
+    while (!stopping())
+    {
+        if (m_polling)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_wake.wait_for(
+                    lock
+                    , m_options.poll_interval
+                    , [this] { return m_stop; }))
+                break;
+
+            lock.unlock();
+            rescan();
+            continue;
+        }
+
+        int timeout = -1;
+        if (!pending.empty())
+        {
+            auto deadline = std::min(quiet, first + m_options.max_delay);
+            timeout = static_cast<int>(std::max<std::int64_t>(
+                0
+                , std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - clock::now()).count()));
+        }
+
+        bool events = m_notifier->wait(timeout);
+        auto now = clock::now();
+
+        if (events)
+        {
+            bool was_empty = pending.empty();
+            m_events += m_notifier->read(pending);
+            if (!pending.empty())
+            {
+                if (was_empty) first = now;
+                quiet = now + m_options.debounce;
+            }
+        }
+
+        if (pending.empty() || now < std::min(quiet, first + m_options.max_delay))
+            continue;
+
+        batch b = std::move(pending);
+        pending = batch();
+
+        try
+        {
+            if (b.overflow)
+            {
+                // Events have been lost, so the whole tree must be checked
+                rescan();
+                if (!watch_tree(m_root)) fall_back();
+                continue;
+            }
+
+            for (const auto& d : b.removed_dirs)
+            {
+                if (m_store)
+                    for (const auto& sub : m_index.directories(d))
+                        m_store->remove_directory(sub);
+                m_notifier->unwatch_tree(d);
+            }
+
+            if (m_store)
+                for (const auto& f : b.removed_files) m_store->remove(f);
+
+            // New directories are watched before they are read, so that
+            // nothing added to them in the meantime is missed
+            bool limited = false;
+            for (const auto& d : b.created)
+                limited = limited || !m_notifier->watch(d);
+
+            auto stats = m_index.refresh(
+                std::vector<std::string>(b.dirty.begin(), b.dirty.end())
+                , m_options.scan);
+
+            // Directories found inside new directories are watched too,
+            // and read again in case they changed before they were watched
+            std::vector<std::string> nested;
+            for (const auto& d : b.created)
+            {
+                auto dirs = m_index.directories(d);
+                for (std::size_t i = 1; i < dirs.size(); ++i)
+                {
+                    limited = limited || !m_notifier->watch(dirs[i]);
+                    nested.push_back(dirs[i]);
+                }
+            }
+
+            if (!nested.empty())
+            {
+                auto more = m_index.refresh(nested, m_options.scan);
+                stats.added += more.added;
+                stats.changed += more.changed;
+                stats.removed += more.removed;
+            }
+
+            ++m_batches;
+            report(stats);
+
+            if (limited)
+            {
+                fall_back();
+                rescan();
+            }
+        }
+        catch (const std::exception&)
+        {
+            ++m_errors;
+        }
+    }
+}   // end run method
+
+void watcher::rescan(void)
+{
+    try
+    {
+        auto stats = m_index.rescan(m_root, m_options.scan);
+        ++m_rescans;
+        report(stats);
+    }
+    catch (const std::exception&)
+    {
+        ++m_errors;
+    }
+}   // end rescan method
+
+void watcher::report(const rescan_statistics& stats)
+{
+    if (m_handler && (stats.added > 0 || stats.changed > 0 || stats.removed > 0))
+        m_handler(stats);
+}   // end report method
+
+}   // end api namespace
@@ -0,0 +1,192 @@
+/**
+ * \file watcher.h
+ * Declare the `watcher` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "media_index.h"
+#include "thumbnail_store.h"
+
+#ifndef _api_watcher_h_included
+#define _api_watcher_h_included
+
+namespace api {
+
+/**
+ * \brief Counters reported by a watcher
+ */
+struct watch_statistics
+{
+    std::uint64_t events;       ///< Number of change events received
+    std::uint64_t batches;      ///< Number of batches applied to the index
+    std::uint64_t rescans;      ///< Number of full (incremental) rescans
+    std::uint64_t errors;       ///< Number of batches that failed
+};  // end watch_statistics struct
+
+/**
+ * \brief A service that keeps a media index (and optionally a thumbnail
+ * store) up to date with changes to a directory tree
+ * 
+ * On Linux, the watcher uses `inotify`, with a watch on every directory in
+ * the tree. Change events are not applied one by one: the directories they
+ * touch are collected, and applied together once there have been no new
+ * events for the debounce interval (or once the maximum delay has passed,
+ * so that a long-running copy still shows up). A bulk import of thousands
+ * of files into a directory therefore costs a single read of that
+ * directory.
+ * 
+ * If `inotify` is not available, or the tree needs more watches than the
+ * system allows (`fs.inotify.max_user_watches`), or the event queue
+ * overflows, the watcher falls back to periodic incremental rescans of the
+ * whole tree, which are cheap because only changed directories are read.
+ * Elsewhere, the watcher always polls.
+ * 
+ * The watcher runs on its own thread from construction to destruction.
+ */
+class watcher
+{
+    public:
+
+    /**
+     * \brief The type of function that is told about each applied batch of
+     * changes; it is called on the watcher thread
+     */
+    using update_handler = std::function<void(const rescan_statistics&)>;
+
+    /**
+     * \brief Watcher configuration
+     */
+    struct options
+    {
+        /**
+         * \brief How long the tree must be quiet before changes are applied
+         */
+        std::chrono::milliseconds debounce = std::chrono::milliseconds(500);
+
+        /**
+         * \brief The longest that changes are held back while events keep
+         * arriving
+         */
+        std::chrono::milliseconds max_delay = std::chrono::seconds(5);
+
+        /**
+         * \brief The interval between rescans when polling
+         */
+        std::chrono::milliseconds poll_interval = std::chrono::minutes(5);
+
+        /**
+         * \brief The scanner configuration for reading directories
+         */
+        scanner::options scan;
+    };  // end options struct
+
+    /**
+     * \brief Constructor, bringing the index up to date with the tree and
+     * starting to watch it
+     * 
+     * \param index The index to keep up to date
+     * 
+     * \param store The thumbnail store to remove stale thumbnails from;
+     * this may be null
+     * 
+     * \param root The directory at the top of the tree
+     * 
+     * \param opts The watcher configuration
+     * 
+     * \param handler The function to be told about changes; this may be
+     * empty
+     * 
+     * \throw api::error The root is not a readable directory
+     */
+    watcher(
+        media_index& index
+        , std::shared_ptr<thumbnail_store> store
+        , std::string root
+        , const options& opts
+        , update_handler handler = update_handler());
+
+    /**
+     * \brief Destructor, stopping the watcher thread
+     */
+    ~watcher(void);
+
+    watcher(const watcher&) = delete;
+    watcher& operator=(const watcher&) = delete;
+
+    /**
+     * \brief Retrieve the directory at the top of the watched tree
+     */
+    const std::string& root(void) const { return m_root; }
+
+    /**
+     * \brief Whether the watcher has fallen back to periodic rescans
+     */
+    bool polling(void) const { return m_polling.load(); }
+
+    /**
+     * \brief Retrieve the counters for the watcher
+     */
+    watch_statistics statistics(void) const;
+
+    private:
+
+    class notifier;
+
+    /**
+     * \brief The body of the watcher thread
+     */
+    void run(void);
+
+    /**
+     * \brief Rescan the whole tree, counting failures
+     */
+    void rescan(void);
+
+    /**
+     * \brief Report a batch of changes to the handler
+     */
+    void report(const rescan_statistics& stats);
+
+    media_index& m_index;                       ///< The index
+    std::shared_ptr<thumbnail_store> m_store;   ///< The thumbnail store
+    std::string m_root;                         ///< Top of the tree
+    options m_options;                          ///< Configuration
+    update_handler m_handler;                   ///< Change handler
+
+    std::atomic<bool> m_polling;                ///< Whether polling
+    std::atomic<std::uint64_t> m_events;        ///< Events received
+    std::atomic<std::uint64_t> m_batches;       ///< Batches applied
+    std::atomic<std::uint64_t> m_rescans;       ///< Full rescans
+    std::atomic<std::uint64_t> m_errors;        ///< Failed batches
+
+    std::mutex m_mutex;                 ///< Protects `m_stop`
+    std::condition_variable m_wake;     ///< Wakes a polling watcher
+    bool m_stop;                        ///< Set when the watcher must stop
+
+    /**
+     * \brief The inotify instance; null when polling
+     */
+    std::unique_ptr<notifier> m_notifier;
+
+    std::thread m_thread;               ///< The watcher thread
+
+};  // end watcher class
+
+}   // end api namespace
+
+#endif
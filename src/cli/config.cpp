@@ -0,0 +1,183 @@
+/**
+ * \file config.cpp
+ * Implement config-related functionality for the command-line indexer
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+void parse_command_line(
+        int argc
+        , char* argv[]
+        , bst::po::variables_map& vm
+        , bool& help_signalled)
+{
+    bst::po::options_description desc("Allowed Options");
+
+    // Set up the options
+    desc.add_options()
+        ("help,h", "display help")
+        (
+            "index,i"
+            , bst::po::value<std::vector<std::string>>()->composing()
+            , "directory tree to (re)index; may be given more than once"
+        )
+        (
+            "index-file"
+            , bst::po::value<std::string>()
+            , "path of the index file; by default, the index shared with "
+                "the GUI"
+        )
+        (
+            "thumbnails,t"
+            , "generate missing thumbnails for the images in the trees "
+                "given with --index"
+        )
+        (
+            "thumbnail-size"
+            , bst::po::value<int>()->default_value(150)->notifier(
+                [](int size)
+                {
+                    if (size <= 0)
+                    {
+                        std::wcerr << L"[ERR] thumbnail size must be "
+                            "greater than zero" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "size of the box that thumbnails must fit into, in pixels"
+        )
+        (
+            "metadata,m"
+            , "extract the EXIF/XMP metadata of indexed images that don't "
+                "have it yet"
+        )
+        (
+            "benchmark-metadata"
+            , "measure metadata extraction throughput over all indexed "
+                "images, reading from disk (cold page cache) and then from "
+                "memory (warm page cache); nothing is written to the index"
+        )
+        (
+            "query,q"
+            , bst::po::value<std::string>()
+            , "list the indexed files whose paths contain the given text"
+        )
+        (
+            "type"
+            , bst::po::value<std::string>()->notifier(
+                [](std::string t)
+                {
+                    if ((t != "image") && (t != "video") && (t != "audio"))
+                    {
+                        std::wcerr << L"[ERR] media type must be one of "
+                            "\"image\", \"video\" or \"audio\"" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "restrict a query to one media type [image|video|audio]"
+        )
+        (
+            "sort"
+            , bst::po::value<std::string>()->default_value("path")->notifier(
+                [](std::string k)
+                {
+                    if ((k != "path") && (k != "size") && (k != "mtime")
+                            && (k != "date") && (k != "pixels"))
+                    {
+                        std::wcerr << L"[ERR] sort key must be one of "
+                            "\"path\", \"size\", \"mtime\", \"date\" or "
+                            "\"pixels\"" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "order of the files listed by a query "
+                "[path|size|mtime|date|pixels]; other than path, the "
+                "largest or newest come first"
+        )
+        (
+            "summary"
+            , "report the number and size of the indexed files by media "
+                "type, and the range of capture dates"
+        )
+        (
+            "search"
+            , bst::po::value<std::string>()
+            , "list the indexed files whose metadata matches a query, e.g. "
+                "'beach AND make:canon NOT date:2019..'; run --metadata "
+                "first"
+        )
+        (
+            "duplicates,d"
+            , "list the groups of indexed files with identical contents"
+        )
+        (
+            "similar,s"
+            , bst::po::value<std::string>()
+            , "list the indexed images that look like the given image file; "
+                "only images with generated thumbnails are found"
+        )
+        (
+            "distance"
+            , bst::po::value<int>()->default_value(6)->notifier(
+                [](int d)
+                {
+                    if (d < 0 || d > 64)
+                    {
+                        std::wcerr << L"[ERR] similarity distance must be "
+                            "from 0 to 64" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "the number of differing hash bits (out of 64) allowed in "
+                "a similar image"
+        )
+        (
+            "threads,j"
+            , bst::po::value<int>()->default_value(0)->notifier(
+                [](int n)
+                {
+                    if (n < 0)
+                    {
+                        std::wcerr << L"[ERR] number of threads must not "
+                            "be negative" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "number of worker threads; 0 for one per core"
+        )
+        ;
+
+        // Parse the options, and run notifiers
+        bst::po::store(bst::po::parse_command_line(argc, argv, desc), vm);
+        bst::po::notify(vm);
+
+        if (vm.count("help")
+                || (!vm.count("index") && !vm.count("thumbnails")
+                    && !vm.count("metadata")
+                    && !vm.count("benchmark-metadata")
+                    && !vm.count("query") && !vm.count("search")
+                    && !vm.count("summary")
+                    && !vm.count("duplicates")
+                    && !vm.count("similar")))
+        {
+            std::cout << desc << std::endl;
+            help_signalled = true;
+        }
+        else help_signalled = false;
+}   // end parse_command_line function
@@ -0,0 +1,50 @@
+/**
+ * \file config.h
+ * Declare config-related functionality for the command-line indexer, based
+ * on Boost.ProgramOptions
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <boost/program_options.hpp>
+
+#ifndef _cli_config_h_included
+#define _cli_config_h_included
+
+/**
+ * \brief Alias for the `boost` namespace
+ */
+namespace bst {
+
+    using namespace boost;
+
+    namespace po = program_options; ///< Alias for `boost::program_options`
+
+}   // end bst namespace
+
+/**
+ * \brief Parse the command-line to configure the indexer
+ * 
+ * \param argc The number of the command-line arguments
+ * 
+ * \param argv The vector of command-line argument strings
+ * 
+ * \param vm The variables map objects that is populated with config
+ * information
+ * 
+ * \param help_signalled Whether or not the 'help' option was specified; in
+ * this case, the options description is printed to stdout, and this flag is
+ * set to `true`; in this case, the indexer should simply exit without
+ * further action
+ */
+extern void parse_command_line(
+    int argc
+    , char* argv[]
+    , bst::po::variables_map& vm
+    , bool& help_signalled);
+
+#endif
@@ -0,0 +1,568 @@
+/**
+ * \file main.cpp
+ * Entry point for the command-line indexer executable
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <QCoreApplication>
+
+#include <boost/filesystem.hpp>
+#include <fmt/format.h>
+
+#include <api/api.h>
+#include <api/batch_reader.h>
+#include <api/catalogue.h>
+#include <api/duplicates.h>
+#include <api/exif.h>
+#include <api/extractor.h>
+#include <api/media_index.h>
+#include <api/metadata.h>
+#include <api/parallel.h>
+#include <api/search_index.h>
+#include <api/similarity.h>
+#include <api/thumbnail_store.h>
+#include <gui/thumbnail.h>
+
+#include "config.h"
+
+namespace {
+
+using steady = std::chrono::steady_clock;
+
+/**
+ * \brief Retrieve the number of seconds since a given time
+ */
+double seconds_since(steady::time_point start)
+{
+    return std::chrono::duration<double>(steady::now() - start).count();
+}
+
+/**
+ * \brief Bring the index up to date with a directory tree, and report the
+ * throughput
+ */
+void index_tree(
+        api::media_index& index
+        , const std::string& root
+        , const api::scanner::options& options)
+{
+    auto start = steady::now();
+    auto stats = index.rescan(root, options);
+    auto secs = seconds_since(start);
+
+    fmt::print(
+        "indexed {}: {} files in {} directories read, {} unchanged; "
+            "{} added, {} changed, {} removed; {} errors\n"
+        , root
+        , stats.scan.files
+        , stats.scan.directories
+        , stats.scan.skipped
+        , stats.added
+        , stats.changed
+        , stats.removed
+        , stats.scan.errors);
+
+    fmt::print(
+        "  {:.2f}s, {:.0f} directories/s, {:.0f} files/s\n"
+        , secs
+        , (stats.scan.directories + stats.scan.skipped) / secs
+        , stats.scan.files / secs);
+}   // end index_tree function
+
+/**
+ * \brief Make sure that every image in the given trees has a thumbnail in
+ * the store and a perceptual hash in the index, and report the throughput
+ * 
+ * The workers take whole directories from a shared list, so the only
+ * per-file memory is one directory's records and one image per worker.
+ */
+void generate_thumbnails(
+        api::media_index& index
+        , const std::vector<std::string>& roots
+        , int size
+        , unsigned threads)
+{
+    std::vector<std::string> directories;
+    for (const auto& root : roots)
+    {
+        auto tree = index.directories(root);
+        directories.insert(directories.end(), tree.begin(), tree.end());
+    }
+
+    api::thumbnail_store store(thumbnailStorePath().toStdString());
+    std::atomic<std::size_t> images(0), failed(0);
+
+    auto start = steady::now();
+
+    // A failure to write to the index stops the workers, and is passed on
+    // once they have all finished
+    api::parallel_for(directories.size(), threads, [&](std::size_t i)
+    {
+        std::vector<api::media_record> records;
+        index.for_each_in(
+            directories[i]
+            , [&records](const api::media_record& r)
+            {
+                if (r.type == api::media_type::image) records.push_back(r);
+            });
+
+        for (const auto& r : records)
+        {
+            ++images;
+            auto thumbnail = loadThumbnail(
+                QString::fromStdString(r.path)
+                , QSize(size, size)
+                , store);
+
+            if (thumbnail.isNull()) ++failed;
+            else if (r.phash == 0)
+                index.set_perceptual_hash(
+                    r.path
+                    , r.size
+                    , r.mtime
+                    , perceptualHash(thumbnail));
+        }
+    });
+
+    auto secs = seconds_since(start);
+    fmt::print(
+        "thumbnails: {} images, {} unreadable; {:.2f}s, {:.0f} images/s\n"
+        , images.load()
+        , failed.load()
+        , secs
+        , images.load() / secs);
+}   // end generate_thumbnails function
+
+/**
+ * \brief Extract the metadata of the indexed images that don't have it
+ * yet, and report the throughput
+ */
+void update_metadata(api::media_index& index, unsigned threads)
+{
+    auto start = steady::now();
+    api::extraction_statistics stats;
+    api::extract_metadata(index, threads, &stats);
+    auto secs = seconds_since(start);
+
+    fmt::print(
+        "metadata: {} images, {} extracted, {} already known, {} "
+            "unreadable; {:.2f}s, {:.0f} files/s, {:.1f} MB/s read\n"
+        , stats.files
+        , stats.extracted
+        , stats.reused
+        , stats.errors
+        , secs
+        , stats.extracted / secs
+        , stats.bytes_read / secs / 1e6);
+}   // end update_metadata function
+
+/**
+ * \brief Measure the metadata extraction throughput over all the indexed
+ * images, from a cold page cache and then a warm one
+ * 
+ * The first pass drops each file from the page cache before reading it,
+ * so it measures reads from disk; the second pass reads the same headers
+ * again, which are then in memory, so it measures the parsing alone. The
+ * headers are read by an `api::batch_reader`, keeping as many reads in
+ * flight as there are threads (or at least 32).
+ */
+void benchmark_metadata(const api::media_index& index, unsigned threads)
+{
+    std::vector<api::read_request> requests;
+    index.for_each([&requests](const api::media_record& r)
+    {
+        if (r.type != api::media_type::image) return;
+
+        api::read_request request;
+        request.path = r.path;
+        request.length = api::exif::header_size;
+        requests.push_back(std::move(request));
+    });
+    std::sort(
+        requests.begin()
+        , requests.end()
+        , [](const api::read_request& a, const api::read_request& b)
+            { return a.path < b.path; });
+
+    for (bool cold : { true, false })
+    {
+        api::batch_reader::options options;
+        options.queue_depth = std::max(32u, threads);
+        options.evict = cold;
+        api::batch_reader reader(options);
+
+        std::uint64_t bytes = 0, errors = 0;
+        auto start = steady::now();
+        reader.read(requests, [&](std::size_t, api::read_result&& result)
+        {
+            api::media_metadata metadata;
+            if (result.error != 0
+                    || !api::parse_metadata(
+                        result.data.data()
+                        , result.data.size()
+                        , metadata))
+                ++errors;
+            bytes += result.data.size();
+        });
+        auto secs = seconds_since(start);
+
+        fmt::print(
+            "metadata ({} cache, {}): {} images, {} unreadable; {:.2f}s, "
+                "{:.0f} files/s, {:.1f} MB/s read\n"
+            , cold ? "cold" : "warm"
+            , reader.uses_io_uring() ? "io_uring" : "threads"
+            , requests.size()
+            , errors
+            , secs
+            , requests.size() / secs
+            , bytes / secs / 1e6);
+    }
+}   // end benchmark_metadata function
+
+/**
+ * \brief List the indexed files whose paths contain some text
+ */
+void run_query(
+        const api::catalogue& cat
+        , const std::string& text
+        , const api::catalogue_filter& filter
+        , api::catalogue_key key)
+{
+    auto rows = cat.select(filter);
+
+    // Matching the path is the only test that isn't a scan of a column
+    rows.erase(
+        std::remove_if(
+            rows.begin()
+            , rows.end()
+            , [&](std::uint32_t row)
+            {
+                return cat.path(row).find(text) == std::string::npos;
+            })
+        , rows.end());
+
+    cat.sort(rows, key, key != api::catalogue_key::path);
+
+    for (auto row : rows)
+    {
+        if (cat.width(row) > 0)
+            fmt::print(
+                "{}\t{}\t{}x{}\n"
+                , cat.path(row)
+                , cat.file_size(row)
+                , cat.width(row)
+                , cat.height(row));
+        else fmt::print("{}\t{}\n", cat.path(row), cat.file_size(row));
+    }
+
+    fmt::print(stderr, "{} matching files\n", rows.size());
+}   // end run_query function
+
+/**
+ * \brief Report the number and size of the indexed files by media type,
+ * and the range of capture dates
+ */
+void print_summary(const api::catalogue& cat)
+{
+    auto start = steady::now();
+    auto totals = cat.totals();
+    auto secs = seconds_since(start);
+
+    static const char* type_names[] = { "images", "videos", "audio files" };
+    for (int t = 0; t < 3; ++t)
+        fmt::print(
+            "{:>10} {:<12}{:>10.1f} MB\n"
+            , totals.type_files[t]
+            , type_names[t]
+            , totals.type_bytes[t] / 1e6);
+    fmt::print(
+        "{:>10} {:<12}{:>10.1f} MB\n"
+        , totals.files
+        , "in total"
+        , totals.bytes / 1e6);
+
+    if (totals.first_capture_time != 0)
+    {
+        auto date = [](std::int64_t t)
+        {
+            char text[16] = "";
+            auto time = static_cast<std::time_t>(t);
+            std::strftime(text, sizeof(text), "%Y-%m-%d", std::gmtime(&time));
+            return std::string(text);
+        };
+
+        fmt::print(
+            "captured from {} to {}\n"
+            , date(totals.first_capture_time)
+            , date(totals.last_capture_time));
+    }
+
+    fmt::print(
+        stderr
+        , "catalogue of {:.1f} MB; totalled in {:.6f}s\n"
+        , cat.memory_usage() / 1e6
+        , secs);
+}   // end print_summary function
+
+/**
+ * \brief List the indexed files that match a metadata query, and report
+ * the time taken to build the inverted index and to run the query
+ */
+void run_search(const api::media_index& index, const std::string& query)
+{
+    auto start = steady::now();
+    api::search_index search(index);
+    auto build_secs = seconds_since(start);
+
+    start = steady::now();
+    auto matches = search.query(query);
+    auto query_secs = seconds_since(start);
+
+    for (const auto& path : search.paths(matches)) fmt::print("{}\n", path);
+
+    fmt::print(
+        stderr
+        , "{} matching files among {}; index built in {:.3f}s ({:.1f} MB), "
+            "searched in {:.6f}s\n"
+        , matches.size()
+        , search.size()
+        , build_secs
+        , search.memory_usage() / 1e6
+        , query_secs);
+}   // end run_search function
+
+/**
+ * \brief List the indexed images that look like a given image
+ * 
+ * Only images that have been given a perceptual hash (by generating their
+ * thumbnails) can be found.
+ */
+void list_similar(
+        const api::media_index& index
+        , const std::string& path
+        , int size
+        , unsigned max_distance)
+{
+    auto image = loadThumbnail(
+        QString::fromStdString(path)
+        , QSize(size, size));
+    if (image.isNull())
+        throw std::runtime_error("cannot read image \"" + path + "\"");
+    auto hash = perceptualHash(image);
+
+    auto start = steady::now();
+    api::similarity::index similar;
+    index.for_each([&similar](const api::media_record& r)
+    {
+        if (r.phash != 0) similar.add(r.path, r.phash);
+    });
+    auto build_secs = seconds_since(start);
+
+    start = steady::now();
+    std::size_t visited = 0;
+    auto matches = similar.find(hash, max_distance, &visited);
+    auto find_secs = seconds_since(start);
+
+    for (const auto& m : matches)
+        fmt::print("{}\t{}\n", m.distance, m.path);
+
+    fmt::print(
+        stderr
+        , "{} similar images among {}; built in {:.3f}s, searched in "
+            "{:.3f}s, visiting {} hashes\n"
+        , matches.size()
+        , similar.size()
+        , build_secs
+        , find_secs
+        , visited);
+}   // end list_similar function
+
+/**
+ * \brief List the groups of indexed files with identical contents, and
+ * report the throughput
+ */
+void list_duplicates(api::media_index& index, unsigned threads)
+{
+    auto start = steady::now();
+    api::duplicate_statistics stats;
+    auto groups = api::find_duplicates(index, threads, &stats);
+    auto secs = seconds_since(start);
+
+    std::uint64_t wasted = 0;
+    for (const auto& g : groups)
+    {
+        wasted += g.size * (g.paths.size() - 1);
+        fmt::print("{:016x}\t{}\n", g.hash, g.size);
+        for (const auto& path : g.paths) fmt::print("\t{}\n", path);
+    }
+
+    fmt::print(
+        stderr
+        , "{} groups of duplicates, {} bytes wasted; {} files, {} sharing "
+            "a size, {} partially hashed, {} fully hashed, {} hashes "
+            "reused, {} unreadable\n"
+        , groups.size()
+        , wasted
+        , stats.files
+        , stats.same_size
+        , stats.ends_hashed
+        , stats.fully_hashed
+        , stats.hashes_reused
+        , stats.errors);
+
+    fmt::print(
+        stderr
+        , "  {:.2f}s, {:.1f} MB/s read\n"
+        , secs
+        , stats.bytes_read / secs / 1e6);
+}   // end list_duplicates function
+
+}   // end anonymous namespace
+
+/**
+ * \brief Entry point for the command-line indexer
+ * 
+ * The indexer updates the index for some directory trees, generates their
+ * thumbnails, extracts their metadata, and queries the index, without
+ * needing a display, so that the caches can be warmed ahead of time (e.g.
+ * overnight on a server).
+ * 
+ * \param argc The number of command-line arguments
+ * 
+ * \param argv The array of command-line argument
+ * 
+ * \return Zero on success, non-zero on error
+ */
+int main(int argc, char *argv[])
+{
+    int result = 0;
+
+    try
+    {
+        bst::po::variables_map vm;
+        bool help_signalled = false;
+        parse_command_line(argc, argv, vm, help_signalled);
+
+        if (!help_signalled)
+        {
+            // Needed for Qt to find its image format plugins
+            QCoreApplication a(argc, argv);
+
+            std::vector<std::string> roots;
+            if (vm.count("index"))
+                for (const auto& root
+                        : vm["index"].as<std::vector<std::string>>())
+                    roots.push_back(
+                        boost::filesystem::canonical(root).string());
+
+            if (vm.count("thumbnails") && roots.empty())
+                throw std::runtime_error(
+                    "thumbnails can only be generated for trees given with "
+                    "--index");
+
+            std::string index_path = vm.count("index-file")
+                ? vm["index-file"].as<std::string>()
+                : mediaIndexPath().toStdString();
+
+            api::scanner::options options;
+            options.threads = static_cast<unsigned>(vm["threads"].as<int>());
+            unsigned threads = api::thread_count(options.threads);
+
+            fmt::print(
+                "MediaIndex {}; index {}; {} threads\n"
+                , api::version()
+                , index_path
+                , threads);
+
+            api::media_index index(index_path);
+
+            for (const auto& root : roots) index_tree(index, root, options);
+
+            if (vm.count("thumbnails"))
+                generate_thumbnails(
+                    index
+                    , roots
+                    , vm["thumbnail-size"].as<int>()
+                    , threads);
+
+            if (vm.count("metadata")) update_metadata(index, threads);
+
+            if (vm.count("benchmark-metadata"))
+                benchmark_metadata(index, threads);
+
+            if (vm.count("query") || vm.count("summary"))
+            {
+                auto start = steady::now();
+                api::catalogue cat(index);
+                fmt::print(
+                    stderr
+                    , "catalogue of {} files built in {:.3f}s\n"
+                    , cat.size()
+                    , seconds_since(start));
+
+                if (vm.count("summary")) print_summary(cat);
+
+                if (vm.count("query"))
+                {
+                    api::catalogue_filter filter;
+                    if (vm.count("type"))
+                    {
+                        auto t = vm["type"].as<std::string>();
+                        auto type = api::media_type::image;
+                        if (t == "video") type = api::media_type::video;
+                        else if (t == "audio") type = api::media_type::audio;
+                        filter.types = 1u << static_cast<unsigned>(type);
+                    }
+
+                    auto k = vm["sort"].as<std::string>();
+                    auto key = api::catalogue_key::path;
+                    if (k == "size") key = api::catalogue_key::size;
+                    else if (k == "mtime") key = api::catalogue_key::mtime;
+                    else if (k == "date")
+                        key = api::catalogue_key::capture_time;
+                    else if (k == "pixels") key = api::catalogue_key::pixels;
+
+                    run_query(cat, vm["query"].as<std::string>(), filter, key);
+                }
+            }
+
+            if (vm.count("search"))
+                run_search(index, vm["search"].as<std::string>());
+
+            if (vm.count("duplicates")) list_duplicates(index, threads);
+
+            if (vm.count("similar"))
+                list_similar(
+                    index
+                    , vm["similar"].as<std::string>()
+                    , vm["thumbnail-size"].as<int>()
+                    , static_cast<unsigned>(vm["distance"].as<int>()));
+        }
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << "[ERR] " << error.what() << std::endl;
+        result = -1;
+    }
+    catch (...)
+    {
+        std::cerr << "[ERR] unrecognised exception" << std::endl;
+        result = -1;
+    }
+
+    return result;
+}   // end main function
@@ -42,6 +42,84 @@ void parse_command_line(
                 })
             , "logging level [ERR|WAR|INF|DEB]"
         )
+        (
+            "thumbnail-cache-mb"
+            , bst::po::value<int>()->default_value(256)->notifier(
+                [](int mb)
+                {
+                    if (mb <= 0)
+                    {
+                        std::wcerr << L"[ERR] thumbnail cache size must be "
+                            "greater than zero" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "memory budget for cached thumbnail icons, in MiB"
+        )
+        (
+            "preview-prefetch"
+            , bst::po::value<int>()->default_value(2)->notifier(
+                [](int n)
+                {
+                    if (n < 0)
+                    {
+                        std::wcerr << L"[ERR] number of previews to "
+                            "prefetch must not be negative" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "number of files either side of the selected file to "
+                "prefetch for previewing"
+        )
+        (
+            "io-threads"
+            , bst::po::value<int>()->default_value(4)->notifier(
+                [](int n)
+                {
+                    if (n <= 0)
+                    {
+                        std::wcerr << L"[ERR] number of IO threads must be "
+                            "greater than zero" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "number of threads reading image files for thumbnails; more "
+                "suit SSDs and network file systems, fewer spinning disks"
+        )
+        (
+            "decode-threads"
+            , bst::po::value<int>()->default_value(0)->notifier(
+                [](int n)
+                {
+                    if (n < 0)
+                    {
+                        std::wcerr << L"[ERR] number of decode threads must "
+                            "not be negative" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "number of threads decoding images for thumbnails; 0 for one "
+                "per core"
+        )
+        (
+            "scale-threads"
+            , bst::po::value<int>()->default_value(2)->notifier(
+                [](int n)
+                {
+                    if (n <= 0)
+                    {
+                        std::wcerr << L"[ERR] number of scale threads must "
+                            "be greater than zero" << std::endl;
+
+                        throw std::runtime_error("configuration error");
+                    }
+                })
+            , "number of threads scaling decoded images into thumbnails"
+        )
         ;
 
         // Parse the options, and run notifiers
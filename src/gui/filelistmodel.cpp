@@ -0,0 +1,277 @@
+/**
+ * \file filelistmodel.cpp
+ * Implement the `FileListModel` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <iterator>
+
+#include <QFileIconProvider>
+#include <QFileSystemModel>
+#include <QLocale>
+#include <QtConcurrent>
+
+#include <api/scanner.h>
+
+#include "filelistmodel.h"
+#include "logging.h"
+
+namespace {
+
+/**
+ * \brief Compare two file names as a file manager would: ignoring case,
+ * and comparing runs of digits as numbers (so `IMG_9` comes before
+ * `IMG_10`)
+ */
+bool naturalLess(
+        const char* a
+        , const char* aEnd
+        , const char* b
+        , const char* bEnd)
+{
+    auto isDigit = [](char c)
+        { return std::isdigit(static_cast<unsigned char>(c)) != 0; };
+
+    const char* i = a;
+    const char* j = b;
+    while (i != aEnd && j != bEnd)
+    {
+        if (isDigit(*i) && isDigit(*j))
+        {
+            // Compare the numbers by length without leading zeros, then
+            // digit by digit
+            while (i != aEnd && *i == '0') ++i;
+            while (j != bEnd && *j == '0') ++j;
+
+            const char* iEnd = i;
+            const char* jEnd = j;
+            while (iEnd != aEnd && isDigit(*iEnd)) ++iEnd;
+            while (jEnd != bEnd && isDigit(*jEnd)) ++jEnd;
+
+            if (iEnd - i != jEnd - j) return iEnd - i < jEnd - j;
+            for (; i != iEnd; ++i, ++j)
+                if (*i != *j) return *i < *j;
+            continue;
+        }
+
+        auto ci = std::tolower(static_cast<unsigned char>(*i));
+        auto cj = std::tolower(static_cast<unsigned char>(*j));
+        if (ci != cj) return ci < cj;
+        ++i;
+        ++j;
+    }
+
+    if ((i == aEnd) != (j == bEnd)) return i == aEnd;
+
+    // Names that only differ in case or leading zeros still need an order
+    return std::lexicographical_compare(a, aEnd, b, bEnd);
+}   // end naturalLess function
+
+}   // end anonymous namespace
+
+FileListModel::FileListModel(QObject* parent) :
+        QAbstractListModel(parent)
+        , m_directory()
+        , m_listing()
+        , m_rows(0)
+        , m_batchSize(2000)
+        , m_lastTicket(0)
+        , m_batchTmr(new QTimer(this))
+        , m_timer()
+        , m_fileIcon(QFileIconProvider().icon(QFileIconProvider::File))
+        , m_pool()
+{
+    // Only the latest listing is wanted, so one thread is enough
+    m_pool.setMaxThreadCount(1);
+
+    // Each batch after the first waits for the event loop, so the view can
+    // paint in between
+    m_batchTmr->setSingleShot(true);
+    m_batchTmr->setInterval(0);
+    connect(
+        m_batchTmr
+        , &QTimer::timeout
+        , this
+        , &FileListModel::insertBatch);
+}
+
+FileListModel::~FileListModel(void)
+{
+    // Nothing that is still queued is wanted any more
+    m_pool.clear();
+    m_pool.waitForDone();
+}   // end destructor
+
+void FileListModel::setDirectory(const QString& path)
+{
+    beginResetModel();
+    m_directory = path;
+    m_listing.reset();
+    m_rows = 0;
+    m_batchTmr->stop();
+    endResetModel();
+
+    m_timer.start();
+
+    // A listing for a directory that is no longer shown is discarded when
+    // it arrives
+    quint64 ticket = ++m_lastTicket;
+    m_pool.clear();
+    QtConcurrent::run(&m_pool, [this, ticket, path]{
+        auto listing = list(path);
+        QMetaObject::invokeMethod(
+            this
+            , [this, ticket, listing]{ onListed(ticket, listing); }
+            , Qt::QueuedConnection);
+    });
+}   // end setDirectory method
+
+QString FileListModel::filePath(const QModelIndex& index) const
+{
+    return data(index, QFileSystemModel::FilePathRole).toString();
+}   // end filePath method
+
+int FileListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_rows;
+}   // end rowCount method
+
+QVariant FileListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows) return QVariant();
+
+    auto id = static_cast<api::path_table::id_type>(index.row());
+    switch (role)
+    {
+        case Qt::DisplayRole:
+        case QFileSystemModel::FileNameRole:
+            return QString::fromStdString(m_listing->paths.name(id));
+
+        case QFileSystemModel::FilePathRole:
+            return QString::fromStdString(m_listing->paths.path(id));
+
+        // This is also the decoration role
+        case QFileSystemModel::FileIconRole:
+            return m_fileIcon;
+
+        case Qt::ToolTipRole:
+            return QString::fromStdString(m_listing->paths.name(id))
+                + "\n" + QLocale().formattedDataSize(
+                    static_cast<qint64>(m_listing->sizes[id]));
+
+        default:
+            return QVariant();
+    }
+}   // end data method
+
+std::shared_ptr<const FileListModel::Listing> FileListModel::list(
+        const QString& directory)
+{
+    auto listing = std::make_shared<Listing>();
+
+    std::vector<api::media_file> files;
+    try
+    {
+        api::scanner::options options;
+        options.threads = 1;
+        options.recursive = false;
+        api::scanner(options).scan(
+            directory.toStdString()
+            , [&files](std::vector<api::media_file>&& batch)
+            {
+                files.insert(
+                    files.end()
+                    , std::make_move_iterator(batch.begin())
+                    , std::make_move_iterator(batch.end()));
+            });
+    }
+    catch (const std::exception& err)
+    {
+        listing->error = err.what();
+        return listing;
+    }
+
+    // All the files are in the same directory, so only their names are
+    // compared
+    std::vector<std::size_t> names(files.size());
+    std::vector<std::size_t> order(files.size());
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        auto slash = files[i].path.find_last_of('/');
+        names[i] = slash == std::string::npos ? 0 : slash + 1;
+        order[i] = i;
+    }
+
+    std::sort(
+        order.begin()
+        , order.end()
+        , [&](std::size_t a, std::size_t b)
+        {
+            const auto& pa = files[a].path;
+            const auto& pb = files[b].path;
+            return naturalLess(
+                pa.data() + names[a]
+                , pa.data() + pa.size()
+                , pb.data() + names[b]
+                , pb.data() + pb.size());
+        });
+
+    listing->paths.reserve(files.size());
+    listing->sizes.reserve(files.size());
+    for (auto i : order)
+    {
+        listing->paths.intern(files[i].path);
+        listing->sizes.push_back(files[i].size);
+    }
+    listing->paths.shrink_to_fit();
+
+    return listing;
+}   // end list method
+
+void FileListModel::onListed(
+        quint64 ticket
+        , std::shared_ptr<const Listing> listing)
+{
+    if (ticket != m_lastTicket) return;
+
+    if (!listing->error.isEmpty())
+        logging::warning(
+            "could not list \"" + m_directory + "\": " + listing->error);
+
+    logging::debug(QString("read %1 files from \"%2\" in %3 ms").arg(
+        listing->paths.size()).arg(m_directory).arg(m_timer.elapsed()));
+
+    m_listing = std::move(listing);
+    insertBatch();
+}   // end onListed method
+
+void FileListModel::insertBatch(void)
+{
+    if (!m_listing) return;
+
+    int total = static_cast<int>(m_listing->paths.size())
+        , count = qMin(m_batchSize, total - m_rows);
+
+    if (count > 0)
+    {
+        beginInsertRows(QModelIndex(), m_rows, m_rows + count - 1);
+        m_rows += count;
+        endInsertRows();
+    }
+
+    if (m_rows < total) m_batchTmr->start();
+    else
+    {
+        logging::debug(QString("showed %1 files in %2 ms").arg(
+            m_rows).arg(m_timer.elapsed()));
+        emit directoryLoaded(m_directory);
+    }
+}   // end insertBatch method
@@ -0,0 +1,179 @@
+/**
+ * \file filelistmodel.h
+ * Declare the `FileListModel` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <memory>
+#include <vector>
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QIcon>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <api/path_table.h>
+
+#ifndef _gui_filelistmodel_h_installed
+#define _gui_filelistmodel_h_installed
+
+/**
+ * \brief A flat list model of the media files in one directory
+ * 
+ * This takes the place of a `QFileSystemModel` for the files view, which
+ * becomes the bottleneck for directories of tens of thousands of files: it
+ * gathers information about every file in the GUI thread, sorts and
+ * re-sorts as entries arrive, and holds a tree node of strings and file
+ * information per file.
+ * 
+ * Instead, the directory is read in the background by an `api::scanner`
+ * (which only `stat`s media files, in large batches), and the files are
+ * sorted by name there too. The listing is held compactly: the paths in an
+ * `api::path_table`, and the sizes in an array. Nothing is converted to
+ * `QString` until a view asks for it, and then only for the rows that it
+ * asks about.
+ * 
+ * The rows are then added to the model in batches, the first straight
+ * away and the rest from the event loop, so a view can lay out and paint
+ * the first screenful of a huge directory before the rest is added. Views
+ * should use uniform item sizes, so that their layout doesn't need the
+ * data of every row.
+ * 
+ * The model answers the same roles as a `QFileSystemModel` does for files
+ * (`FilePathRole`, `FileNameRole` and `FileIconRole`), so that it can be
+ * used with an `IconProxyModel`. It doesn't watch the directory for
+ * changes; `refresh` lists it again.
+ */
+class FileListModel : public QAbstractListModel
+{
+
+    Q_OBJECT
+
+    public:
+
+    /**
+     * \brief Standard constructor for Qt classes / objects
+     * 
+     * \param parent The parent of the object
+     */
+    explicit FileListModel(QObject* parent = nullptr);
+
+    /**
+     * \brief Destructor, waiting for any directory being read
+     */
+    virtual ~FileListModel(void);
+
+    /**
+     * \brief Show the files in a directory
+     * 
+     * The model is emptied straight away, and the rows are added once the
+     * directory has been read in the background.
+     * 
+     * \param path The path of the directory
+     */
+    void setDirectory(const QString& path);
+
+    /**
+     * \brief Retrieve the path of the directory being shown
+     */
+    QString directory(void) const { return m_directory; }
+
+    /**
+     * \brief Read the directory again
+     */
+    void refresh(void) { setDirectory(m_directory); }
+
+    /**
+     * \brief Set the number of rows that are added at a time
+     */
+    void setBatchSize(int rows) { m_batchSize = qMax(1, rows); }
+
+    /**
+     * \brief Retrieve the path of the file for an item
+     */
+    QString filePath(const QModelIndex& index) const;
+
+    /**
+     * \brief Retrieve the number of rows in the model
+     */
+    virtual int rowCount(
+        const QModelIndex& parent = QModelIndex()) const override;
+
+    /**
+     * \brief Retrieve data for a given item and role in the model
+     */
+    virtual QVariant data(
+        const QModelIndex& index
+        , int role = Qt::DisplayRole) const override;
+
+    signals:
+
+    /**
+     * \brief Signal that all the rows for a directory have been added
+     * 
+     * \param path The path of the directory
+     */
+    void directoryLoaded(const QString& path);
+
+    private:
+
+    /**
+     * \brief The files in a directory, sorted by name
+     */
+    struct Listing
+    {
+        api::path_table paths;              ///< The paths of the files
+        std::vector<quint64> sizes;         ///< The sizes of the files
+        QString error;                      ///< Why it couldn't be read
+    };  // end Listing struct
+
+    /**
+     * \brief Read a directory (in a worker thread)
+     */
+    static std::shared_ptr<const Listing> list(const QString& directory);
+
+    /**
+     * \brief Take delivery of a listing (in the GUI thread)
+     * 
+     * \param ticket The ticket of the listing's request; listings for
+     * superseded requests are discarded
+     */
+    void onListed(quint64 ticket, std::shared_ptr<const Listing> listing);
+
+    /**
+     * \brief Add the next batch of rows from the listing
+     */
+    void insertBatch(void);
+
+    QString m_directory;    ///< The directory being shown
+
+    /**
+     * \brief The listing of the directory; null until it has been read
+     */
+    std::shared_ptr<const Listing> m_listing;
+
+    int m_rows;             ///< The number of rows added so far
+    int m_batchSize;        ///< The number of rows added at a time
+    quint64 m_lastTicket;   ///< The ticket of the latest request
+    QTimer* m_batchTmr;     ///< Schedules the next batch of rows
+    QElapsedTimer m_timer;  ///< Times the listing, for logging
+    QIcon m_fileIcon;       ///< The icon for every file, until replaced
+
+    /**
+     * \brief The thread that reads directories
+     * 
+     * This is declared last, so that it is destroyed first, waiting for any
+     * running work while the rest of the object is still intact.
+     */
+    QThreadPool m_pool;
+
+};  // end FileListModel class
+
+#endif
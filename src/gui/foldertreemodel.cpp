@@ -0,0 +1,711 @@
+/**
+ * \file foldertreemodel.cpp
+ * Implement the `FolderTreeModel` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <exception>
+
+#include <QDir>
+#include <QFileIconProvider>
+#include <QFileInfo>
+#include <QFileSystemModel>
+#include <QLocale>
+#include <QStringList>
+#include <QtConcurrent>
+
+#include <api/scanner.h>
+
+#include "foldertreemodel.h"
+#include "logging.h"
+
+FolderTreeModel::FolderTreeModel(
+        std::shared_ptr<api::media_index> index
+        , QObject* parent) :
+    QAbstractItemModel(parent)
+    , m_index(std::move(index))
+    , m_root(new Node)
+    , m_nodes()
+    , m_revealPath()
+    , m_lastTicket(0)
+    , m_indexGeneration(0)
+    , m_refreshTicket(0)
+    , m_indexTmr(new QTimer(this))
+    , m_refreshTmr(new QTimer(this))
+    , m_collator()
+    , m_folderIcon(QFileIconProvider().icon(QFileIconProvider::Folder))
+    , m_pool()
+{
+    m_collator.setNumericMode(true);
+    m_collator.setCaseSensitivity(Qt::CaseInsensitive);
+
+    // Reading folders is mostly waiting for the file system, so a couple of
+    // threads are plenty
+    m_pool.setMaxThreadCount(2);
+
+    // Checking the index for changes only takes its lock, so it can be done
+    // often
+    m_indexTmr->setInterval(1000);
+    connect(
+        m_indexTmr
+        , &QTimer::timeout
+        , this
+        , &FolderTreeModel::onIndexTimer);
+    if (m_index)
+    {
+        m_indexGeneration = m_index->generation();
+        m_indexTmr->start();
+    }
+
+    m_refreshTmr->setInterval(60 * 1000);
+    connect(
+        m_refreshTmr
+        , &QTimer::timeout
+        , this
+        , &FolderTreeModel::refresh);
+    m_refreshTmr->start();
+}
+
+FolderTreeModel::~FolderTreeModel(void)
+{
+    // Nothing that is still queued is wanted any more
+    m_pool.clear();
+    m_pool.waitForDone();
+}   // end destructor
+
+void FolderTreeModel::setRootPath(const QString& path)
+{
+    beginResetModel();
+    m_root.reset(new Node);
+    m_root->path = QDir::cleanPath(path);
+    m_root->name = m_root->path;
+    m_nodes.clear();
+    m_nodes.insert(m_root->path, m_root.get());
+    m_revealPath.clear();
+    endResetModel();
+
+    fetchMore(QModelIndex());
+}   // end setRootPath method
+
+QString FolderTreeModel::rootPath(void) const
+{
+    return m_root->path;
+}   // end rootPath method
+
+QModelIndex FolderTreeModel::index(const QString& path, int column) const
+{
+    auto node = m_nodes.value(QDir::cleanPath(path), nullptr);
+    return node ? indexFor(node, column) : QModelIndex();
+}   // end index method
+
+QString FolderTreeModel::filePath(const QModelIndex& index) const
+{
+    return index.isValid() ? nodeFor(index)->path : QString();
+}   // end filePath method
+
+void FolderTreeModel::revealPath(const QString& path)
+{
+    m_revealPath = QDir::cleanPath(path);
+    continueReveal();
+}   // end revealPath method
+
+void FolderTreeModel::setRefreshInterval(int msec)
+{
+    if (msec <= 0) m_refreshTmr->stop();
+    else m_refreshTmr->start(msec);
+}   // end setRefreshInterval method
+
+int FolderTreeModel::refreshInterval(void) const
+{
+    return m_refreshTmr->isActive() ? m_refreshTmr->interval() : 0;
+}   // end refreshInterval method
+
+void FolderTreeModel::refresh(void)
+{
+    if (m_refreshTicket != 0) return;
+
+    std::vector<Node*> nodes;
+    for (auto node : m_nodes)
+        if (node->state == Node::Loaded) nodes.push_back(node);
+
+    if (!nodes.empty()) m_refreshTicket = load(nodes, false, true);
+}   // end refresh method
+
+QModelIndex FolderTreeModel::index(
+        int row
+        , int column
+        , const QModelIndex& parent) const
+{
+    auto node = nodeFor(parent);
+    if (row < 0
+            || row >= static_cast<int>(node->children.size())
+            || column < 0
+            || column >= ColumnCount)
+        return QModelIndex();
+
+    return createIndex(row, column, node->children[row].get());
+}   // end index method
+
+QModelIndex FolderTreeModel::parent(const QModelIndex& child) const
+{
+    if (!child.isValid()) return QModelIndex();
+    return indexFor(nodeFor(child)->parent);
+}   // end parent method
+
+int FolderTreeModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.column() > 0) return 0;
+    return static_cast<int>(nodeFor(parent)->children.size());
+}   // end rowCount method
+
+int FolderTreeModel::columnCount(const QModelIndex& parent) const
+{
+    Q_UNUSED(parent);
+    return ColumnCount;
+}   // end columnCount method
+
+bool FolderTreeModel::hasChildren(const QModelIndex& parent) const
+{
+    if (parent.column() > 0) return false;
+
+    // Until a folder is loaded, its totals tell whether it has sub-folders,
+    // so that views don't offer to expand every folder
+    auto node = nodeFor(parent);
+    if (!node->children.empty()) return true;
+    return node->state != Node::Loaded && node->summary.hasChildren;
+}   // end hasChildren method
+
+bool FolderTreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    auto node = nodeFor(parent);
+    return node->state == Node::Unloaded && !node->path.isEmpty();
+}   // end canFetchMore method
+
+void FolderTreeModel::fetchMore(const QModelIndex& parent)
+{
+    if (!canFetchMore(parent)) return;
+
+    auto node = nodeFor(parent);
+    node->state = Node::Loading;
+    load({node}, true, true);
+}   // end fetchMore method
+
+QVariant FolderTreeModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+
+    auto node = nodeFor(index);
+    const auto& s = node->summary;
+    QLocale locale;
+
+    // Totals that leave out some folders are only a lower bound
+    QString more = s.unread > 0 ? "+" : "";
+
+    switch (role)
+    {
+        case Qt::DisplayRole:
+            switch (index.column())
+            {
+                case NameColumn:
+                    return node->name;
+
+                case FilesColumn:
+                    if (!s.known) return QString();
+                    return locale.toString(s.treeFiles) + more;
+
+                case SizeColumn:
+                    if (!s.known) return QString();
+                    return locale.formattedDataSize(
+                        static_cast<qint64>(s.treeBytes)) + more;
+
+                default:
+                    return QVariant();
+            }
+
+        // This is also the file icon role
+        case Qt::DecorationRole:
+            if (index.column() != NameColumn) return QVariant();
+            return m_folderIcon;
+
+        case Qt::TextAlignmentRole:
+            if (index.column() == NameColumn) return QVariant();
+            return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+
+        case Qt::ToolTipRole:
+        {
+            if (!s.known) return node->path + "\n" + tr("Not read yet");
+
+            QString tip = tr("%1\n%2 media files here (%3)\n%4 in all (%5)")
+                .arg(node->path)
+                .arg(locale.toString(s.files))
+                .arg(locale.formattedDataSize(static_cast<qint64>(s.bytes)))
+                .arg(locale.toString(s.treeFiles))
+                .arg(locale.formattedDataSize(
+                    static_cast<qint64>(s.treeBytes)));
+            if (s.unread > 0)
+                tip += tr("\n%1 folders below not counted yet").arg(
+                    locale.toString(s.unread));
+            return tip;
+        }
+
+        case QFileSystemModel::FilePathRole:
+            return node->path;
+
+        case QFileSystemModel::FileNameRole:
+            return node->name;
+
+        default:
+            return QVariant();
+    }
+}   // end data method
+
+QVariant FolderTreeModel::headerData(
+        int section
+        , Qt::Orientation orientation
+        , int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractItemModel::headerData(section, orientation, role);
+
+    switch (section)
+    {
+        case NameColumn: return tr("Name");
+        case FilesColumn: return tr("Files");
+        case SizeColumn: return tr("Size");
+        default: return QVariant();
+    }
+}   // end headerData method
+
+bool FolderTreeModel::Summary::operator==(const Summary& other) const
+{
+    return known == other.known
+        && hasChildren == other.hasChildren
+        && files == other.files
+        && bytes == other.bytes
+        && treeFiles == other.treeFiles
+        && treeBytes == other.treeBytes
+        && unread == other.unread;
+}   // end Summary::operator== method
+
+std::shared_ptr<const FolderTreeModel::Listing> FolderTreeModel::list(
+        const std::shared_ptr<api::media_index>& index
+        , const QString& path
+        , bool readDisk)
+{
+    auto listing = std::make_shared<Listing>();
+    listing->path = path;
+
+    api::scanner::options options;
+    options.threads = 1;
+    options.recursive = false;
+
+    auto fromIndex = [](const api::directory_summary& s)
+    {
+        Summary summary;
+        summary.known = s.mtime >= 0;
+        summary.hasChildren = s.mtime < 0 || !s.subdirectories.empty();
+        summary.files = s.files;
+        summary.bytes = s.bytes;
+        summary.treeFiles = s.tree_files;
+        summary.treeBytes = s.tree_bytes;
+        summary.unread = s.unread_directories;
+        return summary;
+    };
+
+    auto directory = path.toStdString();
+    std::vector<std::string> subdirectories;
+    try
+    {
+        if (readDisk && !QFileInfo(path).isDir())
+        {
+            // The index forgets a folder that has gone, and everything that
+            // was below it
+            if (index) index->refresh({directory}, options);
+            listing->exists = false;
+            return listing;
+        }
+
+        if (index)
+        {
+            // A folder that hasn't changed costs a single `stat`
+            if (readDisk) index->rescan(directory, options);
+
+            api::directory_summary s;
+            if (!index->summarise(directory, s) || s.mtime < 0)
+            {
+                if (readDisk) listing->error = "not in the media index";
+                return listing;
+            }
+
+            listing->summary = fromIndex(s);
+            subdirectories = std::move(s.subdirectories);
+        }
+        else if (readDisk)
+            readFolder(directory, listing->summary, subdirectories);
+        else
+            return listing;
+    }
+    catch (const std::exception& err)
+    {
+        listing->error = err.what();
+        return listing;
+    }
+
+    listing->complete = true;
+    listing->children.reserve(subdirectories.size());
+    for (const auto& sub : subdirectories)
+    {
+        Entry e;
+        e.path = QString::fromStdString(sub);
+        e.name = e.path.mid(e.path.lastIndexOf('/') + 1);
+
+        // Each sub-folder is read too, for its totals and to tell whether
+        // it has sub-folders of its own
+        try
+        {
+            if (index)
+            {
+                if (readDisk) index->rescan(sub, options);
+
+                api::directory_summary s;
+                if (index->summarise(sub, s)) e.summary = fromIndex(s);
+            }
+            else
+            {
+                std::vector<std::string> ignored;
+                readFolder(sub, e.summary, ignored);
+            }
+        }
+        catch (const std::exception&)
+        {
+            // A sub-folder that can't be read is still listed, without
+            // totals
+        }
+
+        listing->children.push_back(std::move(e));
+    }
+
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::sort(
+        listing->children.begin()
+        , listing->children.end()
+        , [&collator](const Entry& a, const Entry& b)
+            { return nameLess(collator, a.name, b.name); });
+
+    return listing;
+}   // end list method
+
+void FolderTreeModel::readFolder(
+        const std::string& path
+        , Summary& summary
+        , std::vector<std::string>& subdirectories)
+{
+    api::scanner::options options;
+    options.threads = 1;
+    options.recursive = false;
+
+    summary = Summary();
+    api::scanner(options).scan(
+        path
+        , api::scanner::directory_filter()
+        , [&summary, &subdirectories](api::directory_listing&& listing)
+        {
+            for (const auto& f : listing.files)
+            {
+                ++summary.files;
+                summary.bytes += f.size;
+            }
+            subdirectories = std::move(listing.subdirectories);
+        });
+
+    // The folders below aren't counted without an index
+    summary.known = true;
+    summary.hasChildren = !subdirectories.empty();
+    summary.treeFiles = summary.files;
+    summary.treeBytes = summary.bytes;
+    summary.unread = subdirectories.size();
+}   // end readFolder method
+
+bool FolderTreeModel::nameLess(
+        const QCollator& collator
+        , const QString& a
+        , const QString& b)
+{
+    // Names that only differ in case still need an order
+    int result = collator.compare(a, b);
+    return result != 0 ? result < 0 : a < b;
+}   // end nameLess method
+
+quint64 FolderTreeModel::load(
+        const std::vector<Node*>& nodes
+        , bool fromIndex
+        , bool readDisk)
+{
+    // A listing is only taken for a folder if it answers the folder's
+    // latest request
+    quint64 ticket = ++m_lastTicket;
+    QStringList paths;
+    for (auto node : nodes)
+    {
+        node->ticket = ticket;
+        paths.push_back(node->path);
+    }
+
+    auto index = m_index;
+    QtConcurrent::run(
+        &m_pool
+        , [this, ticket, paths, index, fromIndex, readDisk]{
+            auto deliver = [this, ticket](
+                    std::shared_ptr<const Listing> listing)
+            {
+                QMetaObject::invokeMethod(
+                    this
+                    , [this, ticket, listing]{ onListed(ticket, listing); }
+                    , Qt::QueuedConnection);
+            };
+
+            for (const auto& path : paths)
+            {
+                // The index alone is quick, so what it knows is shown
+                // while the file system is read
+                if (fromIndex && index)
+                {
+                    auto listing = list(index, path, false);
+                    if (listing->complete) deliver(listing);
+                }
+
+                if (readDisk) deliver(list(index, path, true));
+            }
+
+            QMetaObject::invokeMethod(
+                this
+                , [this, ticket]{
+                    if (ticket == m_refreshTicket) m_refreshTicket = 0;
+                }
+                , Qt::QueuedConnection);
+        });
+
+    return ticket;
+}   // end load method
+
+void FolderTreeModel::onListed(
+        quint64 ticket
+        , std::shared_ptr<const Listing> listing)
+{
+    auto node = m_nodes.value(listing->path, nullptr);
+    if (!node || node->ticket != ticket) return;
+
+    if (!listing->exists)
+    {
+        if (node->parent) removeChildren(node->parent, node->row, node->row);
+        else
+        {
+            if (!node->children.empty())
+                removeChildren(
+                    node
+                    , 0
+                    , static_cast<int>(node->children.size()) - 1);
+            node->state = Node::Loaded;
+        }
+    }
+    else if (listing->complete) merge(node, *listing);
+    else if (!listing->error.isEmpty())
+    {
+        logging::warning(
+            "could not read folder \"" + listing->path + "\": "
+            + listing->error);
+
+        // A folder that can't be read is shown without sub-folders, rather
+        // than as loading for ever
+        if (node->state == Node::Loading)
+        {
+            node->state = Node::Loaded;
+            Summary summary = node->summary;
+            summary.hasChildren = false;
+            setSummary(node, summary);
+        }
+    }
+    else return;
+
+    continueReveal();
+}   // end onListed method
+
+void FolderTreeModel::onIndexTimer(void)
+{
+    auto generation = m_index->generation();
+    if (generation == m_indexGeneration) return;
+    m_indexGeneration = generation;
+
+    std::vector<Node*> nodes;
+    for (auto node : m_nodes)
+        if (node->state == Node::Loaded) nodes.push_back(node);
+
+    if (!nodes.empty()) load(nodes, true, false);
+}   // end onIndexTimer method
+
+void FolderTreeModel::continueReveal(void)
+{
+    if (m_revealPath.isEmpty()) return;
+
+    auto isBelow = [](const QString& path, const QString& directory)
+    {
+        return path.startsWith(
+            directory.endsWith('/') ? directory : directory + '/');
+    };
+
+    // Walk down from the root as far as the folders have been loaded
+    Node* node = m_root.get();
+    if (m_revealPath != node->path && !isBelow(m_revealPath, node->path))
+    {
+        m_revealPath.clear();
+        return;
+    }
+
+    while (node->path != m_revealPath)
+    {
+        if (node->state != Node::Loaded)
+        {
+            fetchMore(indexFor(node));
+            return;
+        }
+
+        Node* next = nullptr;
+        for (const auto& child : node->children)
+            if (m_revealPath == child->path
+                    || isBelow(m_revealPath, child->path))
+            {
+                next = child.get();
+                break;
+            }
+
+        // The folder doesn't exist
+        if (!next)
+        {
+            m_revealPath.clear();
+            return;
+        }
+
+        node = next;
+    }
+
+    QString path = m_revealPath;
+    m_revealPath.clear();
+    if (node->parent) emit pathRevealed(path);
+}   // end continueReveal method
+
+void FolderTreeModel::merge(Node* node, const Listing& listing)
+{
+    node->state = Node::Loaded;
+    setSummary(node, listing.summary);
+
+    const auto& entries = listing.children;
+    auto parent = indexFor(node);
+    auto makeNode = [this, node](const Entry& e)
+    {
+        std::unique_ptr<Node> child(new Node);
+        child->path = e.path;
+        child->name = e.name;
+        child->parent = node;
+        child->summary = e.summary;
+        m_nodes.insert(child->path, child.get());
+        return child;
+    };
+
+    // The first listing of a folder is added all at once
+    if (node->children.empty())
+    {
+        if (entries.empty()) return;
+
+        beginInsertRows(parent, 0, static_cast<int>(entries.size()) - 1);
+        for (const auto& e : entries) node->children.push_back(makeNode(e));
+        renumber(node, 0);
+        endInsertRows();
+        return;
+    }
+
+    // Both lists are sorted by name, so they are merged in one pass
+    int row = 0;
+    for (const auto& e : entries)
+    {
+        // Sub-folders that sort before this one have gone
+        int gone = row;
+        while (gone < static_cast<int>(node->children.size())
+                && nameLess(m_collator, node->children[gone]->name, e.name))
+            ++gone;
+        if (gone > row) removeChildren(node, row, gone - 1);
+
+        if (row < static_cast<int>(node->children.size())
+                && node->children[row]->path == e.path)
+            setSummary(node->children[row].get(), e.summary);
+        else
+        {
+            beginInsertRows(parent, row, row);
+            node->children.insert(node->children.begin() + row, makeNode(e));
+            renumber(node, row);
+            endInsertRows();
+        }
+
+        ++row;
+    }
+
+    if (row < static_cast<int>(node->children.size()))
+        removeChildren(
+            node
+            , row
+            , static_cast<int>(node->children.size()) - 1);
+}   // end merge method
+
+void FolderTreeModel::setSummary(Node* node, const Summary& summary)
+{
+    if (node->summary == summary) return;
+
+    node->summary = summary;
+    if (node->parent)
+        emit dataChanged(
+            indexFor(node, NameColumn)
+            , indexFor(node, SizeColumn));
+}   // end setSummary method
+
+void FolderTreeModel::removeChildren(Node* node, int first, int last)
+{
+    beginRemoveRows(indexFor(node), first, last);
+    for (int i = first; i <= last; ++i) forget(node->children[i].get());
+    node->children.erase(
+        node->children.begin() + first
+        , node->children.begin() + last + 1);
+    renumber(node, first);
+    endRemoveRows();
+}   // end removeChildren method
+
+void FolderTreeModel::forget(Node* node)
+{
+    m_nodes.remove(node->path);
+    for (const auto& child : node->children) forget(child.get());
+}   // end forget method
+
+void FolderTreeModel::renumber(Node* node, int first)
+{
+    for (int i = first; i < static_cast<int>(node->children.size()); ++i)
+        node->children[i]->row = i;
+}   // end renumber method
+
+FolderTreeModel::Node* FolderTreeModel::nodeFor(
+        const QModelIndex& index) const
+{
+    if (!index.isValid()) return m_root.get();
+    return static_cast<Node*>(index.internalPointer());
+}   // end nodeFor method
+
+QModelIndex FolderTreeModel::indexFor(const Node* node, int column) const
+{
+    if (!node || !node->parent) return QModelIndex();
+    return createIndex(node->row, column, const_cast<Node*>(node));
+}   // end indexFor method
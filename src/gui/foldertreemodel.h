@@ -0,0 +1,423 @@
+/**
+ * \file foldertreemodel.h
+ * Declare the `FolderTreeModel` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <memory>
+#include <vector>
+
+#include <QAbstractItemModel>
+#include <QCollator>
+#include <QHash>
+#include <QIcon>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <api/media_index.h>
+
+#ifndef _gui_foldertreemodel_h_installed
+#define _gui_foldertreemodel_h_installed
+
+/**
+ * \brief A tree model of the folders below a root folder, fed from the
+ * media index
+ * 
+ * This takes the place of a `QFileSystemModel` for the folder tree, which
+ * reads each folder in the GUI thread as it is expanded, and so stalls on
+ * network mounts and in deep trees.
+ * 
+ * Instead, the children of a folder are loaded lazily (when a view asks
+ * for them, with `fetchMore`), and always in the background: first from
+ * the persistent `api::media_index`, which needs no file system access at
+ * all, and then from the file system, by an incremental, non-recursive
+ * rescan of the folder and each of its children (which costs a single
+ * `stat` for each folder that hasn't changed). The rescan brings the index
+ * up to date as it goes, so folders that have been browsed once show up
+ * straight away the next time.
+ * 
+ * Each folder shows the number and total size of the media files in it and
+ * below it. These come from the totals that the index keeps for each
+ * directory, which it adjusts as files and directories come and go, so
+ * they cost the same for a folder at the top of a huge tree as for one at
+ * the bottom. Totals that don't yet take in every folder below are shown
+ * with a `+`.
+ * 
+ * The folders that have been loaded are kept up to date in the background:
+ * from the index whenever it changes (e.g. when it is rescanned for
+ * searching), and from the file system every `refreshInterval`.
+ * 
+ * If there is no index, the folders are read from the file system, and
+ * only the files directly in each folder are counted.
+ * 
+ * Column 0 holds the folder names; columns 1 and 2 the file counts and
+ * sizes. Like a `QFileSystemModel`, the model gives the path of a folder for
+ * the `QFileSystemModel::FilePathRole`.
+ */
+class FolderTreeModel : public QAbstractItemModel
+{
+
+    Q_OBJECT
+
+    public:
+
+    /**
+     * \brief The columns of the model
+     */
+    enum Column
+    {
+        NameColumn = 0,     ///< The folder name
+        FilesColumn,        ///< The number of media files
+        SizeColumn,         ///< The total size of the media files
+        ColumnCount         ///< The number of columns
+    };
+
+    /**
+     * \brief Constructor
+     * 
+     * \param index The media index to load folders from; this may be null
+     * 
+     * \param parent The parent of the object
+     */
+    explicit FolderTreeModel(
+        std::shared_ptr<api::media_index> index
+        , QObject* parent = nullptr);
+
+    /**
+     * \brief Destructor, waiting for any folders being read
+     */
+    virtual ~FolderTreeModel(void);
+
+    /**
+     * \brief Show the folders below a root folder
+     * 
+     * The model is emptied straight away, and the top-level folders are
+     * added once they have been loaded in the background.
+     */
+    void setRootPath(const QString& path);
+
+    /**
+     * \brief Retrieve the path of the root folder
+     */
+    QString rootPath(void) const;
+
+    /**
+     * \brief Retrieve the index of a folder, if it has been loaded
+     * 
+     * \return The index of the folder, or an invalid index if it hasn't
+     * been loaded (see `revealPath`)
+     */
+    QModelIndex index(const QString& path, int column = 0) const;
+
+    /**
+     * \brief Retrieve the path of the folder for an item
+     */
+    QString filePath(const QModelIndex& index) const;
+
+    /**
+     * \brief Load the folders leading down to a folder
+     * 
+     * The folders are loaded in the background, and `pathRevealed` is
+     * emitted once the folder has an index. If a folder on the way is
+     * found not to exist, nothing is emitted.
+     */
+    void revealPath(const QString& path);
+
+    /**
+     * \brief Set the interval between background reads of the loaded
+     * folders from the file system; 0 turns them off
+     */
+    void setRefreshInterval(int msec);
+
+    /**
+     * \brief Retrieve the interval between background reads of the loaded
+     * folders from the file system
+     */
+    int refreshInterval(void) const;
+
+    /**
+     * \brief Read all the loaded folders from the file system again (in
+     * the background)
+     */
+    void refresh(void);
+
+    // - QAbstractItemModel -
+
+    virtual QModelIndex index(
+        int row
+        , int column
+        , const QModelIndex& parent = QModelIndex()) const override;
+
+    virtual QModelIndex parent(const QModelIndex& child) const override;
+
+    virtual int rowCount(
+        const QModelIndex& parent = QModelIndex()) const override;
+
+    virtual int columnCount(
+        const QModelIndex& parent = QModelIndex()) const override;
+
+    virtual bool hasChildren(
+        const QModelIndex& parent = QModelIndex()) const override;
+
+    virtual bool canFetchMore(const QModelIndex& parent) const override;
+
+    virtual void fetchMore(const QModelIndex& parent) override;
+
+    virtual QVariant data(
+        const QModelIndex& index
+        , int role = Qt::DisplayRole) const override;
+
+    virtual QVariant headerData(
+        int section
+        , Qt::Orientation orientation
+        , int role = Qt::DisplayRole) const override;
+
+    signals:
+
+    /**
+     * \brief Signal that a folder asked for with `revealPath` has been
+     * loaded, and has an index
+     */
+    void pathRevealed(const QString& path);
+
+    private:
+
+    /**
+     * \brief The totals for a folder
+     */
+    struct Summary
+    {
+        bool known = false;         ///< Whether the folder has been read
+        bool hasChildren = true;    ///< Whether it may have sub-folders
+        quint64 files = 0;          ///< Media files directly in the folder
+        quint64 bytes = 0;          ///< Their total size
+        quint64 treeFiles = 0;      ///< Media files in it and below it
+        quint64 treeBytes = 0;      ///< Their total size
+
+        /**
+         * \brief The number of folders below (or including) this one that
+         * aren't in the totals
+         */
+        quint64 unread = 0;
+
+        bool operator==(const Summary& other) const;
+        bool operator!=(const Summary& other) const
+            { return !(*this == other); }
+    };  // end Summary struct
+
+    /**
+     * \brief A sub-folder in a listing
+     */
+    struct Entry
+    {
+        QString path;               ///< The full path of the sub-folder
+        QString name;               ///< The name of the sub-folder
+        Summary summary;            ///< Its totals
+    };  // end Entry struct
+
+    /**
+     * \brief A folder and its sub-folders, sorted by name
+     */
+    struct Listing
+    {
+        QString path;               ///< The full path of the folder
+        bool exists = true;         ///< Whether the folder still exists
+
+        /**
+         * \brief Whether the listing holds anything; listings from the
+         * index are empty for folders that it hasn't read
+         */
+        bool complete = false;
+
+        Summary summary;            ///< The folder's totals
+        std::vector<Entry> children;    ///< The sub-folders
+        QString error;              ///< Why the folder couldn't be read
+    };  // end Listing struct
+
+    /**
+     * \brief A folder in the tree
+     */
+    struct Node
+    {
+        /**
+         * \brief Whether the sub-folders have been loaded
+         */
+        enum State { Unloaded, Loading, Loaded };
+
+        QString path;               ///< The full path of the folder
+        QString name;               ///< The name of the folder
+        Node* parent = nullptr;     ///< The parent; null for the root
+        int row = 0;                ///< The row within the parent
+        State state = Unloaded;     ///< Whether the children are loaded
+        Summary summary;            ///< The folder's totals
+
+        /**
+         * \brief The ticket of the latest request to load the folder;
+         * listings for other requests are discarded
+         */
+        quint64 ticket = 0;
+
+        /**
+         * \brief The sub-folders, sorted by name
+         */
+        std::vector<std::unique_ptr<Node>> children;
+    };  // end Node struct
+
+    /**
+     * \brief Load a folder (in a worker thread)
+     * 
+     * \param index The index to load from; this may be null
+     * 
+     * \param path The path of the folder
+     * 
+     * \param readDisk Whether to read the folder and its sub-folders from
+     * the file system (bringing the index up to date), or to take it from
+     * the index alone
+     */
+    static std::shared_ptr<const Listing> list(
+        const std::shared_ptr<api::media_index>& index
+        , const QString& path
+        , bool readDisk);
+
+    /**
+     * \brief Read a folder from the file system alone, counting only the
+     * files directly in it (in a worker thread)
+     * 
+     * \param path The path of the folder
+     * 
+     * \param summary Set to the folder's totals
+     * 
+     * \param subdirectories Set to the paths of its sub-folders
+     * 
+     * \throw api::error The folder couldn't be read
+     */
+    static void readFolder(
+        const std::string& path
+        , Summary& summary
+        , std::vector<std::string>& subdirectories);
+
+    /**
+     * \brief Compare folder names as a file manager would
+     */
+    static bool nameLess(
+        const QCollator& collator
+        , const QString& a
+        , const QString& b);
+
+    /**
+     * \brief Load folders in the background, delivering a listing for
+     * each to `onListed`
+     * 
+     * \param nodes The folders
+     * 
+     * \param fromIndex Whether to deliver a listing from the index first
+     * 
+     * \param readDisk Whether to read the folders from the file system
+     * 
+     * \return The ticket of the request
+     */
+    quint64 load(
+        const std::vector<Node*>& nodes
+        , bool fromIndex
+        , bool readDisk);
+
+    /**
+     * \brief Take delivery of a listing (in the GUI thread)
+     * 
+     * \param ticket The ticket of the listing's request
+     */
+    void onListed(quint64 ticket, std::shared_ptr<const Listing> listing);
+
+    /**
+     * \brief Check whether the index has changed, and if so, load the
+     * loaded folders from it again
+     */
+    void onIndexTimer(void);
+
+    /**
+     * \brief Continue loading the folders towards `m_revealPath`
+     */
+    void continueReveal(void);
+
+    /**
+     * \brief Bring a folder's sub-folders into line with a listing,
+     * inserting, removing and updating rows
+     */
+    void merge(Node* node, const Listing& listing);
+
+    /**
+     * \brief Set the totals for a folder, reporting any change
+     */
+    void setSummary(Node* node, const Summary& summary);
+
+    /**
+     * \brief Remove some of a folder's sub-folders
+     */
+    void removeChildren(Node* node, int first, int last);
+
+    /**
+     * \brief Forget a folder and everything below it
+     */
+    void forget(Node* node);
+
+    /**
+     * \brief Number the rows of a folder's sub-folders, from a given row
+     */
+    static void renumber(Node* node, int first);
+
+    /**
+     * \brief Retrieve the node for an index; the root node for an invalid
+     * index
+     */
+    Node* nodeFor(const QModelIndex& index) const;
+
+    /**
+     * \brief Retrieve the index for a node
+     */
+    QModelIndex indexFor(const Node* node, int column = 0) const;
+
+    /**
+     * \brief The media index; null if there isn't one
+     */
+    std::shared_ptr<api::media_index> m_index;
+
+    std::unique_ptr<Node> m_root;   ///< The root folder
+
+    /**
+     * \brief The folders in the tree, keyed on path
+     */
+    QHash<QString, Node*> m_nodes;
+
+    QString m_revealPath;           ///< Folder to emit `pathRevealed` for
+    quint64 m_lastTicket;           ///< Ticket of the latest request
+    quint64 m_indexGeneration;      ///< Index generation last loaded from
+
+    /**
+     * \brief The ticket of the running refresh from the file system; 0 if
+     * there isn't one, so that they don't pile up on a slow file system
+     */
+    quint64 m_refreshTicket;
+
+    QTimer* m_indexTmr;             ///< Checks the index for changes
+    QTimer* m_refreshTmr;           ///< Schedules refreshes from the disk
+    QCollator m_collator;           ///< Orders folder names
+    QIcon m_folderIcon;             ///< The icon for every folder
+
+    /**
+     * \brief The threads that load folders, so that a slow file system
+     * doesn't hold up the application's other background work
+     * 
+     * This is declared last, so that it is destroyed first, waiting for any
+     * running work while the rest of the object is still intact.
+     */
+    QThreadPool m_pool;
+
+};  // end FolderTreeModel class
+
+#endif
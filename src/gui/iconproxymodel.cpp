@@ -9,20 +9,75 @@
  * or copy at https://www.boost.org/LICENSE_1_0.txt
  */
 
+#include <algorithm>
+
 #include <QFileSystemModel>
+#include <QHash>
 #include <QPixmap>
 
 #include "iconproxymodel.h"
+#include "thumbnail.h"
 
 IconProxyModel::IconProxyModel(QObject* parent) :
         QIdentityProxyModel(parent)
-        , m_iconMap()
+        , m_iconCache(256 * 1024)
+        , m_pendingRows()
+        , m_thumbnailSize(150, 150)
+        , m_thumbnailStore()
+        , m_scheduler(new ThumbnailScheduler(this))
+        , m_changedIndexes()
+        , m_changedTmr(new QTimer(this))
+        , m_decodesStarted(0)
+        , m_decodesSaved(0)
 {
+    updateLoader();
+
     connect(
-        this
-        , &IconProxyModel::hasIcon
+        m_scheduler
+        , &ThumbnailScheduler::loaded
         , this
         , &IconProxyModel::onIcon);
+
+    connect(
+        m_scheduler
+        , &ThumbnailScheduler::dropped
+        , this
+        , &IconProxyModel::onDropped);
+
+    // Setting a new source model resets this one
+    connect(
+        this
+        , &QAbstractItemModel::modelReset
+        , this
+        , &IconProxyModel::forgetIcons);
+    connect(
+        this
+        , &QAbstractItemModel::rowsRemoved
+        , this
+        , &IconProxyModel::forgetIcons);
+    connect(
+        this
+        , &QAbstractItemModel::rowsMoved
+        , this
+        , &IconProxyModel::forgetIcons);
+    connect(
+        this
+        , &QAbstractItemModel::layoutChanged
+        , this
+        , &IconProxyModel::forgetIcons);
+    connect(
+        this
+        , &QAbstractItemModel::rowsInserted
+        , this
+        , &IconProxyModel::onRowsInserted);
+
+    m_changedTmr->setSingleShot(true);
+    m_changedTmr->setInterval(16);
+    connect(
+        m_changedTmr
+        , &QTimer::timeout
+        , this
+        , &IconProxyModel::flushIconChanges);
 }
 
 QVariant IconProxyModel::data(const QModelIndex & index, int role) const
@@ -30,43 +85,172 @@ QVariant IconProxyModel::data(const QModelIndex & index, int role) const
     // Only substitute an Icon when a File Icon is requested
     if (role == QFileSystemModel::FileIconRole)
     {
-        // Grab the path data, and if we already have an icon for this file
-        // in our map, return that one.
-        auto path = index.data(QFileSystemModel::FilePathRole).toString();
-        auto it = m_iconMap.find(path);
+        // If we already have an icon for this row in our cache, return
+        // that one. Otherwise, a load is scheduled (if there isn't one
+        // already), and we return an empty variant for now. When the image
+        // icon has been loaded, `onIcon` will be called.
+        auto icon = requestIcon(index);
 
-        if (it != m_iconMap.end())
+        if (icon)
         {
-            if (! it->isNull()) return *it;
+            if (! icon->isNull()) return *icon;
             return QIdentityProxyModel::data(index, role);
         }
-        else
-        {
-            // We don't have the icon in our map, so load it asynchronously.
-            // For now, we return an empty variant. When the image icon has
-            // been loaded, `hasIcon` will be emitted.
-            QPersistentModelIndex pIndex{index};
-            QtConcurrent::run([this,path,pIndex]{
-                emit hasIcon(
-                    path
-                    , QIcon(QPixmap(path))
-                    , pIndex);
-            });
-
-            return QVariant{};
-        }
+        else return QVariant{};
     }
     else return QIdentityProxyModel::data(index, role);
 }   // end data method
 
+void IconProxyModel::setThumbnailSize(const QSize& size)
+{
+    m_thumbnailSize = size;
+    updateLoader();
+}   // end setThumbnailSize method
+
+void IconProxyModel::setThumbnailStore(
+        std::shared_ptr<api::thumbnail_store> store)
+{
+    m_thumbnailStore = std::move(store);
+    updateLoader();
+}   // end setThumbnailStore method
+
+void IconProxyModel::setVisibleRange(
+        const QModelIndex& first
+        , const QModelIndex& last)
+{
+    m_scheduler->setViewport(first, last);
+    if (!first.isValid() || !last.isValid()) return;
+
+    // Prefetch the items either side of the visible ones
+    auto parent = first.parent();
+    int band = m_scheduler->prefetchRows()
+        , begin = qMax(0, qMin(first.row(), last.row()) - band)
+        , end = qMin(
+            rowCount(parent) - 1
+            , qMax(first.row(), last.row()) + band);
+
+    for (int row = begin; row <= end; ++row)
+        if (!m_pendingRows.contains(row)) requestIcon(index(row, 0, parent));
+}   // end setVisibleRange method
+
+void IconProxyModel::cancelPendingLoads(void)
+{
+    m_scheduler->cancelAll();
+    m_pendingRows.clear();
+}   // end cancelPendingLoads method
+
+QIcon* IconProxyModel::requestIcon(const QModelIndex& index) const
+{
+    int row = index.row();
+    auto icon = m_iconCache.object(row);
+    if (icon) return icon;
+
+    if (m_pendingRows.contains(row))
+    {
+        // A load for this file has already been scheduled, and `onIcon`
+        // will refresh the view when it is done.
+        ++m_decodesSaved;
+        return nullptr;
+    }
+
+    m_pendingRows.insert(row);
+    ++m_decodesStarted;
+    m_scheduler->schedule(
+        index.data(QFileSystemModel::FilePathRole).toString()
+        , QPersistentModelIndex(index));
+
+    return nullptr;
+}   // end requestIcon method
+
+void IconProxyModel::updateLoader(void)
+{
+    QSize size = m_thumbnailSize;
+    auto store = m_thumbnailStore;
+    m_scheduler->setLoader(
+        [size, store](const QStringList& paths)
+            { return readThumbnails(paths, size, store.get()); }
+        , [size](const EncodedThumbnail& encoded)
+            { return decodeThumbnail(encoded, size); }
+        , [size, store](const DecodedThumbnail& decoded)
+            { return scaleThumbnail(decoded, size, store.get()); });
+}   // end updateLoader method
+
 void IconProxyModel::onIcon(
         const QString& path
-        , const QIcon& icon
+        , const QImage& image
+        , const QPersistentModelIndex& index)
+    {
+        Q_UNUSED(path);
+
+        // The item has gone, and so has everything cached for its row
+        if (!index.isValid()) return;
+
+        // The persistent index has followed the file to its current row
+        int row = index.row();
+        m_pendingRows.remove(row);
+
+        // A null image gives a null icon, which tells `data` to fall back
+        // to the source model's icon. Files that couldn't be read are
+        // dropped instead, so only those that aren't images get here.
+        if (image.isNull()) m_iconCache.insert(row, new QIcon(), 1);
+        else m_iconCache.insert(
+            row
+            , new QIcon(QPixmap::fromImage(image))
+            , qMax(1, static_cast<int>(image.sizeInBytes() / 1024)));
+
+        m_changedIndexes.append(index);
+        if (!m_changedTmr->isActive()) m_changedTmr->start();
+    }
+
+void IconProxyModel::onDropped(
+        const QString& path
         , const QPersistentModelIndex& index)
+{
+    Q_UNUSED(path);
+    if (index.isValid()) m_pendingRows.remove(index.row());
+}   // end onDropped method
+
+void IconProxyModel::forgetIcons(void)
+{
+    cancelPendingLoads();
+    m_iconCache.clear();
+}   // end forgetIcons method
+
+void IconProxyModel::onRowsInserted(
+        const QModelIndex& parent
+        , int first
+        , int last)
+{
+    Q_UNUSED(first);
+
+    // Rows appended at the end leave every other row where it was
+    if (last + 1 < rowCount(parent)) forgetIcons();
+}   // end onRowsInserted method
+
+void IconProxyModel::flushIconChanges(void)
+{
+    QHash<QPersistentModelIndex, QVector<int>> rowsByParent;
+    for (const auto& changed : m_changedIndexes)
+        if (changed.isValid())
+            rowsByParent[changed.parent()].append(changed.row());
+    m_changedIndexes.clear();
+
+    QVector<int> roles{QFileSystemModel::FileIconRole};
+    for (auto it = rowsByParent.begin(); it != rowsByParent.end(); ++it)
     {
-        m_iconMap.insert(path, icon);
-        emit dataChanged(
-            index
-            , index
-            , QVector<int>{QFileSystemModel::FileIconRole});
-    }        
+        QModelIndex parent = it.key();
+        auto& rows = it.value();
+        std::sort(rows.begin(), rows.end());
+
+        for (int i = 0; i < rows.size(); )
+        {
+            int first = rows[i], last = first;
+            while (++i < rows.size() && rows[i] <= last + 1) last = rows[i];
+
+            emit dataChanged(
+                index(first, 0, parent)
+                , index(last, 0, parent)
+                , roles);
+        }
+    }
+}   // end flushIconChanges method
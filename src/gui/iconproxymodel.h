@@ -9,11 +9,21 @@
  * or copy at https://www.boost.org/LICENSE_1_0.txt
  */
 
+#include <QCache>
 #include <QIcon>
+#include <QImage>
 #include <QIdentityProxyModel>
-#include <QMap>
 #include <QPersistentModelIndex>
-#include <QtConcurrent>
+#include <QSet>
+#include <QSize>
+#include <QTimer>
+#include <QVector>
+
+#include <memory>
+
+#include <api/thumbnail_store.h>
+
+#include "thumbnailscheduler.h"
 
 #ifndef _gui_iconproxymodel_h_installed
 #define _gui_iconproxymodel_h_installed
@@ -23,13 +33,50 @@
  * 
  * This proxy model substitutes an image icon (from an image file) when data
  * for the `QFileSystemModel::FileIconRole` is requested for a given file.
- * When an icon is requested for a given file path, an internal icon map is
+ * When an icon is requested for a given file path, an internal icon cache is
  * checked to see if an icon for that file has already been created. If so,
  * it is simply returned.
  * 
- * If not, a `QtConcurrent` background task is invoked to load the image and
- * make it into an icon. When this completes, the new icon is added to the
- * internal store ad the standard `dataChanged` signal is emitted.k
+ * If not, a background task is scheduled to load the image as a thumbnail
+ * of the size given by `setThumbnailSize` (see `readThumbnails`,
+ * `decodeThumbnail` and `scaleThumbnail`), and an empty variant is
+ * returned. When the task completes, the thumbnail is made into an icon,
+ * the new icon is added to the internal cache and the standard
+ * `dataChanged` signal is emitted.
+ * 
+ * The icon cache is a hashed, least-recently-used cache with a memory
+ * budget (see `setIconCacheBudget`), so icons for large folders can't
+ * exhaust memory.
+ * 
+ * If a persistent thumbnail store has been set (see `setThumbnailStore`),
+ * the background task looks there before decoding anything, and adds the
+ * thumbnails that it does decode, so they are available on the next run.
+ * 
+ * Background tasks are run by a `ThumbnailScheduler`, which loads icons for
+ * items on screen first, then for items just off screen, then everything
+ * else. The view should keep the model informed of which items are on
+ * screen by calling `setVisibleRange`; this also prefetches icons for the
+ * items just off screen.
+ * 
+ * Icons arrive from several threads at once, and each `dataChanged` signal
+ * makes the view lay out and repaint, so finished icons are collected and
+ * announced together once per frame (about 16 ms), with adjacent rows
+ * merged into a single `dataChanged` range.
+ * 
+ * Views query the icon role on every repaint, so the same file is usually
+ * requested many times before its first load has finished. Paths with a
+ * load in flight are recorded in a pending set, and repeated requests for
+ * them return an empty variant without starting another load. The
+ * `decodesStarted` and `decodesSaved` counters report how effective this
+ * is.
+ * 
+ * The cache and the pending set are keyed on the rows of the source model
+ * (which must be a list), rather than on paths, so a lookup neither copies
+ * nor hashes a path, and the only copy of each path is the source model's.
+ * Rows only stay with their files while the source model just appends
+ * rows, so when it is reset or replaced, or rows are removed, moved or
+ * inserted before others, the cache and the pending set are cleared, and
+ * outstanding loads are cancelled.
  */
 class IconProxyModel : public QIdentityProxyModel
 {
@@ -60,55 +107,237 @@ class IconProxyModel : public QIdentityProxyModel
             , int role) const override;
 
     /**
-     * \brief Clear the internal icon map
+     * \brief Clear the internal icon cache
+     * 
+     * This is not needed to limit memory use (the cache has a budget for
+     * that), but can be used to force icons to be reloaded.
+     */
+    void clearIconCache(void) { m_iconCache.clear(); }
+
+    /**
+     * \brief Set the memory budget for the internal icon cache
+     * 
+     * When the cache is full, the least recently used icons are discarded.
+     * 
+     * \param bytes The approximate maximum number of bytes of image data
+     * to hold in the cache
+     */
+    void setIconCacheBudget(qint64 bytes)
+        { m_iconCache.setMaxCost(static_cast<int>(bytes / 1024)); }
+
+    /**
+     * \brief Retrieve the approximate number of bytes of image data that are
+     * currently held in the icon cache
+     */
+    qint64 iconCacheUsage(void) const
+        { return qint64(m_iconCache.totalCost()) * 1024; }
+
+    /**
+     * \brief Set the size of the thumbnails that are loaded for icons
+     * 
+     * This should be the icon size of the view, so that images are decoded
+     * at no more than the resolution that is displayed. It only affects
+     * icons that are loaded after it is called.
+     * 
+     * \param size The size of the box that thumbnails must fit into
+     */
+    void setThumbnailSize(const QSize& size);
+
+    /**
+     * \brief Retrieve the size of the thumbnails that are loaded for icons
+     */
+    QSize thumbnailSize(void) const { return m_thumbnailSize; }
+
+    /**
+     * \brief Set the persistent store that is checked for thumbnails before
+     * they are decoded
      * 
-     * This can be called to prevent the internal icon store getting too big.
+     * \param store The thumbnail store; this may be null, in which case
+     * every thumbnail is decoded
+     */
+    void setThumbnailStore(std::shared_ptr<api::thumbnail_store> store);
+
+    /**
+     * \brief Set the maximum number of icons that may be loaded at once; 0
+     * (the default) leaves it to the room in the thumbnail pipeline
+     */
+    void setMaxConcurrentLoads(int maxLoads)
+        { m_scheduler->setMaxConcurrent(maxLoads); }
+
+    /**
+     * \brief Set the number of threads that read image files
+     */
+    void setIoThreads(int threads) { m_scheduler->setIoThreads(threads); }
+
+    /**
+     * \brief Set the number of threads that decode images; 0 means one per
+     * core
      */
-    void clearIconMap(void) { m_iconMap.clear(); }
+    void setDecodeThreads(int threads)
+        { m_scheduler->setDecodeThreads(threads); }
 
-    signals:
+    /**
+     * \brief Set the number of threads that scale decoded images
+     */
+    void setScaleThreads(int threads)
+        { m_scheduler->setScaleThreads(threads); }
 
     /**
-     * Signal that an icon image has been loaded
+     * \brief Tell the model which items the view is showing
+     * 
+     * Icon loads are prioritised by their distance from these items, queued
+     * loads that are now far away are dropped, and loads are scheduled for
+     * the items just outside this range, so that they are ready when the
+     * view is scrolled.
      * 
-     * \param p The path of the file for the icon
+     * \param first The first visible item (an invalid index if there are
+     * none)
      * 
-     * \param i The icon object
+     * \param last The last visible item
+     */
+    void setVisibleRange(const QModelIndex& first, const QModelIndex& last);
+
+    /**
+     * \brief Cancel all outstanding icon loads
      * 
-     * \param idx The index object for the fule
+     * This should be called when the view moves to a different directory,
+     * so that no more time is spent on the old one. Loads that are already
+     * running are left to finish, but their results are discarded rather
+     * than cached.
+     */
+    void cancelPendingLoads(void);
+
+    /**
+     * \brief Retrieve the number of background icon loads that have been
+     * started
+     */
+    quint64 decodesStarted(void) const { return m_decodesStarted; }
+
+    /**
+     * \brief Retrieve the number of icon requests that were satisfied by a
+     * load that was already in flight, rather than starting a new one
+     */
+    quint64 decodesSaved(void) const { return m_decodesSaved; }
+
+    /**
+     * \brief Retrieve the number of icon loads that were cancelled after
+     * they had started, and whose results were discarded
      */
-    void hasIcon(
-        const QString& p
-        , const QIcon& i
-        , const QPersistentModelIndex& idx) const;
+    quint64 decodesDiscarded(void) const
+        { return m_scheduler->discardedCount(); }
 
     protected slots:
 
     /**
-     * \brief Store a loaded icon and emit the `dataChanged` signal so that
-     * any views for this model are updated
+     * \brief Store a loaded icon and schedule a `dataChanged` signal so
+     * that any views for this model are updated
      * 
-     * This method is invoked after an icon has been loaded in a background
-     * thread.
+     * This method is invoked (in the GUI thread) after an icon has been
+     * loaded in a background thread.
      * 
      * \param path The path of the file from which the icon has been
      * generated
      * 
-     * \param icon The icon object
+     * \param image The thumbnail image for the icon
      * 
      * \param index The index object for the file in the model
      */
     void onIcon(
         const QString& path
-        , const QIcon& icon
+        , const QImage& image
+        , const QPersistentModelIndex& index);
+
+    /**
+     * \brief Forget about a load that the scheduler dropped, so that it is
+     * requested again if its item is displayed
+     * 
+     * \param path The path of the file whose load was dropped
+     * 
+     * \param index The index object for the file in the model
+     */
+    void onDropped(
+        const QString& path
         , const QPersistentModelIndex& index);
 
+    /**
+     * \brief Forget all icons, and cancel their loads, once rows no longer
+     * stay with their files
+     */
+    void forgetIcons(void);
+
+    /**
+     * \brief Forget all icons if rows have been inserted before others
+     */
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+
+    /**
+     * \brief Emit `dataChanged` for all the icons that have been stored
+     * since the last time this was called
+     * 
+     * Changed rows are grouped by parent, and each run of adjacent rows is
+     * reported as a single range.
+     */
+    void flushIconChanges(void);
+
     protected:
 
     /**
-     * The internal store of created icons
+     * \brief Schedule an icon load for an item, unless its icon is already
+     * cached or being loaded
+     * 
+     * \param index The index of the item
+     * 
+     * \return The cached icon if there is one, or a null pointer otherwise
+     */
+    QIcon* requestIcon(const QModelIndex& index) const;
+
+    /**
+     * \brief Give the scheduler a loader function for the current thumbnail
+     * size and store
+     */
+    void updateLoader(void);
+
+    /**
+     * \brief The internal store of created icons, keyed on source row
+     * 
+     * The cost of each entry is the size of its image in KiB. Files that
+     * could be read but not decoded are stored as null icons (with a
+     * nominal cost), so that they are not loaded again; files that couldn't
+     * be read are left out, so that they are tried again.
+     */
+    QCache<int, QIcon> m_iconCache;
+
+    /**
+     * \brief The rows of files for which an icon load is in flight
+     * 
+     * This is only accessed from the GUI thread (in `data` and `onIcon`),
+     * so it needs no locking.
+     */
+    mutable QSet<int> m_pendingRows;
+
+    QSize m_thumbnailSize;  ///< The size of thumbnails to load for icons
+
+    /**
+     * \brief The persistent store of thumbnails (may be null)
+     */
+    std::shared_ptr<api::thumbnail_store> m_thumbnailStore;
+
+    /**
+     * \brief The scheduler for background icon loads (owned by the model
+     * through the Qt object hierarchy)
+     */
+    ThumbnailScheduler* m_scheduler;
+
+    /**
+     * \brief The items whose icons have been stored, but not yet announced
+     * with `dataChanged`
      */
-    QMap<QString, QIcon> m_iconMap;
+    QVector<QPersistentModelIndex> m_changedIndexes;
+
+    QTimer* m_changedTmr;   ///< Times the batching of `dataChanged` signals
+
+    mutable quint64 m_decodesStarted;   ///< Count of loads started
+    mutable quint64 m_decodesSaved;     ///< Count of duplicate loads avoided
 
 };  //end IconProxyModel
 
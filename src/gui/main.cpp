@@ -62,7 +62,7 @@ int main(int argc, char *argv[])
 
             QSettings settings("Igor Siemienowicz", "MediaIndex");
             QApplication a(argc, argv);
-            MainWindow w(settings);
+            MainWindow w(settings, vm);
             w.show();
 
             result = a.exec();
@@ -95,10 +95,13 @@ int main(int argc, char *argv[])
  * documentation for various code entities in the application.
  * 
  * \par Overview of Codebase
- * The *MediaIndex* codebase is divided into two main sections:
+ * The *MediaIndex* codebase is divided into three main sections:
  * 
  * * `src/gui` -- the GUI application code, based on Qt
  * 
+ * * `src/cli` -- a command-line indexer, for indexing and generating
+ *   thumbnails without a display
+ * 
  * * `src/api` -- A lower-level Application Programming Interface - see the
  *   \ref api page for more information
  * 
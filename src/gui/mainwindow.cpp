@@ -20,17 +20,33 @@ using namespace fmt::literals;
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
-MainWindow::MainWindow(QSettings& settings, QWidget *parent) :
+MainWindow::MainWindow(
+        QSettings& settings
+        , const bst::po::variables_map& config
+        , QWidget *parent) :
     QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , m_settings(settings)
+    , m_config(config)
     , m_foldersTrVw(nullptr)
     , m_realFilesMdl(nullptr)
     , m_foldersMdl(nullptr)
     , m_filesLstVw(nullptr)
     , m_filesMdl(nullptr)
     , m_imageLbl(nullptr)
+    , m_visibleRangeTmr(nullptr)
     , m_displayedFilePath()
+    , m_smoothRedisplayTmr(nullptr)
+    , m_previewLoader(nullptr)
+    , m_searchEdt(nullptr)
+    , m_searchResultsMdl(nullptr)
+    , m_mediaIndex()
+    , m_searchIndex()
+    , m_searchIndexGeneration(0)
+    , m_searchIndexWtch(nullptr)
+    , m_pendingQuery()
+    , m_displayedImage()
+    , m_displayedImagePath()
 {
     setupUi();
     setupActions();
@@ -59,5 +75,9 @@ MainWindow::MainWindow(QSettings& settings, QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    // A search index rebuild uses the media index, which must not be
+    // closed under it
+    if (m_searchIndexWtch) m_searchIndexWtch->waitForFinished();
+
     delete ui;
 }   // end destructor
@@ -9,16 +9,32 @@
  * or copy at https://www.boost.org/LICENSE_1_0.txt
  */
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <QFileSystemModel>
+#include <QFutureWatcher>
+#include <QImage>
 #include <QLabel>
+#include <QLineEdit>
 #include <QListView>
 #include <QMainWindow>
 #include <QSettings>
 #include <QSplitter>
+#include <QStandardItemModel>
+#include <QTimer>
 #include <QTreeView>
 
+#include <api/media_index.h>
+#include <api/search_index.h>
+
 #include "error.h"
+#include "filelistmodel.h"
+#include "foldertreemodel.h"
 #include "iconproxymodel.h"
+#include "previewloader.h"
 
 #ifndef _gui_mainwindow_h_installed
 #define _gui_mainwindow_h_installed
@@ -124,9 +140,15 @@ class MainWindow : public QMainWindow
      * \param settings A Qt settings object, for storing persistent
      * configuration data (e.g. window geometry)
      * 
+     * \param config The configuration parsed from the command-line (see
+     * the \ref configuration page); this must outlive the window
+     * 
      * \param parent The parent UI object (usually `nullptr`)
      */
-    explicit MainWindow(QSettings& settings, QWidget *parent = nullptr);
+    explicit MainWindow(
+        QSettings& settings
+        , const bst::po::variables_map& config
+        , QWidget *parent = nullptr);
 
     /**
      * \brief Destructor - destroys all user interface elements for this
@@ -174,6 +196,21 @@ class MainWindow : public QMainWindow
      */
     virtual void closeEvent(QCloseEvent *event) override;
 
+    /**
+     * \brief Watch for events on child widgets that have no signals of
+     * their own
+     * 
+     * This is used to notice resizes of the files list view, which change
+     * the set of files that are visible.
+     * 
+     * \param watched The object that received the event
+     * 
+     * \param event The event
+     * 
+     * \return `false`, so that the event is always processed as normal
+     */
+    virtual bool eventFilter(QObject* watched, QEvent* event) override;
+
     protected slots:
 
     /**
@@ -204,6 +241,34 @@ class MainWindow : public QMainWindow
      */
     void handleFileSelected(QString filePath);
 
+    /**
+     * \brief Display a preview image that has been loaded in the
+     * background
+     * 
+     * Previews for files other than the one that is currently selected are
+     * ignored.
+     * 
+     * \param path The path of the previewed file
+     * 
+     * \param source The decoded image
+     * 
+     * \param scaled The decoded image scaled to `displaySize`
+     * 
+     * \param displaySize The size of the display label when the preview
+     * was requested
+     */
+    void handlePreviewReady(
+        QString path
+        , QImage source
+        , QImage scaled
+        , QSize displaySize);
+
+    /**
+     * \brief Take over a search index that has been built in the
+     * background, and run the search that was waiting for it
+     */
+    void handleSearchIndexReady(void);
+
     private:
 
     // -- UI Setup --
@@ -264,6 +329,17 @@ class MainWindow : public QMainWindow
      */
     void setupFileListView(void);
 
+    /**
+     * \brief Open the persistent media index that searches are run
+     * against
+     * 
+     * If the index can't be opened, a warning is logged, and searching is
+     * disabled.
+     * 
+     * This method is called once during construction.
+     */
+    void setupMediaIndex(void);
+
     // -- Actions Setup --
     //
     // These methods are implemented in the 'mainwindow/mw_setup_actions.cpp`
@@ -284,6 +360,13 @@ class MainWindow : public QMainWindow
      */
     void setupFileActions(void);
 
+    /**
+     * \brief Set up the search box in the toolbar
+     * 
+     * This method is called once during construction
+     */
+    void setupSearchActions(void);
+
     // -- Command Execution --
 
     /**
@@ -292,6 +375,16 @@ class MainWindow : public QMainWindow
      */
     void executeFileOpenRootFolderAction(void);
 
+    /**
+     * \brief Execute the User action to search the metadata of the files
+     * under the root folder, using the query in the search box
+     * 
+     * If the search index is out of date, it is rebuilt in the background
+     * first (see `rebuildSearchIndex`). An empty query goes back to
+     * showing the selected folder.
+     */
+    void executeSearchAction(void);
+
     // -- Utilities / Helper Methods --
     //
     // The methods below are implemented in the `mainwindow/mw_utils.cpp`
@@ -339,13 +432,87 @@ class MainWindow : public QMainWindow
      */
     void saveSelectedDirectoryPath(QString p);
 
+    /**
+     * \brief Arrange for `updateVisibleRange` to be called shortly
+     * 
+     * This can be called very frequently (e.g. while the User is dragging
+     * the scroll bar); the update is made at most once per timer interval.
+     */
+    void requestVisibleRangeUpdate(void);
+
+    /**
+     * \brief Tell the files model which items the files list view is
+     * showing, so that it loads their icons first
+     */
+    void updateVisibleRange(void);
+
     /**
      * \brief Display the file referenced by `m_displayedFilePath`, scaled
      * to the display label
      * 
+     * The file is only decoded when `m_displayedFilePath` changes; it is
+     * decoded at no more than screen resolution, and kept in
+     * `m_displayedImage`, so that redisplaying at a new size (e.g. while
+     * the splitter is dragged) is just a rescale.
+     * 
+     * Decoding and smooth scaling are done in the background by
+     * `m_previewLoader` (see `handlePreviewReady`), so that selecting a
+     * large image never blocks the GUI. Only fast rescaling of an image
+     * that has already been decoded is done immediately.
+     * 
+     * \param mode The scaling mode; `Qt::FastTransformation` can be used
+     * for continuous resizing, followed by `Qt::SmoothTransformation` when
+     * the resizing stops
+     * 
      * \todo Expand this functionality for other file types
      */
-    void redisplayFile(void);
+    void redisplayFile(
+        Qt::TransformationMode mode = Qt::SmoothTransformation);
+
+    /**
+     * \brief Ask the preview loader to prefetch the files either side of
+     * the current file in the files list view
+     * 
+     * The number of files on each side is set by the `preview-prefetch`
+     * configuration option.
+     */
+    void prefetchNeighbours(void);
+
+    /**
+     * \brief Retrieve the largest size at which an image may need to be
+     * displayed, which is the size of the screen in device pixels
+     */
+    QSize maxDisplaySize(void) const;
+
+    /**
+     * \brief Bring the media index up to date with the root folder and
+     * build a new search index from it, in the background
+     * 
+     * The rescan is incremental, and metadata is only read for files that
+     * are new or have changed. When the search index is ready,
+     * `handleSearchIndexReady` is called.
+     */
+    void rebuildSearchIndex(void);
+
+    /**
+     * \brief Run the query in `m_pendingQuery` against `m_searchIndex`,
+     * and show the results
+     */
+    void runSearch(void);
+
+    /**
+     * \brief Show a list of files in the files list view, in place of the
+     * selected folder
+     * 
+     * \param paths The paths of the files to show
+     */
+    void showSearchResults(const std::vector<std::string>& paths);
+
+    /**
+     * \brief Show the selected folder in the files list view, if it is
+     * showing search results
+     */
+    void showFolderFiles(void);
 
     // -- Attributes --
 
@@ -360,15 +527,74 @@ class MainWindow : public QMainWindow
      */
     QSettings& m_settings;
 
+    /**
+     * \brief The configuration parsed from the command-line
+     */
+    const bst::po::variables_map& m_config;
+
     // - User Interface Elements -
 
     QTreeView* m_foldersTrVw;       ///< The tree view for folders
-    QFileSystemModel* m_foldersMdl; ///< The data model for folders
+    FolderTreeModel* m_foldersMdl;  ///< The data model for folders
     QListView* m_filesLstVw;        ///< List view for media files
-    QFileSystemModel* m_realFilesMdl;   ///< Data model for media files
+    FileListModel* m_realFilesMdl;  ///< Data model for media files
     IconProxyModel* m_filesMdl;     ///< Proxy for generating icons for files
     QLabel* m_imageLbl;             ///< Label for displaying selected image
+    QTimer* m_visibleRangeTmr;      ///< Throttles visible range updates
     QString m_displayedFilePath;    ///< Path of currently displayed file
+    QTimer* m_smoothRedisplayTmr;   ///< Smooth redisplay after a resize
+    PreviewLoader* m_previewLoader; ///< Loads preview images
+    QLineEdit* m_searchEdt;         ///< The search box
+    QStandardItemModel* m_searchResultsMdl; ///< Files found by a search
+
+    // - Search -
+
+    /**
+     * \brief The persistent index of the media files (null if it couldn't
+     * be opened)
+     */
+    std::shared_ptr<api::media_index> m_mediaIndex;
+
+    /**
+     * \brief The inverted index for searching metadata (null until the
+     * first search)
+     */
+    std::shared_ptr<const api::search_index> m_searchIndex;
+
+    /**
+     * \brief The generation of `m_mediaIndex` that `m_searchIndex` was
+     * built from
+     */
+    std::uint64_t m_searchIndexGeneration;
+
+    /**
+     * \brief A search index built in the background
+     */
+    struct BuiltSearchIndex
+    {
+        /**
+         * \brief The search index; null if it couldn't be built
+         */
+        std::shared_ptr<const api::search_index> index;
+
+        /**
+         * \brief The generation of `m_mediaIndex` read just before the
+         * search index was built from it
+         */
+        std::uint64_t generation = 0;
+    };  // end BuiltSearchIndex struct
+
+    /**
+     * \brief Watches the background rebuilding of the search index
+     */
+    QFutureWatcher<BuiltSearchIndex>* m_searchIndexWtch;
+
+    QString m_pendingQuery;         ///< Query waiting for the search index
+
+    // - Cached Display Data -
+
+    QImage m_displayedImage;        ///< Decoded image being displayed
+    QString m_displayedImagePath;   ///< Path of `m_displayedImage`
 
 };  // end MainWindow class
 
@@ -36,3 +36,27 @@ void MainWindow::executeFileOpenRootFolderAction(void)
     }
     ACTION_CATCH_DURING("Opening Root Folder");
 }   // end executeFileOpenRootFolderAction method
+
+void MainWindow::executeSearchAction(void)
+{
+    ACTION_TRY
+    {
+        QString query = m_searchEdt->text().trimmed();
+        if (query.isEmpty() || !m_mediaIndex)
+        {
+            showFolderFiles();
+            return;
+        }
+
+        m_pendingQuery = query;
+
+        // The search index is rebuilt if the media index has changed since
+        // it was built, or the root folder has changed (which discards it)
+        if (m_searchIndex
+                && m_searchIndexGeneration == m_mediaIndex->generation())
+            runSearch();
+        else if (!m_searchIndexWtch->isRunning())
+            rebuildSearchIndex();
+    }
+    ACTION_CATCH_DURING("Searching");
+}   // end executeSearchAction method
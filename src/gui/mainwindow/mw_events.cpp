@@ -9,7 +9,10 @@
  * or copy at https://www.boost.org/LICENSE_1_0.txt
  */
 
+#include <QEvent>
 #include <QPixmap>
+#include <QSignalBlocker>
+#include <QStatusBar>
 
 #include "../mainwindow.h"
 
@@ -19,10 +22,22 @@ void MainWindow::closeEvent(QCloseEvent *event)
     QMainWindow::closeEvent(event);
 }   // end closeEvent
 
+bool MainWindow::eventFilter(QObject* watched, QEvent* event)
+{
+    if (m_filesLstVw
+            && watched == m_filesLstVw->viewport()
+            && event->type() == QEvent::Resize)
+        requestVisibleRangeUpdate();
+
+    return QMainWindow::eventFilter(watched, event);
+}   // end eventFilter method
+
 void MainWindow::handleRootDirectoryChanged(QString newRootDirectory)
 {
     m_foldersMdl->setRootPath(newRootDirectory);
-    m_foldersTrVw->setRootIndex(m_foldersMdl->index(newRootDirectory));
+
+    // The new root hasn't been scanned for searching
+    m_searchIndex.reset();
 }   // end handleRootDirectoryChanged method
 
 void MainWindow::handleSelectedDirectoryChanged(QString newSelectedDirectory)
@@ -30,19 +45,35 @@ void MainWindow::handleSelectedDirectoryChanged(QString newSelectedDirectory)
     logging::debug("selected directory is now: " + newSelectedDirectory);
     if (m_filesMdl)
     {
-        m_realFilesMdl->setRootPath(newSelectedDirectory);
+        // Icon loads for the old directory are no longer wanted
+        m_filesMdl->cancelPendingLoads();
+
+        // Selecting a folder replaces any search results
+        if (m_filesMdl->sourceModel() != m_realFilesMdl)
+        {
+            m_filesMdl->setSourceModel(m_realFilesMdl);
+            m_searchResultsMdl->clear();
 
-        if (m_filesLstVw)
-            m_filesLstVw->setRootIndex(
-                m_filesMdl->mapFromSource(
-                    m_realFilesMdl->index(newSelectedDirectory)));
+            QSignalBlocker blocker(m_searchEdt);
+            m_searchEdt->clear();
+        }
+
+        m_realFilesMdl->setDirectory(newSelectedDirectory);
+
+        requestVisibleRangeUpdate();
     }
     
     saveSelectedDirectoryPath(newSelectedDirectory);
 
-    // Clear the icon map of the files model proxy - they apply to the old
-    // directory.
-    m_filesMdl->clearIconMap();
+    // Icons are cached by row, so the new listing's reset clears the cache;
+    // thumbnails made for the old directory are still in the thumbnail
+    // store if we come back to it.
+    logging::debug(QString("icon loads started: %1, duplicate loads saved: "
+        "%2, cancelled loads discarded: %3, icon cache usage: %4 KiB").arg(
+            m_filesMdl->decodesStarted()).arg(
+            m_filesMdl->decodesSaved()).arg(
+            m_filesMdl->decodesDiscarded()).arg(
+            m_filesMdl->iconCacheUsage() / 1024));
 }   // end handleSelectedDirectoryChanged method
 
 void MainWindow::handleFileSelected(QString filePath)
@@ -51,5 +82,55 @@ void MainWindow::handleFileSelected(QString filePath)
 
     m_displayedFilePath = filePath;
     redisplayFile();
+    prefetchNeighbours();
 
 }   // end handleFileSelected
+
+void MainWindow::handlePreviewReady(
+        QString path
+        , QImage source
+        , QImage scaled
+        , QSize displaySize)
+{
+    // The selection may have moved on since this was requested
+    if (path != m_displayedFilePath) return;
+
+    m_displayedImage = source;
+    m_displayedImagePath = path;
+
+    if (source.isNull()) m_imageLbl->clear();
+    else if (displaySize == m_imageLbl->size())
+        m_imageLbl->setPixmap(QPixmap::fromImage(scaled));
+    else
+    {
+        // The label has been resized while the preview was loading
+        redisplayFile(Qt::FastTransformation);
+        m_smoothRedisplayTmr->start();
+    }
+}   // end handlePreviewReady method
+
+void MainWindow::handleSearchIndexReady(void)
+{
+    ACTION_TRY
+    {
+        auto built = m_searchIndexWtch->result();
+        auto index = built.index;
+        if (!index)
+        {
+            QString msg = tr("Could not index ") + rootDirectoryPath();
+            logging::warning(msg);
+            statusBar()->showMessage(msg, 5000);
+            return;
+        }
+
+        m_searchIndex = index;
+        m_searchIndexGeneration = built.generation;
+        logging::info(QString("search index: %1 files, %2 KiB").arg(
+            index->size()).arg(index->memory_usage() / 1024));
+
+        // The User may have cleared the search while it was waiting
+        if (!m_searchEdt->text().trimmed().isEmpty()) runSearch();
+        else statusBar()->clearMessage();
+    }
+    ACTION_CATCH_DURING("Searching");
+}   // end handleSearchIndexReady method
@@ -13,6 +13,7 @@
 #include <QAction>
 #include <QIcon>
 #include <QKeySequence>
+#include <QLineEdit>
 
 #include "../logging.h"
 #include "../mainwindow.h"
@@ -27,6 +28,7 @@ void MainWindow::setupActions(void)
     ui->mainToolBar->setToolButtonStyle(Qt::ToolButtonTextUnderIcon);
 
     setupFileActions();
+    setupSearchActions();
 }   // end setupActions method
 
 void MainWindow::setupFileActions(void)
@@ -45,3 +47,40 @@ void MainWindow::setupFileActions(void)
 
     ui->mainToolBar->addAction(openRootFolderAction);
 }   // end setupFileActions method
+
+void MainWindow::setupSearchActions(void)
+{
+    m_searchEdt = new QLineEdit(this);
+    m_searchEdt->setPlaceholderText(
+        tr("Search, e.g. beach make:canon date:2019.."));
+    m_searchEdt->setClearButtonEnabled(true);
+    m_searchEdt->setMaximumWidth(400);
+    m_searchEdt->setEnabled(m_mediaIndex != nullptr);
+
+    connect(
+        m_searchEdt
+        , &QLineEdit::returnPressed
+        , [this](void) { executeSearchAction(); });
+
+    // Clearing the search box goes back to the selected folder
+    connect(
+        m_searchEdt
+        , &QLineEdit::textChanged
+        , [this](const QString& text)
+            { if (text.isEmpty()) showFolderFiles(); });
+
+    auto searchAction = new QAction(tr("&Search"), this);
+    searchAction->setShortcut(QKeySequence::StandardKey::Find);
+    connect(
+        searchAction
+        , &QAction::triggered
+        , [this](void)
+        {
+            m_searchEdt->setFocus();
+            m_searchEdt->selectAll();
+        });
+    addAction(searchAction);
+
+    ui->mainToolBar->addSeparator();
+    ui->mainToolBar->addWidget(m_searchEdt);
+}   // end setupSearchActions method
@@ -12,9 +12,13 @@
 
 #include <QAbstractItemView>
 #include <QFrame>
+#include <QHeaderView>
+#include <QScrollBar>
+#include <QSignalBlocker>
 #include <QVBoxLayout>
 
 #include "../mainwindow.h"
+#include "../thumbnail.h"
 #include "ui_mainwindow.h"
 
 void MainWindow::setupUi(void)
@@ -24,6 +28,7 @@ void MainWindow::setupUi(void)
     
     restoreWindowGeometry();
 
+    setupMediaIndex();
     setupCentralWidget();
 }   // end setupUi method
 
@@ -72,8 +77,23 @@ void MainWindow::setupFolderTreeView(void)
 {
     m_foldersTrVw = new QTreeView();
 
-    m_foldersMdl = new QFileSystemModel();
+    // The folders come from the media index, and are read in the
+    // background, so that expanding a folder never waits for the disk
+    m_foldersMdl = new FolderTreeModel(m_mediaIndex, this);
     m_foldersTrVw->setModel(m_foldersMdl);
+    m_foldersTrVw->setUniformRowHeights(true);
+
+    auto header = m_foldersTrVw->header();
+    header->setStretchLastSection(false);
+    header->setSectionResizeMode(
+        FolderTreeModel::NameColumn
+        , QHeaderView::Stretch);
+    header->setSectionResizeMode(
+        FolderTreeModel::FilesColumn
+        , QHeaderView::ResizeToContents);
+    header->setSectionResizeMode(
+        FolderTreeModel::SizeColumn
+        , QHeaderView::ResizeToContents);
 
     // Use root directory from last time, but make sure it still exists
     QString oldRootPath = rootDirectoryPath();
@@ -88,13 +108,6 @@ void MainWindow::setupFolderTreeView(void)
 
     logging::info("using root folder: " + rootDirectoryPath());
 
-    m_foldersMdl->setFilter(
-        QDir::Dirs | QDir::AllDirs | QDir::NoDotAndDotDot);
-
-    m_foldersTrVw->setColumnHidden(1, true);
-    m_foldersTrVw->setColumnHidden(2, true);
-    m_foldersTrVw->setColumnHidden(3, true);
-
     connect(
         m_foldersTrVw->selectionModel()
         , &QItemSelectionModel::currentChanged
@@ -103,13 +116,29 @@ void MainWindow::setupFolderTreeView(void)
             emit selectedDirectoryChanged(m_foldersMdl->filePath(current));
         });
 
-    handleRootDirectoryChanged(rootDirectoryPath());
+    // The last selected folder is selected once the folders leading down
+    // to it have been loaded
+    connect(
+        m_foldersMdl
+        , &FolderTreeModel::pathRevealed
+        , [this](const QString& path)
+        {
+            // If the files view already shows the folder, it isn't listed
+            // again
+            QSignalBlocker blocker(
+                m_realFilesMdl && m_realFilesMdl->directory() == path
+                    ? this
+                    : nullptr);
+
+            auto index = m_foldersMdl->index(path);
+            m_foldersTrVw->selectionModel()->setCurrentIndex(
+                index
+                , QItemSelectionModel::Select);
+            m_foldersTrVw->scrollTo(index);
+        });
 
-    // Make sure that the tree view has the last selected path selected
-    m_foldersTrVw->selectionModel()->setCurrentIndex(
-        m_foldersMdl->index(
-            selectedDirectoryPath())
-            , QItemSelectionModel::Select);
+    handleRootDirectoryChanged(rootDirectoryPath());
+    m_foldersMdl->revealPath(selectedDirectoryPath());
 
 }   // end setupFolderTree method
 
@@ -122,6 +151,27 @@ QSplitter* MainWindow::createTopBottomSplitter(void)
     m_imageLbl = new QLabel();
     m_imageLbl->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
 
+    // The preview cache holds the selected file and its prefetched
+    // neighbours, with a little room to spare
+    m_previewLoader = new PreviewLoader(this);
+    auto maxSize = maxDisplaySize();
+    m_previewLoader->setCacheBudget(
+        qint64(maxSize.width()) * maxSize.height() * 4
+            * (2 * m_config["preview-prefetch"].as<int>() + 2));
+    connect(
+        m_previewLoader
+        , &PreviewLoader::ready
+        , this
+        , &MainWindow::handlePreviewReady);
+
+    m_smoothRedisplayTmr = new QTimer(this);
+    m_smoothRedisplayTmr->setSingleShot(true);
+    m_smoothRedisplayTmr->setInterval(150);
+    connect(
+        m_smoothRedisplayTmr
+        , &QTimer::timeout
+        , [this](void) { redisplayFile(Qt::SmoothTransformation); });
+
     auto topBottomSplt = new QSplitter(Qt::Vertical, this);
     topBottomSplt->addWidget(m_filesLstVw);
     topBottomSplt->addWidget(m_imageLbl);
@@ -147,7 +197,10 @@ QSplitter* MainWindow::createTopBottomSplitter(void)
             m_settings.setValue("topBottomSplitterBottom", sizes[1]);
             m_settings.endGroup();   
 
-            redisplayFile();        
+            // Rescale quickly while the splitter is moving, and smoothly
+            // once it stops
+            redisplayFile(Qt::FastTransformation);
+            m_smoothRedisplayTmr->start();
         });
 
     return topBottomSplt;
@@ -158,13 +211,21 @@ void MainWindow::setupFileListView(void)
     m_filesLstVw = new QListView();
 
     // Set up the file model and its proxy
-    m_realFilesMdl = new QFileSystemModel(this);
-    m_realFilesMdl->setFilter(QDir::Files | QDir::NoDotAndDotDot);
+    m_realFilesMdl = new FileListModel(this);
 
     m_filesMdl = new IconProxyModel(this);
+    m_filesMdl->setIconCacheBudget(
+        qint64(m_config["thumbnail-cache-mb"].as<int>()) * 1024 * 1024);
+    m_filesMdl->setIoThreads(m_config["io-threads"].as<int>());
+    m_filesMdl->setDecodeThreads(m_config["decode-threads"].as<int>());
+    m_filesMdl->setScaleThreads(m_config["scale-threads"].as<int>());
     
     m_filesMdl->setSourceModel(m_realFilesMdl);
 
+    // Search results are shown through the same proxy, so they get icons
+    // in the same way
+    m_searchResultsMdl = new QStandardItemModel(this);
+
     m_filesLstVw->setModel(m_filesMdl);
 
     // Use selected directory from last time. If it doesn't exist, we use the
@@ -185,15 +246,73 @@ void MainWindow::setupFileListView(void)
     m_filesLstVw->setViewMode(QListView::IconMode);
     m_filesLstVw->setGridSize(QSize(200, 200));
     m_filesLstVw->setIconSize(QSize(150, 150));
+    m_filesMdl->setThumbnailSize(m_filesLstVw->iconSize());
+    m_filesMdl->setThumbnailStore(std::make_shared<api::thumbnail_store>(
+        thumbnailStorePath().toStdString()));
+    logging::info("thumbnail store: " + thumbnailStorePath());
     m_filesLstVw->setWordWrap(true);
 
+    // Every item has the same size, so the view can lay out a huge
+    // directory without asking for the data of every row, and it lays out
+    // in batches, so it stays responsive while rows are being added
+    m_filesLstVw->setUniformItemSizes(true);
+    m_filesLstVw->setLayoutMode(QListView::Batched);
+    m_filesLstVw->setBatchSize(500);
+
+    // Keep the files model informed of which items are on screen, so that
+    // their icons are loaded first
+    m_visibleRangeTmr = new QTimer(this);
+    m_visibleRangeTmr->setSingleShot(true);
+    m_visibleRangeTmr->setInterval(20);
+    connect(
+        m_visibleRangeTmr
+        , &QTimer::timeout
+        , [this](void) { updateVisibleRange(); });
+
+    connect(
+        m_filesLstVw->verticalScrollBar()
+        , &QScrollBar::valueChanged
+        , [this](int) { requestVisibleRangeUpdate(); });
+    connect(
+        m_filesMdl
+        , &QAbstractItemModel::rowsInserted
+        , [this](const QModelIndex&, int, int)
+            { requestVisibleRangeUpdate(); });
+    connect(
+        m_filesMdl
+        , &QAbstractItemModel::layoutChanged
+        , [this](void) { requestVisibleRangeUpdate(); });
+    m_filesLstVw->viewport()->installEventFilter(this);
+
     connect(
         m_filesLstVw->selectionModel()
         , &QItemSelectionModel::currentChanged
         , [this](const QModelIndex& current, const QModelIndex& previous)
         {
-            emit fileSelected(m_realFilesMdl->filePath(current));
+            emit fileSelected(
+                current.data(QFileSystemModel::FilePathRole).toString());
         });
 
     handleSelectedDirectoryChanged(selectedDirectoryPath());
 }   // end setupFileListView method
+
+void MainWindow::setupMediaIndex(void)
+{
+    try
+    {
+        m_mediaIndex = std::make_shared<api::media_index>(
+            mediaIndexPath().toStdString());
+        logging::info("media index: " + mediaIndexPath());
+    }
+    catch (const std::exception& err)
+    {
+        logging::warning(QString("searching is disabled: ") + err.what());
+    }
+
+    m_searchIndexWtch = new QFutureWatcher<BuiltSearchIndex>(this);
+    connect(
+        m_searchIndexWtch
+        , &QFutureWatcherBase::finished
+        , this
+        , &MainWindow::handleSearchIndexReady);
+}   // end setupMediaIndex method
@@ -9,7 +9,16 @@
  * or copy at https://www.boost.org/LICENSE_1_0.txt
  */
 
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QScreen>
 #include <QStandardPaths>
+#include <QStatusBar>
+#include <QtConcurrent>
+
+#include <api/extractor.h>
+
 #include "../mainwindow.h"
 
 void MainWindow::saveWindowGeometry(void)
@@ -71,12 +80,195 @@ void MainWindow::saveSelectedDirectoryPath(QString p)
     m_settings.endGroup();
 }   // end saveSelectedDirectoryPath method
 
-void MainWindow::redisplayFile()
+void MainWindow::requestVisibleRangeUpdate(void)
+{
+    if (m_visibleRangeTmr && !m_visibleRangeTmr->isActive())
+        m_visibleRangeTmr->start();
+}   // end requestVisibleRangeUpdate method
+
+void MainWindow::updateVisibleRange(void)
 {
-    if (!m_displayedFilePath.isEmpty())
-        m_imageLbl->setPixmap(QPixmap(m_displayedFilePath).scaled(
+    // Find the first and last items on screen by probing the viewport from
+    // each end, on a grid that is finer than the item grid
+    QRect area = m_filesLstVw->viewport()->rect();
+    QSize step = m_filesLstVw->gridSize() / 2;
+    if (step.isEmpty()) step = QSize(16, 16);
+
+    QModelIndex first, last;
+    for (int y = area.top();
+            y <= area.bottom() && !first.isValid();
+            y += step.height())
+        for (int x = area.left();
+                x <= area.right() && !first.isValid();
+                x += step.width())
+            first = m_filesLstVw->indexAt(QPoint(x, y));
+
+    for (int y = area.bottom();
+            y >= area.top() && !last.isValid();
+            y -= step.height())
+        for (int x = area.right();
+                x >= area.left() && !last.isValid();
+                x -= step.width())
+            last = m_filesLstVw->indexAt(QPoint(x, y));
+
+    m_filesMdl->setVisibleRange(first, last);
+}   // end updateVisibleRange method
+
+void MainWindow::redisplayFile(Qt::TransformationMode mode)
+{
+    if (m_displayedFilePath.isEmpty()) return;
+
+    bool decoded = (m_displayedImagePath == m_displayedFilePath);
+
+    if (decoded && m_displayedImage.isNull())
+    {
+        // The file couldn't be decoded last time, so don't try again
+        m_imageLbl->clear();
+        return;
+    }
+
+    // A fast rescale of an image that we have already decoded is cheap
+    // enough to do here
+    if (decoded && mode == Qt::FastTransformation)
+    {
+        m_imageLbl->setPixmap(QPixmap::fromImage(m_displayedImage.scaled(
             m_imageLbl->width()
             , m_imageLbl->height()
             , Qt::KeepAspectRatio
-            , Qt::SmoothTransformation));
+            , mode)));
+        return;
+    }
+
+    // Anything else happens in the background, and the result is displayed
+    // by `handlePreviewReady`
+    m_previewLoader->request(
+        m_displayedFilePath
+        , decoded ? m_displayedImage : QImage()
+        , maxDisplaySize()
+        , m_imageLbl->size());
 }   // end displayImageScaled
+
+void MainWindow::prefetchNeighbours(void)
+{
+    int count = m_config["preview-prefetch"].as<int>();
+    auto current = m_filesLstVw->currentIndex();
+    if (count <= 0 || !current.isValid()) return;
+
+    // Nearest first, and the next file before the previous one
+    QStringList paths;
+    for (int distance = 1; distance <= count; ++distance)
+        for (int row : { current.row() + distance, current.row() - distance })
+        {
+            auto neighbour = current.sibling(row, 0);
+            if (neighbour.isValid())
+                paths.append(neighbour.data(
+                    QFileSystemModel::FilePathRole).toString());
+        }
+
+    m_previewLoader->prefetch(paths, maxDisplaySize());
+}   // end prefetchNeighbours method
+
+QSize MainWindow::maxDisplaySize(void) const
+{
+    auto screen = QGuiApplication::primaryScreen();
+    if (!screen) return QSize(4096, 4096);
+
+    return screen->size() * screen->devicePixelRatio();
+}   // end maxDisplaySize method
+
+void MainWindow::rebuildSearchIndex(void)
+{
+    QString msg = tr("Indexing ") + rootDirectoryPath() + "...";
+    logging::info(msg);
+    statusBar()->showMessage(msg);
+
+    auto index = m_mediaIndex;
+    auto root = rootDirectoryPath().toStdString();
+    m_searchIndexWtch->setFuture(QtConcurrent::run(
+        [index, root](void)
+        {
+            // A failure is reported by returning no search index
+            BuiltSearchIndex built;
+            try
+            {
+                index->rescan(root);
+                api::extract_metadata(*index);
+
+                // Changes made after this (e.g. by a folder tree rescan)
+                // may be missed by the search index, so they leave it
+                // out of date
+                built.generation = index->generation();
+                built.index = std::make_shared<const api::search_index>(
+                    *index);
+            }
+            catch (const std::exception&)
+            {
+                built.index = nullptr;
+            }
+
+            return built;
+        }));
+}   // end rebuildSearchIndex method
+
+void MainWindow::runSearch(void)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    auto matches = m_searchIndex->query(m_pendingQuery.toStdString());
+
+    // The media index may hold other trees (e.g. indexed by the
+    // command-line indexer), so only files under the root are shown
+    auto root = rootDirectoryPath().toStdString();
+    if (root.empty() || root.back() != '/') root += '/';
+
+    std::vector<std::string> paths;
+    for (auto& p : m_searchIndex->paths(matches))
+        if (p.compare(0, root.size(), root) == 0)
+            paths.push_back(std::move(p));
+
+    showSearchResults(paths);
+
+    QString msg = tr("%1 files found in %2 ms").arg(paths.size()).arg(
+        timer.elapsed());
+    logging::debug("search \"" + m_pendingQuery + "\": " + msg);
+    statusBar()->showMessage(msg);
+}   // end runSearch method
+
+void MainWindow::showSearchResults(const std::vector<std::string>& paths)
+{
+    // Icon loads for the old listing are no longer wanted
+    m_filesMdl->cancelPendingLoads();
+
+    QList<QStandardItem*> items;
+    items.reserve(static_cast<int>(paths.size()));
+    for (const auto& p : paths)
+    {
+        auto path = QString::fromStdString(p);
+        auto item = new QStandardItem(QFileInfo(path).fileName());
+        item->setData(path, QFileSystemModel::FilePathRole);
+        item->setToolTip(path);
+        item->setEditable(false);
+        items.append(item);
+    }
+
+    // The rows are inserted in one go, so the view lays out once
+    m_searchResultsMdl->clear();
+    m_searchResultsMdl->invisibleRootItem()->appendRows(items);
+
+    if (m_filesMdl->sourceModel() != m_searchResultsMdl)
+        m_filesMdl->setSourceModel(m_searchResultsMdl);
+
+    requestVisibleRangeUpdate();
+}   // end showSearchResults method
+
+void MainWindow::showFolderFiles(void)
+{
+    if (!m_filesMdl || m_filesMdl->sourceModel() == m_realFilesMdl) return;
+
+    m_filesMdl->cancelPendingLoads();
+    m_filesMdl->setSourceModel(m_realFilesMdl);
+    m_searchResultsMdl->clear();
+
+    requestVisibleRangeUpdate();
+}   // end showFolderFiles method
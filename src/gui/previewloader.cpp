@@ -0,0 +1,199 @@
+/**
+ * \file previewloader.cpp
+ * Implement the `PreviewLoader` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <QMutexLocker>
+#include <QRunnable>
+
+#include "previewloader.h"
+#include "thumbnail.h"
+
+namespace {
+
+/**
+ * \brief Priority of requests on the thread pool
+ */
+const int requestPriority = 1;
+
+/**
+ * \brief Priority of prefetches on the thread pool
+ */
+const int prefetchPriority = 0;
+
+/**
+ * \brief A runnable that calls a function, so that functions can be
+ * started on a thread pool with a priority
+ */
+class FunctionRunnable : public QRunnable
+{
+    public:
+
+    explicit FunctionRunnable(std::function<void(void)> fn) : m_fn(fn) {}
+
+    virtual void run(void) override { m_fn(); }
+
+    private:
+
+    std::function<void(void)> m_fn;     ///< The function to run
+
+};  // end FunctionRunnable class
+
+}   // end anonymous namespace
+
+PreviewLoader::PreviewLoader(QObject* parent) :
+        QObject(parent)
+        , m_deferred{0, QString(), QSize(), QSize()}
+        , m_cache(192 * 1024)
+        , m_prefetching()
+        , m_wanted()
+        , m_wantedMutex()
+        , m_latestTicket(0)
+        , m_pool()
+{
+    m_pool.setMaxThreadCount(2);
+}
+
+PreviewLoader::~PreviewLoader(void)
+{
+    // Nothing that is still queued is wanted any more
+    ++m_latestTicket;
+    m_pool.clear();
+    m_pool.waitForDone();
+}   // end destructor
+
+void PreviewLoader::request(
+        const QString& path
+        , const QImage& source
+        , const QSize& maxSize
+        , const QSize& displaySize)
+{
+    quint64 ticket = ++m_latestTicket;
+
+    QImage image = source;
+    if (image.isNull())
+    {
+        auto cached = m_cache.object(path);
+        if (cached) image = *cached;
+        else if (m_prefetching.contains(path))
+        {
+            // Don't decode the file twice; carry on when the prefetch is
+            // done (making sure that it isn't skipped)
+            {
+                QMutexLocker lock(&m_wantedMutex);
+                m_wanted.insert(path);
+            }
+
+            m_deferred = DeferredRequest{ticket, path, maxSize, displaySize};
+            return;
+        }
+    }
+
+    start([=]{
+        if (m_latestTicket.load() != ticket) return;
+
+        QImage decoded = image.isNull() ? loadThumbnail(path, maxSize) : image;
+
+        if (m_latestTicket.load() != ticket) return;
+
+        QImage scaled = decoded.isNull() || displaySize.isEmpty()
+            ? QImage()
+            : decoded.scaled(
+                displaySize
+                , Qt::KeepAspectRatio
+                , Qt::SmoothTransformation);
+
+        QMetaObject::invokeMethod(
+            this
+            , [=]{ onFinished(ticket, path, decoded, scaled, displaySize); }
+            , Qt::QueuedConnection);
+    }, requestPriority);
+}   // end request method
+
+void PreviewLoader::prefetch(const QStringList& paths, const QSize& maxSize)
+{
+    {
+        QMutexLocker lock(&m_wantedMutex);
+        m_wanted = QSet<QString>::fromList(paths);
+
+        // A request may be waiting for one of the previous prefetches
+        if (m_deferred.ticket == m_latestTicket.load())
+            m_wanted.insert(m_deferred.path);
+    }
+
+    // Queue the files that we don't have and aren't already fetching; the
+    // thread pool runs runnables of equal priority in the order they were
+    // started.
+    for (const auto& path : paths)
+    {
+        if (m_prefetching.contains(path) || m_cache.contains(path)) continue;
+
+        m_prefetching.insert(path);
+        start([=]{
+            bool wanted;
+            {
+                QMutexLocker lock(&m_wantedMutex);
+                wanted = m_wanted.contains(path);
+            }
+
+            QImage image = wanted ? loadThumbnail(path, maxSize) : QImage();
+
+            QMetaObject::invokeMethod(
+                this
+                , [=]{ onPrefetched(path, image); }
+                , Qt::QueuedConnection);
+        }, prefetchPriority);
+    }
+}   // end prefetch method
+
+void PreviewLoader::onFinished(
+        quint64 ticket
+        , const QString& path
+        , const QImage& source
+        , const QImage& scaled
+        , const QSize& displaySize)
+{
+    cacheImage(path, source);
+
+    if (ticket == m_latestTicket.load())
+        emit ready(path, source, scaled, displaySize);
+}   // end onFinished method
+
+void PreviewLoader::onPrefetched(const QString& path, const QImage& image)
+{
+    m_prefetching.remove(path);
+    cacheImage(path, image);
+
+    // Resume a request that was waiting for this file
+    if (m_deferred.path == path && m_deferred.ticket == m_latestTicket.load())
+    {
+        DeferredRequest deferred = m_deferred;
+        m_deferred = DeferredRequest{0, QString(), QSize(), QSize()};
+        request(
+            deferred.path
+            , image
+            , deferred.maxSize
+            , deferred.displaySize);
+    }
+}   // end onPrefetched method
+
+void PreviewLoader::cacheImage(const QString& path, const QImage& image)
+{
+    if (image.isNull()) return;
+
+    m_cache.insert(
+        path
+        , new QImage(image)
+        , qMax(1, static_cast<int>(image.sizeInBytes() / 1024)));
+}   // end cacheImage method
+
+void PreviewLoader::start(std::function<void(void)> fn, int priority)
+{
+    m_pool.start(new FunctionRunnable(std::move(fn)), priority);
+}   // end start method
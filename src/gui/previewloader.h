@@ -0,0 +1,205 @@
+/**
+ * \file previewloader.h
+ * Declare the `PreviewLoader` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <atomic>
+#include <functional>
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#ifndef _gui_previewloader_h_installed
+#define _gui_previewloader_h_installed
+
+/**
+ * \brief Loads and scales preview images in the background
+ * 
+ * A preview request names a file, the largest size that the file should be
+ * decoded at (usually the screen size), and the size of the display area.
+ * The file is decoded in a background thread (unless the client already has
+ * the decoded image and passes it in), and then smoothly scaled to fit the
+ * display area, also in the background. The results are delivered in the
+ * thread of the loader (i.e. the GUI thread) by the `ready` signal.
+ * 
+ * Only the most recent request matters: a new request supersedes any
+ * earlier one that hasn't finished. Superseded requests are skipped if they
+ * haven't started, abandoned between decoding and scaling if they have, and
+ * their results are never delivered.
+ * 
+ * Previews are loaded on a thread pool belonging to the loader, so they
+ * don't wait behind any other background work (e.g. thumbnail loads).
+ * 
+ * To make browsing through a sequence of files instant, the client can
+ * also ask for files to be *prefetched* (usually the neighbours of the
+ * selected file). These are decoded at a lower priority than requests, and
+ * kept in a small least-recently-used cache with a memory budget, along
+ * with the images decoded for requests. A request for a file that is in
+ * the cache only needs scaling, and a request for a file that is being
+ * prefetched waits for the prefetch rather than decoding the file again.
+ */
+class PreviewLoader : public QObject
+{
+
+    Q_OBJECT
+
+    public:
+
+    /**
+     * \brief Standard constructor for Qt classes / objects
+     * 
+     * \param parent The parent of the object
+     */
+    explicit PreviewLoader(QObject* parent = nullptr);
+
+    /**
+     * \brief Destructor, waiting for any running background work
+     */
+    virtual ~PreviewLoader(void);
+
+    /**
+     * \brief Request a preview, superseding any earlier request
+     * 
+     * \param path The path of the image file
+     * 
+     * \param source The decoded image, if the client already has it; if
+     * this is null, the file is decoded
+     * 
+     * \param maxSize The largest size at which the file should be decoded
+     * 
+     * \param displaySize The size that the preview must fit
+     */
+    void request(
+        const QString& path
+        , const QImage& source
+        , const QSize& maxSize
+        , const QSize& displaySize);
+
+    /**
+     * \brief Decode files in the background, ready for requests
+     * 
+     * This supersedes any earlier prefetch: files from earlier calls that
+     * have not started decoding are skipped unless they are in this list.
+     * 
+     * \param paths The paths of the files, most wanted first
+     * 
+     * \param maxSize The largest size at which the files should be decoded
+     */
+    void prefetch(const QStringList& paths, const QSize& maxSize);
+
+    /**
+     * \brief Set the memory budget for cached decoded images
+     * 
+     * \param bytes The approximate maximum number of bytes of image data
+     * to hold in the cache
+     */
+    void setCacheBudget(qint64 bytes)
+        { m_cache.setMaxCost(static_cast<int>(bytes / 1024)); }
+
+    signals:
+
+    /**
+     * \brief Signal that a requested preview is ready
+     * 
+     * \param path The path of the image file
+     * 
+     * \param source The decoded image (null if the file couldn't be
+     * decoded)
+     * 
+     * \param scaled The decoded image, smoothly scaled to fit the display
+     * size
+     * 
+     * \param displaySize The display size that was requested
+     */
+    void ready(
+        const QString& path
+        , const QImage& source
+        , const QImage& scaled
+        , const QSize& displaySize);
+
+    protected:
+
+    /**
+     * \brief Deliver the results of a request, unless it has been
+     * superseded
+     */
+    void onFinished(
+        quint64 ticket
+        , const QString& path
+        , const QImage& source
+        , const QImage& scaled
+        , const QSize& displaySize);
+
+    /**
+     * \brief Handle the result of a prefetch
+     */
+    void onPrefetched(const QString& path, const QImage& image);
+
+    /**
+     * \brief Add a decoded image to the cache
+     */
+    void cacheImage(const QString& path, const QImage& image);
+
+    /**
+     * \brief Run a function on the thread pool with the given priority
+     */
+    void start(std::function<void(void)> fn, int priority);
+
+    /**
+     * \brief A request that is waiting for a prefetch of its file
+     */
+    struct DeferredRequest
+    {
+        quint64 ticket;         ///< The ticket of the request
+        QString path;           ///< The path of the file
+        QSize maxSize;          ///< The maximum decoding size
+        QSize displaySize;      ///< The display size
+    };  // end DeferredRequest struct
+
+    DeferredRequest m_deferred;     ///< The request waiting for a prefetch
+
+    QCache<QString, QImage> m_cache;    ///< Decoded images, cost in KiB
+
+    QSet<QString> m_prefetching;    ///< Paths queued or being prefetched
+
+    /**
+     * \brief The paths of the most recent prefetch call
+     * 
+     * This is shared with worker threads (under `m_wantedMutex`), so that
+     * they can skip prefetches that are no longer wanted.
+     */
+    QSet<QString> m_wanted;
+    QMutex m_wantedMutex;           ///< Protects `m_wanted`
+
+    /**
+     * \brief The ticket of the most recent request
+     * 
+     * This is atomic because worker threads read it to skip superseded
+     * work.
+     */
+    std::atomic<quint64> m_latestTicket;
+
+    /**
+     * \brief The thread pool for loading previews
+     * 
+     * This is declared last, so that it is destroyed first, waiting for any
+     * running work while the rest of the object is still intact.
+     */
+    QThreadPool m_pool;
+
+};  // end PreviewLoader class
+
+#endif
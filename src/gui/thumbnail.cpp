@@ -0,0 +1,469 @@
+/**
+ * \file thumbnail.cpp
+ * Implement functionality for loading reduced-size thumbnail images
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageIOHandler>
+#include <QImageReader>
+#include <QStandardPaths>
+#include <QTransform>
+
+#include <api/batch_reader.h>
+#include <api/exif.h>
+#include <api/similarity.h>
+
+#include "thumbnail.h"
+
+namespace {
+
+/**
+ * \brief Apply an EXIF orientation to an image, in the same order as the
+ * Qt image reader does (mirroring first, then rotation)
+ */
+QImage applyTransformation(
+        QImage image
+        , QImageIOHandler::Transformations transformation)
+{
+    if (transformation & QImageIOHandler::TransformationMirror)
+        image = image.mirrored(true, false);
+    if (transformation & QImageIOHandler::TransformationFlip)
+        image = image.mirrored(false, true);
+    if (transformation & QImageIOHandler::TransformationRotate90)
+        image = image.transformed(QTransform().rotate(90));
+
+    return image;
+}   // end applyTransformation function
+
+/**
+ * \brief The largest file that is read into memory ahead of decoding;
+ * bigger ones are decoded straight from the file
+ */
+const std::uint64_t maxReadAhead = 64 * 1024 * 1024;
+
+/**
+ * \brief Load the preview image embedded in the EXIF data of a JPEG file,
+ * if there is one that is good enough to stand in for the main image
+ * 
+ * \param header The start of the JPEG file (see `api::exif::header_size`)
+ * 
+ * \param fullSize The size of the main image, as stored
+ * 
+ * \param target The size of the required thumbnail, as stored
+ * 
+ * \return The (unoriented) preview image, or a null image if there is no
+ * suitable preview
+ */
+QImage loadExifThumbnail(
+        const QByteArray& header
+        , const QSize& fullSize
+        , const QSize& target)
+{
+    api::exif::thumbnail_location location;
+    if (!api::exif::find_thumbnail(
+            reinterpret_cast<const unsigned char*>(header.constData())
+            , static_cast<std::size_t>(header.size())
+            , location))
+        return QImage();
+
+    QImage preview = QImage::fromData(
+        reinterpret_cast<const uchar*>(header.constData()) + location.offset
+        , static_cast<int>(location.length)
+        , "JPEG");
+
+    if (preview.isNull()) return QImage();
+
+    // The preview must be big enough that it isn't scaled up, and must not
+    // have been letter-boxed to a different aspect ratio.
+    if (preview.width() < target.width()
+            || preview.height() < target.height())
+        return QImage();
+
+    double fullAspect = double(fullSize.width()) / fullSize.height()
+        , previewAspect = double(preview.width()) / preview.height();
+    if (qAbs(fullAspect - previewAspect) > 0.02 * fullAspect) return QImage();
+
+    return preview;
+}   // end loadExifThumbnail function
+
+/**
+ * \brief Decode an image with an image reader, as a step towards a
+ * thumbnail
+ * 
+ * The image is decoded at the smallest size that is cheap to get and no
+ * smaller than the thumbnail; it is finished by `scaleThumbnail`.
+ * 
+ * \param reader The reader, for the file or for its contents
+ * 
+ * \param data The contents of the file, if they have already been read;
+ * otherwise, the file's header is read from the file if it is needed
+ * 
+ * \param size The size of the box that the thumbnail must fit into
+ * 
+ * \param decoded Set to the decoded image and how to finish it
+ */
+void decodeWith(
+        QImageReader& reader
+        , const QByteArray& data
+        , const QSize& size
+        , DecodedThumbnail& decoded)
+{
+    reader.setAutoTransform(true);
+
+    // Sizes reported by the reader are as stored in the file, before the
+    // EXIF orientation is applied, so a rotated image needs a rotated box.
+    QSize fullSize = reader.size();
+    auto transformation = reader.transformation();
+    bool rotated = transformation & QImageIOHandler::TransformationRotate90;
+
+    QSize box = size;
+    if (rotated) box.transpose();
+
+    // The format doesn't report its size up-front, so we have no choice but
+    // to read the whole image, and fit it into the box afterwards.
+    if (fullSize.isEmpty())
+    {
+        decoded.image = reader.read();
+        return;
+    }
+
+    QSize target = fullSize.scaled(box, Qt::KeepAspectRatio);
+
+    // Don't enlarge images that are already small
+    if (fullSize.width() <= target.width()
+            && fullSize.height() <= target.height())
+    {
+        decoded.image = reader.read();
+        return;
+    }
+
+    if (reader.format() == "jpeg")
+    {
+        // The header comes from the data if it has already been read
+        // (without copying it), or else from the file
+        QByteArray header;
+        if (data.isEmpty())
+        {
+            QFile file(decoded.path);
+            if (file.open(QIODevice::ReadOnly))
+                header = file.read(api::exif::header_size);
+        }
+        else header = QByteArray::fromRawData(
+            data.constData()
+            , qMin(data.size(), int(api::exif::header_size)));
+
+        // The preview isn't oriented by the reader, so that is left to the
+        // scale step too
+        QImage preview = loadExifThumbnail(header, fullSize, target);
+        if (!preview.isNull())
+        {
+            decoded.image = preview;
+            decoded.target = target;
+            decoded.transformation = transformation;
+            return;
+        }
+
+        // Let the decoder use DCT scaling, which reduces by powers of two
+        // down to 1/8, as far as it can without going below the target
+        int scale = 1;
+        while (scale < 8
+                && fullSize.width() / (2 * scale) >= target.width()
+                && fullSize.height() / (2 * scale) >= target.height())
+            scale *= 2;
+
+        reader.setScaledSize(QSize(
+            (fullSize.width() + scale - 1) / scale
+            , (fullSize.height() + scale - 1) / scale));
+    }
+    else if (reader.supportsOption(QImageIOHandler::ScaledSize))
+    {
+        // Other formats that can decode at a smaller size (e.g. SVG) are
+        // asked for the target straight away; the rest are decoded in full
+        reader.setScaledSize(target);
+    }
+
+    // The reader applies the orientation, so the target must be oriented
+    // to match
+    decoded.image = reader.read();
+    decoded.target = rotated ? target.transposed() : target;
+}   // end decodeWith function
+
+/**
+ * \brief Whether a file looks like an image that can be read, from its
+ * header or its extension
+ */
+bool looksLikeImage(QByteArray header, const QString& suffix)
+{
+    QBuffer buffer(&header);
+    buffer.open(QIODevice::ReadOnly);
+    return !QImageReader::imageFormat(&buffer).isEmpty()
+        || QImageReader::supportedImageFormats().contains(
+            suffix.toLower().toLatin1());
+}   // end looksLikeImage function
+
+/**
+ * \brief Add a newly made thumbnail to the store, encoded as JPEG (or PNG
+ * if it has an alpha channel)
+ */
+void storeThumbnail(
+        api::thumbnail_store& store
+        , const DecodedThumbnail& decoded
+        , const QSize& size
+        , const QImage& image)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+
+    bool alpha = image.hasAlphaChannel();
+    if (image.save(&buffer, alpha ? "PNG" : "JPG", alpha ? -1 : 85))
+        store.store(
+            decoded.path.toStdString()
+            , decoded.fileSize
+            , decoded.mtime
+            , static_cast<unsigned>(size.width())
+            , static_cast<unsigned>(size.height())
+            , reinterpret_cast<const unsigned char*>(data.constData())
+            , static_cast<std::size_t>(data.size()));
+}   // end storeThumbnail function
+
+}   // end anonymous namespace
+
+QImage loadThumbnail(const QString& path, const QSize& size)
+{
+    EncodedThumbnail encoded;
+    encoded.path = path;
+    encoded.deferred = true;
+    return scaleThumbnail(decodeThumbnail(encoded, size), size, nullptr);
+}   // end loadThumbnail function
+
+QImage loadThumbnail(
+        const QString& path
+        , const QSize& size
+        , api::thumbnail_store& store)
+{
+    return scaleThumbnail(
+        decodeThumbnail(readThumbnail(path, size, &store), size)
+        , size
+        , &store);
+}   // end loadThumbnail function
+
+EncodedThumbnail readThumbnail(
+        const QString& path
+        , const QSize& size
+        , api::thumbnail_store* store)
+{
+    return readThumbnails(QStringList{path}, size, store).front();
+}   // end readThumbnail function
+
+std::vector<EncodedThumbnail> readThumbnails(
+        const QStringList& paths
+        , const QSize& size
+        , api::thumbnail_store* store)
+{
+    std::vector<EncodedThumbnail> encoded(static_cast<std::size_t>(
+        paths.size()));
+    auto formats = QImageReader::supportedImageFormats();
+
+    // Each request is for the file at the same position in `owners`
+    std::vector<api::read_request> requests;
+    std::vector<std::size_t> owners;
+
+    for (std::size_t i = 0; i < encoded.size(); ++i)
+    {
+        auto& e = encoded[i];
+        e.path = paths[static_cast<int>(i)];
+
+        QFileInfo info(e.path);
+        e.fileSize = static_cast<std::uint64_t>(info.size());
+        e.mtime = info.lastModified().toMSecsSinceEpoch();
+
+        std::vector<unsigned char> data;
+        if (store && store->lookup(
+                e.path.toStdString()
+                , e.fileSize
+                , e.mtime
+                , static_cast<unsigned>(size.width())
+                , static_cast<unsigned>(size.height())
+                , data))
+        {
+            e.data = QByteArray(
+                reinterpret_cast<const char*>(data.data())
+                , static_cast<int>(data.size()));
+            e.stored = true;
+            continue;
+        }
+
+        if (e.fileSize > maxReadAhead)
+        {
+            e.deferred = true;
+            continue;
+        }
+
+        // Files that aren't obviously images (e.g. videos) are given up on
+        // after their header, rather than read in full
+        api::read_request request;
+        request.path = e.path.toStdString();
+        if (!formats.contains(info.suffix().toLower().toLatin1()))
+            request.length = api::exif::header_size;
+
+        requests.push_back(std::move(request));
+        owners.push_back(i);
+    }
+
+    // Each thread has its own reader, and so its own `io_uring`, which is
+    // set up once rather than for every batch
+    thread_local api::batch_reader reader;
+
+    std::vector<api::read_request> rest;
+    std::vector<std::size_t> restOwners;
+
+    // Every file is reported, even if the `io_uring` fails part way through
+    reader.read(requests, [&](std::size_t r, api::read_result&& result)
+    {
+        // A file that changed size since it was looked at is still being
+        // written, so it is left for later
+        auto& e = encoded[owners[r]];
+        if (result.error != 0 || result.file_size != e.fileSize)
+        {
+            e.readFailed = true;
+            return;
+        }
+
+        e.data = QByteArray(
+            reinterpret_cast<const char*>(result.data.data())
+            , static_cast<int>(result.data.size()));
+        if (!looksLikeImage(e.data, QFileInfo(e.path).suffix()))
+            e.data.clear();
+        else if (requests[r].length != api::read_request::whole_file
+                && result.data.size() < result.file_size)
+        {
+            api::read_request request;
+            request.path = requests[r].path;
+            request.offset = result.data.size();
+            rest.push_back(std::move(request));
+            restOwners.push_back(owners[r]);
+        }
+    });
+
+    reader.read(rest, [&](std::size_t r, api::read_result&& result)
+    {
+        // The header alone would decode as a truncated image, and so would
+        // a file that changed between the two reads
+        auto& e = encoded[restOwners[r]];
+        e.data.append(
+            reinterpret_cast<const char*>(result.data.data())
+            , static_cast<int>(result.data.size()));
+        if (result.error != 0
+                || static_cast<std::uint64_t>(e.data.size())
+                    != result.file_size)
+        {
+            e.data.clear();
+            e.readFailed = true;
+        }
+    });
+
+    return encoded;
+}   // end readThumbnails function
+
+DecodedThumbnail decodeThumbnail(
+        const EncodedThumbnail& encoded
+        , const QSize& size)
+{
+    DecodedThumbnail decoded;
+    decoded.path = encoded.path;
+    decoded.fileSize = encoded.fileSize;
+    decoded.mtime = encoded.mtime;
+    decoded.readFailed = encoded.readFailed;
+
+    if (encoded.stored)
+    {
+        decoded.image = QImage::fromData(encoded.data);
+        decoded.stored = !decoded.image.isNull();
+    }
+
+    // A damaged thumbnail in the store is made again, from the file
+    if (decoded.stored) return decoded;
+    if (encoded.stored || encoded.deferred)
+    {
+        QImageReader reader(encoded.path);
+        decodeWith(reader, QByteArray(), size, decoded);
+        decoded.readFailed = decoded.image.isNull()
+            && (reader.error() == QImageReader::FileNotFoundError
+                || reader.error() == QImageReader::DeviceError);
+    }
+    else if (!encoded.data.isEmpty())
+    {
+        // The file name's extension is a hint for formats that can't be
+        // recognised from their contents
+        QBuffer buffer;
+        buffer.setData(encoded.data);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(
+            &buffer
+            , QFileInfo(encoded.path).suffix().toLower().toLatin1());
+        decodeWith(reader, encoded.data, size, decoded);
+    }
+
+    return decoded;
+}   // end decodeThumbnail function
+
+QImage scaleThumbnail(
+        const DecodedThumbnail& decoded
+        , const QSize& size
+        , api::thumbnail_store* store)
+{
+    QImage image = decoded.image;
+    if (image.isNull() || decoded.stored || decoded.readFailed) return image;
+
+    if (decoded.target.isValid())
+    {
+        if (image.size() != decoded.target)
+            image = image.scaled(
+                decoded.target
+                , Qt::IgnoreAspectRatio
+                , Qt::SmoothTransformation);
+    }
+    else if (image.width() > size.width() || image.height() > size.height())
+        image = image.scaled(
+            size
+            , Qt::KeepAspectRatio
+            , Qt::SmoothTransformation);
+
+    image = applyTransformation(image, decoded.transformation);
+
+    if (store) storeThumbnail(*store, decoded, size, image);
+    return image;
+}   // end scaleThumbnail function
+
+std::uint64_t perceptualHash(const QImage& image)
+{
+    QImage gray = image.convertToFormat(QImage::Format_Grayscale8);
+    return api::similarity::dhash(
+        gray.constBits()
+        , static_cast<unsigned>(gray.width())
+        , static_cast<unsigned>(gray.height())
+        , static_cast<std::size_t>(gray.bytesPerLine()));
+}   // end perceptualHash function
+
+QString thumbnailStorePath(void)
+{
+    return QStandardPaths::writableLocation(
+        QStandardPaths::GenericCacheLocation) + "/MediaIndex/thumbnails";
+}   // end thumbnailStorePath function
+
+QString mediaIndexPath(void)
+{
+    return QStandardPaths::writableLocation(
+        QStandardPaths::GenericDataLocation) + "/MediaIndex/media.idx";
+}   // end mediaIndexPath function
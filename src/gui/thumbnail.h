@@ -0,0 +1,264 @@
+/**
+ * \file thumbnail.h
+ * Declare functionality for loading reduced-size thumbnail images
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <QByteArray>
+#include <QImage>
+#include <QImageIOHandler>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+#include <api/thumbnail_store.h>
+
+#ifndef _gui_thumbnail_h_included
+#define _gui_thumbnail_h_included
+
+/**
+ * \brief Load an image file as a thumbnail that fits within a given size
+ * 
+ * This is much cheaper than loading the whole image and scaling it down.
+ * Where a JPEG file has a preview image embedded in its EXIF data that is
+ * big enough, that preview is decoded instead of the main image. Otherwise,
+ * the image reader is asked for a scaled image, which allows the JPEG
+ * decoder to use DCT scaling, so that the full-resolution image is never
+ * held in memory.
+ * 
+ * Images are oriented according to their EXIF data, and images that are
+ * already smaller than the requested size are not scaled up.
+ * 
+ * This function is thread-safe, and is intended to be called from a
+ * background thread. It returns a `QImage` rather than a `QPixmap`, because
+ * pixmaps may only be created in the GUI thread.
+ * 
+ * \param path The path of the image file
+ * 
+ * \param size The size of the box that the thumbnail must fit into
+ * 
+ * \return The thumbnail image; this is a null image if the file could not
+ * be read as an image
+ */
+extern QImage loadThumbnail(const QString& path, const QSize& size);
+
+/**
+ * \brief Load a thumbnail through a persistent thumbnail store
+ * 
+ * The store is checked first, using the current size and modification time
+ * of the file, so a thumbnail that was made on a previous run is used
+ * without decoding the image again. If there is no up-to-date thumbnail in
+ * the store, the image is loaded using the other overload of this
+ * function, and the result is encoded (as JPEG, or PNG if it has an alpha
+ * channel) and added to the store.
+ * 
+ * This function is thread-safe.
+ * 
+ * \param path The path of the image file
+ * 
+ * \param size The size of the box that the thumbnail must fit into
+ * 
+ * \param store The store of previously made thumbnails
+ * 
+ * \return The thumbnail image; this is a null image if the file could not
+ * be read as an image
+ */
+extern QImage loadThumbnail(
+    const QString& path
+    , const QSize& size
+    , api::thumbnail_store& store);
+
+/**
+ * \brief The bytes of an image file, read ahead of decoding it
+ * 
+ * Loading a thumbnail is split into reading (`readThumbnail`), decoding
+ * (`decodeThumbnail`) and scaling (`scaleThumbnail`), so that the steps
+ * can be run by separate threads: reads spend their time waiting for the
+ * disk, and how many are worth running at once depends on the storage,
+ * while decodes and scales keep a core busy.
+ */
+struct EncodedThumbnail
+{
+    QString path;               ///< The path of the image file
+
+    /**
+     * \brief The contents of the file, or a thumbnail from the store; empty
+     * if the file couldn't be read, or isn't an image
+     */
+    QByteArray data;
+
+    bool stored = false;        ///< Whether `data` came from the store
+
+    /**
+     * \brief Whether the file was too big to be read ahead, so it is
+     * decoded straight from the file
+     */
+    bool deferred = false;
+
+    /**
+     * \brief Whether the file couldn't be read (or changed while it was
+     * being read), so it is worth trying again later
+     */
+    bool readFailed = false;
+
+    std::uint64_t fileSize = 0; ///< The size of the file
+    std::int64_t mtime = 0;     ///< The file's modification time, in ms
+};  // end EncodedThumbnail struct
+
+/**
+ * \brief An image decoded by `decodeThumbnail`, ready to be made into a
+ * thumbnail by `scaleThumbnail`
+ */
+struct DecodedThumbnail
+{
+    QString path;               ///< The path of the image file
+
+    /**
+     * \brief The decoded image; null if the file couldn't be decoded
+     */
+    QImage image;
+
+    /**
+     * \brief The size to scale the image to; if this is invalid, the image
+     * is only scaled down to fit the thumbnail box
+     */
+    QSize target;
+
+    /**
+     * \brief The orientation to apply to the image once it is scaled
+     */
+    QImageIOHandler::Transformations transformation =
+        QImageIOHandler::TransformationNone;
+
+    bool stored = false;        ///< Whether the image came from the store
+
+    /**
+     * \brief Whether the image is null because the file couldn't be read,
+     * rather than because it isn't an image that can be decoded
+     */
+    bool readFailed = false;
+
+    std::uint64_t fileSize = 0; ///< The size of the file
+    std::int64_t mtime = 0;     ///< The file's modification time, in ms
+};  // end DecodedThumbnail struct
+
+/**
+ * \brief Read an image file (or its stored thumbnail) ready for decoding
+ * 
+ * If there is a store with an up-to-date thumbnail of the right size, that
+ * is read instead of the file. Only files that look like images are read
+ * in full.
+ * 
+ * This function is thread-safe.
+ * 
+ * \param path The path of the image file
+ * 
+ * \param size The size of the box that the thumbnail must fit into
+ * 
+ * \param store The store of previously made thumbnails; this may be null
+ */
+extern EncodedThumbnail readThumbnail(
+    const QString& path
+    , const QSize& size
+    , api::thumbnail_store* store);
+
+/**
+ * \brief Read a number of image files at once, in the same way as
+ * `readThumbnail`
+ * 
+ * The files are read together by an `api::batch_reader`, so the reads are
+ * in flight at the same time (through `io_uring`, where it is available).
+ * Files whose extensions are those of image formats are read whole
+ * straight away; the others are read in full only if their headers turn
+ * out to be those of images.
+ * 
+ * This function is thread-safe.
+ * 
+ * \param paths The paths of the image files
+ * 
+ * \param size The size of the box that the thumbnails must fit into
+ * 
+ * \param store The store of previously made thumbnails; this may be null
+ * 
+ * \return What was read for each file, in the same order as `paths`
+ */
+extern std::vector<EncodedThumbnail> readThumbnails(
+    const QStringList& paths
+    , const QSize& size
+    , api::thumbnail_store* store);
+
+/**
+ * \brief Decode an image from the bytes read by `readThumbnail`
+ * 
+ * The image is only decoded as far as is cheap: JPEG images are decoded
+ * with DCT scaling to the nearest size at or above the thumbnail (or from
+ * their EXIF preview), and other images at full size unless their format
+ * can decode at a smaller size.
+ * 
+ * This function is thread-safe.
+ * 
+ * \param encoded The bytes that were read
+ * 
+ * \param size The size of the box that the thumbnail must fit into
+ */
+extern DecodedThumbnail decodeThumbnail(
+    const EncodedThumbnail& encoded
+    , const QSize& size);
+
+/**
+ * \brief Make a thumbnail from an image decoded by `decodeThumbnail`
+ * 
+ * The image is scaled and oriented, and, if it didn't come from the store,
+ * added to the store in the same way as by `loadThumbnail`. Nothing is
+ * stored for a file that couldn't be read.
+ * 
+ * This function is thread-safe.
+ * 
+ * \param decoded The decoded image
+ * 
+ * \param size The size of the box that the thumbnail must fit into
+ * 
+ * \param store The store of previously made thumbnails; this may be null
+ * 
+ * \return The thumbnail image; this is a null image if the file could not
+ * be read as an image
+ */
+extern QImage scaleThumbnail(
+    const DecodedThumbnail& decoded
+    , const QSize& size
+    , api::thumbnail_store* store);
+
+/**
+ * \brief Calculate the perceptual hash of an image (see
+ * `api::similarity::dhash`)
+ * 
+ * The hash only needs a small image, so this is normally given a
+ * thumbnail.
+ * 
+ * \param image The image; this must not be null
+ * 
+ * \return The hash
+ */
+extern std::uint64_t perceptualHash(const QImage& image);
+
+/**
+ * \brief Retrieve the path of the directory for the persistent thumbnail
+ * store, which is shared by all *MediaIndex* executables
+ */
+extern QString thumbnailStorePath(void);
+
+/**
+ * \brief Retrieve the path of the persistent media index file, which is
+ * shared by all *MediaIndex* executables
+ */
+extern QString mediaIndexPath(void);
+
+#endif
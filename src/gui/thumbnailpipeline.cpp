@@ -0,0 +1,314 @@
+/**
+ * \file thumbnailpipeline.cpp
+ * Implement the `ThumbnailPipeline` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <utility>
+#include <vector>
+
+#include <QMutexLocker>
+#include <QThread>
+#include <QtConcurrent>
+
+#include "thumbnailpipeline.h"
+
+ThumbnailPipeline::ThumbnailPipeline(QObject* parent) :
+        QObject(parent)
+        , m_mutex()
+        , m_stages(std::make_shared<const Stages>())
+        , m_queues()
+        , m_queueDepth(2)
+        , m_readBatch(8)
+        , m_handOffBatch(16)
+        , m_epoch(0)
+        , m_handOffPosted(false)
+        , m_readyPosted(false)
+{
+    for (int stage = 0; stage < StageCount; ++stage)
+    {
+        m_running[stage] = 0;
+        m_pending[stage] = 0;
+    }
+
+    // Decoding keeps a core busy, and scaling a decoded image takes a
+    // fraction of the time that decoding it did
+    m_threads[ReadStage] = 4;
+    m_threads[DecodeStage] = qMax(1, QThread::idealThreadCount());
+    m_threads[ScaleStage] = 2;
+
+    for (int stage = 0; stage < StageCount; ++stage)
+        m_pools[stage].setMaxThreadCount(m_threads[stage]);
+}
+
+ThumbnailPipeline::~ThumbnailPipeline(void)
+{
+    cancel();
+
+    // Running jobs can't pass anything on once they are cancelled, so each
+    // pool only needs waiting for once
+    for (auto& pool : m_pools) pool.waitForDone();
+}
+
+void ThumbnailPipeline::setStages(
+        Reader reader
+        , Decoder decoder
+        , Scaler scaler)
+{
+    auto stages = std::make_shared<Stages>();
+    stages->reader = std::move(reader);
+    stages->decoder = std::move(decoder);
+    stages->scaler = std::move(scaler);
+
+    QMutexLocker lock(&m_mutex);
+    m_stages = std::move(stages);
+}   // end setStages method
+
+void ThumbnailPipeline::setThreads(Stage stage, int threads)
+{
+    QMutexLocker lock(&m_mutex);
+    m_threads[stage] = qMax(1, threads);
+    m_pools[stage].setMaxThreadCount(m_threads[stage]);
+    pump();
+}   // end setThreads method
+
+int ThumbnailPipeline::threads(Stage stage) const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_threads[stage];
+}   // end threads method
+
+void ThumbnailPipeline::setQueueDepth(int depth)
+{
+    QMutexLocker lock(&m_mutex);
+    m_queueDepth = qMax(1, depth);
+    pump();
+}   // end setQueueDepth method
+
+void ThumbnailPipeline::setReadBatch(int files)
+{
+    QMutexLocker lock(&m_mutex);
+    m_readBatch = qMax(1, files);
+    pump();
+}   // end setReadBatch method
+
+int ThumbnailPipeline::readBatch(void) const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_readBatch;
+}   // end readBatch method
+
+void ThumbnailPipeline::setHandOffBatch(int results)
+{
+    QMutexLocker lock(&m_mutex);
+    m_handOffBatch = qMax(1, results);
+    pump();
+}   // end setHandOffBatch method
+
+int ThumbnailPipeline::handOffBatch(void) const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_handOffBatch;
+}   // end handOffBatch method
+
+bool ThumbnailPipeline::canSubmit(void) const
+{
+    QMutexLocker lock(&m_mutex);
+    return static_cast<int>(m_queues[ReadStage].size())
+        < capacity(ReadStage);
+}   // end canSubmit method
+
+void ThumbnailPipeline::submit(quint64 ticket, const QString& path)
+{
+    Job job;
+    job.ticket = ticket;
+    job.path = path;
+
+    QMutexLocker lock(&m_mutex);
+    job.epoch = m_epoch;
+    job.stages = m_stages;
+    m_queues[ReadStage].push_back(std::move(job));
+    pump();
+}   // end submit method
+
+void ThumbnailPipeline::cancel(void)
+{
+    QMutexLocker lock(&m_mutex);
+    ++m_epoch;
+    for (auto& queue : m_queues) queue.clear();
+}   // end cancel method
+
+int ThumbnailPipeline::capacity(int stage) const
+{
+    return stage == StageCount
+        ? 2 * m_handOffBatch
+        : m_queueDepth * m_threads[stage] * batchSize(stage);
+}   // end capacity method
+
+int ThumbnailPipeline::batchSize(int stage) const
+{
+    return stage == ReadStage ? m_readBatch : 1;
+}   // end batchSize method
+
+void ThumbnailPipeline::pump(void)
+{
+    // Later stages go first, so that the room they make is used straight
+    // away by the stages before them
+    for (int stage = StageCount - 1; stage >= 0; --stage)
+    {
+        auto& queue = m_queues[stage];
+        const auto& next = m_queues[stage + 1];
+
+        // Running jobs have room kept for their results
+        while (!queue.empty() && m_running[stage] < m_threads[stage])
+        {
+            int room = capacity(stage + 1)
+                - static_cast<int>(next.size()) - m_pending[stage];
+            if (room <= 0) break;
+            auto count = static_cast<std::size_t>(qMin(room, batchSize(stage)));
+
+            // A batch only holds jobs that use the same functions
+            std::vector<Job> jobs;
+            auto stages = queue.front().stages;
+            while (jobs.size() < count
+                    && !queue.empty()
+                    && queue.front().stages == stages)
+            {
+                jobs.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+
+            ++m_running[stage];
+            m_pending[stage] += static_cast<int>(jobs.size());
+
+            QtConcurrent::run(&m_pools[stage], [this, stage, jobs]{
+                run(stage, jobs);
+            });
+
+            if (stage == ReadStage && !m_readyPosted)
+            {
+                m_readyPosted = true;
+                QMetaObject::invokeMethod(
+                    this
+                    , [this]{
+                        {
+                            QMutexLocker lock(&m_mutex);
+                            m_readyPosted = false;
+                        }
+                        emit readyForMore();
+                    }
+                    , Qt::QueuedConnection);
+            }
+        }
+    }
+}   // end pump method
+
+void ThumbnailPipeline::run(int stage, std::vector<Job> jobs)
+{
+    // Everything in a batch was queued, and so submitted, in one epoch
+    bool cancelled;
+    {
+        QMutexLocker lock(&m_mutex);
+        cancelled = jobs.front().epoch != m_epoch;
+    }
+
+    // Each stage lets go of what the one before it made, so that only one
+    // copy of a file is held at a time
+    const auto& stages = *jobs.front().stages;
+    switch (stage)
+    {
+        case ReadStage:
+            if (!cancelled && stages.reader)
+            {
+                QStringList paths;
+                for (const auto& job : jobs) paths << job.path;
+
+                auto encoded = stages.reader(paths);
+                for (std::size_t i = 0;
+                        i < jobs.size() && i < encoded.size();
+                        ++i)
+                    jobs[i].encoded = std::move(encoded[i]);
+            }
+            break;
+
+        case DecodeStage:
+            for (auto& job : jobs)
+            {
+                if (!cancelled && stages.decoder)
+                    job.decoded = stages.decoder(job.encoded);
+                job.encoded = EncodedThumbnail();
+            }
+            break;
+
+        default:
+            for (auto& job : jobs)
+            {
+                if (!cancelled && stages.scaler)
+                    job.image = stages.scaler(job.decoded);
+                job.failed = job.decoded.readFailed;
+                job.decoded = DecodedThumbnail();
+            }
+            break;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    --m_running[stage];
+    m_pending[stage] -= static_cast<int>(jobs.size());
+    if (jobs.front().epoch == m_epoch)
+    {
+        for (auto& job : jobs)
+            m_queues[stage + 1].push_back(std::move(job));
+        if (stage + 1 == StageCount) postHandOff();
+    }
+    pump();
+}   // end run method
+
+void ThumbnailPipeline::postHandOff(void)
+{
+    if (m_handOffPosted) return;
+
+    m_handOffPosted = true;
+    QMetaObject::invokeMethod(
+        this
+        , [this]{ handOff(); }
+        , Qt::QueuedConnection);
+}   // end postHandOff method
+
+void ThumbnailPipeline::handOff(void)
+{
+    std::vector<Job> batch;
+    quint64 epoch;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_handOffPosted = false;
+
+        auto& queue = m_queues[StageCount];
+        while (!queue.empty()
+                && static_cast<int>(batch.size()) < m_handOffBatch)
+        {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+
+        // The rest wait for the next turn of the event loop
+        if (!queue.empty()) postHandOff();
+        pump();
+        epoch = m_epoch;
+    }
+
+    // A receiver may cancel part way through the batch
+    for (const auto& job : batch)
+    {
+        if (job.epoch != epoch) break;
+        if (job.failed) emit failed(job.ticket);
+        else emit finished(job.ticket, job.image);
+
+        QMutexLocker lock(&m_mutex);
+        epoch = m_epoch;
+    }
+}   // end handOff method
@@ -0,0 +1,308 @@
+/**
+ * \file thumbnailpipeline.h
+ * Declare the `ThumbnailPipeline` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "thumbnail.h"
+
+#ifndef _gui_thumbnailpipeline_h_installed
+#define _gui_thumbnailpipeline_h_installed
+
+/**
+ * \brief Makes thumbnails in stages, each with its own threads, joined by
+ * bounded queues
+ * 
+ * Each thumbnail goes through three stages, run by functions supplied by
+ * the client: the file is *read* (see `readThumbnails`), *decoded* (see
+ * `decodeThumbnail`) and *scaled* (see `scaleThumbnail`). The result is
+ * then *handed off* to the pipeline's thread (normally the GUI thread),
+ * which reports it with `finished`, or with `failed` if the file couldn't
+ * be read.
+ * 
+ * Files are read in batches of up to `readBatch`, so that the reader can
+ * keep many reads in flight at once; a batch is started with whatever is
+ * queued when a read thread is free, rather than waiting for it to fill.
+ * 
+ * Each stage has its own pool of threads (see `setThreads`), and its own
+ * queue of work waiting for them. The queues are bounded: a stage only
+ * starts work when there is room for the result in the queue of the next
+ * stage, so when a stage falls behind, the stages before it stop rather
+ * than piling up decoded images in memory, and work only enters the
+ * pipeline (see `submit`) when the read queue has room. So slow reads
+ * don't leave the decode threads idle while there is work read ahead, and
+ * the decode threads can't flood the GUI thread with more results than it
+ * can make into icons.
+ * 
+ * Results are handed off in batches of at most `handOffBatch`, with a
+ * return to the event loop between batches, so that painting and input
+ * are handled while a flood of results is being worked through.
+ * 
+ * Work can be cancelled with `cancel`: queued work is dropped, and the
+ * results of running work are discarded, so jobs submitted before then are
+ * never reported with `finished` or `failed`.
+ */
+class ThumbnailPipeline : public QObject
+{
+
+    Q_OBJECT
+
+    public:
+
+    /**
+     * \brief The stages of the pipeline, in order
+     */
+    enum Stage
+    {
+        ReadStage = 0
+        , DecodeStage
+        , ScaleStage
+        , StageCount
+    };  // end Stage enum
+
+    /**
+     * \brief The type of function that reads a batch of files (in a read
+     * thread), returning what was read for each, in the same order
+     */
+    using Reader =
+        std::function<std::vector<EncodedThumbnail>(const QStringList&)>;
+
+    /**
+     * \brief The type of function that decodes what was read (in a decode
+     * thread)
+     */
+    using Decoder = std::function<DecodedThumbnail(const EncodedThumbnail&)>;
+
+    /**
+     * \brief The type of function that makes the thumbnail from the decoded
+     * image (in a scale thread), returning a null image if there is none
+     */
+    using Scaler = std::function<QImage(const DecodedThumbnail&)>;
+
+    /**
+     * \brief Standard constructor for Qt classes / objects
+     * 
+     * \param parent The parent of the object
+     */
+    explicit ThumbnailPipeline(QObject* parent = nullptr);
+
+    /**
+     * \brief Destructor, waiting for any running work
+     */
+    virtual ~ThumbnailPipeline(void);
+
+    /**
+     * \brief Set the functions that run the stages
+     * 
+     * These apply to jobs that are submitted after this is called.
+     */
+    void setStages(Reader reader, Decoder decoder, Scaler scaler);
+
+    /**
+     * \brief Set the number of threads that run a stage
+     * 
+     * The queue in front of the stage holds `queueDepth` jobs for each
+     * thread.
+     */
+    void setThreads(Stage stage, int threads);
+
+    /**
+     * \brief Retrieve the number of threads that run a stage
+     */
+    int threads(Stage stage) const;
+
+    /**
+     * \brief Set the number of jobs queued in front of each stage, for each
+     * of its threads
+     */
+    void setQueueDepth(int depth);
+
+    /**
+     * \brief Set the maximum number of files read together by a read
+     * thread
+     * 
+     * The read queue holds a batch for each job it would otherwise hold.
+     */
+    void setReadBatch(int files);
+
+    /**
+     * \brief Retrieve the maximum number of files read together by a read
+     * thread
+     */
+    int readBatch(void) const;
+
+    /**
+     * \brief Set the maximum number of results handed off to the
+     * pipeline's thread at a time
+     * 
+     * Twice as many results may wait to be handed off before the scale
+     * stage stops.
+     */
+    void setHandOffBatch(int results);
+
+    /**
+     * \brief Retrieve the maximum number of results handed off to the
+     * pipeline's thread at a time
+     */
+    int handOffBatch(void) const;
+
+    /**
+     * \brief Whether the read queue has room for another job
+     */
+    bool canSubmit(void) const;
+
+    /**
+     * \brief Queue a job to be read, regardless of whether there is room
+     * (see `canSubmit`)
+     * 
+     * \param ticket A number that identifies the job in `finished`
+     * 
+     * \param path The path of the file
+     */
+    void submit(quint64 ticket, const QString& path);
+
+    /**
+     * \brief Drop all queued work, and discard the results of running work
+     */
+    void cancel(void);
+
+    signals:
+
+    /**
+     * \brief Signal that a job has finished
+     * 
+     * \param ticket The ticket given to `submit`
+     * 
+     * \param image The thumbnail; this is a null image if the file isn't
+     * an image that can be decoded
+     */
+    void finished(quint64 ticket, const QImage& image);
+
+    /**
+     * \brief Signal that a job's file couldn't be read (see
+     * `DecodedThumbnail::readFailed`), so it may be worth trying again
+     * 
+     * \param ticket The ticket given to `submit`
+     */
+    void failed(quint64 ticket);
+
+    /**
+     * \brief Signal that room has been made in the read queue
+     */
+    void readyForMore(void);
+
+    private:
+
+    /**
+     * \brief The functions that run the stages
+     */
+    struct Stages
+    {
+        Reader reader;              ///< Runs the read stage
+        Decoder decoder;            ///< Runs the decode stage
+        Scaler scaler;              ///< Runs the scale stage
+    };  // end Stages struct
+
+    /**
+     * \brief A thumbnail on its way through the pipeline
+     */
+    struct Job
+    {
+        quint64 ticket;             ///< The job's ticket
+        quint64 epoch;              ///< The cancellation epoch of the job
+        QString path;               ///< The path of the file
+        std::shared_ptr<const Stages> stages;   ///< The functions to run
+        EncodedThumbnail encoded;   ///< The result of the read stage
+        DecodedThumbnail decoded;   ///< The result of the decode stage
+        QImage image;               ///< The result of the scale stage
+        bool failed = false;        ///< Whether the file couldn't be read
+    };  // end Job struct
+
+    /**
+     * \brief Retrieve the capacity of the queue in front of a stage, or of
+     * the hand-off queue for `StageCount` (with the mutex locked)
+     */
+    int capacity(int stage) const;
+
+    /**
+     * \brief Retrieve the most jobs that a thread of a stage works on at
+     * once (with the mutex locked)
+     */
+    int batchSize(int stage) const;
+
+    /**
+     * \brief Start queued work for every stage that has both a free thread
+     * and room for its result (with the mutex locked)
+     */
+    void pump(void);
+
+    /**
+     * \brief Run a stage for a batch of jobs (in a worker thread), and pass
+     * the jobs on
+     */
+    void run(int stage, std::vector<Job> jobs);
+
+    /**
+     * \brief Arrange for `handOff` to be called, if it isn't already (with
+     * the mutex locked)
+     */
+    void postHandOff(void);
+
+    /**
+     * \brief Report a batch of finished jobs (in the pipeline's thread)
+     */
+    void handOff(void);
+
+    /**
+     * \brief Guards everything below, which is shared with the worker
+     * threads
+     */
+    mutable QMutex m_mutex;
+
+    std::shared_ptr<const Stages> m_stages; ///< The functions to run
+
+    /**
+     * \brief The jobs waiting for each stage, and, at `StageCount`, the
+     * finished jobs waiting to be handed off
+     */
+    std::deque<Job> m_queues[StageCount + 1];
+
+    int m_running[StageCount];      ///< The busy threads of each stage
+    int m_pending[StageCount];      ///< The jobs running in each stage
+    int m_threads[StageCount];      ///< The threads for each stage
+    int m_queueDepth;               ///< Jobs queued per thread
+    int m_readBatch;                ///< Files read together
+    int m_handOffBatch;             ///< Results handed off at a time
+    quint64 m_epoch;                ///< Bumped by each `cancel`
+    bool m_handOffPosted;           ///< Whether `handOff` is on its way
+    bool m_readyPosted;             ///< Whether `readyForMore` is on its way
+
+    /**
+     * \brief The threads for each stage
+     * 
+     * The pools are declared last, so that they are destroyed first,
+     * waiting for any running work while the rest of the object is still
+     * intact.
+     */
+    QThreadPool m_pools[StageCount];
+
+};  // end ThumbnailPipeline class
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * \file thumbnailscheduler.cpp
+ * Implement the `ThumbnailScheduler` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <QThread>
+
+#include "thumbnailscheduler.h"
+
+ThumbnailScheduler::ThumbnailScheduler(QObject* parent) :
+        QObject(parent)
+        , m_queues()
+        , m_inFlight()
+        , m_lastTicket(0)
+        , m_running(0)
+        , m_viewParent()
+        , m_firstRow(-1)
+        , m_lastRow(-1)
+        , m_maxConcurrent(0)
+        , m_droppedCount(0)
+        , m_discardedCount(0)
+        , m_pipeline(new ThumbnailPipeline(this))
+{
+    connect(
+        m_pipeline
+        , &ThumbnailPipeline::finished
+        , this
+        , &ThumbnailScheduler::onFinished);
+
+    connect(
+        m_pipeline
+        , &ThumbnailPipeline::failed
+        , this
+        , &ThumbnailScheduler::onFailed);
+
+    connect(
+        m_pipeline
+        , &ThumbnailPipeline::readyForMore
+        , this
+        , &ThumbnailScheduler::dispatch);
+}
+
+void ThumbnailScheduler::setDecodeThreads(int threads)
+{
+    m_pipeline->setThreads(
+        ThumbnailPipeline::DecodeStage
+        , threads > 0 ? threads : QThread::idealThreadCount());
+}   // end setDecodeThreads method
+
+void ThumbnailScheduler::setMaxConcurrent(int maxConcurrent)
+{
+    m_maxConcurrent = qMax(0, maxConcurrent);
+    dispatch();
+}   // end setMaxConcurrent method
+
+void ThumbnailScheduler::setViewport(
+        const QModelIndex& first
+        , const QModelIndex& last)
+{
+    if (first.isValid() && last.isValid())
+    {
+        m_viewParent = first.parent();
+        m_firstRow = qMin(first.row(), last.row());
+        m_lastRow = qMax(first.row(), last.row());
+    }
+    else
+    {
+        m_viewParent = QPersistentModelIndex();
+        m_firstRow = m_lastRow = -1;
+    }
+
+    // Re-queue everything, keeping the existing order within each new
+    // priority level
+    QList<Request> requests;
+    for (auto& queue : m_queues)
+    {
+        requests.append(queue);
+        queue.clear();
+    }
+
+    for (const auto& request : requests)
+    {
+        int priority = priorityFor(request.index);
+        if (priority == PriorityCount)
+        {
+            ++m_droppedCount;
+            emit dropped(request.path, request.index);
+        }
+        else m_queues[priority].append(request);
+    }
+}   // end setViewport method
+
+int ThumbnailScheduler::prefetchRows(void) const
+{
+    return m_firstRow < 0 ? 0 : m_lastRow - m_firstRow + 1;
+}   // end prefetchRows method
+
+void ThumbnailScheduler::schedule(
+        const QString& path
+        , const QPersistentModelIndex& index)
+{
+    int priority = qMin<int>(priorityFor(index), BackgroundPriority);
+    m_queues[priority].append(Request{path, index});
+    dispatch();
+}   // end schedule method
+
+int ThumbnailScheduler::queuedCount(void) const
+{
+    int count = 0;
+    for (const auto& queue : m_queues) count += queue.size();
+    return count;
+}   // end queuedCount method
+
+int ThumbnailScheduler::priorityFor(const QPersistentModelIndex& index) const
+{
+    if (!index.isValid()) return PriorityCount;
+
+    // Until we know what is on screen, everything is visible
+    if (m_firstRow < 0) return VisiblePriority;
+
+    if (index.parent() != m_viewParent) return PriorityCount;
+
+    int row = index.row()
+        , distance = row < m_firstRow
+            ? m_firstRow - row
+            : (row > m_lastRow ? row - m_lastRow : 0)
+        , band = prefetchRows();
+
+    if (distance == 0) return VisiblePriority;
+    if (distance <= band) return PrefetchPriority;
+    if (distance <= 4 * band) return BackgroundPriority;
+    return PriorityCount;
+}   // end priorityFor method
+
+void ThumbnailScheduler::cancelAll(void)
+{
+    for (auto& queue : m_queues) queue.clear();
+
+    // Loads that are already running can't be stopped, but the pipeline
+    // discards their results, and they no longer count against the
+    // concurrency limit
+    m_pipeline->cancel();
+    m_discardedCount += static_cast<quint64>(m_inFlight.size());
+    m_inFlight.clear();
+    m_running = 0;
+}   // end cancelAll method
+
+void ThumbnailScheduler::dispatch(void)
+{
+    while ((m_maxConcurrent == 0 || m_running < m_maxConcurrent)
+            && m_pipeline->canSubmit())
+    {
+        QList<Request>* queue = nullptr;
+        for (auto& q : m_queues)
+            if (!q.isEmpty())
+            {
+                queue = &q;
+                break;
+            }
+
+        if (!queue) break;
+
+        Request request = queue->takeFirst();
+        if (!request.index.isValid())
+        {
+            // The item has gone from the model
+            ++m_droppedCount;
+            emit dropped(request.path, request.index);
+            continue;
+        }
+
+        // Only the path goes to the pipeline; the persistent index stays in
+        // this thread.
+        quint64 ticket = ++m_lastTicket;
+        m_inFlight.insert(ticket, request);
+        ++m_running;
+        m_pipeline->submit(ticket, request.path);
+    }
+}   // end dispatch method
+
+void ThumbnailScheduler::onFinished(quint64 ticket, const QImage& image)
+{
+    Request request;
+    if (takeFinished(ticket, request))
+        emit loaded(request.path, image, request.index);
+}   // end onFinished method
+
+void ThumbnailScheduler::onFailed(quint64 ticket)
+{
+    // The file may be readable later (e.g. once it has been written), so
+    // the client is free to ask for it again
+    Request request;
+    if (takeFinished(ticket, request))
+        emit dropped(request.path, request.index);
+}   // end onFailed method
+
+bool ThumbnailScheduler::takeFinished(quint64 ticket, Request& request)
+{
+    // Results of cancelled loads are discarded by the pipeline
+    auto it = m_inFlight.find(ticket);
+    if (it == m_inFlight.end()) return false;
+
+    request = it.value();
+    m_inFlight.erase(it);
+
+    --m_running;
+    dispatch();
+    return true;
+}   // end takeFinished method
@@ -0,0 +1,292 @@
+/**
+ * \file thumbnailscheduler.h
+ * Declare the `ThumbnailScheduler` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <QImage>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPersistentModelIndex>
+#include <QString>
+
+#include "thumbnailpipeline.h"
+
+#ifndef _gui_thumbnailscheduler_h_installed
+#define _gui_thumbnailscheduler_h_installed
+
+/**
+ * \brief Schedules background thumbnail loads in order of their distance
+ * from the part of a view that is on screen
+ * 
+ * Load requests are queued at one of three priority levels, according to
+ * where their rows are relative to the *viewport* (the range of rows that
+ * the view is currently showing):
+ * 
+ * * `VisiblePriority` -- rows in the viewport
+ * 
+ * * `PrefetchPriority` -- rows within one viewport's height either side
+ *   of it
+ * 
+ * * `BackgroundPriority` -- everything else
+ * 
+ * When the viewport moves (see `setViewport`), queued requests are
+ * re-prioritised, and requests for rows that are now far away from it are
+ * dropped altogether (the `dropped` signal is emitted for them, so that
+ * they can be requested again if they come back into view).
+ * 
+ * Loads are run by a `ThumbnailPipeline`, which reads, decodes and scales
+ * each thumbnail in stages with their own threads (see `setIoThreads`,
+ * `setDecodeThreads` and `setScaleThreads`). Requests are only handed to
+ * the pipeline when its read queue has room, so the pipeline holds just
+ * enough work to keep its threads busy, and the rest waits here, where it
+ * can still be re-prioritised; queued work for rows that have been
+ * scrolled away never holds up loads for rows on screen. The pipeline's
+ * threads belong to the scheduler, rather than being the application-wide
+ * `QThreadPool`, so thumbnails don't compete with other background work.
+ * 
+ * All outstanding work can be cancelled with `cancelAll` (e.g. when the
+ * view moves to a different directory): queued requests are forgotten, and
+ * the pipeline drops its own queued work and discards the results of
+ * running work, so cancelled requests are never reported with `loaded`.
+ */
+class ThumbnailScheduler : public QObject
+{
+
+    Q_OBJECT
+
+    public:
+
+    /**
+     * \brief The priority levels of requests, from highest to lowest
+     */
+    enum Priority
+    {
+        VisiblePriority = 0
+        , PrefetchPriority
+        , BackgroundPriority
+        , PriorityCount
+    };  // end Priority enum
+
+    /**
+     * \brief Standard constructor for Qt classes / objects
+     * 
+     * \param parent The parent of the object
+     */
+    explicit ThumbnailScheduler(QObject* parent = nullptr);
+
+    /**
+     * \brief Set the functions that load thumbnails, one for each stage of
+     * the pipeline
+     * 
+     * These apply to loads that are started after this is called.
+     */
+    void setLoader(
+        ThumbnailPipeline::Reader reader
+        , ThumbnailPipeline::Decoder decoder
+        , ThumbnailPipeline::Scaler scaler)
+    {
+        m_pipeline->setStages(
+            std::move(reader)
+            , std::move(decoder)
+            , std::move(scaler));
+    }
+
+    /**
+     * \brief Set the number of threads that read files
+     */
+    void setIoThreads(int threads)
+        { m_pipeline->setThreads(ThumbnailPipeline::ReadStage, threads); }
+
+    /**
+     * \brief Retrieve the number of threads that read files
+     */
+    int ioThreads(void) const
+        { return m_pipeline->threads(ThumbnailPipeline::ReadStage); }
+
+    /**
+     * \brief Set the number of threads that decode images; 0 means one per
+     * core
+     */
+    void setDecodeThreads(int threads);
+
+    /**
+     * \brief Retrieve the number of threads that decode images
+     */
+    int decodeThreads(void) const
+        { return m_pipeline->threads(ThumbnailPipeline::DecodeStage); }
+
+    /**
+     * \brief Set the number of threads that scale decoded images
+     */
+    void setScaleThreads(int threads)
+        { m_pipeline->setThreads(ThumbnailPipeline::ScaleStage, threads); }
+
+    /**
+     * \brief Retrieve the number of threads that scale decoded images
+     */
+    int scaleThreads(void) const
+        { return m_pipeline->threads(ThumbnailPipeline::ScaleStage); }
+
+    /**
+     * \brief Set the maximum number of loads that may run at once; 0 (the
+     * default) leaves it to the room in the pipeline
+     */
+    void setMaxConcurrent(int maxConcurrent);
+
+    /**
+     * \brief Retrieve the maximum number of loads that may run at once
+     */
+    int maxConcurrent(void) const { return m_maxConcurrent; }
+
+    /**
+     * \brief Set the range of rows that the view is currently showing
+     * 
+     * Queued requests are re-prioritised, and requests that are too far
+     * from the new viewport are dropped.
+     * 
+     * \param first The index of the first visible item
+     * 
+     * \param last The index of the last visible item; this must have the
+     * same parent as `first`
+     */
+    void setViewport(const QModelIndex& first, const QModelIndex& last);
+
+    /**
+     * \brief Retrieve the number of rows either side of the viewport that
+     * are prefetched
+     */
+    int prefetchRows(void) const;
+
+    /**
+     * \brief Queue a thumbnail load
+     * 
+     * The caller is responsible for not queuing the same file twice.
+     * 
+     * \param path The path of the file to load
+     * 
+     * \param index The model index of the item for the file
+     */
+    void schedule(const QString& path, const QPersistentModelIndex& index);
+
+    /**
+     * \brief Cancel all queued and running loads
+     * 
+     * No signals are emitted for the cancelled requests; the client should
+     * forget about all of its outstanding requests.
+     */
+    void cancelAll(void);
+
+    /**
+     * \brief Retrieve the number of requests waiting to be started
+     */
+    int queuedCount(void) const;
+
+    /**
+     * \brief Retrieve the number of requests that were dropped because
+     * they were too far from the viewport
+     */
+    quint64 droppedCount(void) const { return m_droppedCount; }
+
+    /**
+     * \brief Retrieve the number of loads that were cancelled after
+     * they had been started
+     */
+    quint64 discardedCount(void) const { return m_discardedCount; }
+
+    signals:
+
+    /**
+     * \brief Signal that a thumbnail has been loaded
+     * 
+     * This is emitted in the thread of the scheduler (i.e. the GUI thread).
+     * 
+     * \param path The path of the file
+     * 
+     * \param image The thumbnail (null if the file couldn't be loaded)
+     * 
+     * \param index The model index of the item for the file
+     */
+    void loaded(
+        const QString& path
+        , const QImage& image
+        , const QPersistentModelIndex& index);
+
+    /**
+     * \brief Signal that a request was dropped without being loaded, either
+     * while it was queued, or because the file couldn't be read
+     * 
+     * \param path The path of the file
+     * 
+     * \param index The model index of the item for the file
+     */
+    void dropped(const QString& path, const QPersistentModelIndex& index);
+
+    private:
+
+    /**
+     * \brief A queued load request
+     */
+    struct Request
+    {
+        QString path;                   ///< The file to load
+        QPersistentModelIndex index;    ///< The model item for the file
+    };  // end Request struct
+
+    /**
+     * \brief Work out the priority of a request from the position of its
+     * row relative to the viewport
+     * 
+     * \return The priority, or `PriorityCount` if the request should be
+     * dropped
+     */
+    int priorityFor(const QPersistentModelIndex& index) const;
+
+    /**
+     * \brief Start queued requests, highest priority first, until the
+     * pipeline's read queue is full or the concurrency limit is reached
+     */
+    void dispatch(void);
+
+    /**
+     * \brief Handle the completion of a load (in the scheduler's thread)
+     */
+    void onFinished(quint64 ticket, const QImage& image);
+
+    /**
+     * \brief Handle a load whose file couldn't be read (in the scheduler's
+     * thread)
+     */
+    void onFailed(quint64 ticket);
+
+    /**
+     * \brief Forget a finished load, and start another in its place
+     * 
+     * \return `false` if the load had been cancelled
+     */
+    bool takeFinished(quint64 ticket, Request& request);
+
+    QList<Request> m_queues[PriorityCount]; ///< Queued requests by priority
+    QHash<quint64, Request> m_inFlight;     ///< Running requests, by ticket
+    quint64 m_lastTicket;                   ///< Last ticket issued
+
+    int m_running;                  ///< Number of loads running
+
+    QPersistentModelIndex m_viewParent; ///< Parent of the viewport rows
+    int m_firstRow;                 ///< First viewport row (-1 if unknown)
+    int m_lastRow;                  ///< Last viewport row (-1 if unknown)
+
+    int m_maxConcurrent;            ///< Maximum number of loads running
+    quint64 m_droppedCount;         ///< Number of requests dropped
+    quint64 m_discardedCount;       ///< Number of loads cancelled
+    ThumbnailPipeline* m_pipeline;  ///< Runs the loads
+
+};  // end ThumbnailScheduler class
+
+#endif
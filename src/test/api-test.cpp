@@ -9,8 +9,13 @@
  * or copy at https://www.boost.org/LICENSE_1_0.txt
  */
 
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
 #include <catch2/catch.hpp>
 #include <api/api.h>
+#include <api/parallel.h>
 
 // simple test for the 'version' API function
 TEST_CASE("version", "unit")
@@ -19,3 +24,22 @@ TEST_CASE("version", "unit")
     REQUIRE(api::version().empty() == false);
     REQUIRE(api::wversion().empty() == false);
 }
+
+// work is spread over threads, and an exception from any of them stops the
+// rest and is passed on to the caller
+TEST_CASE("parallel for", "unit")
+{
+    std::vector<std::atomic<int>> counts(1000);
+    api::parallel_for(counts.size(), 4, [&](std::size_t i) { ++counts[i]; });
+    for (const auto& c : counts) REQUIRE(c.load() == 1);
+
+    std::atomic<int> calls(0);
+    REQUIRE_THROWS_AS(
+        api::parallel_for(1000, 4, [&](std::size_t i)
+        {
+            ++calls;
+            if (i == 10) throw std::runtime_error("failed");
+        })
+        , std::runtime_error);
+    REQUIRE(calls.load() < 1000);
+}
@@ -0,0 +1,158 @@
+/**
+ * \file batch-reader-test.cpp
+ * Tests for batched file reading
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/batch_reader.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+using test_utils::write_file;
+
+namespace {
+
+// make some distinctive contents of a given size
+std::string contents(std::size_t size, int seed)
+{
+    std::string s(size, '\0');
+    for (std::size_t i = 0; i < size; ++i)
+        s[i] = static_cast<char>((i * 31 + static_cast<std::size_t>(seed))
+            % 251);
+    return s;
+}
+
+}   // end anonymous namespace
+
+// whole files, headers and ranges are read, with or without io_uring, and
+// however many more files there are than reads in flight
+TEST_CASE("batch reader", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+
+    std::vector<std::string> files;
+    std::vector<api::read_request> requests;
+    for (int i = 0; i < 100; ++i)
+    {
+        // Sizes either side of the header length, and some empty files
+        std::size_t size = i % 10 == 0
+            ? 0
+            : 1000 * static_cast<std::size_t>(i * 37 % 200);
+        files.push_back(contents(size, i));
+
+        auto path = dir / ("f" + std::to_string(i) + ".jpg");
+        write_file(path, files.back());
+
+        api::read_request r;
+        r.path = path.string();
+        if (i % 3 == 1) r.length = 64 * 1024;
+        if (i % 3 == 2)
+        {
+            r.offset = 500;
+            r.length = 2000;
+        }
+        requests.push_back(r);
+    }
+
+    api::read_request missing;
+    missing.path = (dir / "missing.jpg").string();
+    requests.push_back(missing);
+
+    for (bool io_uring : { true, false })
+    {
+        api::batch_reader::options options;
+        options.queue_depth = 8;
+        options.max_bytes_in_flight = 200 * 1000;
+        options.use_io_uring = io_uring;
+        api::batch_reader reader(options);
+        if (!io_uring) REQUIRE_FALSE(reader.uses_io_uring());
+
+        std::vector<int> seen(requests.size(), 0);
+        reader.read(requests, [&](std::size_t i, api::read_result&& result)
+        {
+            ++seen[i];
+            if (i == files.size())
+            {
+                REQUIRE(result.error == ENOENT);
+                REQUIRE(result.data.empty());
+                return;
+            }
+
+            const auto& r = requests[i];
+            const auto& file = files[i];
+            REQUIRE(result.error == 0);
+            REQUIRE(result.file_size == file.size());
+
+            auto offset = std::min<std::size_t>(r.offset, file.size());
+            auto expected = file.substr(
+                offset
+                , std::min<std::uint64_t>(r.length, file.size() - offset));
+            REQUIRE(std::string(result.data.begin(), result.data.end())
+                == expected);
+        });
+
+        for (auto count : seen) REQUIRE(count == 1);
+    }
+
+    // an exception from the sink is passed on once the reads in flight are
+    // done, and the reader can still be used afterwards
+    api::batch_reader reader;
+    int reported = 0;
+    REQUIRE_THROWS_AS(
+        reader.read(requests, [&](std::size_t, api::read_result&&)
+        {
+            ++reported;
+            throw std::runtime_error("sink failed");
+        })
+        , std::runtime_error);
+    REQUIRE(reported == 1);
+
+    reported = 0;
+    reader.read(requests, [&](std::size_t, api::read_result&&)
+        { ++reported; });
+    REQUIRE(reported == static_cast<int>(requests.size()));
+
+    // when the io_uring fails part way through a batch, the reads it hadn't
+    // finished are made by threads, and so is everything after
+    for (unsigned fail_on : { 1u, 2u, 5u })
+    {
+        api::batch_reader::options options;
+        options.queue_depth = 8;
+        options.fail_io_uring_on = fail_on;
+        api::batch_reader failing(options);
+
+        for (int batch = 0; batch < 2; ++batch)
+        {
+            std::vector<int> seen(requests.size(), 0);
+            failing.read(requests, [&](std::size_t i, api::read_result&& r)
+            {
+                ++seen[i];
+                if (i == files.size()) return;
+
+                auto offset = std::min<std::size_t>(
+                    requests[i].offset
+                    , files[i].size());
+                REQUIRE(r.error == 0);
+                REQUIRE(std::string(r.data.begin(), r.data.end())
+                    == files[i].substr(offset, requests[i].length));
+            });
+
+            for (auto count : seen) REQUIRE(count == 1);
+            REQUIRE_FALSE(failing.uses_io_uring());
+        }
+    }
+}   // end batch reader test
@@ -0,0 +1,139 @@
+/**
+ * \file catalogue-test.cpp
+ * Tests for the `api::catalogue` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/catalogue.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+using test_utils::write_file;
+
+// rows are grouped by directory, and can be filtered, sorted and totalled
+TEST_CASE("catalogue columns", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    auto media = dir / "media";
+    bfs::create_directories(media / "sub");
+
+    // name, contents (so the size is the length), width, capture time
+    struct file
+    {
+        const char* name;
+        const char* contents;
+        std::uint32_t width;
+        std::int64_t captured;
+    };
+
+    std::vector<file> files = {
+        { "sub/b.jpg", "bbb", 4000, 1546344000 }
+        , { "c.jpg", "c", 640, 1560600000 }
+        , { "a.png", "aaaaa", 1920, 0 }
+        , { "sub/a.mp4", "aaaaaaa", 0, 0 }
+        , { "d.mp3", "dd", 0, 0 }
+    };
+
+    for (const auto& f : files)
+        write_file(media / f.name, f.contents);
+
+    api::media_index index((dir / "media.idx").string());
+    index.rescan(media.string());
+
+    for (const auto& f : files)
+    {
+        if (f.width == 0) continue;
+
+        api::media_record r;
+        REQUIRE(index.find((media / f.name).string(), r));
+        REQUIRE(index.set_details(r.path, r.size, r.mtime, f.width, 100, 1));
+
+        api::media_metadata m;
+        m.capture_time = f.captured;
+        REQUIRE(index.set_metadata(r.path, r.size, r.mtime, m));
+    }
+
+    api::catalogue cat(index);
+    REQUIRE(cat.size() == 5);
+
+    std::vector<std::string> paths;
+    for (std::uint32_t row = 0; row < cat.size(); ++row)
+        paths.push_back(cat.path(row));
+    REQUIRE(paths == std::vector<std::string>{
+        (media / "a.png").string()
+        , (media / "c.jpg").string()
+        , (media / "d.mp3").string()
+        , (media / "sub" / "a.mp4").string()
+        , (media / "sub" / "b.jpg").string() });
+
+    REQUIRE(cat.directory(4) == (media / "sub").string());
+    REQUIRE(cat.name(4) == "b.jpg");
+    REQUIRE(cat.file_size(4) == 3);
+    REQUIRE(cat.width(4) == 4000);
+    REQUIRE(cat.capture_time(4) == 1546344000);
+    REQUIRE(cat.type(3) == api::media_type::video);
+
+    REQUIRE(cat.rows_in(media.string()) == std::make_pair(0u, 3u));
+    REQUIRE(cat.rows_in((media / "sub").string()) == std::make_pair(3u, 5u));
+    REQUIRE(cat.rows_in((media / "none").string()).first
+        == cat.rows_in((media / "none").string()).second);
+
+    using rows = api::catalogue::row_list;
+
+    api::catalogue_filter filter;
+    REQUIRE(cat.select(filter) == rows{ 0, 1, 2, 3, 4 });
+
+    filter.types = 1 << static_cast<int>(api::media_type::image);
+    REQUIRE(cat.select(filter) == rows{ 0, 1, 4 });
+
+    filter.min_width = 1000;
+    REQUIRE(cat.select(filter) == rows{ 0, 4 });
+
+    filter = api::catalogue_filter();
+    filter.min_size = 2;
+    filter.max_size = 5;
+    REQUIRE(cat.select(filter) == rows{ 0, 2, 4 });
+
+    filter = api::catalogue_filter();
+    filter.max_capture_time = 1550000000;
+    REQUIRE(cat.select(filter) == rows{ 4 });
+
+    auto all = cat.select(api::catalogue_filter());
+    cat.sort(all, api::catalogue_key::size);
+    REQUIRE(all == rows{ 1, 2, 4, 0, 3 });
+    cat.sort(all, api::catalogue_key::size, true);
+    REQUIRE(all == rows{ 3, 0, 4, 2, 1 });
+    cat.sort(all, api::catalogue_key::capture_time);
+    REQUIRE(all == rows{ 0, 2, 3, 4, 1 });
+    cat.sort(all, api::catalogue_key::pixels, true);
+    REQUIRE(all == rows{ 4, 0, 1, 2, 3 });
+    cat.sort(all, api::catalogue_key::path);
+    REQUIRE(all == rows{ 0, 1, 2, 3, 4 });
+
+    auto totals = cat.totals();
+    REQUIRE(totals.files == 5);
+    REQUIRE(totals.bytes == 18);
+    REQUIRE(totals.type_files[0] == 3);
+    REQUIRE(totals.type_bytes[0] == 9);
+    REQUIRE(totals.type_bytes[1] == 7);
+    REQUIRE(totals.type_bytes[2] == 2);
+    REQUIRE(totals.first_capture_time == 1546344000);
+    REQUIRE(totals.last_capture_time == 1560600000);
+
+    totals = cat.totals(rows{ 2, 3 });
+    REQUIRE(totals.files == 2);
+    REQUIRE(totals.bytes == 9);
+    REQUIRE(totals.first_capture_time == 0);
+}   // end catalogue columns test
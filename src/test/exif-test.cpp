@@ -0,0 +1,90 @@
+/**
+ * \file exif-test.cpp
+ * Tests for the EXIF reading functionality of the API
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <api/exif.h>
+
+#include "test_utils.h"
+
+using namespace test_utils;
+
+namespace {
+
+// build a minimal JPEG file whose EXIF block has an IFD0 with one entry,
+// and an IFD1 describing the given preview bytes
+bytes make_jpeg(const bytes& preview, bool le)
+{
+    bytes tiff;
+    tiff.push_back(le ? 'I' : 'M');
+    tiff.push_back(le ? 'I' : 'M');
+    put16(tiff, 42, le);
+    put32(tiff, 8, le);
+
+    // IFD0: orientation only, then the offset of IFD1
+    put16(tiff, 1, le);
+    put16(tiff, 0x0112, le); put16(tiff, 3, le); put32(tiff, 1, le);
+    put16(tiff, 6, le); put16(tiff, 0, le);
+    put32(tiff, 26, le);
+
+    // IFD1: the preview offset and length
+    unsigned long preview_offset = 26 + 2 + 2 * 12 + 4;
+    put16(tiff, 2, le);
+    put_entry(tiff, 0x0201, 4, 1, preview_offset, le);
+    put_entry(tiff, 0x0202, 4, 1, preview.size(), le);
+    put32(tiff, 0, le);
+    tiff.insert(tiff.end(), preview.begin(), preview.end());
+
+    return make_exif_jpeg(tiff);
+}
+
+}   // end anonymous namespace
+
+// the embedded preview is found in both byte orders
+TEST_CASE("exif thumbnail location", "unit")
+{
+    bytes preview = { 0xff, 0xd8, 1, 2, 3, 4, 0xff, 0xd9 };
+
+    for (bool le : { true, false })
+    {
+        auto jpeg = make_jpeg(preview, le);
+        api::exif::thumbnail_location loc{0, 0};
+
+        REQUIRE(api::exif::find_thumbnail(jpeg.data(), jpeg.size(), loc));
+        REQUIRE(loc.length == preview.size());
+        REQUIRE(bytes(
+                jpeg.begin() + loc.offset
+                , jpeg.begin() + loc.offset + loc.length) == preview);
+    }
+}
+
+// files without a usable preview are reported as such, rather than failing
+TEST_CASE("exif thumbnail missing", "unit")
+{
+    api::exif::thumbnail_location loc{0, 0};
+
+    // not a JPEG
+    bytes png = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+    REQUIRE_FALSE(api::exif::find_thumbnail(png.data(), png.size(), loc));
+
+    // a JPEG with no EXIF segment
+    bytes plain = { 0xff, 0xd8, 0xff, 0xda, 0x00, 0x02, 0xff, 0xd9 };
+    REQUIRE_FALSE(api::exif::find_thumbnail(plain.data(), plain.size(), loc));
+
+    // a preview that is not itself a JPEG
+    auto bad = make_jpeg(bytes{ 1, 2, 3, 4 }, true);
+    REQUIRE_FALSE(api::exif::find_thumbnail(bad.data(), bad.size(), loc));
+
+    // a header that has been truncated part-way through the EXIF block
+    auto jpeg = make_jpeg(bytes{ 0xff, 0xd8, 0xff, 0xd9 }, true);
+    REQUIRE_FALSE(api::exif::find_thumbnail(jpeg.data(), 40, loc));
+}
@@ -0,0 +1,103 @@
+/**
+ * \file hash-test.cpp
+ * Tests for content hashing and duplicate detection
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstring>
+#include <string>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/duplicates.h>
+#include <api/hash.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+using test_utils::write_file;
+
+// XXH64 matches the reference implementation, however data is split
+TEST_CASE("xxh64", "unit")
+{
+    REQUIRE(api::hash::xxh64_of("", 0) == 0xef46db3751d8e999ull);
+    REQUIRE(api::hash::xxh64_of("a", 1) == 0xd24ec4f1a98c6e5bull);
+    REQUIRE(api::hash::xxh64_of("abc", 3) == 0x44bc2cf5ad770999ull);
+
+    const char* text = "Nobody inspects the spammish repetition";
+    auto length = std::strlen(text);
+    REQUIRE(api::hash::xxh64_of(text, length) == 0xfbcea83c8a378bf1ull);
+
+    std::string data;
+    for (int i = 0; i < 1000; ++i) data += static_cast<char>(i * 7);
+    auto whole = api::hash::xxh64_of(data.data(), data.size());
+
+    for (std::size_t split : { 1u, 5u, 31u, 32u, 33u, 100u, 999u })
+    {
+        api::hash::xxh64 h;
+        h.update(data.data(), split);
+        h.update(data.data() + split, data.size() - split);
+        REQUIRE(h.digest() == whole);
+    }
+}   // end xxh64 test
+
+// duplicates are found in stages, and their hashes are kept in the index
+TEST_CASE("find duplicates", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    auto root = dir / "media";
+    bfs::create_directories(root / "sub");
+
+    // big files that differ only in the middle get past the partial hash
+    std::string big(300 * 1024, 'b'), big_changed = big;
+    big_changed[150 * 1024] = 'x';
+
+    write_file(root / "a.jpg", "same contents");
+    write_file(root / "sub" / "b.jpg", "same contents");
+    write_file(root / "c.jpg", "diff contents");
+    write_file(root / "unique.jpg", "a unique length");
+    write_file(root / "big1.png", big);
+    write_file(root / "sub" / "big2.png", big);
+    write_file(root / "big3.png", big_changed);
+    write_file(root / "empty1.jpg", "");
+    write_file(root / "empty2.jpg", "");
+
+    api::media_index index((dir / "media.idx").string());
+    index.rescan(root.string());
+
+    api::duplicate_statistics stats;
+    auto groups = api::find_duplicates(index, 4, &stats);
+
+    REQUIRE(groups.size() == 2);
+    REQUIRE(groups[0].size == big.size());
+    REQUIRE(groups[0].paths.size() == 2);
+    REQUIRE(groups[0].paths[0] == (root / "big1.png").string());
+    REQUIRE(groups[0].paths[1] == (root / "sub" / "big2.png").string());
+    REQUIRE(groups[1].paths.size() == 2);
+    REQUIRE(groups[1].paths[0] == (root / "a.jpg").string());
+
+    REQUIRE(stats.files == 9);
+    REQUIRE(stats.same_size == 6);
+    REQUIRE(stats.ends_hashed == 6);
+    REQUIRE(stats.fully_hashed == 5);   // all but c.jpg
+    REQUIRE(stats.errors == 0);
+
+    // the full hashes are reused; c.jpg now shares its size with files
+    // whose full hashes are known, so it has to be hashed in full too
+    groups = api::find_duplicates(index, 1, &stats);
+    REQUIRE(groups.size() == 2);
+    REQUIRE(stats.hashes_reused == 5);
+    REQUIRE(stats.fully_hashed == 1);
+
+    groups = api::find_duplicates(index, 1, &stats);
+    REQUIRE(groups.size() == 2);
+    REQUIRE(stats.hashes_reused == 6);
+    REQUIRE(stats.fully_hashed == 0);
+    REQUIRE(stats.bytes_read == 0);
+}   // end find duplicates test
@@ -0,0 +1,262 @@
+/**
+ * \file media-index-test.cpp
+ * Tests for the `api::media_index` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <ctime>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/error.h>
+#include <api/media_index.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+using test_utils::write_file;
+
+namespace {
+
+// backdate the modification times of a tree, so that later changes are
+// certain to show up
+void backdate(const bfs::path& root)
+{
+    auto t = std::time(nullptr) - 1000;
+    bfs::last_write_time(root, t);
+    for (bfs::recursive_directory_iterator it(root), end; it != end; ++it)
+        bfs::last_write_time(it->path(), t);
+}
+
+}   // end anonymous namespace
+
+// the index is built, persisted and rescanned incrementally
+TEST_CASE("media index rescan", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    auto root = dir / "media";
+    auto file = (dir / "index" / "media.idx").string();
+
+    bfs::create_directories(root / "a" / "b");
+    bfs::create_directories(root / "c");
+    write_file(root / "top.jpg", 10);
+    write_file(root / "a" / "one.png", 20);
+    write_file(root / "a" / "b" / "two.mp4", 30);
+    write_file(root / "c" / "three.mp3", 40);
+    write_file(root / "c" / "notes.txt", 5);
+    backdate(root);
+
+    api::scanner::options opts;
+    opts.threads = 2;
+
+    {
+        api::media_index index(file);
+        REQUIRE(index.size() == 0);
+
+        auto stats = index.rescan(root.string(), opts);
+        REQUIRE(stats.added == 4);
+        REQUIRE(stats.changed == 0);
+        REQUIRE(stats.removed == 0);
+        REQUIRE(stats.scan.directories == 4);
+        REQUIRE(index.size() == 4);
+
+        api::media_record r;
+        REQUIRE(index.find((root / "a" / "one.png").string(), r));
+        REQUIRE(r.size == 20);
+        REQUIRE(r.width == 0);
+        REQUIRE(r.type == api::media_type::image);
+        REQUIRE_FALSE(index.find((root / "c" / "notes.txt").string(), r));
+
+        REQUIRE(index.set_details(r.path, r.size, r.mtime, 640, 480, 1234));
+        REQUIRE_FALSE(index.set_details(
+            r.path
+            , r.size + 1
+            , r.mtime
+            , 1
+            , 1
+            , 1));
+    }
+
+    {
+        api::media_index index(file);
+        REQUIRE(index.size() == 4);
+
+        api::media_record r;
+        REQUIRE(index.find((root / "a" / "one.png").string(), r));
+        REQUIRE(r.width == 640);
+        REQUIRE(r.height == 480);
+        REQUIRE(r.hash == 1234);
+
+        // nothing has changed, so no directory is read
+        auto stats = index.rescan(root.string(), opts);
+        REQUIRE(stats.scan.directories == 0);
+        REQUIRE(stats.scan.skipped == 4);
+        REQUIRE(stats.added + stats.changed + stats.removed == 0);
+
+        // only changed directories are read
+        write_file(root / "a" / "b" / "new.jpg", 50);
+        bfs::remove_all(root / "c");
+        stats = index.rescan(root.string(), opts);
+        REQUIRE(stats.scan.directories == 2);
+        REQUIRE(stats.scan.skipped == 1);
+        REQUIRE(stats.added == 1);
+        REQUIRE(stats.removed == 1);
+        REQUIRE(index.size() == 4);
+        REQUIRE_FALSE(index.find((root / "c" / "three.mp3").string(), r));
+        REQUIRE(index.find((root / "a" / "b" / "new.jpg").string(), r));
+
+        std::size_t count = 0;
+        REQUIRE(index.for_each_in(
+            (root / "a" / "b").string()
+            , [&count](const api::media_record&) { ++count; }));
+        REQUIRE(count == 2);
+    }
+
+    // a damaged tail is dropped, and the rest of the index survives
+    {
+        std::ofstream f(file, std::ios::binary | std::ios::app);
+        f << "garbage";
+    }
+
+    {
+        api::media_index index(file);
+        REQUIRE(index.size() == 4);
+
+        api::media_record r;
+        REQUIRE(index.find((root / "a" / "b" / "new.jpg").string(), r));
+    }
+}   // end media index rescan test
+
+// the per-directory totals follow the files and directories as they change,
+// and come out the same when the index is loaded again
+TEST_CASE("media index directory summaries", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    auto root = dir / "media";
+    auto file = (dir / "index" / "media.idx").string();
+
+    bfs::create_directories(root / "a" / "b");
+    bfs::create_directories(root / "c");
+    write_file(root / "top.jpg", 10);
+    write_file(root / "a" / "one.png", 20);
+    write_file(root / "a" / "b" / "two.mp4", 30);
+    write_file(root / "a" / "b" / "three.jpg", 40);
+    write_file(root / "c" / "four.mp3", 50);
+    backdate(root);
+
+    api::scanner::options opts;
+    opts.threads = 2;
+
+    auto check = [](
+            const api::media_index& index
+            , const bfs::path& path
+            , std::uint64_t files
+            , std::uint64_t bytes
+            , std::uint64_t tree_files
+            , std::uint64_t tree_bytes)
+    {
+        api::directory_summary s;
+        REQUIRE(index.summarise(path.string(), s));
+        REQUIRE(s.files == files);
+        REQUIRE(s.bytes == bytes);
+        REQUIRE(s.tree_files == tree_files);
+        REQUIRE(s.tree_bytes == tree_bytes);
+    };
+
+    {
+        api::media_index index(file);
+
+        // a sub-directory indexed before its parent is counted in the
+        // parent's totals once the parent is read
+        index.rescan((root / "a").string(), opts);
+        check(index, root / "a", 1, 20, 3, 90);
+        index.rescan(root.string(), opts);
+
+        check(index, root, 1, 10, 5, 150);
+        check(index, root / "a", 1, 20, 3, 90);
+        check(index, root / "a" / "b", 2, 70, 2, 70);
+        check(index, root / "c", 1, 50, 1, 50);
+
+        api::directory_summary s;
+        REQUIRE(index.summarise(root.string(), s));
+        REQUIRE(s.mtime >= 0);
+        REQUIRE(s.subdirectories.size() == 2);
+        REQUIRE_FALSE(index.summarise((root / "d").string(), s));
+
+        write_file(root / "a" / "b" / "five.jpg", 60);
+        write_file(root / "a" / "b" / "two.mp4", 35);
+        bfs::remove_all(root / "c");
+        index.refresh(
+            {(root / "a" / "b").string(), (root / "c").string()}
+            , opts);
+
+        check(index, root, 1, 10, 5, 165);
+        check(index, root / "a", 1, 20, 4, 155);
+        check(index, root / "a" / "b", 3, 135, 3, 135);
+        REQUIRE_FALSE(index.summarise((root / "c").string(), s));
+
+        // a directory read on its own leaves its sub-directories unread,
+        // which shows in its own and its ancestors' summaries
+        bfs::create_directories(root / "d" / "e");
+        write_file(root / "d" / "e" / "six.jpg", 70);
+        api::scanner::options single;
+        single.recursive = false;
+
+        index.rescan((root / "d").string(), single);
+        REQUIRE(index.summarise((root / "d").string(), s));
+        REQUIRE(s.mtime >= 0);
+        REQUIRE(s.unread_directories == 1);
+        REQUIRE(index.summarise(root.string(), s));
+        REQUIRE(s.unread_directories == 1);
+        check(index, root / "d" / "e", 0, 0, 0, 0);
+
+        index.rescan((root / "d" / "e").string(), single);
+        check(index, root / "d", 0, 0, 1, 70);
+        check(index, root, 1, 10, 6, 235);
+        REQUIRE(index.summarise(root.string(), s));
+        REQUIRE(s.unread_directories == 0);
+    }
+
+    {
+        api::media_index index(file);
+        check(index, root, 1, 10, 6, 235);
+        check(index, root / "a", 1, 20, 4, 155);
+        check(index, root / "a" / "b", 3, 135, 3, 135);
+        check(index, root / "d", 0, 0, 1, 70);
+
+        api::directory_summary s;
+        REQUIRE(index.summarise(root.string(), s));
+        REQUIRE(s.unread_directories == 0);
+        REQUIRE(s.subdirectories.size() == 2);
+    }
+}   // end media index directory summaries test
+
+// a file that isn't an index is refused rather than overwritten, but an
+// older or damaged index is rebuilt
+TEST_CASE("media index foreign file", "unit")
+{
+    test_utils::temp_directory temp;
+    auto root = temp.path();
+
+    auto photo = root / "photo.jpg";
+    write_file(photo, 100);
+    REQUIRE_THROWS_AS(api::media_index(photo.string()), api::error);
+    REQUIRE(bfs::file_size(photo) == 100);
+
+    auto old = root / "old.idx";
+    {
+        std::ofstream f(old.string(), std::ios::binary);
+        f << "MIDXLG01" << std::string(50, 'x');
+    }
+    api::media_index index(old.string());
+    REQUIRE(index.size() == 0);
+    REQUIRE(bfs::file_size(old) == 8);
+}   // end media index foreign file test
@@ -0,0 +1,168 @@
+/**
+ * \file metadata-test.cpp
+ * Tests for reading metadata, and extracting it into the index
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/exif.h>
+#include <api/extractor.h>
+#include <api/metadata.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+using namespace test_utils;
+
+namespace {
+
+// build a JPEG file with EXIF (camera, capture time, orientation, lens and
+// GPS), an XMP packet with two keywords, and a 4000x3000 frame header
+bytes make_jpeg(void)
+{
+    bytes tiff = { 'I', 'I', 42, 0 };
+    put32(tiff, 8);
+
+    // IFD0 at 8; its values follow it at 74
+    put16(tiff, 5);
+    put_entry(tiff, 0x010f, 2, 6, 74);
+    put_entry(tiff, 0x0110, 2, 4, 0);
+    tiff.erase(tiff.end() - 4, tiff.end());
+    put_text(tiff, std::string("EOS", 4));
+    put_entry(tiff, 0x0112, 3, 1, 6);
+    put_entry(tiff, 0x8769, 4, 1, 80);
+    put_entry(tiff, 0x8825, 4, 1, 130);
+    put32(tiff, 0);
+    put_text(tiff, std::string("Canon", 6));
+
+    // Exif IFD at 80; the date follows it at 110
+    put16(tiff, 2);
+    put_entry(tiff, 0x9003, 2, 20, 110);
+    put_entry(tiff, 0xa434, 2, 3, 0);
+    tiff.erase(tiff.end() - 4, tiff.end());
+    put_text(tiff, std::string("50", 4));
+    put32(tiff, 0);
+    put_text(tiff, std::string("2019:06:15 12:30:45", 20));
+
+    // GPS IFD at 130; the rationals follow it at 184
+    put16(tiff, 4);
+    put_entry(tiff, 1, 2, 2, 'N');
+    put_entry(tiff, 2, 5, 3, 184);
+    put_entry(tiff, 3, 2, 2, 'W');
+    put_entry(tiff, 4, 5, 3, 208);
+    put32(tiff, 0);
+    for (unsigned long v : { 33, 1, 51, 1, 36, 1, 151, 1, 12, 1, 36, 1 })
+        put32(tiff, v);
+
+    bytes segments, xmp;
+    put_text(xmp, std::string("http://ns.adobe.com/xap/1.0/", 29));
+    put_text(xmp
+        , "<x:xmpmeta><rdf:RDF><rdf:Description><dc:subject><rdf:Bag>"
+        "<rdf:li>beach</rdf:li><rdf:li>Tom &amp; Jerry</rdf:li>"
+        "</rdf:Bag></dc:subject></rdf:Description></rdf:RDF></x:xmpmeta>");
+    put_segment(segments, 0xe1, xmp);
+
+    // An 8-bit, 4000x3000 frame with three components
+    put_segment(segments, 0xc0, {
+        0x08, 0x0b, 0xb8, 0x0f, 0xa0, 0x03
+        , 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 });
+
+    return make_exif_jpeg(tiff, segments);
+}
+
+}   // end anonymous namespace
+
+// all the supported fields are read from the headers
+TEST_CASE("metadata read", "unit")
+{
+    auto jpeg = make_jpeg();
+    api::media_metadata m;
+    REQUIRE(api::exif::read_metadata(jpeg.data(), jpeg.size(), m));
+
+    REQUIRE(m.make == "Canon");
+    REQUIRE(m.model == "EOS");
+    REQUIRE(m.lens == "50");
+    REQUIRE(m.orientation == 6);
+    REQUIRE(m.capture_time == 1560601845);
+    REQUIRE(m.width == 4000);
+    REQUIRE(m.height == 3000);
+    REQUIRE(m.has_location);
+    REQUIRE(m.latitude == Approx(33.86));
+    REQUIRE(m.longitude == Approx(-151.21));
+    REQUIRE(m.keywords == std::vector<std::string>{ "beach", "Tom & Jerry" });
+
+    // the serialised form survives a round trip, and damage is detected
+    bytes encoded;
+    api::encode_metadata(m, encoded);
+
+    api::media_metadata decoded;
+    REQUIRE(api::decode_metadata(encoded.data(), encoded.size(), decoded));
+    REQUIRE(decoded == m);
+    REQUIRE_FALSE(
+        api::decode_metadata(encoded.data(), encoded.size() - 1, decoded));
+
+    // a truncated header yields what it can, without failing
+    api::media_metadata partial;
+    REQUIRE(api::exif::read_metadata(jpeg.data(), 100, partial));
+
+    bytes text = { 'h', 'e', 'l', 'l', 'o' };
+    REQUIRE_FALSE(api::exif::read_metadata(text.data(), text.size(), m));
+}   // end metadata read test
+
+// metadata is extracted in parallel, persisted, and not read again
+TEST_CASE("metadata extraction", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    auto root = dir / "media";
+    auto file = (dir / "media.idx").string();
+
+    bfs::create_directories(root);
+    write_file(root / "photo.jpg", make_jpeg());
+    write_file(root / "broken.jpg", bytes{ 1, 2, 3 });
+    write_file(root / "clip.mp4", bytes{ 1, 2, 3 });
+    auto photo = (root / "photo.jpg").string();
+
+    {
+        api::media_index index(file);
+        index.rescan(root.string());
+
+        api::extraction_statistics stats;
+        api::extract_metadata(index, 2, &stats);
+        REQUIRE(stats.files == 2);
+        REQUIRE(stats.extracted == 2);
+        REQUIRE(stats.errors == 1);
+        REQUIRE(stats.bytes_read == make_jpeg().size() + 3);
+
+        api::media_record r;
+        REQUIRE(index.find(photo, r));
+        REQUIRE(r.metadata);
+        REQUIRE(r.metadata->make == "Canon");
+        REQUIRE(r.width == 4000);
+        REQUIRE(r.height == 3000);
+    }
+
+    {
+        api::media_index index(file);
+
+        api::media_record r;
+        REQUIRE(index.find(photo, r));
+        REQUIRE(r.metadata);
+        REQUIRE(r.metadata->capture_time == 1560601845);
+        REQUIRE(r.metadata->keywords.size() == 2);
+
+        api::extraction_statistics stats;
+        api::extract_metadata(index, 2, &stats);
+        REQUIRE(stats.reused == 2);
+        REQUIRE(stats.extracted == 0);
+    }
+}   // end metadata extraction test
@@ -0,0 +1,82 @@
+/**
+ * \file path-table-test.cpp
+ * Tests for the `api::path_table` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <api/path_table.h>
+
+// paths are numbered in order, found again, and rebuilt from their parts
+TEST_CASE("path table interning", "unit")
+{
+    api::path_table table;
+    using id_type = api::path_table::id_type;
+
+    REQUIRE(table.intern("/photos/2019/a.jpg") == 0);
+    REQUIRE(table.intern("/photos/2019/b.jpg") == 1);
+    REQUIRE(table.intern("/photos/a.jpg") == 2);
+    REQUIRE(table.intern("/top.jpg") == 3);
+    REQUIRE(table.intern("relative.jpg") == 4);
+    REQUIRE(table.intern("/photos/2019/a.jpg") == 0);
+
+    REQUIRE(table.size() == 5);
+    REQUIRE(table.directory_count() == 4);
+
+    REQUIRE(table.path(1) == "/photos/2019/b.jpg");
+    REQUIRE(table.path(3) == "/top.jpg");
+    REQUIRE(table.path(4) == "relative.jpg");
+    REQUIRE(table.directory(1) == "/photos/2019");
+    REQUIRE(table.directory(3) == "/");
+    REQUIRE(table.name(2) == "a.jpg");
+    REQUIRE(table.directory_id(0) == table.directory_id(1));
+
+    id_type id = 0;
+    REQUIRE(table.find("/photos/a.jpg", id));
+    REQUIRE(id == 2);
+    REQUIRE_FALSE(table.find("/photos/b.jpg", id));
+    REQUIRE_FALSE(table.find("/elsewhere/a.jpg", id));
+
+    REQUIRE(table.find_directory("/photos", id));
+    REQUIRE(table.directory_path(id) == "/photos");
+    REQUIRE_FALSE(table.find_directory("/photos/2018", id));
+
+    // enough paths to grow the hash table several times
+    std::vector<std::string> paths;
+    for (int d = 0; d < 50; ++d)
+        for (int f = 0; f < 200; ++f)
+            paths.push_back(
+                "/archive/" + std::to_string(d) + "/IMG_"
+                + std::to_string(f) + ".jpg");
+
+    for (const auto& p : paths) table.intern(p);
+    REQUIRE(table.size() == 5 + paths.size());
+
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        REQUIRE(table.find(paths[i], id));
+        REQUIRE(id == 5 + i);
+        REQUIRE(table.path(id) == paths[i]);
+    }
+
+    // the directory prefixes are held once, not per path, so the table is
+    // smaller than the strings it replaces, even before counting their
+    // heap overheads
+    table.shrink_to_fit();
+    std::size_t strings = paths.size() * sizeof(std::string);
+    for (const auto& p : paths) strings += p.size() + 1;
+    REQUIRE(table.memory_usage() < strings * 2 / 3);
+
+    table.clear();
+    REQUIRE(table.size() == 0);
+    REQUIRE_FALSE(table.find("/photos/a.jpg", id));
+    REQUIRE(table.intern("/photos/a.jpg") == 0);
+}   // end path table interning test
@@ -0,0 +1,153 @@
+/**
+ * \file scanner-test.cpp
+ * Tests for the `api::scanner` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <map>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/error.h>
+#include <api/scanner.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+using test_utils::write_file;
+
+// media files are recognised by their extensions
+TEST_CASE("media classification", "unit")
+{
+    api::media_type type;
+
+    REQUIRE(api::classify_media("a.jpg", type));
+    REQUIRE(type == api::media_type::image);
+    REQUIRE(api::classify_media("/x/B.JPEG", type));
+    REQUIRE(type == api::media_type::image);
+    REQUIRE(api::classify_media("clip.Mov", type));
+    REQUIRE(type == api::media_type::video);
+    REQUIRE(api::classify_media("song.flac", type));
+    REQUIRE(type == api::media_type::audio);
+
+    REQUIRE_FALSE(api::classify_media("notes.txt", type));
+    REQUIRE_FALSE(api::classify_media("jpg", type));
+    REQUIRE_FALSE(api::classify_media("dir.jpg/file", type));
+    REQUIRE_FALSE(api::classify_media("a.", type));
+}   // end media classification test
+
+// a tree is scanned for media files with any number of threads
+TEST_CASE("scanner", "unit")
+{
+    test_utils::temp_directory temp;
+    auto root = temp.path();
+    bfs::create_directories(root / "a" / "b" / "c");
+    bfs::create_directories(root / "empty");
+
+    std::map<std::string, std::size_t> expected = {
+        { (root / "top.jpg").string(), 10 }
+        , { (root / "a" / "clip.mp4").string(), 20 }
+        , { (root / "a" / "b" / "song.MP3").string(), 30 }
+        , { (root / "a" / "b" / "c" / "deep.png").string(), 40 }
+    };
+
+    for (const auto& e : expected) write_file(e.first, e.second);
+    write_file(root / "readme.txt", 5);
+    write_file(root / "a" / "b" / "data.bin", 5);
+
+    for (unsigned threads : { 1u, 4u })
+    {
+        api::scanner::options opts;
+        opts.threads = threads;
+        api::scanner scanner(opts);
+
+        std::vector<api::media_file> found;
+        auto stats = scanner.scan(
+            root.string() + "/"
+            , [&found](std::vector<api::media_file>&& batch)
+            {
+                found.insert(found.end(), batch.begin(), batch.end());
+            });
+
+        REQUIRE(stats.directories == 5);
+        REQUIRE(stats.files == 4);
+        REQUIRE(stats.entries == 10);
+        REQUIRE(stats.errors == 0);
+
+        REQUIRE(found.size() == expected.size());
+        for (const auto& f : found)
+        {
+            auto it = expected.find(f.path);
+            REQUIRE(it != expected.end());
+            REQUIRE(f.size == it->second);
+            REQUIRE(f.mtime > 0);
+        }
+
+        auto clip = std::find_if(
+            found.begin()
+            , found.end()
+            , [](const api::media_file& f)
+            {
+                return bfs::path(f.path).filename() == "clip.mp4";
+            });
+        REQUIRE(clip != found.end());
+        REQUIRE(clip->type == api::media_type::video);
+    }
+
+    // a non-recursive scan sees only the top level
+    api::scanner::options opts;
+    opts.recursive = false;
+    std::size_t count = 0;
+    api::scanner(opts).scan(
+        root.string()
+        , [&count](std::vector<api::media_file>&& batch)
+        {
+            count += batch.size();
+        });
+    REQUIRE(count == 1);
+
+    REQUIRE_THROWS_AS(
+        api::scanner().scan((root / "missing").string(), nullptr)
+        , api::error);
+}   // end scanner test
+
+// a symbolic link to the root is followed, as are links to media files, but
+// not links to directories
+TEST_CASE("scanner symbolic links", "unit")
+{
+    test_utils::temp_directory temp;
+    auto base = temp.path();
+    auto real = base / "real";
+    bfs::create_directories(real / "sub");
+    write_file(real / "a.jpg", 10);
+    write_file(real / "sub" / "b.png", 20);
+    write_file(base / "outside.mov", 30);
+
+    bfs::create_symlink(base / "outside.mov", real / "linked.mov");
+    bfs::create_symlink(base / "missing.jpg", real / "dangling.jpg");
+    bfs::create_symlink(real / "sub", real / "loop");
+    bfs::create_directory_symlink(real, base / "link");
+
+    std::map<std::string, std::size_t> found;
+    auto stats = api::scanner().scan(
+        (base / "link").string()
+        , [&found](std::vector<api::media_file>&& batch)
+        {
+            for (const auto& f : batch) found[f.path] = f.size;
+        });
+
+    std::map<std::string, std::size_t> expected = {
+        { (base / "link" / "a.jpg").string(), 10 }
+        , { (base / "link" / "linked.mov").string(), 30 }
+        , { (base / "link" / "sub" / "b.png").string(), 20 }
+    };
+    REQUIRE(found == expected);
+    REQUIRE(stats.directories == 2);
+    REQUIRE(stats.errors == 1);
+}   // end scanner symbolic links test
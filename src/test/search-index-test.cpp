@@ -0,0 +1,182 @@
+/**
+ * \file search-index-test.cpp
+ * Tests for the `api::posting_list` and `api::search_index` classes
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/error.h>
+#include <api/search_index.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+using test_utils::write_file;
+
+namespace {
+
+using number_set = std::set<std::uint32_t>;
+
+// make a posting list and a reference set with the same random contents:
+// a dense chunk (held as a bitmap), a sparse one (held as an array), and a
+// few scattered numbers
+void make_random(
+        std::mt19937& rng
+        , api::posting_list& list
+        , number_set& reference)
+{
+    std::uniform_int_distribution<std::uint32_t> dense(0, 65535);
+    std::uniform_int_distribution<std::uint32_t> sparse(65536, 131071);
+    std::uniform_int_distribution<std::uint32_t> anywhere(0, 1u << 22);
+
+    for (int i = 0; i < 20000; ++i) reference.insert(dense(rng));
+    for (int i = 0; i < 1000; ++i) reference.insert(sparse(rng));
+    for (int i = 0; i < 100; ++i) reference.insert(anywhere(rng));
+
+    // added out of order, to exercise insertion
+    std::vector<std::uint32_t> numbers(reference.begin(), reference.end());
+    std::shuffle(numbers.begin(), numbers.end(), rng);
+    for (auto n : numbers) list.add(n);
+}
+
+std::vector<std::uint32_t> to_vector(const number_set& s)
+{
+    return std::vector<std::uint32_t>(s.begin(), s.end());
+}
+
+}   // end anonymous namespace
+
+// set operations agree with std::set, across container kinds
+TEST_CASE("posting list operations", "unit")
+{
+    std::mt19937 rng(42);
+    api::posting_list a, b;
+    number_set ra, rb;
+    make_random(rng, a, ra);
+    make_random(rng, b, rb);
+
+    REQUIRE(a.numbers() == to_vector(ra));
+    REQUIRE(a.size() == ra.size());
+    REQUIRE(a.contains(*ra.begin()));
+    REQUIRE(a.memory_usage() < ra.size() * sizeof(std::uint32_t));
+
+    number_set expected;
+    std::set_intersection(
+        ra.begin(), ra.end(), rb.begin(), rb.end()
+        , std::inserter(expected, expected.end()));
+    REQUIRE((a & b).numbers() == to_vector(expected));
+
+    expected.clear();
+    std::set_union(
+        ra.begin(), ra.end(), rb.begin(), rb.end()
+        , std::inserter(expected, expected.end()));
+    REQUIRE((a | b).numbers() == to_vector(expected));
+
+    expected.clear();
+    std::set_difference(
+        ra.begin(), ra.end(), rb.begin(), rb.end()
+        , std::inserter(expected, expected.end()));
+    REQUIRE((a - b).numbers() == to_vector(expected));
+
+    // complements, and results that shrink back into arrays
+    auto everything = api::posting_list::all(200000);
+    REQUIRE(everything.size() == 200000);
+    REQUIRE((everything - (everything - a)) == (a & everything));
+    REQUIRE((a - a).empty());
+}   // end posting list operations test
+
+// queries combine terms and capture date ranges
+TEST_CASE("search index queries", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    bfs::create_directories(dir / "media");
+
+    struct photo
+    {
+        const char* name;
+        const char* make;
+        const char* lens;
+        std::int64_t captured;
+        std::vector<std::string> keywords;
+    };
+
+    // 2019-01-01, 2019-06-15 and 2020-02-29, all at noon
+    std::vector<photo> photos = {
+        { "a.jpg", "Canon", "EF 50mm", 1546344000, { "beach", "Family" } }
+        , { "b.jpg", "Nikon", "", 1560600000, { "beach" } }
+        , { "c.jpg", "Canon", "", 1582977600, { "mountain" } }
+        , { "d.jpg", "", "", 0, {} }
+    };
+
+    for (const auto& p : photos)
+        write_file(dir / "media" / p.name, p.name);
+    write_file(dir / "media" / "e.mp4", "video");
+
+    api::media_index media((dir / "media.idx").string());
+    media.rescan((dir / "media").string());
+
+    for (const auto& p : photos)
+    {
+        api::media_record r;
+        REQUIRE(media.find((dir / "media" / p.name).string(), r));
+
+        api::media_metadata m;
+        m.make = p.make;
+        m.lens = p.lens;
+        m.capture_time = p.captured;
+        m.keywords = p.keywords;
+        REQUIRE(media.set_metadata(r.path, r.size, r.mtime, m));
+    }
+
+    api::search_index index(media);
+    REQUIRE(index.size() == 5);
+
+    auto names = [&](const std::string& query)
+    {
+        std::vector<std::string> result;
+        for (const auto& p : index.paths(index.query(query)))
+            result.push_back(bfs::path(p).filename().string());
+        return result;
+    };
+    using names_type = std::vector<std::string>;
+
+    REQUIRE(names("beach") == names_type{ "a.jpg", "b.jpg" });
+    REQUIRE(names("tag:FAMILY") == names_type{ "a.jpg" });
+    REQUIRE(names("beach make:canon") == names_type{ "a.jpg" });
+    REQUIRE(names("beach AND NOT make:canon") == names_type{ "b.jpg" });
+    REQUIRE(names("camera:nikon OR mountain")
+        == names_type{ "b.jpg", "c.jpg" });
+    REQUIRE(names("-(make:canon OR make:nikon) type:image")
+        == names_type{ "d.jpg" });
+    REQUIRE(names("lens:\"EF 50mm\"") == names_type{ "a.jpg" });
+    REQUIRE(names("type:video") == names_type{ "e.mp4" });
+
+    REQUIRE(names("date:2019") == names_type{ "a.jpg", "b.jpg" });
+    REQUIRE(names("date:2019-06") == names_type{ "b.jpg" });
+    REQUIRE(names("date:2019-06-15..") == names_type{ "b.jpg", "c.jpg" });
+    REQUIRE(names("date:..2019-01-01") == names_type{ "a.jpg" });
+    REQUIRE(names("date:2020-02-29 OR missing") == names_type{ "c.jpg" });
+
+    REQUIRE(index.query("").size() == 5);
+    REQUIRE_THROWS_AS(index.query("(beach"), api::error);
+    REQUIRE_THROWS_AS(index.query("beach AND"), api::error);
+    REQUIRE_THROWS_AS(index.query("colour:red"), api::error);
+    REQUIRE_THROWS_AS(index.query("date:June"), api::error);
+    REQUIRE_THROWS_AS(index.query("date:20190"), api::error);
+    REQUIRE_THROWS_AS(index.query("date:2019--"), api::error);
+    REQUIRE_THROWS_AS(index.query("date:2019-06-"), api::error);
+}   // end search index queries test
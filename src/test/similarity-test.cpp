@@ -0,0 +1,107 @@
+/**
+ * \file similarity-test.cpp
+ * Tests for perceptual hashing and similarity search
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <api/similarity.h>
+
+namespace {
+
+// make a grayscale test pattern of the given size, with a bright blob on a
+// gradient
+std::vector<unsigned char> make_pattern(unsigned width, unsigned height)
+{
+    std::vector<unsigned char> pixels(width * height);
+    for (unsigned y = 0; y < height; ++y)
+        for (unsigned x = 0; x < width; ++x)
+        {
+            double fx = double(x) / width, fy = double(y) / height;
+            double v = 200 * fx * fy;
+            if ((fx - 0.3) * (fx - 0.3) + (fy - 0.6) * (fy - 0.6) < 0.04)
+                v = 255;
+            pixels[y * width + x] = static_cast<unsigned char>(v);
+        }
+    return pixels;
+}
+
+}   // end anonymous namespace
+
+// resized images have (nearly) the same hash; different images don't
+TEST_CASE("dhash", "unit")
+{
+    using namespace api::similarity;
+
+    auto large = make_pattern(640, 480), small = make_pattern(80, 60);
+    auto h_large = dhash(large.data(), 640, 480, 640)
+        , h_small = dhash(small.data(), 80, 60, 80);
+    REQUIRE(distance(h_large, h_small) <= 4);
+
+    // a mirrored image looks quite different
+    auto mirrored = small;
+    for (unsigned y = 0; y < 60; ++y)
+        for (unsigned x = 0; x < 80; ++x)
+            mirrored[y * 80 + x] = small[y * 80 + 79 - x];
+    REQUIRE(distance(h_small, dhash(mirrored.data(), 80, 60, 80)) > 20);
+
+    // a flat image and a tiny one still hash
+    std::vector<unsigned char> flat(100, 128);
+    REQUIRE(dhash(flat.data(), 10, 10, 10) != 0);
+    REQUIRE(dhash(flat.data(), 3, 2, 3) != 0);
+}   // end dhash test
+
+// the BK-tree finds what a brute-force search finds, but visits less
+TEST_CASE("similarity index", "unit")
+{
+    using namespace api::similarity;
+
+    std::mt19937_64 random(42);
+    std::vector<std::uint64_t> hashes;
+    index idx;
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        auto h = random();
+
+        // every tenth image has a near-duplicate
+        if (i % 10 == 1) h = hashes.back() ^ (1ull << (h % 64));
+        hashes.push_back(h);
+        idx.add("image" + std::to_string(i), h);
+    }
+
+    REQUIRE(idx.size() == hashes.size());
+
+    for (int q = 0; q < 20; ++q)
+    {
+        auto query = hashes[q * 10] ^ (1ull << q);
+        std::set<std::string> expected;
+        for (std::size_t i = 0; i < hashes.size(); ++i)
+            if (distance(hashes[i], query) <= 4)
+                expected.insert("image" + std::to_string(i));
+
+        std::size_t visited = 0;
+        auto found = idx.find(query, 4, &visited);
+        std::set<std::string> paths;
+        for (const auto& m : found)
+        {
+            REQUIRE(m.distance <= 4);
+            paths.insert(m.path);
+        }
+
+        REQUIRE(paths == expected);
+        REQUIRE(expected.size() >= 2);
+        REQUIRE(found.front().distance <= found.back().distance);
+        REQUIRE(visited < hashes.size() / 2);
+    }
+}   // end similarity index test
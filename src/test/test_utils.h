@@ -0,0 +1,186 @@
+/**
+ * \file test_utils.h
+ * Declare helpers shared by the tests
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#ifndef _test_test_utils_h_included
+#define _test_test_utils_h_included
+
+namespace test_utils {
+
+/**
+ * \brief A new, empty directory under the system's temporary directory,
+ * which is removed (with everything in it) when this goes out of scope
+ * 
+ * The directory is removed even when a failed assertion ends the test
+ * early.
+ */
+class temp_directory
+{
+    public:
+
+    /**
+     * \brief Constructor, creating the directory
+     */
+    temp_directory(void) :
+        m_path(
+            boost::filesystem::temp_directory_path()
+            / boost::filesystem::unique_path())
+    {
+        boost::filesystem::create_directories(m_path);
+    }
+
+    /**
+     * \brief Destructor, removing the directory
+     */
+    ~temp_directory(void)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(m_path, ec);
+    }
+
+    temp_directory(const temp_directory&) = delete;
+    temp_directory& operator=(const temp_directory&) = delete;
+
+    /**
+     * \brief Retrieve the path of the directory
+     */
+    const boost::filesystem::path& path(void) const { return m_path; }
+
+    private:
+
+    boost::filesystem::path m_path; ///< The path of the directory
+
+};  // end temp_directory class
+
+/**
+ * \brief Write a file with the given contents
+ */
+inline void write_file(
+    const boost::filesystem::path& path
+    , const std::string& contents)
+{
+    std::ofstream f(path.string(), std::ios::binary);
+    f << contents;
+}
+
+/**
+ * \brief Write a file of the given size
+ */
+inline void write_file(const boost::filesystem::path& path, std::size_t size)
+{
+    write_file(path, std::string(size, 'x'));
+}
+
+/**
+ * \brief Write a file with the given bytes
+ */
+inline void write_file(
+    const boost::filesystem::path& path
+    , const std::vector<unsigned char>& contents)
+{
+    std::ofstream f(path.string(), std::ios::binary);
+    f.write(
+        reinterpret_cast<const char*>(contents.data())
+        , static_cast<std::streamsize>(contents.size()));
+}
+
+/**
+ * \brief Bytes for building test files
+ */
+using bytes = std::vector<unsigned char>;
+
+/**
+ * \brief Append a 16-bit value, little-endian unless `le` is `false`
+ */
+inline void put16(bytes& b, unsigned long v, bool le = true)
+{
+    if (le) { b.push_back(v & 0xff); b.push_back((v >> 8) & 0xff); }
+    else { b.push_back((v >> 8) & 0xff); b.push_back(v & 0xff); }
+}
+
+/**
+ * \brief Append a 32-bit value, little-endian unless `le` is `false`
+ */
+inline void put32(bytes& b, unsigned long v, bool le = true)
+{
+    if (le) { put16(b, v & 0xffff, le); put16(b, v >> 16, le); }
+    else { put16(b, v >> 16, le); put16(b, v & 0xffff, le); }
+}
+
+/**
+ * \brief Append the characters of a string
+ */
+inline void put_text(bytes& b, const std::string& s)
+{
+    b.insert(b.end(), s.begin(), s.end());
+}
+
+/**
+ * \brief Append a TIFF IFD entry
+ */
+inline void put_entry(
+    bytes& b
+    , unsigned tag
+    , unsigned type
+    , unsigned long count
+    , unsigned long value
+    , bool le = true)
+{
+    put16(b, tag, le);
+    put16(b, type, le);
+    put32(b, count, le);
+    put32(b, value, le);
+}
+
+/**
+ * \brief Append a JPEG marker segment, with its length
+ */
+inline void put_segment(bytes& jpeg, unsigned char marker, const bytes& body)
+{
+    jpeg.push_back(0xff);
+    jpeg.push_back(marker);
+    put16(jpeg, body.size() + 2, false);
+    jpeg.insert(jpeg.end(), body.begin(), body.end());
+}
+
+/**
+ * \brief Build a minimal JPEG file holding a TIFF structure as its EXIF
+ * block
+ * 
+ * \param tiff The TIFF header and IFDs, with offsets from its start
+ * 
+ * \param segments Any further marker segments (see `put_segment`), which
+ * go between the EXIF block and the scan
+ */
+inline bytes make_exif_jpeg(const bytes& tiff, const bytes& segments = {})
+{
+    bytes exif;
+    put_text(exif, std::string("Exif\0\0", 6));
+    exif.insert(exif.end(), tiff.begin(), tiff.end());
+
+    bytes jpeg = { 0xff, 0xd8 };
+    put_segment(jpeg, 0xe1, exif);
+    jpeg.insert(jpeg.end(), segments.begin(), segments.end());
+
+    for (unsigned char c : { 0xff, 0xda, 0x00, 0x02, 0x12, 0x34, 0xff, 0xd9 })
+        jpeg.push_back(c);
+    return jpeg;
+}
+
+}   // end test_utils namespace
+
+#endif
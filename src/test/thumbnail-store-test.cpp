@@ -0,0 +1,127 @@
+/**
+ * \file thumbnail-store-test.cpp
+ * Tests for the `api::thumbnail_store` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <fstream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/thumbnail_store.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+
+// thumbnails are stored, found and invalidated by file size / time / box
+TEST_CASE("thumbnail store lookup", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    std::vector<unsigned char> thumb = { 1, 2, 3, 4, 5 }, found;
+
+    {
+        api::thumbnail_store store(dir.string());
+        REQUIRE_FALSE(store.lookup("/media/a.jpg", 100, 5000, 150, 150, found));
+
+        REQUIRE(store.store(
+            "/media/a.jpg"
+            , 100
+            , 5000
+            , 150
+            , 150
+            , thumb.data()
+            , thumb.size()));
+
+        REQUIRE(store.lookup("/media/a.jpg", 100, 5000, 150, 150, found));
+        REQUIRE(found == thumb);
+
+        // a change to any part of the key is a miss
+        REQUIRE_FALSE(store.lookup("/media/a.jpg", 101, 5000, 150, 150, found));
+        REQUIRE_FALSE(store.lookup("/media/a.jpg", 100, 5001, 150, 150, found));
+        REQUIRE_FALSE(store.lookup("/media/a.jpg", 100, 5000, 100, 100, found));
+        REQUIRE_FALSE(store.lookup("/other/a.jpg", 100, 5000, 150, 150, found));
+    }
+
+    // thumbnails persist in a new store over the same directory
+    {
+        api::thumbnail_store store(dir.string());
+        REQUIRE(store.lookup("/media/a.jpg", 100, 5000, 150, 150, found));
+        REQUIRE(found == thumb);
+
+        // a new thumbnail for a changed file supersedes the old one
+        std::vector<unsigned char> newer = { 9, 8, 7 };
+        REQUIRE(store.store(
+            "/media/a.jpg"
+            , 200
+            , 6000
+            , 150
+            , 150
+            , newer.data()
+            , newer.size()));
+        REQUIRE(store.lookup("/media/a.jpg", 200, 6000, 150, 150, found));
+        REQUIRE(found == newer);
+        REQUIRE_FALSE(store.lookup("/media/a.jpg", 100, 5000, 150, 150, found));
+    }
+}
+
+// a pack with a partial record at the end (e.g. after a crash) keeps its
+// intact records and remains usable
+TEST_CASE("thumbnail store damaged pack", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    std::vector<unsigned char> thumb = { 1, 2, 3 }, found;
+
+    {
+        api::thumbnail_store store(dir.string());
+        REQUIRE(store.store("/m/a.png", 1, 2, 64, 64, thumb.data(), 3));
+    }
+
+    for (bfs::directory_iterator it(dir), end; it != end; ++it)
+        std::ofstream(it->path().string(), std::ios::binary | std::ios::app)
+            << "garbage";
+
+    {
+        api::thumbnail_store store(dir.string());
+        REQUIRE(store.lookup("/m/a.png", 1, 2, 64, 64, found));
+        REQUIRE(store.store("/m/b.png", 1, 2, 64, 64, thumb.data(), 3));
+    }
+
+    {
+        api::thumbnail_store store(dir.string());
+        REQUIRE(store.lookup("/m/a.png", 1, 2, 64, 64, found));
+        REQUIRE(store.lookup("/m/b.png", 1, 2, 64, 64, found));
+    }
+}
+
+// stores sharing a directory (as separate processes would) don't lose each
+// other's thumbnails, and pick them up when they next write to a pack
+TEST_CASE("thumbnail store sharing", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    std::vector<unsigned char> thumb = { 1, 2, 3 }, found;
+
+    api::thumbnail_store first(dir.string()), second(dir.string());
+    REQUIRE(first.store("/m/a.jpg", 1, 1, 10, 10, thumb.data(), 3));
+    REQUIRE(second.lookup("/m/a.jpg", 1, 1, 10, 10, found));
+
+    REQUIRE(first.store("/m/b.jpg", 2, 2, 10, 10, thumb.data(), 3));
+    REQUIRE_FALSE(second.lookup("/m/b.jpg", 2, 2, 10, 10, found));
+
+    REQUIRE(second.store("/m/c.jpg", 3, 3, 10, 10, thumb.data(), 3));
+    REQUIRE(second.lookup("/m/b.jpg", 2, 2, 10, 10, found));
+
+    api::thumbnail_store third(dir.string());
+    REQUIRE(third.lookup("/m/a.jpg", 1, 1, 10, 10, found));
+    REQUIRE(third.lookup("/m/b.jpg", 2, 2, 10, 10, found));
+    REQUIRE(third.lookup("/m/c.jpg", 3, 3, 10, 10, found));
+}
@@ -0,0 +1,95 @@
+/**
+ * \file watcher-test.cpp
+ * Tests for the `api::watcher` class
+ * 
+ * \author Igor Siemienowicz
+ * 
+ * \copyright Copyright Igor Siemienowicz 2019 Distributed under the Boost
+ * Software License, Version 1.0. (See accompanying file ../LICENSE_1_0.txt
+ * or copy at https://www.boost.org/LICENSE_1_0.txt
+ */
+
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+#include <catch2/catch.hpp>
+#include <api/watcher.h>
+
+#include "test_utils.h"
+
+namespace bfs = boost::filesystem;
+using test_utils::write_file;
+
+namespace {
+
+// wait (for a while) for a condition to become true
+template <typename Condition>
+bool wait_for(Condition c)
+{
+    for (int i = 0; i < 500 && !c(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return c();
+}
+
+}   // end anonymous namespace
+
+// changes to the tree are batched and applied to the index and store
+TEST_CASE("watcher", "unit")
+{
+    test_utils::temp_directory temp;
+    auto dir = temp.path();
+    auto root = dir / "media";
+    bfs::create_directories(root / "a");
+    write_file(root / "a" / "old.jpg", 10);
+
+    api::media_index index((dir / "media.idx").string());
+    auto store = std::make_shared<api::thumbnail_store>(
+        (dir / "thumbnails").string());
+
+    std::vector<unsigned char> thumb = { 1, 2, 3 }, found;
+    auto old_path = (root / "a" / "old.jpg").string();
+    api::media_record r;
+    std::int64_t old_mtime = 0;
+
+    {
+        api::watcher::options opts;
+        opts.debounce = std::chrono::milliseconds(100);
+        api::watcher watcher(index, store, root.string(), opts);
+
+        REQUIRE(index.size() == 1);
+        REQUIRE(index.find(old_path, r));
+        old_mtime = r.mtime;
+        REQUIRE(store->store(old_path, 10, old_mtime, 9, 9, thumb.data(), 3));
+        REQUIRE(store->lookup(old_path, 10, old_mtime, 9, 9, found));
+
+        if (watcher.polling())
+        {
+            WARN("inotify is not available; skipping watcher checks");
+            return;
+        }
+
+        // let the watcher install its watches
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        // a bulk import is applied in a handful of batches
+        for (int i = 0; i < 200; ++i)
+            write_file(root / "a" / ("new" + std::to_string(i) + ".jpg"), 5);
+        bfs::create_directories(root / "b" / "c");
+        write_file(root / "b" / "c" / "deep.png", 5);
+        bfs::remove(old_path);
+
+        REQUIRE(wait_for([&index] { return index.size() == 201; }));
+        REQUIRE(index.find((root / "b" / "c" / "deep.png").string(), r));
+        REQUIRE_FALSE(index.find(old_path, r));
+        REQUIRE(watcher.statistics().batches <= 3);
+        REQUIRE(watcher.statistics().events >= 200);
+
+        // files added to a new directory after it was read are picked up
+        write_file(root / "b" / "c" / "later.png", 5);
+        REQUIRE(wait_for([&index] { return index.size() == 202; }));
+    }
+
+    // the thumbnail of the removed file has gone
+    REQUIRE_FALSE(store->lookup(old_path, 10, old_mtime, 9, 9, found));
+}   // end watcher test